@@ -0,0 +1,85 @@
+// A pipeline that needs only fields held by an index reads them from the index keys rather than
+// fetching documents, if the query requires them to be there.  Check that such pipelines return
+// what fetching would, and that explain shows indexOnly for them and not for pipelines that need
+// other fields, fields that may be missing or a multikey index.
+
+var t = db.covered_pipeline;
+t.drop();
+
+var sharded = (typeof(RUNNING_IN_SHARDED_AGG_TEST) != 'undefined'); // see end of testshard1.js
+
+for (var i = 0; i < 1000; i++) {
+    t.insert({ a: i % 10, b: i % 7, c: i, pad: "not in the index" });
+}
+t.ensureIndex({ a: 1, b: 1 });
+
+// the index holds null for a missing b, so b has to be required to cover it
+var match = { $match: { a: { $gte: 3, $lt: 7 }, b: { $gte: 0 } } };
+var group = { $group: { _id: { a: "$a", b: "$b" }, n: { $sum: 1 } } };
+
+// what the pipelines should return, counted from the documents
+var expected;
+function countGroups(query) {
+    expected = {};
+    t.find(query).forEach(function(doc) {
+        var key = doc.a + "," + doc.b;
+        expected[key] = (expected[key] || 0) + 1;
+    });
+}
+countGroups(match.$match);
+
+function check(pipeline) {
+    var res = t.aggregate(pipeline).toArray();
+    assert.eq(Object.keySet(expected).length, res.length, tojson(pipeline));
+    res.forEach(function(g) {
+        assert.eq(expected[g._id.a + "," + g._id.b], g.n, tojson(pipeline));
+    });
+}
+
+function cursorExplain(pipeline) {
+    var res = db.runCommand({ aggregate: t.getName(), pipeline: pipeline, explain: true });
+    assert.commandWorked(res);
+    assert(res.stages[0].$cursor, tojson(res));
+    return res.stages[0].$cursor;
+}
+
+var covered = [[match, group],
+               [match, { $sort: { a: 1 } }, group],
+               [match, { $project: { _id: 0, b: 1 } }, { $group: { _id: "$b", n: { $sum: 1 } } }]];
+covered.slice(0, 2).forEach(check);
+
+// $sum of c needs the documents
+var fetched = [match, { $group: { _id: { a: "$a", b: "$b" }, n: { $sum: 1 }, c: { $sum: "$c" } } }];
+check(fetched);
+
+if (!sharded) {
+    covered.forEach(function(p) {
+        var explain = cursorExplain(p);
+        assert.eq(true, explain.plan.indexOnly, tojson(explain));
+        assert.eq("BtreeCursor a_1_b_1", explain.plan.cursor, tojson(explain));
+    });
+    assert.eq({ a: 1 }, cursorExplain(covered[1]).sort);
+    assert.eq(false, cursorExplain(fetched).plan.indexOnly);
+
+    // a missing b groups apart from a null one, which only the documents can tell
+    t.insert({ a: 4, c: 2000 });
+    t.insert({ a: 4, b: null, c: 2001 });
+    var mayBeMissing = [{ $match: { a: { $gte: 3, $lt: 7 } } }, group];
+    assert.eq(false, cursorExplain(mayBeMissing).plan.indexOnly);
+    countGroups(mayBeMissing[0].$match);
+    assert(expected["4,undefined"] && expected["4,null"], tojson(expected));
+    check(mayBeMissing);
+
+    // the covered pipeline, which requires b, leaves both out as before
+    countGroups(match.$match);
+    assert.eq(true, cursorExplain(covered[0]).plan.indexOnly);
+    check(covered[0]);
+
+    // a multikey index can't say which element of an array a key came from
+    t.insert({ a: 5, b: [1, 2], c: 1000 });
+    expected["5,1,2"] = 1;
+    assert.eq(false, cursorExplain(covered[0]).plan.indexOnly);
+    check(covered[0]);
+}
+
+t.drop();
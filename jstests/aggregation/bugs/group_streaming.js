@@ -0,0 +1,91 @@
+// $group returns groups as it goes when an index sorts its input on the group _id, so it doesn't
+// hold every group in memory.  Check that it returns the same groups as the hashed $group, that
+// multikey indexes (which need not return equal arrays together) are not streamed, that more
+// groups than fit in memory can be streamed, and that a streamed group larger than the memory
+// limit fails as the hashed one does.
+
+var t = db.group_streaming;
+t.drop();
+
+var sharded = (typeof(RUNNING_IN_SHARDED_AGG_TEST) != 'undefined'); // see end of testshard1.js
+
+function sortById(docs) {
+    return docs.sort(function(l, r) { return bsonWoCompare({ x: l._id }, { x: r._id }); });
+}
+
+function check(idSpec, sortSpec, query) {
+    var match = { $match: query || {} };
+    var group = { $group: { _id: idSpec, n: { $sum: 1 }, v: { $push: "$v" } } };
+    var hashed = sortById(t.aggregate([match, group]).toArray());
+    var streamed = t.aggregate([match, { $sort: sortSpec }, group]).toArray();
+    assert.eq(hashed.length, streamed.length, tojson(sortSpec));
+    sortById(streamed).forEach(function(g, i) {
+        assert.eq(hashed[i]._id, g._id, tojson(sortSpec));
+        assert.eq(hashed[i].n, g.n, tojson(sortSpec));
+        assert.eq(hashed[i].v.sort(), g.v.sort(), tojson(sortSpec));
+    });
+}
+
+for (var i = 0; i < 1000; i++) {
+    // null, missing, ints and doubles that compare equal group together
+    var a = i % 7 == 0 ? null : (i % 2 ? (i % 13) : (i % 13) + 0.0);
+    var doc = { v: i, b: i % 3 };
+    if (i % 11 != 0)
+        doc.a = a;
+    t.insert(doc);
+}
+t.ensureIndex({ a: 1, b: -1 });
+
+check("$a", { a: 1 });
+check("$a", { a: -1, b: 1 });
+// a compound _id keeps a missing 'a' missing, where the index has null, so this is only streamed
+// when the query requires 'a'
+check({ x: "$b", y: "$a" }, { a: 1, b: -1 });
+check({ x: "$b", y: "$a" }, { a: 1, b: -1 }, { a: { $gte: 0 }, b: { $exists: true } });
+
+// equal arrays are not next to each other in a multikey index on them
+t.insert({ a: [1, 5], v: 1000, b: 0 });
+t.insert({ a: 1, v: 1001, b: 0 });
+t.insert({ a: [1, 5], v: 1002, b: 0 });
+check("$a", { a: 1 });
+check({ x: "$b", y: "$a" }, { a: 1, b: -1 });
+
+if (!sharded) {
+    // more than 100MB of groups, one per document, fit when streamed from the _id index
+    t.drop();
+    var bigStr = Array(1024 * 1024 + 1).toString(); // 1MB of ','
+    for (var i = 0; i < 101; i++)
+        t.insert({ _id: i, bigStr: i + bigStr });
+
+    var group = { $group: { _id: "$_id", bigStr: { $first: "$bigStr" } } };
+    var res = t.runCommand("aggregate", { pipeline: [group] });
+    assert.commandFailed(res);
+    assert.eq(16945, res.code);
+
+    assert.eq(101, t.aggregate([{ $sort: { _id: 1 } }, group]).itcount());
+    assert.eq(101, t.aggregate([{ $sort: { _id: -1 } }, group]).itcount());
+
+    // a streamed $group holds only one group, but that group is still held to the memory limit
+    t.drop();
+    for (var i = 0; i < 110; i++)
+        t.insert({ _id: i, g: 0, bigStr: i + bigStr });
+    t.ensureIndex({ g: 1 });
+
+    group = { $group: { _id: "$g", bigStr: { $push: "$bigStr" } } };
+    res = t.runCommand("aggregate", { pipeline: [group] });
+    assert.commandFailed(res);
+    assert.eq(16945, res.code);
+
+    [{ g: 1 }, { g: -1 }].forEach(function(sortSpec) {
+        res = t.runCommand("aggregate", { pipeline: [{ $sort: sortSpec }, group] });
+        assert.commandFailed(res, tojson(sortSpec));
+        assert.eq(16945, res.code, tojson(sortSpec));
+
+        res = t.runCommand("aggregate", { pipeline: [{ $sort: sortSpec }, group],
+                                          allowDiskUse: true });
+        assert.commandFailed(res, tojson(sortSpec));
+        assert.eq(16945, res.code, tojson(sortSpec));
+    });
+}
+
+t.drop();
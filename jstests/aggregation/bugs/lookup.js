@@ -0,0 +1,102 @@
+// $lookup joins each document to those of another collection with an equal field, through an
+// index on the foreign field if there is one and a hash table of the foreign collection if not.
+// Check that both return the same joins, in input order, that explain shows which was used, and
+// that a hash table too big for memory is spilled with allowDiskUse and refused without it.  When
+// sharded, the join must run on the merger, which can read the foreign collection.
+
+var local = db.lookup_local;
+var foreign = db.lookup_foreign;
+local.drop();
+foreign.drop();
+
+var sharded = (typeof(RUNNING_IN_SHARDED_AGG_TEST) != 'undefined'); // see end of testshard1.js
+if (sharded) {
+    // spread the input over the shards; the foreign collection stays on the primary shard
+    db.adminCommand({ shardcollection: local.getFullName(), key: { _id: 'hashed' } });
+}
+
+for (var i = 0; i < 500; i++) {
+    local.insert({ _id: i, a: i % 23 == 0 ? null : i % 50 });
+    if (i % 3 == 0)
+        foreign.insert({ _id: i, b: i % 40, tag: "f" + i });
+}
+foreign.insert({ _id: "missing" });
+foreign.insert({ _id: "array", b: [7, 8] });
+
+var lookup = { $lookup: { from: foreign.getName(), localField: "a", foreignField: "b",
+                          as: "joined" } };
+
+function joins() {
+    return local.aggregate([{ $sort: { _id: 1 } }, lookup]).toArray().map(function(doc) {
+        var ids = doc.joined.map(function(f) { return f._id; }).sort();
+        return { _id: doc._id, ids: ids };
+    });
+}
+
+function strategy() {
+    var res = db.runCommand({ aggregate: local.getName(), pipeline: [lookup], explain: true });
+    assert.commandWorked(res);
+    return res.stages[1].$lookup.strategy;
+}
+
+var hashed = joins();
+assert.eq(500, hashed.length);
+hashed.forEach(function(doc, i) {
+    assert.eq(i, doc._id); // in input order
+
+    // what the query system would match
+    var expected = foreign.find({ b: local.findOne({ _id: i }).a }).toArray()
+                          .map(function(f) { return f._id; }).sort();
+    assert.eq(expected, doc.ids, tojson(doc));
+});
+
+// without a $sort before it, which would make the split itself
+function unsortedJoins(pipeline) {
+    return local.aggregate(pipeline).toArray().map(function(doc) {
+        var ids = doc.joined.map(function(f) { return f._id; }).sort();
+        return { _id: doc._id, ids: ids };
+    }).sort(function(l, r) { return l._id - r._id; });
+}
+assert.eq(hashed, unsortedJoins([lookup]));
+assert.eq(hashed.filter(function(doc) { return doc._id % 2; }),
+          unsortedJoins([{ $match: { _id: { $mod: [2, 1] } } }, lookup]));
+
+if (sharded) {
+    var res = db.runCommand({ aggregate: local.getName(), pipeline: [lookup], explain: true });
+    assert.commandWorked(res);
+    assert.eq([], res.splitPipeline.shardsPart, tojson(res));
+    assert.eq(foreign.getName(), res.splitPipeline.mergerPart[0].$lookup.from, tojson(res));
+}
+
+foreign.ensureIndex({ b: 1 });
+assert.eq(hashed, joins());
+assert.eq(hashed, unsortedJoins([lookup]));
+
+if (!sharded) {
+    assert.eq("indexedLoop", strategy());
+    foreign.dropIndex({ b: 1 });
+    assert.eq("hashTable", strategy());
+
+    // more than the 100MB a hash table may use, one 1MB document per join key
+    local.drop();
+    foreign.drop();
+    var bigStr = Array(1024 * 1024 + 1).toString(); // 1MB of ','
+    for (var i = 0; i < 101; i++) {
+        foreign.insert({ _id: i, b: i, bigStr: bigStr });
+        local.insert({ _id: i, a: 100 - i });
+    }
+
+    var pipeline = [{ $sort: { _id: 1 } }, lookup, { $project: { a: 1, n: { $size: "$joined" } } }];
+    var res = local.runCommand("aggregate", { pipeline: pipeline });
+    assert.commandFailed(res);
+    assert.eq(18619, res.code);
+
+    var out = local.aggregate(pipeline, { allowDiskUse: true }).toArray();
+    assert.eq(101, out.length);
+    out.forEach(function(doc, i) {
+        assert.eq({ _id: i, a: 100 - i, n: 1 }, doc);
+    });
+}
+
+local.drop();
+foreign.drop();
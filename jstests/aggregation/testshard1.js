@@ -236,6 +236,7 @@ for (var shardName in res.shards) {
 RUNNING_IN_SHARDED_AGG_TEST = true; // global
 load("jstests/aggregation/bugs/server9444.js"); // external sort
 load("jstests/aggregation/bugs/server11675.js"); // text support
+load("jstests/aggregation/bugs/lookup.js"); // $lookup runs on the merger
 
 // shut everything down
 shardedAggTest.stop();
@@ -0,0 +1,41 @@
+// $lookup reads the collection it joins from, so aggregate needs find on it as well as on the
+// collection it aggregates.
+var conn = MongoRunner.runMongod({auth : ""});
+
+var adminDB = conn.getDB("admin");
+var testDB = conn.getDB("testdb");
+
+adminDB.createUser({user:'admin', pwd:'password', roles:['userAdminAnyDatabase',
+                                                          'readWriteAnyDatabase']});
+adminDB.auth('admin', 'password');
+
+testDB.local.insert({_id: 1, a: 1});
+testDB.foreign.insert({_id: 2, b: 1, secret: "not for localReader"});
+assert.gleSuccess(testDB);
+
+testDB.createRole({role: 'readLocal', roles: [],
+                   privileges: [{resource: {db: 'testdb', collection: 'local'},
+                                 actions: ['find']}]});
+testDB.createRole({role: 'readForeign', roles: [],
+                   privileges: [{resource: {db: 'testdb', collection: 'foreign'},
+                                 actions: ['find']}]});
+testDB.createUser({user: 'localReader', pwd: 'password', roles: ['readLocal']});
+testDB.createUser({user: 'bothReader', pwd: 'password', roles: ['readLocal', 'readForeign']});
+adminDB.logout();
+
+var pipeline = [{$lookup: {from: 'foreign', localField: 'a', foreignField: 'b', as: 'joined'}}];
+
+testDB.auth('localReader', 'password');
+assert.eq(1, testDB.local.aggregate([{$match: {a: 1}}]).itcount());
+var res = testDB.runCommand({aggregate: 'local', pipeline: pipeline});
+assert.commandFailed(res);
+assert.eq(13, res.code, tojson(res)); // Unauthorized
+testDB.logout();
+
+testDB.auth('bothReader', 'password');
+var joined = testDB.local.aggregate(pipeline).toArray();
+assert.eq(1, joined.length);
+assert.eq(2, joined[0].joined[0]._id);
+testDB.logout();
+
+MongoRunner.stopMongod(conn);
@@ -0,0 +1,114 @@
+// compact_online.js
+// online compact empties sparsely used extents record by record, keeping the indexes right
+
+var mydb = db.getSiblingDB('compact_online');
+t = mydb.compactonline;
+t.drop();
+
+// several extents, then leave them mostly empty
+var pad = new Array(200).join("x");
+for (var i = 0; i < 20000; i++) {
+    t.insert({ _id: i, x: i % 100, pad: pad });
+}
+t.ensureIndex({ x: 1 });
+t.remove({ _id: { $mod: [4, 1] } });
+t.remove({ _id: { $mod: [4, 2] } });
+t.remove({ _id: { $mod: [4, 3] } });
+assert.eq(5000, t.count());
+
+var before = t.stats();
+printjson(before);
+
+var res = mydb.runCommand({ compact: 'compactonline', online: true, maxPauseMillis: 5 });
+printjson(res);
+assert(res.ok);
+assert.gt(res.extentsFreed, 0);
+assert.gt(res.recordsMoved, 0);
+assert.gt(res.bytesReclaimed, 0);
+
+var after = t.stats();
+assert.eq(before.storageSize - res.bytesReclaimed, after.storageSize);
+assert.eq(before.numExtents - res.extentsFreed, after.numExtents);
+
+// same documents, reachable through every index
+assert.eq(5000, t.count());
+assert.eq(5000, t.find().hint({ _id: 1 }).itcount());
+assert.eq(5000, t.find().hint({ x: 1 }).itcount());
+assert.eq(50, t.find({ x: 4 }).itcount());
+assert.eq(8, t.findOne({ _id: 8 })._id);
+assert(t.validate(true).valid);
+
+// nothing left worth emptying
+res = mydb.runCommand({ compact: 'compactonline', online: true });
+assert(res.ok);
+assert.eq(0, res.extentsFreed);
+
+assert(!mydb.runCommand({ compact: 'compactonline', online: true, maxPauseMillis: 0 }).ok);
+
+// the same while inserts, moving updates and removes run alongside
+t = mydb.compactonlineload;
+t.drop();
+for (var i = 0; i < 20000; i++) {
+    t.insert({ _id: i, x: i % 100, pad: pad });
+}
+t.ensureIndex({ x: 1 });
+t.remove({ _id: { $not: { $mod: [4, 0] } } });
+assert.eq(5000, t.count());
+
+var load = startParallelShell(
+    "var t = db.getSiblingDB('compact_online').compactonlineload;" +
+    "var grown = new Array(400).join('z');" +
+    "for (var i = 0; i < 2000; i++) {" +
+    "    t.insert({ _id: 100000 + i, x: i % 100, pad: 'y' });" +
+    "    t.update({ _id: 4 * i }, { $set: { pad: grown } });" +
+    "    if (i % 2 == 0) t.remove({ _id: 8000 + 4 * i });" +
+    "}" +
+    "assert.gleSuccess(db);");
+res = mydb.runCommand({ compact: 'compactonlineload', online: true, maxPauseMillis: 5 });
+printjson(res);
+assert(res.ok);
+load();
+
+// 5000 + 2000 inserted - 1000 removed, all reachable through every index
+assert.eq(6000, t.count());
+assert.eq(6000, t.find().hint({ _id: 1 }).itcount());
+assert.eq(6000, t.find().hint({ x: 1 }).itcount());
+assert.eq(2000, t.find({ _id: { $gte: 100000 } }).itcount());
+assert.eq(2000, t.find({ pad: new Array(400).join('z') }).itcount());
+assert.eq(0, t.find({ _id: { $gte: 8000, $lt: 16000, $mod: [8, 0] } }).itcount());
+assert(t.validate(true).valid);
+
+// a cursor scanning in natural order would miss records moved behind it, so nothing moves while
+// one is open
+t = mydb.compactonlinecursor;
+t.drop();
+for (var i = 0; i < 20000; i++) {
+    t.insert({ _id: i, x: i % 100, pad: pad });
+}
+t.remove({ _id: { $not: { $mod: [4, 0] } } });
+before = t.stats();
+
+var cursor = t.find().batchSize(100);
+var seen = {};
+for (var i = 0; i < 100; i++) {
+    seen[cursor.next()._id] = true;
+}
+res = mydb.runCommand({ compact: 'compactonlinecursor', online: true, maxTimeMS: 1000 });
+assert.commandFailed(res);
+assert.eq(50, res.code); // ExceededTimeLimit, still waiting
+assert.eq(before.numExtents, t.stats().numExtents);
+
+while (cursor.hasNext()) {
+    seen[cursor.next()._id] = true;
+}
+assert.eq(5000, Object.keys(seen).length);
+
+res = mydb.runCommand({ compact: 'compactonlinecursor', online: true });
+assert(res.ok);
+assert.gt(res.extentsFreed, 0);
+assert.eq(0, res.stepsPaused);
+assert.eq(5000, t.find().itcount());
+assert(t.validate(true).valid);
+
+mydb.createCollection('compactonlinecapped', { capped: true, size: 4096 });
+assert(!mydb.runCommand({ compact: 'compactonlinecapped', online: true }).ok);
@@ -0,0 +1,103 @@
+// v:2 indexes store keys prefix compressed per bucket.  Check that they return what v:1 indexes
+// return, through inserts (splits), bulk builds and removes (merges), and that they are smaller.
+
+var plain = db.jstests_index_prefix_v1;
+var compressed = db.jstests_index_prefix_v2;
+
+function key(i) {
+    return "http://www.example.com/catalog/department-" + (i % 7) + "/products/item-" + i;
+}
+
+function fill(t) {
+    // not in key order, so buckets split in the middle as well as at the end
+    for (var i = 0; i < 4000; i++) {
+        var j = (i * 7919) % 4000;
+        t.insert({ _id: j, k: key(j), g: j % 3, s: "group member " + j });
+    }
+}
+
+function check(spec) {
+    assert(plain.validate(true).valid);
+    assert(compressed.validate(true).valid);
+    assert.eq(plain.count(), compressed.count());
+
+    function ids(t, query) {
+        return t.find(query, { _id: 1 }).hint(spec).toArray().map(function(o) { return o._id; });
+    }
+    var queries = [{},
+                   { k: key(123) },
+                   { k: { $gte: key(1000), $lt: key(2000) } },
+                   { k: /^http:\/\/www\.example\.com\/catalog\/department-3/ },
+                   { g: 1, s: { $gt: "group member 2" } }];
+    queries.forEach(function(q) {
+        assert.eq(ids(plain, q), ids(compressed, q), tojson(q));
+    });
+}
+
+function indexSize(t, name) {
+    return t.stats().indexSizes[name];
+}
+
+// every document has exactly one key in each index
+function checkKeyCounts(t) {
+    var v = t.validate(true);
+    assert(v.valid);
+    t.getIndexes().forEach(function(ix) {
+        assert.eq(t.count(), v.keysPerIndex[t.getFullName() + ".$" + ix.name], ix.name);
+    });
+}
+
+// a contiguous range of each index's keys: for k, from part way into department-0 to part way
+// into department-3
+var ranges = [{ spec: { k: 1 }, range: { k: { $gt: key(1400), $lt: key(3503) } } },
+              { spec: { g: 1, s: 1 }, range: { g: 1, s: { $gte: "group member 1",
+                                                          $lt: "group member 3" } } }];
+
+ranges.forEach(function(r) {
+    var spec = r.spec;
+    plain.drop();
+    compressed.drop();
+
+    // built incrementally
+    plain.ensureIndex(spec, { v: 1 });
+    compressed.ensureIndex(spec, { v: 2 });
+    compressed.getIndexes().forEach(function(ix) {
+        if (ix.name != "_id_")
+            assert.eq(2, ix.v);
+    });
+    fill(plain);
+    fill(compressed);
+    check(spec);
+
+    var name = compressed.getIndexes().filter(function(ix) { return ix.name != "_id_"; })[0].name;
+    assert.lt(indexSize(compressed, name), indexSize(plain, name));
+
+    // removes merge buckets
+    plain.remove({ _id: { $mod: [3, 0] } });
+    compressed.remove({ _id: { $mod: [3, 0] } });
+    check(spec);
+
+    // removing a run of adjacent keys empties whole buckets, so their neighbours merge
+    var before = compressed.count();
+    plain.remove(r.range);
+    compressed.remove(r.range);
+    assert.lt(compressed.count(), before - 500);
+    check(spec);
+    checkKeyCounts(plain);
+    checkKeyCounts(compressed);
+
+    // built in bulk
+    plain.dropIndexes();
+    compressed.dropIndexes();
+    plain.ensureIndex(spec, { v: 1 });
+    compressed.ensureIndex(spec, { v: 2 });
+    check(spec);
+    assert.lt(indexSize(compressed, name), indexSize(plain, name));
+});
+
+// v:2 has to be asked for, and there is no v:3
+plain.drop();
+plain.ensureIndex({ k: 1 });
+assert.eq(1, plain.getIndexes()[1].v);
+plain.ensureIndex({ x: 1 }, { v: 3 });
+assert(db.getLastError());
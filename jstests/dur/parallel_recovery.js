@@ -0,0 +1,104 @@
+/* parallel_recovery.js
+   replay the same journal serially and with several recovery threads (journalRecoveryThreads),
+   check that both produce identical data files, and report how long each replay took.
+*/
+
+var testname = "parallel_recovery";
+var step = 1;
+
+function log(str) {
+    print();
+    print(testname + " step " + step++ + " " + (str || ""));
+}
+
+function runDiff(a, b) {
+    function reSlash(s) {
+        var x = s;
+        if (_isWindows()) {
+            while (1) {
+                var y = x.replace('/', '\\');
+                if (y == x)
+                    break;
+                x = y;
+            }
+        }
+        return x;
+    }
+    a = reSlash(a);
+    b = reSlash(b);
+    print("diff " + a + " " + b);
+    return run("diff", a, b);
+}
+
+var path = MongoRunner.dataPath + testname;
+var pathSerial = MongoRunner.dataPath + testname + "serial";
+var pathParallel = MongoRunner.dataPath + testname + "parallel";
+
+// --syncdelay 0 so the data files are never flushed and the whole journal is replayed
+log("run mongod with --journal");
+var conn = startMongodEmpty("--port", 30001, "--dbpath", path, "--journal", "--smallfiles",
+                            "--syncdelay", 0, "--journalOptions", 8);
+var d = conn.getDB("test");
+
+var N = 20000;
+if (d.adminCommand("buildInfo").debug)
+    N = 5000;
+var pad = new Array(512).join("x");
+for (var i = 0; i < N; i++) {
+    // fixed _id's so that the files are the same however they are replayed
+    d.foo.insert({ _id: i, x: i, pad: pad });
+}
+d.foo.ensureIndex({ x: 1 });
+for (var i = 0; i < N; i += 3) {
+    d.foo.update({ _id: i }, { $inc: { x: 1 } });
+}
+d.foo.remove({ _id: { $lt: N / 10 } });
+printjson(d.runCommand({ getlasterror: 1, fsync: 1 }));
+
+log("kill 9");
+stopMongod(30001, /*signal*/9);
+
+// be sure nothing is skipped
+removeFile(path + "/journal/lsn");
+
+copyDbpath(path, pathSerial);
+copyDbpath(path, pathParallel);
+
+// --journalOptions 4 exits once recovery is done
+function recover(dbpath, threads) {
+    var start = new Date();
+    var rc = runMongoProgram("mongod", "--port", 30002, "--dbpath", dbpath, "--journal",
+                             "--smallfiles", "--journalOptions", 4,
+                             "--setParameter", "journalRecoveryThreads=" + threads);
+    var ms = (new Date()) - start;
+    assert.eq(0, rc, "recovery with " + threads + " thread(s) failed");
+    print(testname + " recovery with " + threads + " thread(s) took " + ms + "ms");
+    return ms;
+}
+
+log("recover serially");
+var serialMs = recover(pathSerial, 1);
+
+log("recover in parallel");
+var parallelMs = recover(pathParallel, 4);
+
+log("check data files match");
+var files = listFiles(pathSerial);
+files.forEach(function(f) {
+    if (f.isDirectory || f.name.indexOf("/test.") < 0)
+        return;
+    var name = f.name.substring(f.name.lastIndexOf("/") + 1);
+    var diff = runDiff(pathSerial + "/" + name, pathParallel + "/" + name);
+    assert.eq("", diff, name + " differs between serial and parallel recovery");
+});
+
+log("check data");
+conn = startMongodNoReset("--port", 30003, "--dbpath", pathParallel, "--journal", "--smallfiles");
+d = conn.getDB("test");
+assert.eq(N - N / 10, d.foo.count());
+assert.eq(3 * N / 10 + 1, d.foo.findOne({ _id: 3 * N / 10 }).x);
+assert(d.foo.validate(true).valid);
+stopMongod(30003);
+
+print(testname + " serial: " + serialMs + "ms parallel: " + parallelMs + "ms");
+print(testname + " SUCCESS");
@@ -0,0 +1,37 @@
+// Test that private view remapping is reported in the dur section of serverStatus, and that
+// journalRemapMaxPauseMillis is accepted.  durOptions 32 remaps after every group commit.
+
+var conn = MongoRunner.runMongod({ dur: "", smallfiles: "", durOptions: 32,
+                                   setParameter: "journalRemapMaxPauseMillis=5" });
+var db = conn.getDB("test");
+
+assert.eq(5, db.adminCommand({ getParameter: 1, journalRemapMaxPauseMillis: 1 })
+               .journalRemapMaxPauseMillis);
+
+for (var i = 0; i < 5000; i++) {
+    db.remap.insert({ i: i, s: "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx" });
+}
+assert.eq(5000, db.remap.count());
+
+function remapPasses() {
+    var pauses = db.serverStatus().dur.remapPrivateViewPausesMicros;
+    assert(pauses, "no remapPrivateViewPausesMicros in serverStatus().dur");
+    var n = 0;
+    for (var i = 0; i < pauses.length; i++) {
+        if (i > 0) {
+            assert.gt(pauses[i].upTo, pauses[i - 1].upTo);
+        }
+        n += pauses[i].count;
+    }
+    return n;
+}
+
+assert.soon(function() { return remapPasses() > 0; }, "no remap passes recorded");
+assert.gte(db.serverStatus().dur.timeMs.remapPrivateViewMaxPause, 0);
+
+// the data is still readable after the views have been remapped
+for (var i = 0; i < 5000; i += 500) {
+    assert.eq(i, db.remap.findOne({ i: i }).i);
+}
+
+MongoRunner.stopMongod(conn);
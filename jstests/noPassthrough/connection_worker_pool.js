@@ -0,0 +1,88 @@
+// Test servicing connections from a pool of worker threads (connectionWorkerThreads) rather
+// than a thread per connection: more connections than workers, per-connection state (lastError,
+// authentication) surviving across requests, requests that block not starving the rest, and the
+// pool's thread cap (connectionWorkerMaxThreads) cutting waits short rather than being passed.
+
+var conn = MongoRunner.runMongod({ setParameter: 'connectionWorkerThreads=2' });
+var coll = conn.getDB('test').workerpool;
+
+assert.eq(2, conn.getDB('admin').runCommand({ getParameter: 1,
+                                              connectionWorkerThreads: 1 })
+                                  .connectionWorkerThreads);
+
+// more connections than worker threads, each doing several requests
+var conns = [];
+for (var i = 0; i < 10; i++) {
+    conns.push(new Mongo(conn.host));
+}
+for (var round = 0; round < 5; round++) {
+    for (var i = 0; i < conns.length; i++) {
+        conns[i].getDB('test').workerpool.insert({ conn: i, round: round });
+    }
+}
+assert.eq(50, coll.count());
+for (var i = 0; i < conns.length; i++) {
+    assert.eq(5, conns[i].getDB('test').workerpool.count({ conn: i }));
+}
+
+// lastError belongs to the connection, not to the worker thread that ran the request
+coll.ensureIndex({ u: 1 }, { unique: true });
+conns[0].getDB('test').workerpool.insert({ u: 1 });
+conns[0].getDB('test').workerpool.insert({ u: 1 });
+for (var i = 1; i < conns.length; i++) {
+    assert.isnull(conns[i].getDB('test').getLastError());
+}
+assert.eq(11000, conns[0].getDB('test').getLastErrorObj().code);
+
+// authentication belongs to the connection too
+conn.getDB('admin').createUser({ user: 'admin', pwd: 'pwd', roles: ['root'] });
+assert(conns[1].getDB('admin').auth('admin', 'pwd'));
+for (var i = 0; i < conns.length; i++) {
+    var users = conns[i].getDB('admin').runCommand({ connectionStatus: 1 })
+                        .authInfo.authenticatedUsers;
+    assert.eq(i == 1 ? 1 : 0, users.length, 'connection ' + i);
+}
+
+// idle connections still hold their tickets
+assert.gte(conn.getDB('admin').serverStatus().connections.current, conns.length + 1);
+
+assert.commandWorked(conn.getDB('admin').runCommand({ setParameter: 1,
+                                                     connectionWorkerMaxThreads: 4 }));
+
+// requests that wait -- awaitData tails and pubsub long polls -- have workers started in
+// their place, up to 4 threads in all; past that they return to the client early.  Either way,
+// more of them than there are workers don't starve other connections
+var tailed = conn.getDB('test').tailed;
+tailed.drop();
+conn.getDB('test').createCollection('tailed', { capped: true, size: 4096 });
+tailed.insert({ x: 1 });
+
+var done = "db.getSiblingDB('test').waiters.insert({ done: true });";
+var tail = "var cur = db.getSiblingDB('test').tailed.find()" +
+           "            .addOption(DBQuery.Option.tailable)" +
+           "            .addOption(DBQuery.Option.awaitData);" +
+           "var end = new Date().getTime() + 10000;" +
+           "while (new Date().getTime() < end) { if (cur.hasNext()) cur.next(); }" + done;
+var poll = "var sub = db.PS().subscribe('workerpool');" +
+           "var end = new Date().getTime() + 10000;" +
+           "while (new Date().getTime() < end) { sub.poll(end - new Date().getTime()); }" + done;
+var waiters = [];
+for (var i = 0; i < 2; i++) {
+    waiters.push(startParallelShell(tail, conn.port));
+    waiters.push(startParallelShell(poll, conn.port));
+}
+sleep(2000);
+
+// the other requests get through while the waiters are still waiting, not once they are done
+var other = new Mongo(conn.host);
+for (var i = 0; i < 20; i++) {
+    assert.commandWorked(other.getDB('admin').runCommand({ isMaster: 1 }));
+}
+other.getDB('test').workerpool.insert({ waited: true });
+assert.eq(1, other.getDB('test').workerpool.count({ waited: true }));
+assert.gt(waiters.length, other.getDB('test').waiters.count({ done: true }),
+          'requests starved by blocked workers');
+
+waiters.forEach(function(join) { join(); });
+
+MongoRunner.stopMongod(conn);
@@ -0,0 +1,68 @@
+// Foreground index builds generate and sort keys on indexBuildThreads threads, by default only the
+// one holding the lock.  Check that more build the same index as a single thread does, that
+// documents whose keys cannot be generated still fail the build, and that unique builds find or
+// drop duplicates.
+
+var conn = MongoRunner.runMongod({ setParameter: "indexBuildThreads=4" });
+var db = conn.getDB("test");
+var t = db.index_build_threads;
+
+function setThreads(n) {
+    assert.commandWorked(db.adminCommand({ setParameter: 1, indexBuildThreads: n }));
+}
+
+var N = 20000;
+for (var i = 0; i < N; i++) {
+    // a: out of order, b: multikey
+    t.insert({ _id: i, a: (i * 7919) % N, b: [i % 13, "s" + (i % 101)] });
+}
+assert.eq(N, t.count());
+
+function ids(spec, query) {
+    return t.find(query, { _id: 1 }).hint(spec).toArray().map(function(o) { return o._id; });
+}
+
+function build(threads, spec, options) {
+    setThreads(threads);
+    t.dropIndex(spec);
+    t.ensureIndex(spec, options || {});
+    return db.getLastErrorObj();
+}
+
+[{ a: 1 }, { b: 1, a: -1 }].forEach(function(spec) {
+    var queries = [{}, { a: { $gte: 100, $lt: 5000 } }, { b: 7 }, { b: "s42" }];
+
+    assert.isnull(build(1, spec).err);
+    var serial = queries.map(function(q) { return ids(spec, q); });
+
+    // 0 is one thread per core, up to the most the sort memory is split between
+    [4, 0].forEach(function(threads) {
+        assert.isnull(build(threads, spec).err);
+        assert(t.validate(true).valid);
+        queries.forEach(function(q, i) {
+            assert.eq(serial[i], ids(spec, q), threads + " " + tojson(spec) + " " + tojson(q));
+        });
+    });
+});
+
+// the partitions' multikey flags reach the index
+assert(t.find({ b: 7 }).hint({ b: 1, a: -1 }).explain().isMultiKey);
+
+// documents with parallel arrays fail the build with the key generator's error...
+t.update({ _id: 5 }, { $set: { c: [1, 2], d: [3, 4] } });
+var err = build(4, { c: 1, d: 1 });
+assert.eq(10088, err.code, tojson(err));
+assert.eq(0, t.getIndexes().filter(function(ix) { return ix.name == "c_1_d_1"; }).length);
+
+// duplicates fail a unique build, or are dropped with dropDups
+t.update({ _id: 5 }, { $unset: { c: 1, d: 1 } });
+t.insert({ _id: N, a: 17 });
+err = build(4, { a: 1 }, { unique: true });
+assert.eq(11000, err.code, tojson(err));
+
+assert.isnull(build(4, { a: 1 }, { unique: true, dropDups: true }).err);
+assert.eq(N, t.count());
+assert.eq(1, t.find({ a: 17 }).itcount());
+assert(t.validate(true).valid);
+
+MongoRunner.stopMongod(conn);
@@ -0,0 +1,95 @@
+// A $group or count that has to scan a whole collection scans it on parallelScanThreads threads,
+// each grouping or counting a range of its extents.  Check that they return what a single thread
+// does, that indexed queries and pipelines that can't be split still run, that the partial groups
+// are held to the $group memory limit, and that explain shows the scan.
+
+var conn = MongoRunner.runMongod({ setParameter: "parallelScanThreads=4" });
+var db = conn.getDB("test");
+var t = db.parallel_scan;
+
+function setThreads(n) {
+    assert.commandWorked(db.adminCommand({ setParameter: 1, parallelScanThreads: n }));
+}
+
+// more than the 16MB a collection needs to be scanned in parallel, in many extents
+var N = 25000;
+var pad = new Array(1024).join("x");
+for (var i = 0; i < N; i++) {
+    t.insert({ _id: i, a: i % 17, b: [i % 3, i % 5], c: i / 2, pad: pad });
+}
+assert.gleSuccess(db);
+t.ensureIndex({ c: 1 });
+
+function sortById(docs) {
+    return docs.sort(function(l, r) { return bsonWoCompare({ x: l._id }, { x: r._id }); });
+}
+
+var pipelines = [
+    [{ $group: { _id: "$a", n: { $sum: 1 }, avg: { $avg: "$c" }, max: { $max: "$_id" } } }],
+    [{ $match: { a: { $gt: 5 } } }, { $group: { _id: null, ids: { $addToSet: "$a" } } }],
+    [{ $match: { a: 3 } },
+     { $project: { b: 1, d: { $multiply: ["$a", 2] } } },
+     { $unwind: "$b" },
+     { $group: { _id: { b: "$b", d: "$d" }, n: { $sum: 1 } } },
+     { $sort: { n: -1 } }],
+    // answered by the index on c, so scanned serially
+    [{ $match: { c: { $lt: 100 } } }, { $group: { _id: "$a", n: { $sum: 1 } } }],
+    // $sort before the $group, so scanned serially
+    [{ $sort: { a: 1 } }, { $group: { _id: "$a", first: { $first: "$_id" } } }]
+];
+var queries = [{ a: 3 }, { a: { $in: [1, 2] }, b: 4 }, { c: { $gte: 20000 } }, { pad: "nope" }];
+
+setThreads(1);
+var serialGroups = pipelines.map(function(p) { return sortById(t.aggregate(p).toArray()); });
+var serialCounts = queries.map(function(q) { return t.count(q); });
+
+setThreads(4);
+pipelines.forEach(function(p, i) {
+    var groups = sortById(t.aggregate(p).toArray());
+    assert.eq(serialGroups[i].length, groups.length, tojson(p));
+    groups.forEach(function(g, j) {
+        if (g.ids) {
+            g.ids.sort();
+            serialGroups[i][j].ids.sort();
+        }
+        assert.eq(serialGroups[i][j], g, tojson(p));
+    });
+});
+queries.forEach(function(q, i) {
+    assert.eq(serialCounts[i], t.count(q), tojson(q));
+});
+
+function explainStages(pipeline) {
+    var res = db.runCommand({ aggregate: t.getName(), pipeline: pipeline, explain: true });
+    assert.commandWorked(res);
+    return res.stages;
+}
+
+// the stages up to the $group go to the scan threads, and the query to their collection scans
+var explain = explainStages(pipelines[2]);
+assert(explain[0].$parallelScan, tojson(explain));
+assert.eq(4, explain[0].$parallelScan.threads, tojson(explain));
+assert.eq({ a: 3 }, explain[0].$parallelScan.query, tojson(explain));
+assert.eq(3, explain[0].$parallelScan.pipeline.length, tojson(explain));
+
+explain = explainStages(pipelines[3]);
+assert(explain[0].$cursor, tojson(explain));
+
+// the partial groups of all the ranges are held to the $group memory limit: past it, the pipeline
+// fails without allowDiskUse, as a serial $group would, and runs on one thread with it
+var bigGroup = { $group: { _id: "$_id", p1: { $first: "$pad" }, p2: { $last: "$pad" },
+                           p3: { $max: "$pad" }, p4: { $min: "$pad" }, p5: { $push: "$pad" } } };
+var res = db.runCommand({ aggregate: t.getName(), pipeline: [bigGroup] });
+assert.commandFailed(res);
+assert.eq(16945, res.code, tojson(res));
+res = db.runCommand({ aggregate: t.getName(), pipeline: [bigGroup, { $group: { _id: null,
+                                                                                n: { $sum: 1 } } }],
+                      allowDiskUse: true });
+assert.commandWorked(res);
+assert.eq(N, res.result[0].n, tojson(res));
+
+// 0 is one thread per core
+setThreads(0);
+assert.eq(serialCounts[0], t.count(queries[0]));
+
+MongoRunner.stopMongod(conn);
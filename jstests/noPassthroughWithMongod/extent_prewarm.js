@@ -0,0 +1,42 @@
+// Extents carved out of a data file's unused space are paged in on a background thread
+// (prewarmNewExtents), and the bytes it touches are counted in serverStatus.
+
+var t = db.extent_prewarm;
+t.drop();
+
+function prewarmed() {
+    return db.serverStatus().metrics.storage.prewarmedBytes;
+}
+
+assert.commandWorked(db.adminCommand({ setParameter: 1, prewarmNewExtents: true }));
+var before = prewarmed();
+
+// extents grow with the collection; later ones are well over the 1MB prewarming minimum
+var pad = new Array(4096).join("x");
+for (var i = 0; i < 5000; i++) {
+    t.insert({ _id: i, pad: pad });
+}
+assert.gleSuccess(db);
+
+assert.soon(function() { return prewarmed() > before; }, "no extents prewarmed");
+
+// the data written while extents were being prewarmed is intact
+assert.eq(5000, t.count());
+assert(t.validate(true).valid);
+
+// turned off, new extents are left alone
+assert.commandWorked(db.adminCommand({ setParameter: 1, prewarmNewExtents: false }));
+var t2 = db.extent_prewarm_off;
+t2.drop();
+sleep(1000);
+var off = prewarmed();
+for (var i = 0; i < 5000; i++) {
+    t2.insert({ _id: i, pad: pad });
+}
+assert.gleSuccess(db);
+sleep(1000);
+assert.eq(off, prewarmed());
+
+assert.commandWorked(db.adminCommand({ setParameter: 1, prewarmNewExtents: true }));
+t.drop();
+t2.drop();
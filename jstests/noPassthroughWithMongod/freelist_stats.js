@@ -0,0 +1,40 @@
+// freelistStats reports the deleted records of a collection by size class
+
+var t = db.freelist_stats;
+t.drop();
+
+var pad = new Array(200).join("x");
+for (var i = 0; i < 1000; i++) {
+    t.insert({ _id: i, pad: pad });
+}
+assert.gleSuccess(db);
+
+var before = db.runCommand({ freelistStats: t.getName() });
+assert.commandWorked(before);
+assert.eq(t.getFullName(), before.ns);
+assert.eq(19, before.buckets.length);
+
+// punch holes and reuse some of them
+t.remove({ _id: { $mod: [2, 0] } });
+assert.gleSuccess(db);
+var holes = db.runCommand({ freelistStats: t.getName() });
+assert.commandWorked(holes);
+assert.gte(holes.deletedRecords, before.deletedRecords + 500);
+assert.gt(holes.fragmentation, before.fragmentation);
+
+var sum = 0;
+holes.buckets.forEach(function(b) { sum += b.count; });
+assert.eq(holes.deletedRecords, sum);
+
+for (var i = 0; i < 250; i++) {
+    t.insert({ _id: 1000 + i, pad: pad });
+}
+assert.gleSuccess(db);
+var reused = db.runCommand({ freelistStats: t.getName() });
+assert.commandWorked(reused);
+assert.lt(reused.deletedRecords, holes.deletedRecords);
+assert(reused.indexed, tojson(reused));
+assert.eq(1250 - 500, t.count());
+
+assert.commandFailed(db.runCommand({ freelistStats: "freelist_stats_missing" }));
+t.drop();
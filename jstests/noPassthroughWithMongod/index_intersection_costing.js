@@ -0,0 +1,71 @@
+// Indexes keep a sampled histogram of their keys, made by bulk builds and, with
+// sampleIndexKeysInBackground, remade in the background after enough writes.  The planner uses the histograms to skip index intersections that cannot
+// beat one of their indexes alone, rather than racing them.
+
+var t = db.index_intersection_costing;
+t.drop();
+
+function setPruning(on) {
+    assert.commandWorked(db.adminCommand({ setParameter: 1,
+                                           internalQueryPlannerIntersectionCostPruning: on }));
+}
+
+function setSampling(on) {
+    assert.commandWorked(db.adminCommand({ setParameter: 1, sampleIndexKeysInBackground: on }));
+}
+
+function sampled() {
+    return db.serverStatus().metrics.query.indexKeySamples;
+}
+
+function intersects(query) {
+    t.getPlanCache().clear();
+    return t.find(query).explain(true).allPlans.some(function(p) {
+        return p.cursor == "Complex Plan";
+    });
+}
+
+for (var i = 0; i < 10000; i++) {
+    t.insert({ a: i, b: i % 2, c: i % 10 });
+}
+assert.gleSuccess(db);
+// built in bulk, so with histograms
+t.ensureIndex({ a: 1 });
+t.ensureIndex({ b: 1 });
+t.ensureIndex({ c: 1 });
+assert.gleSuccess(db);
+
+// 0.1% of {a: 1} against half of {b: 1}
+var unselective = { a: { $gte: 500, $lt: 510 }, b: 1 };
+// 10% of {a: 1} against 10% of {c: 1}
+var selective = { a: { $gte: 0, $lt: 1000 }, c: 3 };
+
+setPruning(true);
+assert(!intersects(unselective));
+assert(intersects(selective));
+assert.eq(5, t.find(unselective).itcount());
+assert.eq(100, t.find(selective).itcount());
+
+// without histograms to go on, intersections are tried
+setPruning(false);
+assert(intersects(unselective));
+setPruning(true);
+
+// writing more than a quarter of the index again has the next query queue a new sample, if
+// background sampling is on
+var before = sampled();
+for (var i = 10000; i < 15000; i++) {
+    t.insert({ a: i, b: 0, c: i % 10 });
+}
+assert.gleSuccess(db);
+t.find(unselective).itcount();
+sleep(500);
+assert.eq(before, sampled());
+
+setSampling(true);
+t.find(unselective).itcount();
+assert.soon(function() { return sampled() > before; }, "no indexes sampled");
+assert(!intersects(unselective));
+setSampling(false);
+
+t.drop();
@@ -0,0 +1,93 @@
+// A burst of writes no longer flushes a collection's plan cache.  Each cached plan is checked by
+// its next run instead: kept if it is still about as productive as when it won its trial, and
+// evicted (so the shape is planned again) if not.  serverStatus().planCache counts both, along
+// with the time spent in plan trials, per query shape.
+
+var writeOps = db.adminCommand({ getParameter: 1, internalQueryCacheWriteOpsBetweenFlush: 1 })
+                 .internalQueryCacheWriteOpsBetweenFlush;
+
+function planCache() {
+    var s = db.adminCommand({ serverStatus: 1, planCache: { shapes: 1000 } }).planCache;
+    assert(s, "no planCache section in serverStatus");
+    return s;
+}
+
+// counts for the one shape queried in 'coll', less those of earlier runs of this test
+var base = {};
+function shapeStats(coll) {
+    var shapes = planCache().shapes.filter(function(s) { return s.ns == coll.getFullName(); });
+    assert.eq(1, shapes.length, tojson(planCache()));
+    var b = base[coll.getName()] || { trials: 0, replans: 0, revalidations: 0 };
+    return { trials: shapes[0].trials - b.trials,
+             trialMicros: shapes[0].trialMicros,
+             replans: shapes[0].replans - b.replans,
+             revalidations: shapes[0].revalidations - b.revalidations };
+}
+
+function remember(coll) {
+    planCache().shapes.forEach(function(s) {
+        if (s.ns == coll.getFullName())
+            base[coll.getName()] = s;
+    });
+}
+
+function cached(coll) {
+    return coll.getPlanCache().listQueryShapes().length == 1;
+}
+
+function setup(coll) {
+    coll.drop();
+    remember(coll);
+    for (var i = 0; i < 200; i++) {
+        coll.insert({ a: i, b: i % 10 });
+    }
+    coll.ensureIndex({ a: 1 });
+    coll.ensureIndex({ b: 1 });
+    assert.gleSuccess(db);
+
+    // the {b: 1} plan wins: every key it reads matches
+    assert.eq(20, coll.find({ a: { $gte: 0 }, b: 3 }).itcount());
+    assert(cached(coll));
+    assert.eq(1, shapeStats(coll).trials);
+    assert.gte(shapeStats(coll).trialMicros, 0);
+}
+
+// writes that leave the plan as good as it was: the entry survives them
+var kept = db.plan_cache_revalidation_kept;
+setup(kept);
+for (var i = 0; i < writeOps; i++) {
+    kept.insert({ a: 1000 + i, b: 5 });
+}
+assert.gleSuccess(db);
+assert(cached(kept));
+assert.eq(20, kept.find({ a: { $gte: 1 }, b: 3 }).itcount());
+assert(cached(kept));
+assert.eq(1, shapeStats(kept).revalidations);
+assert.eq(0, shapeStats(kept).replans);
+assert.eq(1, shapeStats(kept).trials);
+
+// writes after which {b: 1} reads mostly keys that fail {a: {$gte: 0}}: the entry is evicted
+var shifted = db.plan_cache_revalidation_shifted;
+setup(shifted);
+for (var i = 0; i < writeOps; i++) {
+    shifted.insert({ a: -1, b: 3 });
+}
+assert.gleSuccess(db);
+assert(cached(shifted));
+assert.eq(20, shifted.find({ a: { $gte: 0 }, b: 3 }).itcount());
+assert(!cached(shifted));
+assert.eq(1, shapeStats(shifted).replans);
+assert.eq(0, shapeStats(shifted).revalidations);
+
+// the next query of the shape races the plans again
+assert.eq(20, shifted.find({ a: { $gte: 0 }, b: 3 }).itcount());
+assert.eq(2, shapeStats(shifted).trials);
+
+var totals = planCache();
+assert.gte(totals.trials, 3);
+assert.gte(totals.shapesTracked, 2);
+assert.gte(totals.replans, 1);
+assert.gte(totals.revalidations, 1);
+
+kept.drop();
+shifted.drop();
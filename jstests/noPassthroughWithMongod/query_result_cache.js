@@ -0,0 +1,92 @@
+// With queryResultCacheEnabled, a find or aggregate repeated against a collection that has not
+// been written since is answered from the cache of complete results.  Check that repeats hit,
+// that every kind of write makes the next read miss and see the write, and that queries which
+// leave a cursor open or read other collections are not cached.
+
+var t = db.query_result_cache;
+var other = db.query_result_cache_other;
+t.drop();
+other.drop();
+
+function setEnabled(on) {
+    assert.commandWorked(db.adminCommand({ setParameter: 1, queryResultCacheEnabled: on }));
+}
+
+function stats() {
+    return db.serverStatus().queryResultCache;
+}
+
+// the change in hits and misses made by f()
+function counted(f) {
+    var before = stats();
+    f();
+    var after = stats();
+    return { hits: after.hits - before.hits, misses: after.misses - before.misses };
+}
+
+for (var i = 0; i < 50; i++) {
+    t.insert({ _id: i, a: i % 5 });
+}
+assert.gleSuccess(db);
+
+setEnabled(true);
+
+var query = { a: 2 };
+var pipeline = [{ $match: { a: { $lt: 3 } } }, { $group: { _id: "$a", n: { $sum: 1 } } }];
+
+function find() { return t.find(query).sort({ _id: 1 }).toArray(); }
+function aggregate() { return t.aggregate(pipeline).toArray(); }
+
+var found = find();
+assert.eq(10, found.length);
+assert.eq({ hits: 1, misses: 0 }, counted(function() { assert.eq(found, find()); }));
+var grouped = aggregate();
+assert.eq({ hits: 1, misses: 0 }, counted(function() { assert.eq(grouped, aggregate()); }));
+
+// every write invalidates: insert, in-place update, moving update, remove, and compact, which
+// moves every document
+var writes = [
+    function() { t.insert({ _id: 100, a: 2 }); },
+    function() { t.update({ _id: 100 }, { $inc: { a: 5 } }); },
+    function() { t.update({ _id: 100 }, { $set: { pad: new Array(1000).join("x") } }); },
+    function() { t.remove({ _id: 100 }); },
+    function() { assert.commandWorked(t.runCommand("compact")); }
+];
+writes.forEach(function(write) {
+    find();
+    write();
+    assert.gleSuccess(db);
+    var expected = t.find(query).sort({ _id: 1 }).hint({ $natural: 1 }).toArray();
+    assert.eq({ hits: 0, misses: 1 }, counted(function() { assert.eq(expected, find()); }),
+              write.toString());
+    assert.lt(0, stats().invalidations);
+});
+
+// a first batch that leaves a cursor open is not cached
+function openCursor() { return t.find().batchSize(5).itcount(); }
+openCursor();
+assert.eq({ hits: 0, misses: 1 }, counted(openCursor));
+
+// nor are $where, explain, or pipelines that $out or $lookup
+function where() { return t.find({ $where: "this.a == 2" }).itcount(); }
+where();
+assert.eq(0, counted(where).hits);
+assert.eq(0, counted(function() { t.find(query).explain(); }).hits);
+
+other.insert({ _id: 2, b: "other" });
+var lookup = [{ $match: { a: 2 } },
+              { $lookup: { from: other.getName(), localField: "a", foreignField: "_id",
+                           as: "joined" } }];
+t.aggregate(lookup).toArray();
+other.update({ _id: 2 }, { $set: { b: "changed" } });
+assert.gleSuccess(db);
+t.aggregate(lookup).forEach(function(doc) {
+    assert.eq("changed", doc.joined[0].b);
+});
+
+// off again, nothing is looked up
+setEnabled(false);
+assert.eq({ hits: 0, misses: 0 }, counted(find));
+
+t.drop();
+other.drop();
@@ -0,0 +1,71 @@
+// Load shared pubsub functions
+assert(load('jstests/libs/pubsub.js'));
+
+var ps = db.PS();
+var res;
+
+// poll group over three subscriptions, one of which never gets messages
+var subA = ps.subscribe('A');
+var subB = ps.subscribe('B');
+var subC = ps.subscribe('C');
+var group = ps.createPollGroup([subA.getId(), subB.getId(), subC.getId()]);
+assert.eq(group.getId().constructor, ObjectId);
+
+// no messages received yet
+res = group.poll();
+assert(gotNoMessage(res, subA));
+assert(gotNoMessage(res, subB));
+assert(gotNoMessage(res, subC));
+
+// messages are returned per subscription, as when polling on an array
+ps.publish('A', msg1);
+ps.publish('B', msg2);
+var gotFirst = false;
+assert.soon(function() {
+    res = group.poll();
+    if (onlyGotMessage(res, subA, 'A', msg1)) gotFirst = true;
+    return gotFirst && onlyGotMessage(res, subB, 'B', msg2) && gotNoMessage(res, subC);
+});
+
+// members of a group being polled cannot be polled on individually
+var shell1 = startParallelShell('db.runCommand({ poll: ObjectId(\'' + group.getId() + '\'), ' +
+                                                'timeout: 2000 });',
+                                db.getMongo().port);
+assert.soon(function() {
+    res = subC.poll();
+    return res.errors !== undefined && res.errors[subC.getId().str] === codes.kPollActive;
+});
+shell1();
+
+// unsubscribed members are dropped from the group and reported once
+subB.unsubscribe();
+res = group.poll();
+assert.eq(res.errors[subB.getId().str], codes.kInvalidSubscriptionId);
+ps.publish('A', msg2);
+assert.soon(function() {
+    res = group.poll();
+    return onlyGotMessage(res, subA, 'A', msg2);
+});
+assert.eq(res.errors, undefined);
+
+// unknown subscriptions are reported when the group is created
+var invalidId = new ObjectId();
+res = db.runCommand({ createPollGroup: [subA.getId(), invalidId] });
+assert.commandWorked(res);
+assert.eq(res.errors[invalidId.str], codes.kInvalidSubscriptionId);
+assert.commandWorked(ps.destroyPollGroup(res.pollGroupId));
+
+// destroying a group leaves its subscriptions intact
+assert.commandWorked(group.destroy());
+res = group.poll();
+assert.eq(res.errors[group.getId().str], codes.kInvalidSubscriptionId);
+ps.publish('C', msg1);
+assert.soon(function() {
+    res = subC.poll();
+    return onlyGotMessage(res, subC, 'C', msg1);
+});
+
+// cannot destroy a group twice
+assert.eq(group.destroy().errors[group.getId().str], 'Poll group not found.');
+
+assert.commandWorked(ps.unsubscribe([subA.getId(), subC.getId()]));
@@ -0,0 +1,60 @@
+// Tests that messages lost between publisher and subscriber are reported as gaps in the
+// poll reply and counted as missed in serverStatus
+
+var ps = db.PS();
+
+var channelStats = function(channel) {
+    var found;
+    db.serverStatus().pubsub.channels.forEach(function(stats) {
+        if (stats.channel == channel)
+            found = stats;
+    });
+    return found;
+}
+
+var sub = ps.subscribe('gaps');
+var id = sub.getId().str;
+
+// the first message sets where the subscription starts counting from
+ps.publish('gaps', { n: 1 });
+
+// the next two are numbered but never sent
+assert.commandWorked(db.adminCommand({ configureFailPoint: 'pubsubDropPublications',
+                                       mode: { times: 2 } }));
+ps.publish('gaps', { n: 2 });
+ps.publish('gaps', { n: 3 });
+ps.publish('gaps', { n: 4 });
+
+var received = [];
+var gaps = [];
+assert.soon(function() {
+    var res = ps.poll(sub.getId());
+    if (res.messages[id])
+        received = received.concat(res.messages[id]['gaps']);
+    if (res.gaps && res.gaps[id])
+        gaps = gaps.concat(res.gaps[id]);
+    return received.length == 2;
+});
+
+assert.eq(received[0].n, 1);
+assert.eq(received[1].n, 4);
+
+assert.eq(gaps.length, 1);
+assert.eq(gaps[0].channel, 'gaps');
+assert.eq(gaps[0].last - gaps[0].first, 1);
+
+var stats = channelStats('gaps');
+assert.eq(stats.published, 4);
+assert.eq(stats.delivered, 2);
+assert.eq(stats.missed, 2);
+
+// nothing lost, no gaps
+ps.publish('gaps', { n: 5 });
+assert.soon(function() {
+    var res = ps.poll(sub.getId());
+    assert.eq(res.gaps, undefined);
+    return res.messages[id] != undefined;
+});
+assert.eq(channelStats('gaps').missed, 2);
+
+assert.commandWorked(ps.unsubscribe(sub.getId()));
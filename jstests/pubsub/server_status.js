@@ -0,0 +1,62 @@
+// Tests the pubsub serverStatus section
+
+var ps = db.PS();
+
+var channelStats = function(channel) {
+    var found;
+    db.serverStatus().pubsub.channels.forEach(function(stats) {
+        if (stats.channel == channel)
+            found = stats;
+    });
+    return found;
+}
+
+var sub = ps.subscribe('status');
+var subFilter = ps.subscribe('status', { a: 2 });
+
+ps.publish('status', { a: 1 });
+ps.publish('status', { a: 2 });
+
+var delivered = 0;
+assert.soon(function() {
+    var res = ps.poll([sub.getId(), subFilter.getId()]);
+    for (var id in res.messages)
+        delivered += res.messages[id]['status'].length;
+    return delivered == 3;
+});
+
+var stats = channelStats('status');
+assert.eq(stats.published, 2);
+assert.eq(stats.delivered, 3);
+assert.eq(stats.filtered, 1);
+assert.eq(stats.missed, 0);
+
+// every delivery is counted in exactly one latency bucket
+var bucketed = 0;
+stats.latencyMicros.forEach(function(bucket) { bucketed += bucket.count; });
+assert.eq(bucketed, 3);
+
+// channel names that aren't valid field names are reported as values
+var oddSub = ps.subscribe('$odd.name');
+ps.publish('$odd.name', { a: 1 });
+assert.soon(function() {
+    var res = ps.poll(oddSub.getId());
+    return res.messages[oddSub.getId().str] != undefined;
+});
+var oddStats = channelStats('$odd.name');
+assert.eq(oddStats.published, 1);
+assert.eq(oddStats.delivered, 1);
+assert.commandWorked(ps.unsubscribe(oddSub.getId()));
+
+// per-subscription stats are only reported when asked for
+var status = db.serverStatus();
+assert.eq(status.pubsub.subscriptions, undefined);
+assert.gte(status.pubsub.numSubscriptions, 2);
+
+status = db.serverStatus({ pubsub: { subscriptions: 1 } });
+var subStats = status.pubsub.subscriptions[subFilter.getId().str];
+assert.eq(subStats.channel, 'status');
+assert.eq(subStats.delivered, 1);
+assert.eq(subStats.filtered, 1);
+
+assert.commandWorked(ps.unsubscribe([sub.getId(), subFilter.getId()]));
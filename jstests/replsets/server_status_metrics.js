@@ -19,6 +19,7 @@ function testSecondaryMetrics(secondary, opCount, offset) {
     assert(ss.metrics.repl.preload.docs.totalMillis  >= 0, "preload.docs time missing")
     assert(ss.metrics.repl.preload.docs.num >= 0, "preload.indexes num missing")
     assert(ss.metrics.repl.preload.indexes.totalMillis >= 0, "preload.indexes time missing")
+    assert(ss.metrics.repl.preload.aheadOps >= 0, "preload.aheadOps missing")
 
     assert(ss.metrics.repl.apply.batches.num > 0, "no batches")
     assert(ss.metrics.repl.apply.batches.totalMillis > 0, "no batch time")
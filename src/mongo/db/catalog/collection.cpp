@@ -166,6 +166,8 @@ namespace mongo {
         if ( !loc.isOK() )
             return loc;
 
+        _infoCache.notifyOfWriteOp();
+
         return StatusWith<DiskLoc>( loc );
     }
 
@@ -214,6 +216,8 @@ namespace mongo {
         if ( !loc.isOK() )
             return loc;
 
+        _infoCache.notifyOfWriteOp();
+
         InsertDeleteOptions indexOptions;
         indexOptions.logIfError = false;
         indexOptions.dupsAllowed = true; // in repair we should be doing no checking
@@ -418,6 +422,8 @@ namespace mongo {
                 return StatusWith<DiskLoc>( ret );
             if ( debug )
                 debug->keyUpdates += updatedKeys;
+            if ( updatedKeys )
+                ii.entry( descriptor )->noteKeyWrite();
         }
 
         // Broadcast the mutation so that query results stay correct.
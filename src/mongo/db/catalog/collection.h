@@ -30,7 +30,9 @@
 
 #pragma once
 
+#include <set>
 #include <string>
+#include <vector>
 
 #include "mongo/base/string_data.h"
 #include "mongo/db/catalog/collection_cursor_cache.h"
@@ -46,6 +48,7 @@ namespace mongo {
 
     class Database;
     class ExtentManager;
+    class FreeListIndex;
     class NamespaceDetails;
     class IndexCatalog;
     class MultiIndexBlock;
@@ -55,6 +58,7 @@ namespace mongo {
     class CappedIterator;
 
     class OpDebug;
+    class Timer;
 
     class DocWriter {
     public:
@@ -96,9 +100,33 @@ namespace mongo {
     struct CompactStats {
         CompactStats() {
             corruptDocuments = 0;
+            recordsMoved = 0;
+            extentsFreed = 0;
+            bytesReclaimed = 0;
+            stepsPaused = 0;
         }
 
         long long corruptDocuments;
+
+        // online compact only
+        long long recordsMoved;
+        long long extentsFreed;
+        long long bytesReclaimed; // net change in storageSize, positive when it shrank
+        long long stepsPaused; // for cursors open on the collection, see compactOnlineStep()
+    };
+
+    /**
+     * What an online compact carries from one Collection::compactOnlineStep() to the next.
+     */
+    struct OnlineCompactState {
+        // the extent being emptied, null between extents
+        DiskLoc extent;
+
+        // the deleted records of 'extent', off the deleted lists so nothing moves into them
+        std::vector<DiskLoc> withheld;
+
+        // extents emptied or passed over already
+        std::set<DiskLoc> visited;
     };
 
     /**
@@ -181,6 +209,27 @@ namespace mongo {
 
         StatusWith<CompactStats> compact( const CompactOptions* options );
 
+        /**
+         * One step of an online compact: move records out of a sparsely used extent into free
+         * space elsewhere in the collection, fixing up the indexes record by record, until
+         * 'maxMicros' have passed, and free the extent once it is empty.  The collection is
+         * consistent after every step so the caller can yield its lock in between, provided it
+         * passes the same 'state' back in and keeps the namespace from being dropped meanwhile.
+         *
+         * A moved record can land behind a collection scan that is yielded or in a cursor, which
+         * would then miss it, and the move isn't in the oplog for an initial sync cloning the
+         * collection to make up for.  So no record is moved while any cursor or yielded runner is
+         * open on the collection: the step only counts itself in 'stats->stepsPaused'.
+         * @return false once no extent is left that is worth emptying
+         */
+        StatusWith<bool> compactOnlineStep( OnlineCompactState* state,
+                                            const CompactOptions* options,
+                                            int maxMicros,
+                                            CompactStats* stats );
+
+        /** when stopping an online compact early: put back the space 'state' withholds */
+        void compactOnlineAbandon( OnlineCompactState* state );
+
         // -----------
 
 
@@ -221,6 +270,13 @@ namespace mongo {
                             MultiIndexBlock& indexesToInsertTo,
                             const CompactOptions* compactOptions, CompactStats* stats );
 
+        DiskLoc _compactOnlinePickExtent( OnlineCompactState* state, FreeListIndex* index,
+                                          const Timer& t, int maxMicros, bool* unfinished );
+        void _compactOnlineRetryExtent( OnlineCompactState* state );
+        void _compactOnlineMove( OnlineCompactState* state, const DiskLoc& loc,
+                                 const CompactOptions* options, CompactStats* stats );
+        void _compactOnlineFreeExtent( OnlineCompactState* state, CompactStats* stats );
+
         // @return 0 for inf., otherwise a number of files
         int largestFileNumberInQuota() const;
 
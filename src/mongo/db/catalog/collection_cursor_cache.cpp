@@ -435,6 +435,11 @@ namespace mongo {
         return _cursors.size();
     }
 
+    size_t CollectionCursorCache::numCursorsAndRunners(){
+        SimpleMutex::scoped_lock lk( _mutex );
+        return _cursors.size() + _nonCachedRunners.size();
+    }
+
     CursorId CollectionCursorCache::_allocateCursorId_inlock() {
         for ( int i = 0; i < 10000; i++ ) {
             unsigned mypart = static_cast<unsigned>( _random->nextInt32() );
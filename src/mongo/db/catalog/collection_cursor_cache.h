@@ -98,6 +98,9 @@ namespace mongo {
         void getCursorIds( std::set<CursorId>* openCursors );
         std::size_t numCursors();
 
+        /** @return numCursors() plus the number of registered runners */
+        std::size_t numCursorsAndRunners();
+
         /**
          * @param pin - if true, will try to pin cursor
          *                  if pinned already, will assert
@@ -43,16 +43,24 @@
 
 namespace mongo {
 
+    namespace {
+        // shared by all collections, so no two ever have the same generation
+        AtomicUInt64 lastWriteGeneration;
+    }
+
     CollectionInfoCache::CollectionInfoCache( Collection* collection )
         : _collection( collection ),
           _keysComputed( false ),
           _planCache(new PlanCache(collection->ns().ns())),
-          _querySettings(new QuerySettings()) { }
+          _querySettings(new QuerySettings()) {
+        _bumpWriteGeneration();
+    }
 
     void CollectionInfoCache::reset() {
         Lock::assertWriteLocked( _collection->ns().ns() );
         LOG(1) << _collection->ns().ns() << ": clearing plan cache - collection info cache reset";
         clearQueryCache();
+        _bumpWriteGeneration();
         _keysComputed = false;
         // query settings is not affected by info cache reset.
         // index filters should persist throughout life of collection
@@ -80,11 +88,16 @@ namespace mongo {
     }
 
     void CollectionInfoCache::notifyOfWriteOp() {
+        _bumpWriteGeneration();
         if (NULL != _planCache.get()) {
             _planCache->notifyOfWriteOp();
         }
     }
 
+    void CollectionInfoCache::_bumpWriteGeneration() {
+        _writeGeneration.store( lastWriteGeneration.addAndFetch( 1 ) );
+    }
+
     void CollectionInfoCache::clearQueryCache() {
         if (NULL != _planCache.get()) {
             _planCache->clear();
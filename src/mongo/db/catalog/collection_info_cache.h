@@ -33,6 +33,7 @@
 #include <boost/scoped_ptr.hpp>
 
 #include "mongo/db/index_set.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/db/query/query_settings.h"
 #include "mongo/db/query/plan_cache.h"
 
@@ -91,6 +92,25 @@ namespace mongo {
         /* you must notify the cache if you are doing writes, as query plan utility will change */
         void notifyOfWriteOp();
 
+        /**
+         * For writes that change documents in place, without touching indexes or moving them:
+         * these leave plans alone but not results.
+         */
+        void notifyOfInPlaceUpdate() { _bumpWriteGeneration(); }
+
+        /**
+         * For moves of unchanged documents to other records, as compact makes: plans stay good,
+         * but results in natural order may not.
+         */
+        void notifyOfRecordMove() { _bumpWriteGeneration(); }
+
+        /**
+         * Changes with every write to the collection, and differs from that of every collection
+         * (including those dropped or created since) at any time, so results read at one
+         * generation are still the collection's contents while it is unchanged.
+         */
+        unsigned long long getWriteGeneration() const { return _writeGeneration.load(); }
+
     private:
 
         Collection* _collection; // not owned
@@ -107,6 +127,10 @@ namespace mongo {
         boost::scoped_ptr<QuerySettings> _querySettings;
 
         void computeIndexKeys();
+
+        void _bumpWriteGeneration();
+
+        AtomicUInt64 _writeGeneration;
     };
 
 }  // namespace mongo
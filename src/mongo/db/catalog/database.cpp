@@ -49,6 +49,7 @@
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/server_parameters.h"
 #include "mongo/db/storage_options.h"
+#include "mongo/db/structure/catalog/freelist_index.h"
 #include "mongo/db/catalog/collection.h"
 
 namespace mongo {
@@ -159,6 +160,10 @@ namespace mongo {
         verify( Lock::isW() );
         _magic = 0;
 
+        // our NamespaceDetails are about to be unmapped; the indexes of other databases just get
+        // rebuilt when next used
+        FreeListIndex::forgetAll();
+
         for ( CollectionMap::const_iterator i = _collections.begin(); i != _collections.end(); ++i )
             delete i->second;
     }
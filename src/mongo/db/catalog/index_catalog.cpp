@@ -1162,6 +1162,8 @@ namespace mongo {
 
         options.dupsAllowed = ignoreUniqueIndex( index->descriptor() ) || !isUnique;
 
+        index->noteKeyWrite();
+
         int64_t inserted;
         return index->accessMethod()->insert(obj, loc, options, &inserted, prep );
     }
@@ -1173,6 +1175,8 @@ namespace mongo {
         InsertDeleteOptions options;
         options.logIfError = logIfError;
 
+        index->noteKeyWrite();
+
         int64_t removed;
         Status status = index->accessMethod()->remove(obj, loc, options, &removed);
 
@@ -1313,8 +1317,9 @@ namespace mongo {
             double vv = o["v"].Number();
             // note (one day) we may be able to fresh build less versions than we can use
             // isASupportedIndexVersionNumber() is what we can use
+            // v:2 (prefix compressed keys) is never the default, it must be asked for
             uassert(14803, str::stream() << "this version of mongod cannot build new indexes of version number " << vv, 
-                    vv == 0 || vv == 1);
+                    vv == 0 || vv == 1 || vv == 2);
             v = (int) vv;
         }
         // idea is to put things we use a lot earlier
@@ -32,6 +32,7 @@
 
 #include "mongo/db/index/index_access_method.h"
 #include "mongo/db/index/index_descriptor.h"
+#include "mongo/db/query/index_key_histogram.h"
 
 namespace mongo {
 
@@ -44,7 +45,8 @@ namespace mongo {
           _accessMethod( NULL ),
           _forcedBtreeIndex( NULL ),
           _ordering( Ordering::make( descriptor->keyPattern() ) ),
-          _isReady( false ) {
+          _isReady( false ),
+          _histogramMutex( "IndexCatalogEntry::_histogramMutex" ) {
         _descriptor->_cachedEntry = this;
     }
 
@@ -111,6 +113,27 @@ namespace mongo {
         _isMultikey = true;
     }
 
+    boost::shared_ptr<const IndexKeyHistogram> IndexCatalogEntry::keyHistogram() const {
+        SimpleMutex::scoped_lock lk( _histogramMutex );
+        return _keyHistogram;
+    }
+
+    void IndexCatalogEntry::setKeyHistogram(
+            const boost::shared_ptr<const IndexKeyHistogram>& histogram ) {
+        SimpleMutex::scoped_lock lk( _histogramMutex );
+        _keyHistogram = histogram;
+        _writesSinceHistogram.store( 0 );
+    }
+
+    bool IndexCatalogEntry::keyHistogramIsStale() const {
+        boost::shared_ptr<const IndexKeyHistogram> histogram = keyHistogram();
+        if ( !histogram )
+            return true;
+        // a quarter of the index rewritten, and at least enough writes to be worth a walk
+        long long writes = _writesSinceHistogram.load();
+        return writes > 1000 && writes > histogram->numKeys() / 4;
+    }
+
     // ----
 
     bool IndexCatalogEntry::_catalogIsReady() const {
@@ -30,11 +30,14 @@
 
 #pragma once
 
+#include <boost/shared_ptr.hpp>
 #include <string>
 
 #include "mongo/base/owned_pointer_vector.h"
 #include "mongo/bson/ordering.h"
 #include "mongo/db/diskloc.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/mutex.h"
 
 namespace mongo {
 
@@ -42,6 +45,7 @@ namespace mongo {
     class IndexDescriptor;
     class RecordStore;
     class IndexAccessMethod;
+    class IndexKeyHistogram;
 
     class IndexCatalogEntry {
         MONGO_DISALLOW_COPYING( IndexCatalogEntry );
@@ -88,6 +92,19 @@ namespace mongo {
         // if this ready is ready for queries
         bool isReady() const;
 
+        // --
+
+        // sampled statistics of the keys, NULL until a bulk build or the sampler makes them
+        boost::shared_ptr<const IndexKeyHistogram> keyHistogram() const;
+
+        void setKeyHistogram( const boost::shared_ptr<const IndexKeyHistogram>& histogram );
+
+        // counts a document indexed or unindexed since the histogram was made
+        void noteKeyWrite() { _writesSinceHistogram.fetchAndAdd( 1 ); }
+
+        // true if there is no histogram, or enough writes since it that it should be remade
+        bool keyHistogramIsStale() const;
+
     private:
 
         int _indexNo() const;
@@ -113,6 +130,11 @@ namespace mongo {
         bool _isReady; // cache of NamespaceDetails info
         DiskLoc _head; // cache of IndexDetails
         bool _isMultikey; // cache of NamespaceDetails info
+
+        // set by the sampler under a read lock, so guarded rather than covered by the lock
+        mutable SimpleMutex _histogramMutex;
+        boost::shared_ptr<const IndexKeyHistogram> _keyHistogram;
+        AtomicInt64 _writesSinceHistogram;
     };
 
     class IndexCatalogEntryContainer {
@@ -0,0 +1,229 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/pch.h"
+
+#include "mongo/db/catalog/index_stats_sampler.h"
+
+#include <deque>
+#include <set>
+
+#include "mongo/base/counter.h"
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/catalog/index_catalog.h"
+#include "mongo/db/catalog/index_catalog_entry.h"
+#include "mongo/db/client.h"
+#include "mongo/db/catalog/database_holder.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/d_concurrency.h"
+#include "mongo/db/index/index_access_method.h"
+#include "mongo/db/index/index_cursor.h"
+#include "mongo/db/index/index_descriptor.h"
+#include "mongo/db/query/index_key_histogram.h"
+#include "mongo/db/query/query_knobs.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage_options.h"
+#include "mongo/util/background.h"
+
+namespace mongo {
+
+    // a walk reads every key of the index, so is only made when asked for
+    MONGO_EXPORT_SERVER_PARAMETER(sampleIndexKeysInBackground, bool, false);
+
+    static Counter64 sampledIndexes;
+    static ServerStatusMetricField<Counter64> displaySampledIndexes( "query.indexKeySamples",
+                                                                     &sampledIndexes );
+
+    namespace {
+
+        // walked per lock acquisition, so writers are not held off for long
+        const int SampleChunkKeys = 10000;
+        // a stale histogram only costs a planning trial, so requests beyond this are dropped
+        const size_t MaxQueuedIndexes = 64;
+
+        typedef std::pair<std::string, std::string> SampleRequest; // ns, index name
+
+        class IndexStatsSampler : public BackgroundJob {
+        public:
+            IndexStatsSampler() : _mutex( "IndexStatsSampler" ) {}
+            virtual ~IndexStatsSampler() {}
+
+            virtual string name() const { return "IndexStatsSampler"; }
+
+            void add( const SampleRequest& r ) {
+                scoped_lock lk( _mutex );
+                if ( _queued.size() >= MaxQueuedIndexes || _queued.count( r ) )
+                    return;
+                _queued.insert( r );
+                _queue.push_back( r );
+                _queueNotEmpty.notify_one();
+            }
+
+            virtual void run() {
+                Client::initThread( name().c_str() );
+
+                while ( !inShutdown() ) {
+                    SampleRequest r;
+                    {
+                        scoped_lock lk( _mutex );
+                        while ( _queue.empty() )
+                            _queueNotEmpty.wait( lk.boost() );
+                        r = _queue.front();
+                        _queue.pop_front();
+                    }
+
+                    try {
+                        _sample( r );
+                    }
+                    catch ( DBException& e ) {
+                        LOG(1) << "IndexStatsSampler: skipping index " << r.second << " on "
+                               << r.first << causedBy( e );
+                    }
+
+                    // requests for the index while it was walked are answered by this walk
+                    scoped_lock lk( _mutex );
+                    _queued.erase( r );
+                }
+
+                cc().shutdown();
+            }
+
+        private:
+            /**
+             * Walks the index from its first key, a chunk at a time.  Between chunks the index is
+             * found again by name and the walk picks up after the last key it read.  Gives up if
+             * the database, collection or index goes away, or a bulk build replaces its histogram
+             * meanwhile.
+             */
+            void _sample( const SampleRequest& r ) {
+                scoped_ptr<IndexKeyHistogram::Builder> builder;
+                boost::shared_ptr<const IndexKeyHistogram> startingHistogram;
+                BSONObj lastKey;
+                DiskLoc lastLoc;
+
+                while ( !inShutdown() ) {
+                    Lock::DBRead lk( r.first );
+                    // a Client::Context would open a database dropped since the request
+                    Database* db = dbHolder().get( r.first, storageGlobalParams.dbpath );
+                    if ( !db )
+                        return;
+                    Collection* collection = db->getCollection( r.first );
+                    if ( !collection )
+                        return;
+
+                    IndexCatalogEntry* entry = NULL;
+                    IndexCatalog::IndexIterator ii =
+                        collection->getIndexCatalog()->getIndexIterator( false );
+                    while ( ii.more() ) {
+                        IndexDescriptor* desc = ii.next();
+                        if ( desc->indexName() == r.second ) {
+                            entry = ii.entry( desc );
+                            break;
+                        }
+                    }
+                    if ( !entry )
+                        return;
+
+                    IndexCursor* rawCursor;
+                    if ( !entry->accessMethod()->newCursor( &rawCursor ).isOK() )
+                        return;
+                    scoped_ptr<IndexCursor> cursor( rawCursor );
+
+                    if ( !builder ) {
+                        startingHistogram = entry->keyHistogram();
+                        builder.reset( new IndexKeyHistogram::Builder(
+                                           collection->numRecords(),
+                                           internalQueryIndexStatsSamples ) );
+                        cursor->seek( _firstKey( entry->descriptor()->keyPattern() ) );
+                    }
+                    else {
+                        if ( entry->keyHistogram() != startingHistogram )
+                            return;
+                        // seek() lands on the first entry with lastKey
+                        cursor->seek( lastKey );
+                        while ( !cursor->isEOF() &&
+                                cursor->getKey().woCompare( lastKey ) == 0 &&
+                                cursor->getValue().compare( lastLoc ) <= 0 ) {
+                            cursor->next();
+                        }
+                    }
+
+                    for ( int n = 0; n < SampleChunkKeys && !cursor->isEOF(); n++ ) {
+                        lastKey = cursor->getKey().getOwned();
+                        lastLoc = cursor->getValue();
+                        builder->add( lastKey );
+                        cursor->next();
+                    }
+
+                    if ( cursor->isEOF() ) {
+                        entry->setKeyHistogram(
+                            boost::shared_ptr<const IndexKeyHistogram>( builder->done() ) );
+                        sampledIndexes.increment();
+                        return;
+                    }
+                }
+            }
+
+            /** the key before any other in an index on 'keyPattern' */
+            static BSONObj _firstKey( const BSONObj& keyPattern ) {
+                BSONObjBuilder b;
+                BSONObjIterator it( keyPattern );
+                while ( it.more() ) {
+                    if ( it.next().number() < 0 )
+                        b.appendMaxKey( "" );
+                    else
+                        b.appendMinKey( "" );
+                }
+                return b.obj();
+            }
+
+            mongo::mutex _mutex;
+            boost::condition _queueNotEmpty;
+            std::deque<SampleRequest> _queue;
+            std::set<SampleRequest> _queued;
+        };
+
+        IndexStatsSampler* sampler = NULL;
+
+    } // namespace
+
+    void requestIndexKeySample( const std::string& ns, const std::string& indexName ) {
+        if ( !sampler || !sampleIndexKeysInBackground )
+            return;
+        sampler->add( SampleRequest( ns, indexName ) );
+    }
+
+    void startIndexStatsSampler() {
+        verify( !sampler );
+        sampler = new IndexStatsSampler();
+        sampler->go();
+    }
+
+} // namespace mongo
@@ -161,6 +161,27 @@ namespace mongo {
         return *c;
     }
 
+    Client* Client::detachThread() {
+        Client* c = currentClient.release();
+        if ( c ) {
+            // the Client may be resumed on any thread, so it must not be left in an operation
+            verify( c->_context == 0 );
+        }
+        return c;
+    }
+
+    void Client::attachThread(Client* c) {
+        verify( c );
+        verify( currentClient.get() == 0 );
+        currentClient.reset(c);
+#ifndef _WIN32
+        stringstream temp;
+        temp << hex << showbase << pthread_self();
+        scoped_lock bl(clientsMutex); // currentOp reads _threadId under clientsMutex
+        c->_threadId = temp.str();
+#endif
+    }
+
     Client::Client(const string& desc, AbstractMessagingPort *p) :
         ClientBasic(p),
         _context(0),
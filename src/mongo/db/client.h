@@ -86,6 +86,15 @@ namespace mongo {
             initThread(desc);
         }
 
+        /** takes the current thread's Client out of TLS without destroying it, so that the
+         *  connection can be serviced by another thread for its next request.
+         *  @return the Client, or NULL if the thread had none
+         */
+        static Client* detachThread();
+
+        /** makes c, previously returned by detachThread(), the current thread's Client */
+        static void attachThread(Client* c);
+
         /** this has to be called as the client goes away, but before thread termination
          *  @return true if anything was done
          */
@@ -43,6 +43,7 @@
 #include "mongo/db/jsobj.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/util/timer.h"
 
 namespace mongo {
 
@@ -67,9 +68,13 @@ namespace mongo {
             help << "compact collection\n"
                 "warning: this operation locks the database and is slow. you can cancel with killOp()\n"
                 "{ compact : <collection_name>, [force:<bool>], [validate:<bool>],\n"
-                "  [paddingFactor:<num>], [paddingBytes:<num>] }\n"
+                "  [paddingFactor:<num>], [paddingBytes:<num>], [online:<bool>], [maxPauseMillis:<num>] }\n"
                 "  force - allows to run on a replica set primary\n"
-                "  validate - check records are noncorrupt before adding to newly compacting extents. slower but safer (defaults to true in this version)\n";
+                "  validate - check records are noncorrupt before adding to newly compacting extents. slower but safer (defaults to true in this version)\n"
+                "  online - move records a few at a time, yielding the lock in between, instead of rebuilding the collection.\n"
+                "           only frees sparsely used extents, but can run on a live primary\n"
+                "  maxPauseMillis - with online, the longest the collection is locked for at a time (default 10)\n"
+                "  with online, no record is moved while cursors are open on the collection, as they could miss it\n";
         }
         CompactCmd() : Command("compact") { }
 
@@ -90,7 +95,9 @@ namespace mongo {
                 return false;
             }
 
-            if( isCurrentlyAReplSetPrimary() && !cmdObj["force"].trueValue() ) {
+            const bool online = cmdObj["online"].trueValue();
+
+            if( !online && isCurrentlyAReplSetPrimary() && !cmdObj["force"].trueValue() ) {
                 errmsg = "will not run compact on an active replica set primary as this is a slow blocking operation. use force:true to force";
                 return false;
             }
@@ -141,6 +148,17 @@ namespace mongo {
             if ( cmdObj.hasElement("validate") )
                 compactOptions.validateDocuments = cmdObj["validate"].trueValue();
 
+            if ( online ) {
+                int maxPauseMillis = 10;
+                if ( cmdObj.hasElement("maxPauseMillis") ) {
+                    maxPauseMillis = cmdObj["maxPauseMillis"].numberInt();
+                    if ( maxPauseMillis < 1 || maxPauseMillis > 1000 ) {
+                        errmsg = "invalid maxPauseMillis";
+                        return false;
+                    }
+                }
+                return runOnline( ns, compactOptions, maxPauseMillis, errmsg, result );
+            }
 
             Lock::DBWrite lk(ns.ns());
             BackgroundOperation::assertNoBgOpInProgForNs(ns.ns());
@@ -174,6 +192,108 @@ namespace mongo {
 
             return true;
         }
+
+    private:
+        /**
+         * Compact in steps of at most 'maxPauseMillis' under the collection lock, sleeping in
+         * between for at least as long as the step took, and for longer while others are
+         * queueing for the lock or cursors are open on the collection.
+         */
+        bool runOnline( const NamespaceString& ns, const CompactOptions& compactOptions,
+                        int maxPauseMillis, string& errmsg, BSONObjBuilder& result ) {
+            // registered while we hold the lock, this keeps the collection and its indexes from
+            // being dropped between steps
+            scoped_ptr<BackgroundOperation> backgroundOperation;
+            {
+                Lock::DBWrite lk(ns.ns());
+                BackgroundOperation::assertNoBgOpInProgForNs(ns.ns());
+                Client::Context ctx(ns);
+
+                Collection* collection = ctx.db()->getCollection(ns.ns());
+                if( ! collection ) {
+                    errmsg = "namespace does not exist";
+                    return false;
+                }
+
+                if ( collection->isCapped() ) {
+                    errmsg = "cannot compact a capped collection";
+                    return false;
+                }
+
+                backgroundOperation.reset( new BackgroundOperation(ns.ns()) );
+            }
+
+            log() << "compact " << ns << " online begin, options: " << compactOptions.toString()
+                  << " maxPauseMillis: " << maxPauseMillis;
+
+            Timer t;
+            OnlineCompactState state;
+            CompactStats stats;
+            long long steps = 0;
+            int backoffMicros = 0;
+
+            while ( true ) {
+                int stepMicros;
+                int yieldMicros;
+                {
+                    Timer lockWait;
+                    Lock::DBWrite lk(ns.ns(), Lock::DBWrite::collectionScope);
+                    const int lockWaitMicros = lockWait.micros();
+                    Client::Context ctx(ns);
+
+                    Collection* collection = ctx.db()->getCollection(ns.ns());
+                    verify( collection );
+
+                    Timer step;
+                    const long long stepsPaused = stats.stepsPaused;
+                    StatusWith<bool> more( false );
+                    try {
+                        killCurrentOp.checkForInterrupt();
+                        more = collection->compactOnlineStep( &state, &compactOptions,
+                                                              maxPauseMillis * 1000, &stats );
+                    }
+                    catch ( DBException& ) {
+                        collection->compactOnlineAbandon( &state );
+                        throw;
+                    }
+                    if ( !more.isOK() ) {
+                        collection->compactOnlineAbandon( &state );
+                        return appendCommandStatus( result, more.getStatus() );
+                    }
+                    if ( !more.getValue() )
+                        break;
+
+                    steps++;
+                    stepMicros = step.micros();
+                    yieldMicros = Client::recommendedYieldMicros();
+
+                    // having waited longer for the lock than we held it means the foreground is
+                    // busy: back off more each time that happens, less each time it doesn't.
+                    // a paused step waits for cursors to close, which isn't worth polling for
+                    if ( stats.stepsPaused != stepsPaused )
+                        backoffMicros = 100 * 1000;
+                    else if ( lockWaitMicros > stepMicros )
+                        backoffMicros = std::min( std::max( 2 * backoffMicros,
+                                                            maxPauseMillis * 1000 ),
+                                                  1000 * 1000 );
+                    else
+                        backoffMicros /= 2;
+                }
+                sleepmicros( stepMicros + backoffMicros + 2 * yieldMicros );
+            }
+
+            log() << "compact " << ns << " online end, moved " << stats.recordsMoved
+                  << " records, freed " << stats.extentsFreed << " extents ("
+                  << stats.bytesReclaimed << " bytes) in " << steps << " steps, "
+                  << t.millis() << "ms";
+
+            result.append( "recordsMoved", stats.recordsMoved );
+            result.append( "extentsFreed", stats.extentsFreed );
+            result.append( "bytesReclaimed", stats.bytesReclaimed );
+            result.append( "steps", steps );
+            result.append( "stepsPaused", stats.stepsPaused );
+            return true;
+        }
     };
     static CompactCmd compactCmd;
 
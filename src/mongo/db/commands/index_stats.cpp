@@ -346,6 +346,7 @@ namespace mongo {
 
     typedef BtreeInspectorImpl<V0> BtreeInspectorV0;
     typedef BtreeInspectorImpl<V1> BtreeInspectorV1;
+    typedef BtreeInspectorImpl<V2> BtreeInspectorV2;
 
     /**
      * Run analysis with the provided parameters. See IndexStatsCmd for in-depth expanation of
@@ -379,6 +380,7 @@ namespace mongo {
 
         scoped_ptr<BtreeInspector> inspector(NULL);
         switch (details->version()) {
+          case 2: inspector.reset(new BtreeInspectorV2(params.expandNodes)); break;
           case 1: inspector.reset(new BtreeInspectorV1(params.expandNodes)); break;
           case 0: inspector.reset(new BtreeInspectorV0(params.expandNodes)); break;
           default:
@@ -405,7 +407,7 @@ namespace mongo {
      *
      * The output has the form:
      *     { index: <index name>,
-     *       version: <index version (0 or 1),
+     *       version: <index version (0, 1 or 2),
      *       isIdKey: <true if this is the default _id index>,
      *       keyPattern: <bson object describing the key pattern>,
      *       storageNs: <namespace of the index's underlying storage>,
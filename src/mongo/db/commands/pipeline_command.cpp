@@ -34,6 +34,7 @@
 #include "mongo/db/auth/action_set.h"
 #include "mongo/db/auth/action_type.h"
 #include "mongo/db/auth/privilege.h"
+#include "mongo/db/catalog/collection.h"
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/client.h"
 #include "mongo/db/curop.h"
@@ -48,6 +49,7 @@
 #include "mongo/db/pipeline/pipeline.h"
 #include "mongo/db/query/find_constants.h"
 #include "mongo/db/query/get_runner.h"
+#include "mongo/db/query/query_result_cache.h"
 #include "mongo/db/storage_options.h"
 
 namespace mongo {
@@ -303,6 +305,9 @@ namespace {
             }
 #endif
 
+            bool cacheable = false;
+            unsigned long long writeGeneration = 0;
+
             PipelineRunner* runner = NULL;
             scoped_ptr<ClientCursorPin> pin; // either this OR the runnerHolder will be non-null
             auto_ptr<PipelineRunner> runnerHolder;
@@ -317,6 +322,23 @@ namespace {
 
                 Collection* collection = ctx.ctx().db()->getCollection(ns);
 
+                // A repeat of a pipeline whose whole reply was cached at the collection's current
+                // write generation is answered from the cache.
+                if (queryResultCacheEnabled
+                    && QueryResultCache::canCacheFor(collection)
+                    && !pPipeline->isExplain()
+                    && !pCtx->inShard
+                    && pPipeline->readsOnlyInput()) {
+                    writeGeneration = collection->infoCache()->getWriteGeneration();
+                    cacheable = true;
+
+                    BSONObj cached;
+                    if (queryResultCache().get(ns, cmdObj, writeGeneration, &cached)) {
+                        result.appendElements(cached);
+                        return true;
+                    }
+                }
+
                 // This does mongod-specific stuff like creating the input Runner and adding to the
                 // front of the pipeline if needed.
                 boost::shared_ptr<Runner> input = PipelineD::prepareCursorSource(pPipeline, pCtx);
@@ -365,6 +387,19 @@ namespace {
             }
             // Any code that needs the cursor pinned must be inside the try block, above.
 
+            // Keep a complete reply that nothing wrote under while it was computed.
+            if (cacheable) {
+                BSONObj reply = result.asTempObj();
+                if (!isCursorCommand(cmdObj) || 0 == reply["cursor"]["id"].numberLong()) {
+                    Client::ReadContext ctx(ns);
+                    Collection* collection = ctx.ctx().db()->getCollection(ns);
+                    if (collection
+                        && collection->infoCache()->getWriteGeneration() == writeGeneration) {
+                        queryResultCache().put(ns, cmdObj, writeGeneration, reply);
+                    }
+                }
+            }
+
             return true;
         }
     } cmdPipeline;
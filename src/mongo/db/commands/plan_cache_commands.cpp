@@ -26,6 +26,7 @@
 *    it in the license file.
 */
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 
@@ -36,8 +37,10 @@
 #include "mongo/db/jsobj.h"
 #include "mongo/db/auth/authorization_session.h"
 #include "mongo/db/commands/plan_cache_commands.h"
+#include "mongo/db/commands/server_status.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/query/explain_plan.h"
+#include "mongo/db/query/plan_cache_stats.h"
 #include "mongo/db/query/plan_ranker.h"
 
 namespace {
@@ -412,4 +415,29 @@ namespace mongo {
         return Status::OK();
     }
 
+    //
+    // Plan trial and replan counts by query shape.
+    //
+
+    class PlanCacheServerStatus : public ServerStatusSection {
+    public:
+        // Only the shapes that have spent the longest in plan trials are listed: 20 of them,
+        // unless asked for more with {planCache: {shapes: <n>}}.
+        static const int kShapesReported = 20;
+
+        PlanCacheServerStatus() : ServerStatusSection("planCache") { }
+        virtual bool includeByDefault() const { return true; }
+
+        BSONObj generateSection(const BSONElement& configElement) const {
+            int shapes = kShapesReported;
+            if (configElement.isABSONObj() && configElement.Obj()["shapes"].isNumber()) {
+                shapes = std::max(0, configElement.Obj()["shapes"].numberInt());
+            }
+
+            BSONObjBuilder b;
+            planCacheShapeStats.append(&b, shapes);
+            return b.obj();
+        }
+    } planCacheServerStatus;
+
 } // namespace mongo
@@ -57,7 +57,11 @@ namespace mongo {
         const std::string kPollAgainField = "pollAgain";
         const std::string kMessagesField = "messages";
         const std::string kErrorField = "errors";
+        const std::string kGapsField = "gaps";
         const std::string kUnsubscribeField = "unsubscribe";
+        const std::string kCreatePollGroupField = "createPollGroup";
+        const std::string kPollGroupId = "pollGroupId";
+        const std::string kDestroyPollGroupField = "destroyPollGroup";
 
         // Helper method to validate single or array of SubscriptionId arguments
         void validate(BSONElement& element, std::set<OID>& oids) {
@@ -265,7 +269,7 @@ namespace mongo {
      *
      * Format:
      * {
-     *    subscriptionId: <ObjectId | Array>, // ID or IDs of subscriptions to poll on
+     *    poll: <ObjectId | Array>, // ID or IDs of subscriptions to poll on, or ID of a poll group
      *    [timeout]: <Number>  // number of milliseconds to wait if there are no new messages.
      * }
      *
@@ -283,8 +287,20 @@ namespace mongo {
      *           subscriptionId2: <string>,
      *           ...
      *        }
+     *    [gaps]: <Object>, // returned if and only if messages were lost. Has format:
+     *        {
+     *           subscriptionId: <Array>, // key is ID, value is array of gaps with format:
+     *               {
+     *                  channel: <string>, // channel the messages were published to
+     *                  origin: <ObjectId>, // ID of the process that published them
+     *                  first: <Long>, // sequence numbers of the first and last messages
+     *                  last: <Long>   // that were never received
+     *               }
+     *           ...
+     *        }
      *    millisPolled: <Integer>, // number of milliseconds command waited before finding messages.
-     *    [pollAgain]: <Bool> // returned as true only if poll gets no messages and times out.
+     *    [pollAgain]: <Bool> // returned as true only if poll gets no messages and times out,
+     *                        // or is cut short because the server has no worker to spare.
      * }
      */
     class PollCommand : public Command {
@@ -307,7 +323,8 @@ namespace mongo {
         }
 
         virtual void help(stringstream &help) const {
-            help << "{ poll : <subscriptionId(s)>, timeout : <integer milliseconds> }";
+            help << "{ poll : <subscriptionId(s) | pollGroupId>, "
+                 << "timeout : <integer milliseconds> }";
         }
 
         bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg,
@@ -346,11 +363,13 @@ namespace mongo {
             long long millisPolled = 0;
             bool pollAgain = false;
             std::map<SubscriptionId, std::string> errors;
+            std::vector<SequenceGap> gaps;
             std::priority_queue<SubscriptionMessage> messages = PubSub::poll(oids,
                                                                              timeout,
                                                                              millisPolled,
                                                                              pollAgain,
-                                                                             errors);
+                                                                             errors,
+                                                                             gaps);
 
             // serialize messages into BSON
             BSONObjBuilder messagesBuilder;
@@ -374,6 +393,26 @@ namespace mongo {
             }
 
             result.append(kMessagesField, messagesBuilder.obj());
+
+            if (gaps.size() > 0) {
+                // gaps are found in order of subscription, so each subscription's
+                // gaps are contiguous
+                BSONObjBuilder gapsBuilder;
+                std::vector<SequenceGap>::iterator it = gaps.begin();
+                while (it != gaps.end()) {
+                    SubscriptionId currId = it->subscriptionId;
+                    BSONArrayBuilder arrayBuilder;
+                    for (; it != gaps.end() && it->subscriptionId == currId; it++) {
+                        arrayBuilder.append(BSON("channel" << it->channel <<
+                                                 "origin" << it->origin <<
+                                                 "first" << static_cast<long long>(it->first) <<
+                                                 "last" << static_cast<long long>(it->last)));
+                    }
+                    gapsBuilder.append(currId.toString(), arrayBuilder.arr());
+                }
+                result.append(kGapsField, gapsBuilder.obj());
+            }
+
             result.append(kMillisPolledField, millisPolled);
             if (pollAgain)
                 result.append(kPollAgainField, true);
@@ -465,4 +504,147 @@ namespace mongo {
 
     } unsubscribeCmd;
 
+
+    /**
+     * Command for binding a set of subscriptions into a poll group. Polling on the returned
+     * ID polls on all of the subscriptions in the group without looking up each of them again.
+     *
+     * Format:
+     * {
+     *    createPollGroup: <ObjectId | Array>, // ID(s) of subscriptions to poll on together.
+     * }
+     *
+     * Return value:
+     * {
+     *    pollGroupId: <ObjectId>, // ID of poll group created, to be passed to poll
+     *    [errors]: <Object> // if any subscriptions can't be found, returns Object with format:
+     *        {
+     *           subscriptionId: <string>, // key is subscription ID, value is error message
+     *           subscriptionId2: <string>,
+     *           ...
+     *        }
+     * }
+     */
+    class CreatePollGroupCommand : public Command {
+    public:
+        CreatePollGroupCommand() : Command("createPollGroup") {}
+
+        virtual bool slaveOk() const { return true; }
+        virtual bool slaveOverrideOk() const { return true; }
+        virtual bool isWriteCommandForConfigServer() const { return false; }
+
+        virtual LockType locktype() const { return NONE; }
+
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            // TODO: get a real action type
+            actions.addAction(ActionType::find);
+            out->push_back(Privilege(parseResourcePattern(dbname, cmdObj), actions));
+        }
+
+        virtual void help(stringstream &help) const {
+            help << "{ createPollGroup : <subscriptionId(s)> }";
+        }
+
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg,
+                 BSONObjBuilder& result, bool fromRepl) {
+
+            uassert(18561, "PubSub is not enabled.", pubsubEnabled);
+
+            BSONElement oidElement = cmdObj[kCreatePollGroupField];
+            std::set<OID> oids;
+            validate(oidElement, oids);
+
+            std::map<SubscriptionId, std::string> errors;
+            OID pollGroupId = PubSub::createPollGroup(oids, errors);
+            result.append(kPollGroupId, pollGroupId);
+
+            if (errors.size() > 0) {
+                BSONObjBuilder errorBuilder;
+                for (std::map<SubscriptionId, std::string>::iterator it = errors.begin();
+                     it != errors.end();
+                     it++) {
+                        errorBuilder.append(it->first.toString(), it->second);
+                }
+                result.append(kErrorField, errorBuilder.obj());
+            }
+
+            return true;
+        }
+
+    } createPollGroupCmd;
+
+
+    /**
+     * Command for removing a poll group. The subscriptions in the group are not affected.
+     *
+     * Format:
+     * {
+     *    destroyPollGroup: <ObjectId | Array>, // ID(s) of poll group(s) to remove.
+     * }
+     *
+     * Return value:
+     * {
+     *    [errors]: <Object> // if any poll groups can't be found, returns Object with format:
+     *        {
+     *           pollGroupId: <string>, // key is poll group ID, value is error message
+     *           pollGroupId2: <string>,
+     *           ...
+     *        }
+     * }
+     */
+    class DestroyPollGroupCommand : public Command {
+    public:
+        DestroyPollGroupCommand() : Command("destroyPollGroup") {}
+
+        virtual bool slaveOk() const { return true; }
+        virtual bool slaveOverrideOk() const { return true; }
+        virtual bool isWriteCommandForConfigServer() const { return false; }
+
+        virtual LockType locktype() const { return NONE; }
+
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            // TODO: get a real action type
+            actions.addAction(ActionType::find);
+            out->push_back(Privilege(parseResourcePattern(dbname, cmdObj), actions));
+        }
+
+        virtual void help(stringstream &help) const {
+            help << "{ destroyPollGroup : <pollGroupId(s)> }";
+        }
+
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg,
+                 BSONObjBuilder& result, bool fromRepl) {
+
+            uassert(18562, "PubSub is not enabled.", pubsubEnabled);
+
+            BSONElement oidElement = cmdObj[kDestroyPollGroupField];
+            std::set<OID> oids;
+            validate(oidElement, oids);
+
+            std::map<SubscriptionId, std::string> errors;
+            for (std::set<OID>::iterator it = oids.begin(); it != oids.end(); it++) {
+                PubSub::destroyPollGroup(*it, errors);
+            }
+
+            if (errors.size() > 0) {
+                BSONObjBuilder errorBuilder;
+                for (std::map<SubscriptionId, std::string>::iterator it = errors.begin();
+                     it != errors.end();
+                     it++) {
+                        errorBuilder.append(it->first.toString(), it->second);
+                }
+                result.append(kErrorField, errorBuilder.obj());
+            }
+
+            return true;
+        }
+
+    } destroyPollGroupCmd;
+
 }  // namespace mongo
@@ -921,7 +921,7 @@ namespace mongo {
         }
 
         invariant(!_context.get());
-        _writeLock.reset(new Lock::DBWrite(request->getNS()));
+        _writeLock.reset(new Lock::DBWrite(request->getNS(), Lock::DBWrite::collectionScope));
         if (!checkIsMasterForCollection(request->getNS(), result)) {
             return false;
         }
@@ -1121,7 +1121,7 @@ namespace mongo {
         }
 
         ///////////////////////////////////////////
-        Lock::DBWrite writeLock( nsString.ns() );
+        Lock::DBWrite writeLock( nsString.ns(), Lock::DBWrite::collectionScope );
         ///////////////////////////////////////////
 
         if ( !checkShardVersion( &shardingState, *updateItem.getRequest(), result ) )
@@ -1177,7 +1177,7 @@ namespace mongo {
         }
 
         ///////////////////////////////////////////
-        Lock::DBWrite writeLock( nss.ns() );
+        Lock::DBWrite writeLock( nss.ns(), Lock::DBWrite::collectionScope );
         ///////////////////////////////////////////
 
         // Check version once we're locked
@@ -32,13 +32,18 @@
 
 #include "mongo/db/d_concurrency.h"
 
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/catalog/database_holder.h"
 #include "mongo/db/client.h"
 #include "mongo/db/commands/server_status.h"
 #include "mongo/db/curop.h"
 #include "mongo/db/d_globals.h"
 #include "mongo/db/dur.h"
+#include "mongo/db/introspect.h"
 #include "mongo/db/lockstat.h"
 #include "mongo/db/namespace_string.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage_options.h"
 #include "mongo/server.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/concurrency/mapsf.h"
@@ -65,6 +70,10 @@ namespace mongo {
 
     static const bool DB_LEVEL_LOCKING_ENABLED = ( ( MONGOD_CONCURRENCY_LEVEL ) >= MONGOD_CONCURRENCY_LEVEL_DB );
 
+    // lets Lock::DBWrite::collectionScope writers to different collections of a database run
+    // concurrently. see d_concurrency.h
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(collectionLevelLocking, bool, false);
+
     inline LockState& lockState() { 
         return cc().lockState();
     }
@@ -95,6 +104,9 @@ namespace mongo {
     typedef mapsf< StringMap<WrapperForRWLock*> > DBLocksMap;
     static DBLocksMap dblocks;
 
+    /* full ns->lock, for collection level locking. like dblocks these are never deleted. */
+    static DBLocksMap collectionLocks;
+
     /* we don't want to touch dblocks too much as a mutex is involved.  thus party for that, 
        this is here...
     */
@@ -242,8 +254,22 @@ namespace mongo {
             return true;
         if( ls.threadState() != 'w' ) 
             return false;
+        WrapperForRWLock* c = ls.collectionLock();
+        if( c && nsToDatabaseSubstring( ns ) == ls.otherName() ) {
+            // only the collection is ours, not the rest of the database
+            return ns == c->name();
+        }
         return ls.isLocked( ns );
     }
+    bool Lock::atLeastIntentWriteLocked(const StringData& ns) {
+        LockState &ls = lockState();
+        if( ls.collectionLock() && nsToDatabaseSubstring( ns ) == ls.otherName() )
+            return true;
+        return isWriteLocked( ns );
+    }
+    bool Lock::isCollectionLocked() {
+        return lockState().collectionLock() != NULL;
+    }
     bool Lock::atLeastReadLocked(const StringData& ns)
     { 
         LockState &ls = lockState();
@@ -270,6 +296,9 @@ namespace mongo {
     bool Lock::dbLevelLockingEnabled() {
         return DB_LEVEL_LOCKING_ENABLED;
     }
+    bool Lock::collectionLevelLockingEnabled() {
+        return DB_LEVEL_LOCKING_ENABLED && collectionLevelLocking;
+    }
 
     RWLockRecursive &Lock::ParallelBatchWriterMode::_batchLock = *(new RWLockRecursive("special"));
     void Lock::ParallelBatchWriterMode::iAmABatchParticipant() {
@@ -303,6 +332,13 @@ namespace mongo {
         int prevCount = ls.recursiveCount();
         Lock::ScopedLock* what = ls.leaveScopedLock();
         fassert( 16171 , prevCount != 1 || what == this );
+        if( what ) {
+            // all unlocked: write what profile() queued under a collection lock, see introspect.h
+            if( std::uncaught_exception() )
+                discardDeferredProfiles();
+            else
+                profileDeferred();
+        }
     }
     
     long long Lock::ScopedLock::acquireFinished( LockStat* stat ) {
@@ -527,6 +563,10 @@ namespace mongo {
             // nested. if/when we do temprelease with DBWrite we will need to increment here
             // (so we can not release or assert if nested).
             massert(16106, str::stream() << "internal error tried to lock two databases at the same time. old:" << ls.otherName() << " new:" << db , db == ls.otherName() );
+            WrapperForRWLock* c = ls.collectionLock();
+            massert(18603, str::stream() << "can't lock " << _what << " while only collection "
+                                         << ( c ? c->name() : "" ) << " is locked",
+                    c == 0 || _what == c->name());
             return;
         }
 
@@ -567,6 +607,7 @@ namespace mongo {
         _locked_W=false;
         _locked_w=false; 
         _weLocked=0;
+        _weLockedCollection=0;
 
 
         massert( 16186 , "can't get a DBWrite while having a read lock" , ! ls.hasAnyReadLock() );
@@ -582,8 +623,11 @@ namespace mongo {
                 _locked_W = true;
                 return;
             } 
-            if( !nested )
+            if( !nested ) {
+                if( _scope == collectionScope && lockCollection(ls, ns) )
+                    return;
                 lockOther(db);
+            }
             lockTop(ls);
             if( nested )
                 lockNestable(nested);
@@ -594,6 +638,70 @@ namespace mongo {
         }
     }
 
+    /** @return true if the collection could be created without changing its database */
+    static bool collectionLockable(const string& ns) {
+        NamespaceString nss(ns);
+        if( nss.coll().empty() || nss.isSystem() || nss.isSpecial() )
+            return false;
+        return n(nss.db()) == Lock::notnestable;
+    }
+
+    /** must be at least intent locked on ns's database */
+    static bool collectionExists(const string& ns) {
+        // opening the database would change dbHolder
+        if( !dbHolder().__isLoaded(ns, storageGlobalParams.dbpath) )
+            return false;
+        Database* db = dbHolder().get(ns, storageGlobalParams.dbpath);
+        return db && db->getCollection(ns);
+    }
+
+    /**
+     * intent locks ns's database, then exclusively locks the collection.
+     * @return false, with nothing locked, if this has to be a database level lock instead
+     */
+    bool Lock::DBWrite::lockCollection(LockState& ls, const string& ns) {
+        if( !collectionLevelLocking || ls.otherCount() || !collectionLockable(ns) )
+            return false;
+
+        StringData db = nsToDatabaseSubstring( ns );
+        if( db != ls.otherName() ) {
+            DBLocksMap::ref r(dblocks);
+            WrapperForRWLock*& lock = r[db];
+            if( lock == 0 )
+                lock = new WrapperForRWLock(db);
+            ls.lockedOther( db , 1 , lock );
+        }
+        else {
+            ls.lockedOther(1);
+        }
+        fassert(18606, _weLocked==0 && _weLockedCollection==0);
+        ls.otherLock()->lock_intent();
+        _weLocked = ls.otherLock();
+
+        // the collection lock is taken before the global 'w', as database locks are: a writer
+        // waiting here must not hold 'w', or it would never join a w->X upgrade by the
+        // collection's holder (see commitIfNeeded) and the upgrade would wait forever
+        WrapperForRWLock* c;
+        {
+            DBLocksMap::ref r(collectionLocks);
+            WrapperForRWLock*& lock = r[ns];
+            if( lock == 0 )
+                lock = new WrapperForRWLock(ns);
+            c = lock;
+        }
+        c->lock();
+        ls.lockedCollection(c);
+        _weLockedCollection = c;
+
+        lockTop(ls);
+
+        if( collectionExists(ns) )
+            return true;
+
+        unlockDB();
+        return false;
+    }
+
     void Lock::DBRead::lockDB(const string& ns) {
         fassert( 16254, !ns.empty() );
         LockState& ls = lockState();
@@ -619,8 +727,9 @@ namespace mongo {
         }
     }
 
-    Lock::DBWrite::DBWrite( const StringData& ns )
-        : ScopedLock( 'w' ), _what(ns.toString()), _nested(false) {
+    Lock::DBWrite::DBWrite( const StringData& ns, Scope scope )
+        : ScopedLock( 'w' ), _weLocked(0), _weLockedCollection(0),
+          _what(ns.toString()), _scope(scope), _nested(false) {
         lockDB( _what );
     }
 
@@ -637,7 +746,14 @@ namespace mongo {
     }
 
     void Lock::DBWrite::unlockDB() {
-        if( _weLocked ) {
+        if( _weLockedCollection ) {
+            recordTime();  // for lock stats
+            lockState().unlockedCollection();
+            lockState().unlockedOther();
+            _weLockedCollection->unlock();
+            _weLocked->unlock_intent();
+        }
+        else if( _weLocked ) {
             recordTime();  // for lock stats
         
             if ( _nested )
@@ -659,6 +775,7 @@ namespace mongo {
             qlk.unlock_W();
         }
         _weLocked = 0;
+        _weLockedCollection = 0;
         _locked_W = _locked_w = false;
     }
     void Lock::DBRead::unlockDB() {
@@ -717,6 +834,12 @@ namespace mongo {
             // nested. prev could be read or write. if/when we do temprelease with DBRead/DBWrite we will need to increment/decrement here
             // (so we can not release or assert if nested).  temprelease we should avoid if we can though, it's a bit of an anti-pattern.
             massert(16099, str::stream() << "internal error tried to lock two databases at the same time. old:" << ls.otherName() << " new:" << db, db == ls.otherName() );
+            // reading the database's catalog is fine under a collection lock, other
+            // collections are not
+            WrapperForRWLock* c = ls.collectionLock();
+            massert(18605, str::stream() << "can't lock " << _what << " while only collection "
+                                         << ( c ? c->name() : "" ) << " is locked",
+                    c == 0 || _what == c->name() || _what == db);
             return;
         }
 
@@ -872,4 +995,20 @@ namespace mongo {
 
     } lockStatsServerStatusSection;
 
+    class CollectionLockStatsServerStatusSection : public ServerStatusSection {
+    public:
+        CollectionLockStatsServerStatusSection() : ServerStatusSection( "collectionLocks" ){}
+        virtual bool includeByDefault() const { return Lock::collectionLevelLockingEnabled(); }
+
+        BSONObj generateSection( const BSONElement& configElement ) const {
+            BSONObjBuilder b;
+            DBLocksMap::ref r(collectionLocks);
+            for( DBLocksMap::const_iterator i = r.r.begin(); i != r.r.end(); ++i ) {
+                b.append(i->first, i->second->stats.report());
+            }
+            return b.obj();
+        }
+
+    } collectionLockStatsServerStatusSection;
+
 }
@@ -57,10 +57,13 @@ namespace mongo {
         static bool nested();
         static bool isWriteLocked(const StringData& ns);
         static bool atLeastReadLocked(const StringData& ns); // true if this db is locked
+        static bool atLeastIntentWriteLocked(const StringData& ns); // db write locked, or one of its collections
+        static bool isCollectionLocked(); // true if we hold a collection level write lock
         static void assertAtLeastReadLocked(const StringData& ns);
         static void assertWriteLocked(const StringData& ns);
 
         static bool dbLevelLockingEnabled(); 
+        static bool collectionLevelLockingEnabled();
         
         static LockStat* globalLockStat();
         static LockStat* nestableLockStat( Nestable db );
@@ -168,14 +171,16 @@ namespace mongo {
             /**
              * flow
              *   1) lockDB
-             *      a) lockTop
-             *      b) lockNestable or lockOther
+             *      a) lockCollection (collectionScope only), or
+             *      b) lockTop
+             *      c) lockNestable or lockOther
              *   2) unlockDB
              */
 
             void lockTop(LockState&);
             void lockNestable(Nestable db);
             void lockOther(const StringData& db);
+            bool lockCollection(LockState&, const string& ns);
             void lockDB(const string& ns);
             void unlockDB();
 
@@ -184,7 +189,19 @@ namespace mongo {
             void _relock();
 
         public:
-            DBWrite(const StringData& dbOrNs);
+            /**
+             * dbScope locks the whole database exclusively.
+             *
+             * collectionScope, for writes that only touch documents and indexes of an existing
+             * collection, takes an intent lock on the database and an exclusive lock on just
+             * that collection, so writers to other collections of the database can proceed
+             * concurrently. Readers of the database still exclude it. Falls back to dbScope when
+             * collection level locking is disabled, for system, local and admin namespaces, and
+             * when the collection doesn't exist yet (creating it changes the database).
+             */
+            enum Scope { dbScope, collectionScope };
+
+            DBWrite(const StringData& dbOrNs, Scope scope = dbScope);
             virtual ~DBWrite();
 
             class UpgradeToExclusive : private boost::noncopyable {
@@ -201,7 +218,9 @@ namespace mongo {
             bool _locked_w;
             bool _locked_W;
             WrapperForRWLock *_weLocked;
+            WrapperForRWLock *_weLockedCollection; // set if _weLocked is only intent locked
             const string _what;
+            const Scope _scope;
             bool _nested;
         };
 
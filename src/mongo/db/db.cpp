@@ -43,6 +43,7 @@
 #include "mongo/db/auth/authorization_manager_global.h"
 #include "mongo/db/catalog/index_catalog.h"
 #include "mongo/db/catalog/index_key_validate.h"
+#include "mongo/db/catalog/index_stats_sampler.h"
 #include "mongo/db/client.h"
 #include "mongo/db/clientcursor.h"
 #include "mongo/db/commands/server_status.h"
@@ -71,10 +72,12 @@
 #include "mongo/db/startup_warnings.h"
 #include "mongo/db/stats/counters.h"
 #include "mongo/db/stats/snapshots.h"
+#include "mongo/db/storage/extent_prewarmer.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/db/ttl.h"
 #include "mongo/db/pubsub_d.h"
 #include "mongo/platform/process_id.h"
+#include "mongo/s/d_logic.h"
 #include "mongo/s/d_writeback.h"
 #include "mongo/scripting/engine.h"
 #include "mongo/util/background.h"
@@ -83,6 +86,7 @@
 #include "mongo/util/concurrency/thread_name.h"
 #include "mongo/util/exception_filter_win32.h"
 #include "mongo/util/file_allocator.h"
+#include "mongo/util/net/blocking_section.h"
 #include "mongo/util/net/message_server.h"
 #include "mongo/util/net/ssl_manager.h"
 #include "mongo/util/ntservice.h"
@@ -190,6 +194,8 @@ namespace mongo {
         }
 
         virtual void process( Message& m , AbstractMessagingPort* port , LastError * le) {
+            // an exhaust cursor streams batches for as long as the client keeps reading them
+            scoped_ptr<BlockingSection> exhausting;
             while ( true ) {
                 if ( inShutdown() ) {
                     log() << "got request after shutdown()" << endl;
@@ -229,6 +235,8 @@ namespace mongo {
                             m.appendData(b.buf(), b.len());
                             b.decouple();
                             DEV log() << "exhaust=true sending more" << endl;
+                            if ( ! exhausting )
+                                exhausting.reset( new BlockingSection() );
                             beNice();
                             continue; // this goes back to top loop
                         }
@@ -243,6 +251,41 @@ namespace mongo {
             if( c ) c->shutdown();
         }
 
+        virtual bool canDetach() const { return true; }
+
+        virtual ConnectionState* detach( AbstractMessagingPort* p ) {
+            ConnState* state = new ConnState();
+            state->client = Client::detachThread();
+            state->shardingInfo = ShardedConnectionInfo::release();
+            return state;
+        }
+
+        virtual void attach( AbstractMessagingPort* p , ConnectionState* state ) {
+            scoped_ptr<ConnState> s( static_cast<ConnState*>( state ) );
+            if ( ! s )
+                return;
+            if ( s->client ) {
+                Client::attachThread( s->client );
+                s->client = NULL;
+            }
+            if ( s->shardingInfo ) {
+                ShardedConnectionInfo::set( s->shardingInfo );
+                s->shardingInfo = NULL;
+            }
+        }
+
+    private:
+        struct ConnState : public ConnectionState {
+            ConnState() : client(NULL), shardingInfo(NULL) {}
+            virtual ~ConnState() {
+                delete client;
+                delete shardingInfo;
+            }
+
+            Client* client;
+            ShardedConnectionInfo* shardingInfo;
+        };
+
     };
 
     void logStartup() {
@@ -750,6 +793,9 @@ namespace mongo {
             startTTLBackgroundJob();
         }
 
+        startExtentPrewarmer();
+        startIndexStatsSampler();
+
         bool pubsub = true;
         if (pubsub)
             startPubsubBackgroundJob();
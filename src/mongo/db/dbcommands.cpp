@@ -68,6 +68,7 @@
 #include "mongo/db/repair_database.h"
 #include "mongo/db/repl/is_master.h"
 #include "mongo/db/repl/oplog.h"
+#include "mongo/db/structure/catalog/freelist_index.h"
 #include "mongo/db/write_concern.h"
 #include "mongo/s/d_logic.h"
 #include "mongo/s/d_writeback.h"
@@ -1098,6 +1099,51 @@ namespace mongo {
         }
     } cmdCollectionStats;
 
+    class FreelistStats : public Command {
+    public:
+        FreelistStats() : Command( "freelistStats" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return READ; }
+        virtual void help( stringstream &help ) const {
+            help << "{ freelistStats:\"blog.posts\" }\n"
+                    "deleted record counts and bytes per size class, and the fraction of the\n"
+                    "collection's storage that is free (fragmentation)";
+        }
+        virtual void addRequiredPrivileges(const std::string& dbname,
+                                           const BSONObj& cmdObj,
+                                           std::vector<Privilege>* out) {
+            ActionSet actions;
+            actions.addAction(ActionType::collStats);
+            out->push_back(Privilege(parseResourcePattern(dbname, cmdObj), actions));
+        }
+        bool run(const string& dbname, BSONObj& jsobj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+            string ns = dbname + "." + jsobj.firstElement().valuestr();
+            Client::Context cx( ns );
+            Collection* collection = cx.db()->getCollection( ns );
+            if ( !collection ) {
+                errmsg = "Collection [" + ns + "] not found.";
+                return false;
+            }
+            if ( collection->details()->isCapped() ) {
+                errmsg = "capped collections don't keep deleted records by size";
+                return false;
+            }
+
+            result.append( "ns" , ns.c_str() );
+
+            BSONObjBuilder stats;
+            FreeListIndex::appendStats( collection->details(), &stats );
+            BSONObj obj = stats.obj();
+            result.appendElements( obj );
+
+            long long storageSize = collection->storageSize();
+            result.appendNumber( "storageSize" , storageSize );
+            result.append( "fragmentation" , storageSize ?
+                           obj["deletedBytes"].numberLong() / (double) storageSize : 0.0 );
+            return true;
+        }
+    } cmdFreelistStats;
+
     class CollectionModCommand : public Command {
     public:
         CollectionModCommand() : Command( "collMod" ){}
@@ -49,6 +49,9 @@
          to be too frequent.
        there could be a slow down immediately after remapping as fresh copy-on-writes for commonly written pages will
          be required.  so doing these remaps fractionally is helpful. 
+       on posix (other than solaris) mmap(MAP_FIXED) replaces a view atomically, so readers never see a missing
+         view and we remap while still in R: only writers are held off.  each pass also stops once it has run
+         for journalRemapMaxPauseMillis, picking up where it left off on the next pass.
 
    mutexes:
 
@@ -64,7 +67,7 @@
      UNLOCK groupCommitMutex
 
    every Nth groupCommit, at the end, we REMAPPRIVATEVIEW() at the end of the work. because of
-   that we are in W lock for that groupCommit, which is nonideal of course.
+   that we are in W lock for that groupCommit on Windows and Solaris, which is nonideal of course.
 
    @see https://docs.google.com/drawings/edit?id=1TklsmZzm7ohIZkwgeK6rMvsdaR13KjtJYMsfLr175Zc
 */
@@ -81,6 +84,7 @@
 #include "mongo/db/dur_journal.h"
 #include "mongo/db/dur_recover.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/server.h"
 #include "mongo/util/concurrency/race.h"
@@ -109,13 +113,28 @@ namespace mongo {
 
         CommitJob& commitJob = *(new CommitJob()); // don't destroy
 
+        // a REMAPPRIVATEVIEW pass stops once it has run this long; the remaining views are remapped
+        // on later passes. 0 means no limit.
+        MONGO_EXPORT_STARTUP_SERVER_PARAMETER(journalRemapMaxPauseMillis, int, 20);
+
+        namespace {
+            // exponential buckets from 100 micros up to ~400ms
+            Histogram::Options remapPauseHistogramOptions() {
+                Histogram::Options opts;
+                opts.numBuckets = 14;
+                opts.bucketSize = 100;
+                opts.exponential = true;
+                return opts;
+            }
+        }
+
         Stats stats;
 
         void Stats::S::reset() {
             memset(this, 0, sizeof(*this));
         }
 
-        Stats::Stats() {
+        Stats::Stats() : remapPauseMicros(remapPauseHistogramOptions()) {
             _a.reset();
             _b.reset();
             curr = &_a;
@@ -162,7 +181,8 @@ namespace mongo {
                              "prepLogBuffer" << (unsigned) (_prepLogBufferMicros/1000) <<
                              "writeToJournal" << (unsigned) (_writeToJournalMicros/1000) <<
                              "writeToDataFiles" << (unsigned) (_writeToDataFilesMicros/1000) <<
-                             "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000)
+                             "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000) <<
+                             "remapPrivateViewMaxPause" << (unsigned) (_remapPrivateViewMaxPauseMicros/1000)
                            );
             if (storageGlobalParams.journalCommitInterval != 0)
                 b << "journalCommitIntervalMs" << storageGlobalParams.journalCommitInterval;
@@ -170,7 +190,19 @@ namespace mongo {
         }
 
         BSONObj Stats::asObj() {
-            return other()->_asObj();
+            BSONObjBuilder b;
+            b.appendElements(other()->_asObj());
+
+            // each bucket counts the remap passes with a pause up to and including upTo
+            BSONArrayBuilder pauses(b.subarrayStart("remapPrivateViewPausesMicros"));
+            for (uint32_t i = 0; i < remapPauseMicros.getBucketsNum(); i++) {
+                BSONObjBuilder bucket(pauses.subobjStart());
+                bucket.appendNumber("upTo", static_cast<long long>(remapPauseMicros.getBoundary(i)));
+                bucket.appendNumber("count", static_cast<long long>(remapPauseMicros.getCount(i)));
+                bucket.done();
+            }
+            pauses.done();
+            return b.obj();
         }
 
         void Stats::rotate() {
@@ -311,7 +343,6 @@ namespace mongo {
                         LOG(2) << "can't commitNow from commitIfNeeded, as we are in admin db lock";
                         return false;
                     }
-
                     LOG(1) << "commitIfNeeded upgrading from shared write to exclusive write state"
                            << endl;
                     Lock::DBWrite::UpgradeToExclusive ex;
@@ -490,7 +521,13 @@ namespace mongo {
 
             LOG(4) << "journal REMAPPRIVATEVIEW" << endl;
 
+#if defined(_WIN32) || defined(__sunos__)
             verify( Lock::isW() );
+#else
+            // writers must be held off (a remap discards uncommitted writes in the view), but
+            // readers may carry on as the view is replaced atomically
+            verify( Lock::isRW() );
+#endif
             verify( !commitJob.hasWritten() );
 
             // we want to remap all private views about every 2 seconds.  there could be ~1000 views so
@@ -520,14 +557,11 @@ namespace mongo {
             if( sz == 0 )
                 return;
 
-            {
-                // be careful not to use too much memory if the write rate is 
-                // extremely high
-                double f = privateMapBytes / ((double)UncommittedBytesLimit);
-                if( f > fraction ) { 
-                    fraction = f;
-                }
-                privateMapBytes = 0;
+            // be careful not to use too much memory if the write rate is 
+            // extremely high
+            double f = privateMapBytes / ((double)UncommittedBytesLimit);
+            if( f > fraction ) { 
+                fraction = f;
             }
 
             unsigned ntodo = (unsigned) (sz * fraction);
@@ -543,10 +577,14 @@ namespace mongo {
                 if( i == e ) i = b;
             }
             unsigned startedAt = startAt;
-            startAt = (startAt + ntodo) % sz; // mark where to start next time
 
+            // the pass is bounded in time rather than in views: a view can be arbitrarily large, so
+            // on a big data set even a small fraction could hold writers off for a long while.  we
+            // always remap at least one view so that we make progress.
+            const long long maxPauseMicros = journalRemapMaxPauseMillis * 1000LL;
             Timer t;
-            for( unsigned x = 0; x < ntodo; x++ ) {
+            unsigned ndone = 0;
+            while( ndone < ntodo ) {
                 dassert( i != e );
                 if( (*i)->isDurableMappedFile() ) {
                     DurableMappedFile *mmf = (DurableMappedFile*) *i;
@@ -555,20 +593,33 @@ namespace mongo {
                         mmf->willNeedRemap() = false;
                         mmf->remapThePrivateView();
                     }
-                    i++;
-                    if( i == e ) i = b;
                 }
+                i++;
+                if( i == e ) i = b;
+                ndone++;
+                if( maxPauseMicros > 0 && t.micros() >= maxPauseMicros )
+                    break;
             }
-            LOG(2) << "journal REMAPPRIVATEVIEW done startedAt: " << startedAt << " n:" << ntodo << ' ' << t.millis() << "ms" << endl;
+            startAt = (startAt + ndone) % sz; // mark where to start next time
+
+            // what we didn't get to still counts against the private map, so that the next
+            // commits come back here sooner rather than taking the limited locks path
+            privateMapBytes = (size_t) (privateMapBytes * ((double)(ntodo - ndone) / ntodo));
+
+            LOG(2) << "journal REMAPPRIVATEVIEW done startedAt: " << startedAt << " n:" << ndone << '/' << ntodo << ' ' << t.millis() << "ms" << endl;
         }
 
         /** We need to remap the private views periodically. otherwise they would become very large.
-            Call within write lock.  See top of file for more commentary.
+            Call within write lock (Windows, Solaris) or R lock (other posix).  See top of file for more commentary.
         */
         void REMAPPRIVATEVIEW() {
             Timer t;
             _REMAPPRIVATEVIEW();
-            stats.curr->_remapPrivateViewMicros += t.micros();
+            unsigned long long micros = t.micros();
+            stats.curr->_remapPrivateViewMicros += micros;
+            if( micros > stats.curr->_remapPrivateViewMaxPauseMicros )
+                stats.curr->_remapPrivateViewMaxPauseMicros = micros;
+            stats.remapPauseMicros.insert( micros > 0xffffffffULL ? 0xffffffff : (uint32_t) micros );
         }
 
         // this is a pseudo-local variable in the groupcommit functions 
@@ -719,13 +770,17 @@ namespace mongo {
                 // if commitIfNeeded() operations are not in a W lock, you could get too big of a private map 
                 // on a giant operation.  for now they will all be W.
                 // 
-                // If desired, perhaps this can be eliminated on posix as it may be that the remap is race-free there.
+                // On posix other than Solaris the remap is race-free (mmap MAP_FIXED replaces the view atomically), so
+                // there we stay in R: writers are held off, as they must be, but readers are not.
                 //
-                // For durthread, lgw is set, and we can upgrade to a W lock for the remap. we do this way as we don't want 
-                // to be in W the entire time we were committing about (in particular for WRITETOJOURNAL() which takes time).
+                // Elsewhere, for durthread, lgw is set, and we can upgrade to a W lock for the remap. we do this way as we
+                // don't want to be in W the entire time we were committing about (in particular for WRITETOJOURNAL() which
+                // takes time).
                 if( lgw ) { 
+#if defined(_WIN32) || defined(__sunos__)
                     LOG(4) << "_groupCommit upgrade" << endl;
                     lgw->upgrade();
+#endif
                     REMAPPRIVATEVIEW();
                 }
             }
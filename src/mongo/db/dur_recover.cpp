@@ -48,13 +48,17 @@
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/storage/durable_mapped_file.h"
 #include "mongo/db/pdfile.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/util/bufreader.h"
 #include "mongo/util/checksum.h"
 #include "mongo/util/compress.h"
 #include "mongo/util/concurrency/race.h"
+#include "mongo/util/concurrency/thread_pool.h"
 #include "mongo/util/mongoutils/str.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/util/startup_test.h"
+#include "mongo/util/timer.h"
 
 using namespace mongoutils;
 
@@ -79,6 +83,17 @@ namespace mongo {
         void removeJournalFiles();
         boost::filesystem::path getJournalDir();
 
+        // threads used to decompress and, separately, to apply journal sections during recovery.
+        // 0 means one per core; 1 replays serially.
+        MONGO_EXPORT_STARTUP_SERVER_PARAMETER(journalRecoveryThreads, int, 0);
+
+        static unsigned recoveryThreads() {
+            if( journalRecoveryThreads > 0 )
+                return journalRecoveryThreads;
+            unsigned n = ProcessInfo().getNumCores();
+            return n ? n : 1;
+        }
+
         /** get journal filenames, in order. throws if unexpected content found */
         static void getFiles(boost::filesystem::path dir, vector<boost::filesystem::path>& files) {
             map<unsigned,boost::filesystem::path> m;
@@ -366,11 +381,214 @@ namespace mongo {
                 log() << "END section" << endl;
         }
 
-        void RecoveryJob::processSection(const JSectHeader *h, const void *p, unsigned len, const JSectFooter *f) {
-            LockMongoFilesShared lkFiles; // for RecoveryJob::Last
-            scoped_lock lk(_mx);
-            RACECHECK
+        /** replays the sections of one journal file with two thread pools.  sections are gathered into
+            batches; while one batch is decompressed, parsed and checksummed on the decode pool, the
+            batch before it is applied.  basic writes are cut at ChunkBits boundaries of their data
+            file and a given chunk of a given file always goes to the same apply thread, so writes to
+            any one location land in journal order.  DurOps are replayed on the calling thread once
+            every write before them is done.
+
+            the sections point into the mapped journal file, so this must not outlive that mapping;
+            the destructor waits for outstanding work.
+        */
+        class RecoveryJob::ParallelReplay : boost::noncopyable {
+        public:
+            ParallelReplay(RecoveryJob& rj, unsigned nThreads) :
+                _rj(rj),
+                _nThreads(nThreads),
+                _pendingBytes(0),
+                _partitions(nThreads),
+                _writeBytes(0),
+                _decodePool(nThreads),
+                _applyPool(nThreads) {
+            }
+
+            /** queue a section, decoding and applying earlier ones as batches fill */
+            void add(const JSectHeader *h, const void *p, unsigned len, const JSectFooter *f) {
+                if( _rj.skipSection(h) )
+                    return;
+                _pending.push_back(boost::shared_ptr<Section>(new Section(h, p, len, f)));
+                _pendingBytes += len;
+                if( _pending.size() >= 2 * _nThreads || _pendingBytes >= MaxBatchBytes )
+                    _submit();
+            }
+
+            /** apply everything queued so far */
+            void finish() {
+                if( !_pending.empty() )
+                    _submit();
+                _decodePool.join();
+                _apply(_decoding);
+                _decoding.clear();
+            }
+
+        private:
+            // cut writes into 1MB pieces for partitioning across apply threads
+            static const unsigned ChunkBits = 20;
+            static const unsigned MaxBatchBytes = 64 * 1024 * 1024;
+
+            struct Section : boost::noncopyable {
+                Section(const JSectHeader *h, const void *p, unsigned len, const JSectFooter *f) :
+                    h(h), p(p), len(len), f(f), errorCode(0) { }
+                const JSectHeader *h;
+                const void *p;
+                unsigned len;
+                const JSectFooter *f;
+
+                scoped_ptr<JournalSectionIterator> i; // owns the uncompressed data entries point into
+                vector<ParsedJournalEntry> entries;
+                int errorCode;
+                string error;  // set if the section couldn't be decoded
+            };
+            typedef vector<boost::shared_ptr<Section> > Batch;
+
+            struct WritePiece {
+                WritePiece(char *dest, const char *src, unsigned len) : dest(dest), src(src), len(len) { }
+                char *dest;
+                const char *src;
+                unsigned len;
+            };
+
+            /** runs on the decode pool. errors are kept for the applying thread to raise in order. */
+            static void _decode(Section *s) {
+                try {
+                    s->i.reset(new JournalSectionIterator(*s->h, s->p, s->len, true));
+                    while( !s->i->atEof() ) {
+                        ParsedJournalEntry e;
+                        s->i->next(e);
+                        s->entries.push_back(e);
+                    }
+                    verify( ((const char *)s->h) + sizeof(JSectHeader) == s->p );
+                    if( !s->f->checkHash(s->h, s->len + sizeof(JSectHeader)) ) {
+                        msgasserted(13594, "journal checksum doesn't match");
+                    }
+                }
+                catch( DBException& e ) {
+                    s->errorCode = e.getCode();
+                    s->error = e.what();
+                }
+                catch( std::exception& e ) {
+                    s->error = e.what();
+                }
+            }
+
+            /** runs on the apply pool */
+            static void _write(const vector<WritePiece> *pieces) {
+                for( vector<WritePiece>::const_iterator i = pieces->begin(); i != pieces->end(); ++i ) {
+                    memcpy(i->dest, i->src, i->len);
+                }
+            }
+
+            void _submit() {
+                // wait for the previous batch to decode; start on this one while we apply that one
+                _decodePool.join();
+                Batch decoded;
+                decoded.swap(_decoding);
+                _decoding.swap(_pending);
+                _pendingBytes = 0;
+                for( Batch::iterator i = _decoding.begin(); i != _decoding.end(); ++i ) {
+                    _decodePool.schedule(&ParallelReplay::_decode, i->get());
+                }
+                _apply(decoded);
+            }
+
+            void _apply(const Batch& batch) {
+                LockMongoFilesShared lkFiles; // for RecoveryJob::Last
+                scoped_lock lk(_rj._mx);
+
+                bool apply = (storageGlobalParams.durOptions &
+                              StorageGlobalParams::DurScanOnly) == 0;
+
+                for( Batch::const_iterator i = batch.begin(); i != batch.end(); ++i ) {
+                    Section& s = **i;
+                    if( !s.error.empty() ) {
+                        // everything before the bad section is applied, as with serial replay
+                        _flushWrites();
+                        msgasserted(s.errorCode ? s.errorCode : 18607,
+                                    str::stream() << "error decoding journal section seq:"
+                                                  << s.h->seqNumber << ' ' << s.error);
+                    }
+                    if( !apply )
+                        continue;
+
+                    Last last;
+                    for( vector<ParsedJournalEntry>::const_iterator e = s.entries.begin(); e != s.entries.end(); ++e ) {
+                        if( e->e ) {
+                            _queueWrite(last, *e);
+                        }
+                        else if( e->op ) {
+                            _flushWrites();
+                            if( e->op->needFilesClosed() ) {
+                                _rj._close();
+                                last = Last();
+                            }
+                            e->op->replay();
+                        }
+                    }
+                }
+                _flushWrites();
+            }
+
+            /** resolves the target file on this thread (it may need opening) and hands the write out by chunk */
+            void _queueWrite(Last& last, const ParsedJournalEntry& entry) {
+                verify(entry.dbName);
+                verify((size_t)strnlen(entry.dbName, MaxDatabaseNameLen) < MaxDatabaseNameLen);
+
+                DurableMappedFile *mmf = last.newEntry(entry, _rj);
+                if( (entry.e->ofs + entry.e->len) > mmf->length() ) {
+                    // as in RecoveryJob::write(), a write past the end of the file is ignored when recovering
+                    return;
+                }
+                verify(mmf->view_write());
+                verify(entry.e->srcData());
+
+                char *dest = (char*)mmf->view_write() + entry.e->ofs;
+                const char *src = entry.e->srcData();
+                unsigned long long ofs = entry.e->ofs;
+                unsigned left = entry.e->len;
+                _writeBytes += left;
+
+                // spread neighbouring chunks of a file over different threads
+                size_t fileHash = ((size_t) mmf) >> 4;
+                while( left ) {
+                    unsigned long long chunk = ofs >> ChunkBits;
+                    unsigned n = (unsigned) std::min<unsigned long long>(left, ((chunk + 1) << ChunkBits) - ofs);
+                    _partitions[(fileHash + chunk) % _nThreads].push_back(WritePiece(dest, src, n));
+                    dest += n;
+                    src += n;
+                    ofs += n;
+                    left -= n;
+                }
+            }
+
+            void _flushWrites() {
+                for( unsigned i = 0; i < _nThreads; i++ ) {
+                    if( !_partitions[i].empty() )
+                        _applyPool.schedule(&ParallelReplay::_write, &_partitions[i]);
+                }
+                _applyPool.join();
+                for( unsigned i = 0; i < _nThreads; i++ ) {
+                    _partitions[i].clear();
+                }
+                stats.curr->_writeToDataFilesBytes += _writeBytes;
+                _writeBytes = 0;
+            }
 
+            RecoveryJob& _rj;
+            const unsigned _nThreads;
+
+            Batch _pending;   // being gathered
+            unsigned _pendingBytes;
+            Batch _decoding;  // on the decode pool
+            vector<vector<WritePiece> > _partitions; // one per apply thread
+            unsigned long long _writeBytes;
+
+            // declared last so they are joined before the batches go away
+            ThreadPool _decodePool;
+            ThreadPool _applyPool;
+        };
+
+        bool RecoveryJob::skipSection(const JSectHeader *h) {
             /** todo: we should really verify the checksum to see that seqNumber is ok?
                       that is expensive maybe there is some sort of checksum of just the header 
                       within the header itself
@@ -386,8 +604,18 @@ namespace mongo {
                     }
                     _lastSeqMentionedInConsoleLog = h->seqNumber;
                 }
-                return;
+                return true;
             }
+            return false;
+        }
+
+        void RecoveryJob::processSection(const JSectHeader *h, const void *p, unsigned len, const JSectFooter *f) {
+            LockMongoFilesShared lkFiles; // for RecoveryJob::Last
+            scoped_lock lk(_mx);
+            RACECHECK
+
+            if( skipSection(h) )
+                return;
 
             auto_ptr<JournalSectionIterator> i;
             if( _recovering ) {
@@ -434,6 +662,14 @@ namespace mongo {
             @return true if this is detected to be the last file (ends abruptly)
         */
         bool RecoveryJob::processFileBuffer(const void *p, unsigned len) {
+            // with dump set the sections are logged as they are applied, so keep that serial
+            scoped_ptr<ParallelReplay> replay;
+            unsigned nThreads = recoveryThreads();
+            if( _recovering && nThreads > 1 &&
+                !(storageGlobalParams.durOptions & StorageGlobalParams::DurDumpJournal) ) {
+                replay.reset(new ParallelReplay(*this, nThreads));
+            }
+
             try {
                 unsigned long long fileId;
                 BufReader br(p,len);
@@ -476,6 +712,8 @@ namespace mongo {
                             log() << "Ending processFileBuffer at differing fileId want:" << fileId << " got:" << h.fileId << endl;
                             log() << "  sect len:" << h.sectionLen() << " seqnum:" << h.seqNumber << endl;
                         }
+                        if( replay )
+                            replay->finish();
                         return true;
                     }
                     unsigned slen = h.sectionLen();
@@ -483,15 +721,22 @@ namespace mongo {
                     const char *hdr = (const char *) br.skip(h.sectionLenWithPadding());
                     const char *data = hdr + sizeof(JSectHeader);
                     const char *footer = data + dataLen;
-                    processSection((const JSectHeader*) hdr, data, dataLen, (const JSectFooter*) footer);
+                    if( replay )
+                        replay->add((const JSectHeader*) hdr, data, dataLen, (const JSectFooter*) footer);
+                    else
+                        processSection((const JSectHeader*) hdr, data, dataLen, (const JSectFooter*) footer);
 
                     // ctrl c check
                     killCurrentOp.checkForInterrupt(false);
                 }
+                if( replay )
+                    replay->finish();
             }
             catch( BufReader::eof& ) {
                 if (storageGlobalParams.durOptions & StorageGlobalParams::DurDumpJournal)
                     log() << "ABRUPT END" << endl;
+                if( replay )
+                    replay->finish();
                 return true; // abrupt end
             }
 
@@ -528,6 +773,7 @@ namespace mongo {
             _lastDataSyncedFromLastRun = journalReadLSN();
             log() << "recover lsn: " << _lastDataSyncedFromLastRun << endl;
 
+            Timer t;
             for( unsigned i = 0; i != files.size(); ++i ) {
                 bool abruptEnd = processFile(files[i]);
                 if( abruptEnd && i+1 < files.size() ) {
@@ -538,6 +784,8 @@ namespace mongo {
             }
 
             close();
+            log() << "recover replayed " << files.size() << " journal file(s) in " << t.millis()
+                  << "ms using " << recoveryThreads() << " thread(s)" << endl;
 
             if (storageGlobalParams.durOptions & StorageGlobalParams::DurScanOnly) {
                 uasserted(13545, str::stream() << "--durOptions "
@@ -68,6 +68,10 @@ namespace mongo {
 
             static RecoveryJob & get() { return _instance; }
         private:
+            class ParallelReplay; // pipelines decompression and application of sections, recovery only
+            friend class ParallelReplay;
+
+            bool skipSection(const JSectHeader *h); // already in the datafiles as of the last run
             void write(Last& last, const ParsedJournalEntry& entry); // actually writes to the file
             void applyEntry(Last& last, const ParsedJournalEntry& entry, bool apply, bool dump);
             void applyEntries(const vector<ParsedJournalEntry> &entries);
@@ -28,6 +28,8 @@
 *    it in the license file.
 */
 
+#include "mongo/util/histogram.h"
+
 namespace mongo {
     namespace dur {
 
@@ -55,6 +57,7 @@ namespace mongo {
                 unsigned long long _writeToJournalMicros;
                 unsigned long long _writeToDataFilesMicros;
                 unsigned long long _remapPrivateViewMicros;
+                unsigned long long _remapPrivateViewMaxPauseMicros; // longest single remap pass
 
                 // undesirable to be in write lock for the group commit (it can be done in a read lock), so good if we
                 // have visibility when this happens.  can happen for a couple reasons
@@ -66,6 +69,12 @@ namespace mongo {
                 unsigned _dtMillis;
             };
             S *curr;
+
+            /** duration of each remap pass -- the time writers (and, on Windows and Solaris, readers
+                too) are held off while private views are remapped.  cumulative since startup, not
+                rotated with curr.
+            */
+            Histogram remapPauseMicros;
         private:
             S _a,_b;
             unsigned long long _lastRotate;
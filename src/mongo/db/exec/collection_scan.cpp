@@ -64,7 +64,8 @@ namespace mongo {
         : _workingSet(workingSet),
           _filter(filter),
           _params(params),
-          _nsDropped(false) {
+          _nsDropped(false),
+          _passedEnd(false) {
 
         // We pre-allocate a WSID and use it to pass up fetch requests.  It is only
         // used to pass up fetch requests and we should never use it for anything else.
@@ -128,6 +129,10 @@ namespace mongo {
             nextLoc = _iter->getNext();
         }
 
+        if (!_params.end.isNull() && nextLoc == _params.end) {
+            _passedEnd = true;
+        }
+
         WorkingSetID id = _workingSet->allocate();
         WorkingSetMember* member = _workingSet->get(id);
         member->loc = nextLoc;
@@ -148,11 +153,65 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState CollectionScan::workBatch(size_t maxWorks,
+                                                    std::vector<WorkingSetID>* out,
+                                                    WorkingSetID* special) {
+        // Tailing is left to work(...), as is anything out of the ordinary below.
+        if (_params.tailable) {
+            return PlanStage::workBatch(maxWorks, out, special);
+        }
+
+        const size_t before = out->size();
+        for (size_t i = 0; i < maxWorks; ++i) {
+            // Initialization, EOF and records that must be paged in first.
+            if (NULL == _iter || CollectionScan::isEOF() || !diskLocInMemory(_iter->curr())) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                StageState state = work(&id);
+                if (PlanStage::ADVANCED == state) {
+                    out->push_back(id);
+                }
+                else if (PlanStage::NEED_TIME != state) {
+                    *special = id;
+                    return state;
+                }
+                continue;
+            }
+
+            ++_commonStats.works;
+            DiskLoc nextLoc = _iter->getNext();
+            BSONObj obj = nextLoc.obj();
+
+            if (!_params.end.isNull() && nextLoc == _params.end) {
+                _passedEnd = true;
+            }
+
+            ++_specificStats.docsTested;
+
+            // Only documents that pass the filter get a WorkingSetMember.
+            if (!Filter::passes(obj, _filter)) {
+                ++_commonStats.needTime;
+                continue;
+            }
+
+            WorkingSetID id = _workingSet->allocate();
+            WorkingSetMember* member = _workingSet->get(id);
+            member->loc = nextLoc;
+            member->obj = obj;
+            member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+
+            ++_commonStats.advanced;
+            out->push_back(id);
+        }
+
+        return out->size() > before ? PlanStage::ADVANCED : PlanStage::NEED_TIME;
+    }
+
     bool CollectionScan::isEOF() {
         if ((0 != _params.maxScan) && (_specificStats.docsTested >= _params.maxScan)) {
             return true;
         }
         if (_nsDropped) { return true; }
+        if (_passedEnd) { return true; }
         if (NULL == _iter) { return false; }
         return _iter->isEOF();
     }
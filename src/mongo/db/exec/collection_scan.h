@@ -51,6 +51,8 @@ namespace mongo {
                        const MatchExpression* filter);
 
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* special);
         virtual bool isEOF();
 
         virtual void invalidate(const DiskLoc& dl, InvalidationType type);
@@ -78,6 +80,9 @@ namespace mongo {
         // True if nsdetails(_ns) == NULL on our first call to work.
         bool _nsDropped;
 
+        // True once we have read the record at _params.end.
+        bool _passedEnd;
+
         // If we want to return a DiskLoc and it points at something that's not in memory, we return
         // a a "please page this in" result.  We allocate one WSM for this purpose at construction
         // and reuse it for any future fetch requests, changing the DiskLoc as appropriate.
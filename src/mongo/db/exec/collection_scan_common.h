@@ -39,6 +39,7 @@ namespace mongo {
         };
 
         CollectionScanParams() : start(DiskLoc()),
+                                 end(DiskLoc()),
                                  direction(FORWARD),
                                  tailable(false),
                                  maxScan(0) { }
@@ -50,6 +51,11 @@ namespace mongo {
         // not being invalidated before the first call to work(...).
         DiskLoc start;
 
+        // isNull by default.  If you specify a value, the scan ends once it has read the record at
+        // this DiskLoc, which must come at or after 'start'.  Like 'start', it mustn't be
+        // invalidated while the scan runs.
+        DiskLoc end;
+
         Direction direction;
 
         // Do we want the scan to be 'tailable'?  Only meaningful if the collection is capped.
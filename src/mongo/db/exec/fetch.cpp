@@ -40,7 +40,14 @@ namespace mongo {
     MONGO_FP_DECLARE(fetchInMemorySucceed);
 
     FetchStage::FetchStage(WorkingSet* ws, PlanStage* child, const MatchExpression* filter)
-        : _ws(ws), _child(child), _filter(filter), _idBeingPagedIn(WorkingSet::INVALID_ID) { }
+        : _ws(ws),
+          _child(child),
+          _filter(filter),
+          _idBeingPagedIn(WorkingSet::INVALID_ID),
+          _batchPos(0),
+          _childBatchEnded(false),
+          _childBatchEnd(PlanStage::NEED_TIME),
+          _childBatchEndId(WorkingSet::INVALID_ID) { }
 
     FetchStage::~FetchStage() { }
 
@@ -51,6 +58,11 @@ namespace mongo {
             return false;
         }
 
+        if (_batchPos < _batch.size() || _childBatchEnded) {
+            // Our child's last batch isn't used up yet.
+            return false;
+        }
+
         return _child->isEOF();
     }
 
@@ -79,7 +91,19 @@ namespace mongo {
         // If we're here, we're not waiting for a DiskLoc to be fetched.  Get another to-be-fetched
         // result from our child.
         WorkingSetID id = WorkingSet::INVALID_ID;
-        StageState status = _child->work(&id);
+        StageState status;
+        if (_batchPos < _batch.size()) {
+            id = _batch[_batchPos++];
+            status = PlanStage::ADVANCED;
+        }
+        else if (_childBatchEnded) {
+            _childBatchEnded = false;
+            id = _childBatchEndId;
+            status = _childBatchEnd;
+        }
+        else {
+            status = _child->work(&id);
+        }
 
         if (PlanStage::ADVANCED == status) {
             WorkingSetMember* member = _ws->get(id);
@@ -138,6 +162,48 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState FetchStage::workBatch(size_t maxWorks,
+                                                std::vector<WorkingSetID>* out,
+                                                WorkingSetID* special) {
+        // Take a batch from our child unless we're still working through the last one.
+        if (_batchPos == _batch.size() && !_childBatchEnded
+            && WorkingSet::INVALID_ID == _idBeingPagedIn) {
+            _batch.clear();
+            _batchPos = 0;
+            StageState state = _child->workBatch(maxWorks, &_batch, &_childBatchEndId);
+            if (PlanStage::ADVANCED != state && PlanStage::NEED_TIME != state) {
+                _childBatchEnd = state;
+                _childBatchEnded = true;
+            }
+            else if (_batch.empty()) {
+                ++_commonStats.works;
+                ++_commonStats.needTime;
+                return PlanStage::NEED_TIME;
+            }
+        }
+
+        // Fetch what the batch holds, passing up a page-in request when a record isn't in memory.
+        const size_t before = out->size();
+        for (size_t i = 0; i < maxWorks; ++i) {
+            if (_batchPos == _batch.size() && !_childBatchEnded
+                && WorkingSet::INVALID_ID == _idBeingPagedIn) {
+                break;
+            }
+
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            StageState state = FetchStage::work(&id);
+            if (PlanStage::ADVANCED == state) {
+                out->push_back(id);
+            }
+            else if (PlanStage::NEED_TIME != state) {
+                *special = id;
+                return state;
+            }
+        }
+
+        return out->size() > before ? PlanStage::ADVANCED : PlanStage::NEED_TIME;
+    }
+
     void FetchStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -162,6 +228,14 @@ namespace mongo {
                 WorkingSetCommon::fetchAndInvalidateLoc(member);
             }
         }
+
+        // Likewise for what is left of our child's last batch.
+        for (size_t i = _batchPos; i < _batch.size(); ++i) {
+            WorkingSetMember* member = _ws->get(_batch[i]);
+            if (member->hasLoc() && (member->loc == dl)) {
+                WorkingSetCommon::fetchAndInvalidateLoc(member);
+            }
+        }
     }
 
     PlanStage::StageState FetchStage::fetchCompleted(WorkingSetID* out) {
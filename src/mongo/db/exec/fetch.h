@@ -50,6 +50,8 @@ namespace mongo {
 
         virtual bool isEOF();
         virtual StageState work(WorkingSetID* out);
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* special);
 
         virtual void prepareToYield();
         virtual void recoverFromYield();
@@ -81,6 +83,17 @@ namespace mongo {
         // a "please page this in" result and hold on to the WSID until the next call to work(...).
         WorkingSetID _idBeingPagedIn;
 
+        // Results of our child's last workBatch(...) that we have yet to fetch, from _batchPos on.
+        // work(...) takes these before asking our child for more.
+        std::vector<WorkingSetID> _batch;
+        size_t _batchPos;
+
+        // If our child's last batch ended in a state other than ADVANCED or NEED_TIME, that state
+        // and its WSID, to be passed on once _batch is used up.
+        bool _childBatchEnded;
+        StageState _childBatchEnd;
+        WorkingSetID _childBatchEndId;
+
         // Stats
         CommonStats _commonStats;
         FetchStats _specificStats;
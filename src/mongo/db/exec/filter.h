@@ -158,6 +158,15 @@ namespace mongo {
             return filter->matches(&doc, NULL);
         }
 
+        /**
+         * Returns true if filter is NULL or if the document 'obj' satisfies the filter.  Lets a
+         * stage test a document before it allocates a WorkingSetMember for it.
+         */
+        static bool passes(const BSONObj& obj, const MatchExpression* filter) {
+            if (NULL == filter) { return true; }
+            return filter->matchesBSON(obj, NULL);
+        }
+
         static bool passes(const BSONObj& keyData,
                            const BSONObj& keyPattern,
                            const MatchExpression* filter) {
@@ -27,6 +27,9 @@
  */
 
 #include "mongo/db/exec/limit.h"
+
+#include <algorithm>
+
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/util/mongoutils/str.h"
 
@@ -81,6 +84,46 @@ namespace mongo {
         }
     }
 
+    PlanStage::StageState LimitStage::workBatch(size_t maxWorks,
+                                                std::vector<WorkingSetID>* out,
+                                                WorkingSetID* special) {
+        if (0 == _numToReturn) {
+            ++_commonStats.works;
+            return PlanStage::IS_EOF;
+        }
+
+        // A batch never holds more results than units of work, so this can't overshoot.
+        const size_t before = out->size();
+        StageState status = _child->workBatch(std::min(maxWorks, size_t(_numToReturn)),
+                                               out, special);
+
+        const size_t produced = out->size() - before;
+        _numToReturn -= static_cast<int>(produced);
+        _commonStats.works += produced;
+        _commonStats.advanced += produced;
+
+        if (PlanStage::ADVANCED == status) {
+            return status;
+        }
+
+        ++_commonStats.works;
+        if (PlanStage::FAILURE == status) {
+            if (WorkingSet::INVALID_ID == *special) {
+                mongoutils::str::stream ss;
+                ss << "limit stage failed to read in results from child";
+                Status status(ErrorCodes::InternalError, ss);
+                *special = WorkingSetCommon::allocateStatusMember( _ws, status);
+            }
+        }
+        else if (PlanStage::NEED_FETCH == status) {
+            ++_commonStats.needFetch;
+        }
+        else if (PlanStage::NEED_TIME == status) {
+            ++_commonStats.needTime;
+        }
+        return status;
+    }
+
     void LimitStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "mongo/db/exec/plan_stats.h"
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/invalidation_type.h"
@@ -171,6 +173,35 @@ namespace mongo {
          */
         virtual StageState work(WorkingSetID* out) = 0;
 
+        /**
+         * Perform up to 'maxWorks' units of work, appending every result produced to 'out'.  The
+         * caller owns the results in 'out' just as if work(...) had returned them one at a time.
+         *
+         * Stops at the first unit of work that returns neither ADVANCED nor NEED_TIME and returns
+         * that state, with *special set as work(...) would have set its out parameter; the
+         * results produced before it are still in 'out'.  Otherwise returns ADVANCED if anything
+         * was appended to 'out' and NEED_TIME if not.  Never appends more than 'maxWorks' results.
+         *
+         * This default calls work(...) once per unit.  Stages that carry whole scans override it
+         * to move a batch through without a virtual call and a WorkingSetMember per document.
+         */
+        virtual StageState workBatch(size_t maxWorks, std::vector<WorkingSetID>* out,
+                                     WorkingSetID* special) {
+            const size_t before = out->size();
+            for (size_t i = 0; i < maxWorks; ++i) {
+                WorkingSetID id = WorkingSet::INVALID_ID;
+                StageState state = work(&id);
+                if (ADVANCED == state) {
+                    out->push_back(id);
+                }
+                else if (NEED_TIME != state) {
+                    *special = id;
+                    return state;
+                }
+            }
+            return out->size() > before ? ADVANCED : NEED_TIME;
+        }
+
         /**
          * Returns true if no more work can be done on the query / out of results.
          */
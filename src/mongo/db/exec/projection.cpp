@@ -230,6 +230,51 @@ namespace mongo {
         return status;
     }
 
+    PlanStage::StageState ProjectionStage::workBatch(size_t maxWorks,
+                                                     std::vector<WorkingSetID>* out,
+                                                     WorkingSetID* special) {
+        const size_t before = out->size();
+        StageState status = _child->workBatch(maxWorks, out, special);
+
+        // Each result we project counts as a unit of our work, as does whatever ended the batch.
+        for (size_t i = before; i < out->size(); ++i) {
+            ++_commonStats.works;
+            Status projStatus = transform(_ws->get((*out)[i]));
+            if (!projStatus.isOK()) {
+                warning() << "Couldn't execute projection, status = "
+                          << projStatus.toString() << endl;
+                for (size_t j = i; j < out->size(); ++j) {
+                    _ws->free((*out)[j]);
+                }
+                out->resize(i);
+                *special = WorkingSetCommon::allocateStatusMember(_ws, projStatus);
+                return PlanStage::FAILURE;
+            }
+            ++_commonStats.advanced;
+        }
+
+        if (PlanStage::ADVANCED == status) {
+            return status;
+        }
+
+        ++_commonStats.works;
+        if (PlanStage::FAILURE == status) {
+            if (WorkingSet::INVALID_ID == *special) {
+                mongoutils::str::stream ss;
+                ss << "projection stage failed to read in results from child";
+                Status status(ErrorCodes::InternalError, ss);
+                *special = WorkingSetCommon::allocateStatusMember( _ws, status);
+            }
+        }
+        else if (PlanStage::NEED_FETCH == status) {
+            ++_commonStats.needFetch;
+        }
+        else if (PlanStage::NEED_TIME == status) {
+            ++_commonStats.needTime;
+        }
+        return status;
+    }
+
     void ProjectionStage::prepareToYield() {
         ++_commonStats.yields;
         _child->prepareToYield();
@@ -300,11 +300,10 @@ namespace mongo {
             // This is heavy and should be done as part of work().
             _sortKeyGen.reset(new SortStageKeyGenerator(_pattern, _query));
             _sortKeyComparator.reset(new WorkingSetComparator(_sortKeyGen->getSortComparator()));
-            // If limit > 1, we need to initialize _dataSet here to maintain ordered
-            // set of data items while fetching from the child stage.
-            if (_limit > 1) {
-                const WorkingSetComparator& cmp = *_sortKeyComparator;
-                _dataSet.reset(new SortableDataItemSet(cmp));
+            // The top-k heap never holds more than _limit items, so make room for them up front
+            // unless the limit is so large that it's probably a batch size.
+            if (_limit > 1 && _limit * sizeof(SortableDataItem) < kMaxBytes / 10) {
+                _data.reserve(_limit);
             }
             return PlanStage::NEED_TIME;
         }
@@ -471,10 +470,12 @@ namespace mongo {
      *                     Updates memory usage if item was replaced.
      *     sortBuffer() - Does nothing.
      * limit > 1:
-     *     addToBuffer() - Does not update vector. Adds item to set.
-     *                     If size of set exceeds limit, remove item from set
-     *                     with lowest key. Updates memory usage accordingly.
-     *     sortBuffer() - Copies items from set to vectors.
+     *     addToBuffer() - Adds item to vector until it holds limit items, then makes the
+     *                     vector a heap with the item with the highest key at the front.
+     *                     After that, an item with a lower key than the front replaces it,
+     *                     and any other item is dropped right away. Updates memory usage
+     *                     accordingly.
+     *     sortBuffer() - Sorts the heap, or the vector if limit was never reached.
      */
     void SortStage::addToBuffer(const SortableDataItem& item) {
         // Holds ID of working set member to be freed at end of this function.
@@ -500,31 +501,29 @@ namespace mongo {
             }
         }
         else {
-            // Update data item set instead of vector
-            // Limit not reached - insert and return
+            // Top-k: a max-heap of the best _limit items seen so far, with the worst in front.
+            const WorkingSetComparator& cmp = *_sortKeyComparator;
             vector<SortableDataItem>::size_type limit(_limit);
-            if (_dataSet->size() < limit) {
-                _dataSet->insert(item);
+            if (_data.size() < limit) {
+                _data.push_back(item);
                 _memUsage += _ws->get(item.wsid)->getMemUsage();
+                if (_data.size() == limit) {
+                    std::make_heap(_data.begin(), _data.end(), cmp);
+                }
                 return;
             }
-            // Limit will be exceeded - compare with item with lowest key
-            // If new item does not have a lower key value than last item,
-            // do nothing.
+
+            // If new item does not have a lower key value than the worst kept item, drop it.
             wsidToFree = item.wsid;
-            SortableDataItemSet::const_iterator lastItemIt = --(_dataSet->end());
-            const SortableDataItem& lastItem = *lastItemIt;
-            const WorkingSetComparator& cmp = *_sortKeyComparator;
-            if (cmp(item, lastItem)) {
-                _memUsage -= _ws->get(lastItem.wsid)->getMemUsage();
+            if (cmp(item, _data.front())) {
+                const SortableDataItem& worstItem = _data.front();
+                _memUsage -= _ws->get(worstItem.wsid)->getMemUsage();
                 _memUsage += _ws->get(item.wsid)->getMemUsage();
-                wsidToFree = lastItem.wsid;
-                // According to std::set iterator validity rules,
-                // it does not matter which of erase()/insert() happens first.
-                // Here, we choose to erase first to release potential resources
-                // used by the last item and to keep the scope of the iterator to a minimum.
-                _dataSet->erase(lastItemIt);
-                _dataSet->insert(item);
+                wsidToFree = worstItem.wsid;
+
+                std::pop_heap(_data.begin(), _data.end(), cmp);
+                _data.back() = item;
+                std::push_heap(_data.begin(), _data.end(), cmp);
             }
         }
 
@@ -549,12 +548,14 @@ namespace mongo {
             return;
         }
         else {
-            // Set already contains items in sorted order, so we simply copy the items
-            // from the set to the vector.
-            // Release the memory for the set after the copy.
-            vector<SortableDataItem> newData(_dataSet->begin(), _dataSet->end());
-            _data.swap(newData);
-            _dataSet.reset();
+            const WorkingSetComparator& cmp = *_sortKeyComparator;
+            if (_data.size() == size_t(_limit)) {
+                std::sort_heap(_data.begin(), _data.end(), cmp);
+            }
+            else {
+                // Never filled, so never made a heap.
+                std::sort(_data.begin(), _data.end(), cmp);
+            }
         }
     }
 
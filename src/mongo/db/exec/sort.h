@@ -30,7 +30,6 @@
 
 #include <boost/scoped_ptr.hpp>
 #include <vector>
-#include <set>
 
 #include "mongo/db/diskloc.h"
 #include "mongo/db/jsobj.h"
@@ -190,7 +189,7 @@ namespace mongo {
             DiskLoc loc;
         };
 
-        // Comparison object for data buffers (vector and set).
+        // Comparison object for the data buffer.
         // Items are compared on (sortKey, loc). This is also how the items are
         // ordered in the indices.
         // Keys are compared using BSONObj::woCompare() with DiskLoc as a tie-breaker.
@@ -203,16 +202,14 @@ namespace mongo {
         };
 
         /**
-         * Inserts one item into data buffer (vector or set).
-         * If limit is exceeded, remove item with lowest key.
+         * Inserts one item into data buffer.
+         * If limit is exceeded, remove item with highest key.
          */
         void addToBuffer(const SortableDataItem& item);
 
         /**
          * Sorts data buffer.
          * Assumes no more items will be added to buffer.
-         * If data is stored in set, copy set
-         * contents to vector and clear set.
          */
         void sortBuffer();
 
@@ -223,13 +220,9 @@ namespace mongo {
         // The data we buffer and sort.
         // _data will contain sorted data when all data is gathered
         // and sorted.
-        // When _limit is greater than 1 and not all data has been gathered from child stage,
-        // _dataSet is used instead to maintain an ordered set of the incomplete data set.
-        // When the data set is complete, we copy the items from _dataSet to _data which will
-        // be used to provide the results of this stage through _resultIterator.
+        // When _limit is greater than 1, _data is a heap of the best _limit items seen so far
+        // once it holds _limit of them, so that it never holds more.
         vector<SortableDataItem> _data;
-        typedef std::set<SortableDataItem, WorkingSetComparator> SortableDataItemSet;
-        scoped_ptr<SortableDataItemSet> _dataSet;
 
         // Iterates through _data post-sort returning it.
         vector<SortableDataItem>::iterator _resultIterator;
@@ -42,15 +42,20 @@ namespace mongo {
         public:
             typedef pair<BSONObj, DiskLoc> Data;
 
+            typedef BSONObjExternalSorter::InterruptCheck InterruptCheck;
+
             ComparatorWithInterruptCheck(const ExternalSortComparison* comp,
-                                         boost::shared_ptr<const bool> mayInterrupt)
+                                         boost::shared_ptr<const InterruptCheck> interrupt)
                 : _comp(comp)
-                , _mayInterrupt(mayInterrupt)
+                , _interrupt(interrupt)
             {}
 
             int operator() (const Data& l, const Data& r) const {
-                RARELY if (*_mayInterrupt) {
-                    killCurrentOp.checkForInterrupt(!*_mayInterrupt);
+                RARELY if (_interrupt->mayInterrupt) {
+                    if (_interrupt->client)
+                        killCurrentOp.checkForInterrupt(*_interrupt->client);
+                    else
+                        killCurrentOp.checkForInterrupt(false);
                 }
 
                 return _comp->compare(l, r);
@@ -58,19 +63,29 @@ namespace mongo {
 
         private:
             const ExternalSortComparison* _comp;
-            boost::shared_ptr<const bool> _mayInterrupt;
+            boost::shared_ptr<const InterruptCheck> _interrupt;
         };
     }
 
     BSONObjExternalSorter::BSONObjExternalSorter(const ExternalSortComparison* comp,
                                                  long maxFileSize)
-        : _mayInterrupt(boost::make_shared<bool>(false))
+        : _interrupt(boost::make_shared<InterruptCheck>())
         , _sorter(Sorter<BSONObj, DiskLoc>::make(
                     SortOptions().TempDir(storageGlobalParams.dbpath + "/_tmp")
                                  .ExtSortAllowed()
                                  .MaxMemoryUsageBytes(maxFileSize),
-                    ComparatorWithInterruptCheck(comp, _mayInterrupt)))
+                    ComparatorWithInterruptCheck(comp, _interrupt)))
     {}
+
+    auto_ptr<BSONObjExternalSorter::Iterator> BSONObjExternalSorter::merge(
+            const vector<shared_ptr<Iterator> >& iterators,
+            const ExternalSortComparison* comp) {
+        return auto_ptr<Iterator>(Iterator::merge(
+                    iterators,
+                    SortOptions(),
+                    ComparatorWithInterruptCheck(comp,
+                                                 boost::make_shared<InterruptCheck>())));
+    }
 }
 
 #include "mongo/db/sorter/sorter.cpp"
@@ -36,6 +36,8 @@
 
 namespace mongo {
 
+    class Client;
+
     typedef pair<BSONObj, DiskLoc> ExternalSortDatum;
 
     /**
@@ -57,19 +59,46 @@ namespace mongo {
         BSONObjExternalSorter(const ExternalSortComparison* comp, long maxFileSize=100*1024*1024);
 
         void add( const BSONObj& o, const DiskLoc& loc, bool mayInterrupt ) {
-            *_mayInterrupt = mayInterrupt;
+            _interrupt->mayInterrupt = mayInterrupt;
             _sorter->add(o.getOwned(), loc);
         }
 
         auto_ptr<Iterator> iterator() { return auto_ptr<Iterator>(_sorter->done()); }
 
-        void sort( bool mayInterrupt ) { *_mayInterrupt = mayInterrupt; }
+        /**
+         * Merges iterators that each return data in 'comp' order, such as the iterators of
+         * several sorters built with 'comp', into one iterator over all of it in order.
+         */
+        static auto_ptr<Iterator> merge(const vector<shared_ptr<Iterator> >& iterators,
+                                        const ExternalSortComparison* comp);
+
+        void sort( bool mayInterrupt ) {
+            _interrupt->mayInterrupt = mayInterrupt;
+            _interrupt->client = NULL;
+        }
+
+        /**
+         * like sort(true), for a sort finished by iterator() on another thread than 'client''s,
+         * which waits for it: the current operation of 'client' is checked for interrupts
+         */
+        void sortFor( Client* client ) {
+            _interrupt->mayInterrupt = true;
+            _interrupt->client = client;
+        }
+
         int numFiles() { return _sorter->numFiles(); }
         long getCurSizeSoFar() { return _sorter->memUsed(); }
         void hintNumObjects(long long) {} // unused
 
+        /** when and for whom the comparisons of a sort check for interrupts */
+        struct InterruptCheck {
+            InterruptCheck() : mayInterrupt(false), client(NULL) { }
+            bool mayInterrupt;
+            Client* client; // NULL for the client of the thread doing the comparisons
+        };
+
     private:
-        shared_ptr<bool> _mayInterrupt;
+        shared_ptr<InterruptCheck> _interrupt;
         scoped_ptr<Sorter<BSONObj, DiskLoc> > _sorter;
     };
 }
@@ -41,9 +41,14 @@
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/pdfile_private.h"
+#include "mongo/db/query/index_key_histogram.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/repl/rs.h"
 #include "mongo/db/sort_phase_one.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/structure/btree/btreebuilder.h"
+#include "mongo/util/concurrency/thread_pool.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/util/progress_meter.h"
 
 namespace mongo {
@@ -51,7 +56,8 @@ namespace mongo {
     BtreeBasedAccessMethod::BtreeBasedAccessMethod(IndexCatalogEntry* btreeState)
         : _btreeState(btreeState), _descriptor(btreeState->descriptor()) {
 
-        verify(0 == _descriptor->version() || 1 == _descriptor->version());
+        verify(0 == _descriptor->version() || 1 == _descriptor->version() ||
+               2 == _descriptor->version());
         _interface = BtreeInterface::interfaces[_descriptor->version()];
     }
 
@@ -195,6 +201,9 @@ namespace mongo {
         else if ( 1 == _descriptor->version() ) {
             newHead = BtreeBucket<V1>::addBucket( _btreeState );
         }
+        else if ( 2 == _descriptor->version() ) {
+            newHead = BtreeBucket<V2>::addBucket( _btreeState );
+        }
         else {
             return Status( ErrorCodes::InternalError, "invalid index number" );
         }
@@ -240,6 +249,11 @@ namespace mongo {
                                                                      _btreeState->head(),
                                                                      key );
         }
+        if ( 2 == _descriptor->version() ) {
+            return BtreeBucket<V2>::asVersion( record )->findSingle( _btreeState,
+                                                                     _btreeState->head(),
+                                                                     key );
+        }
         verify( 0 );
     }
 
@@ -324,13 +338,58 @@ namespace mongo {
 
     // -------
 
+    // threads generating and sorting keys for a foreground index build.  1, the default, builds
+    // on the thread holding the lock; 0 means one per core.  Either way there are at most
+    // BtreeBulk::MaxThreads.
+    MONGO_EXPORT_SERVER_PARAMETER(indexBuildThreads, int, 1);
+
     class BtreeBulk : public IndexAccessMethod {
     public:
-        BtreeBulk( BtreeBasedAccessMethod* real ) {
+        // documents handed to a key generating thread at a time, and at most this many bytes
+        // of them
+        static const size_t BatchDocs = 1000;
+        static const size_t BatchBytes = 4 * 1024 * 1024;
+
+        // copied documents waiting for a worker or being read by one.  a single batch may go
+        // over this on its own, so that documents of any size get through
+        static const size_t MaxBytesInFlight = 32 * 1024 * 1024;
+
+        // the partitions share the memory of a single sorter.  each gets at least
+        // MinPartitionBytes of it, so that they don't spill to many small files
+        static const size_t SortBytes = 100 * 1024 * 1024;
+        static const size_t MinPartitionBytes = 16 * 1024 * 1024;
+        static const unsigned MaxThreads = SortBytes / MinPartitionBytes;
+
+        BtreeBulk( BtreeBasedAccessMethod* real )
+            : _batchBytes( 0 ),
+              _mutex( "BtreeBulk" ),
+              _batchesInFlight( 0 ),
+              _bytesInFlight( 0 ),
+              _failure( Status::OK() ) {
             _real = real;
         }
 
-        ~BtreeBulk() {}
+        ~BtreeBulk() {
+            // a failed build can leave workers adding to the partitions
+            _pool.reset();
+        }
+
+        /**
+         * Generate and sort keys on 'nThreads' threads, each with its own sorter.  Needs
+         * _phase1.sortCmp.
+         */
+        void startThreads( unsigned nThreads ) {
+            verify( nThreads <= MaxThreads );
+            for ( unsigned i = 0; i < nThreads; i++ ) {
+                shared_ptr<SortPhaseOne> p( new SortPhaseOne() );
+                p->sortCmp = _phase1.sortCmp;
+                p->sorter.reset( new BSONObjExternalSorter( p->sortCmp.get(),
+                                                            SortBytes / nThreads ) );
+                _partitions.push_back( p );
+                _idle.push_back( p.get() );
+            }
+            _pool.reset( new ThreadPool( nThreads ) );
+        }
 
         virtual shared_ptr<KeyGenerator> getKeyGenerator() const {
             invariant( false );
@@ -341,6 +400,16 @@ namespace mongo {
                               const InsertDeleteOptions& options,
                               int64_t* numInserted,
                               const PregeneratedKeysOnIndex* pregen ) {
+            if ( _pool ) {
+                // copied as the caller need not keep obj alive until a worker gets to it.  keys
+                // are counted by the workers, so numInserted is left alone.
+                _batch.push_back( ExternalSortDatum( obj.getOwned(), loc ) );
+                _batchBytes += obj.objsize();
+                if ( _batch.size() >= BatchDocs || _batchBytes >= BatchBytes )
+                    _submitBatch();
+                return Status::OK();
+            }
+
             BSONObjSet keys;
             _real->getKeys(obj, &keys);
             _phase1.addKeys(keys, loc, false);
@@ -401,13 +470,39 @@ namespace mongo {
 
         // -------
 
+        /**
+         * Waits for the key generating threads, then folds their counts into _phase1.  Documents
+         * keys could not be generated for fail the build here, or are added to dupsToDrop with
+         * dropDups, as the serial build would have done from insert().
+         */
+        void finishKeys( set<DiskLoc>* dupsToDrop, bool dropDups ) {
+            if ( _pool ) {
+                if ( !_batch.empty() )
+                    _submitBatch();
+                _pool->join();
+                uassertStatusOK( _failure );
+
+                for ( size_t i = 0; i < _badDocs.size(); i++ ) {
+                    if ( !dropDups || !dupsToDrop )
+                        uassertStatusOK( _badDocs[i].second );
+                    dupsToDrop->insert( _badDocs[i].first );
+                }
+
+                for ( size_t i = 0; i < _partitions.size(); i++ ) {
+                    _phase1.n += _partitions[i]->n;
+                    _phase1.nkeys += _partitions[i]->nkeys;
+                    _phase1.multi = _phase1.multi || _partitions[i]->multi;
+                }
+            }
+            _phaseMillis.push_back( make_pair( "keys", _timer.millis() ) );
+            _timer.reset();
+        }
+
         template< class V >
         void commit( set<DiskLoc>* dupsToDrop,
                      CurOp* op,
                      bool mayInterrupt ) {
 
-            Timer timer;
-
             IndexCatalogEntry* entry = _real->_btreeState;
 
             bool dupsAllowed = !entry->descriptor()->unique() ||
@@ -416,15 +511,20 @@ namespace mongo {
 
             BtreeBuilder<V> btBuilder(dupsAllowed, entry);
 
-            BSONObj keyLast;
-            scoped_ptr<BSONObjExternalSorter::Iterator> i( _phase1.sorter->iterator() );
+            op->setMessage( _phaseMessage( "(2/4) sort" ).c_str() );
+            scoped_ptr<BSONObjExternalSorter::Iterator> i( _sortedKeys( mayInterrupt ) );
+            _phaseMillis.push_back( make_pair( "sort", _timer.millis() ) );
+            _timer.reset();
 
             // verifies that pm and op refer to the same ProgressMeter
-            ProgressMeter& pm = op->setMessage("Index Bulk Build: (2/3) btree bottom up",
-                                               "Index: (2/3) BTree Bottom Up Progress",
+            ProgressMeter& pm = op->setMessage(_phaseMessage( "(3/4) btree bottom up" ).c_str(),
+                                               "Index: (3/4) BTree Bottom Up Progress",
                                                _phase1.nkeys,
                                                10);
 
+            // the keys go by in order, so the planner's histogram of them comes for free
+            IndexKeyHistogram::Builder histogram( _phase1.nkeys, internalQueryIndexStatsSamples );
+
             while( i->more() ) {
                 RARELY if ( mayInterrupt ) killCurrentOp.checkForInterrupt();
                 ExternalSortDatum d = i->next();
@@ -437,6 +537,7 @@ namespace mongo {
                     else {
                         btBuilder.addKey(d.first, d.second);
                     }
+                    histogram.add(d.first);
                 }
                 catch( AssertionException& e ) {
                     if ( dupsAllowed ) {
@@ -465,24 +566,162 @@ namespace mongo {
                 pm.hit();
             }
             pm.finished();
-            op->setMessage("Index Bulk Build: (3/3) btree-middle",
-                           "Index: (3/3) BTree Middle Progress");
-            LOG(timer.seconds() > 10 ? 0 : 1 ) << "\t done building bottom layer, going to commit";
+            _phaseMillis.push_back( make_pair( "bottom up", _timer.millis() ) );
+            _timer.reset();
+
+            op->setMessage(_phaseMessage( "(4/4) btree-middle" ).c_str(),
+                           "Index: (4/4) BTree Middle Progress");
+            LOG(_phaseMillis.back().second > 10000 ? 0 : 1 )
+                << "\t done building bottom layer, going to commit";
             btBuilder.commit( mayInterrupt );
             if ( btBuilder.getn() != _phase1.nkeys && ! dropDups ) {
                 warning() << "not all entries were added to the index, probably some "
                           << "keys were too large" << endl;
             }
+            entry->setKeyHistogram( boost::shared_ptr<const IndexKeyHistogram>( histogram.done() ) );
+            _phaseMillis.push_back( make_pair( "middle", _timer.millis() ) );
+            LOG(1) << "\t bulk build " << _phaseMessage( "done" )
+                   << " with " << std::max<size_t>( _partitions.size(), 1 ) << " thread(s)";
         }
 
         // -------
 
+        typedef vector<ExternalSortDatum> Batch;
+
+        void _submitBatch() {
+            {
+                mongo::mutex::scoped_lock lk( _mutex );
+                // bounds the copied documents waiting for a worker, by count and by size
+                while ( _batchesInFlight >= 2 * _partitions.size() ||
+                        ( _batchesInFlight > 0 &&
+                          _bytesInFlight + _batchBytes > MaxBytesInFlight ) )
+                    _batchDone.wait( lk.boost() );
+                _batchesInFlight++;
+                _bytesInFlight += _batchBytes;
+            }
+            shared_ptr<Batch> batch( new Batch() );
+            batch->swap( _batch );
+            _pool->schedule( &BtreeBulk::_generateKeys, this, batch, _batchBytes );
+            _batchBytes = 0;
+        }
+
+        /** runs on a pool thread, adding a batch's keys to whichever partition is idle */
+        void _generateKeys( shared_ptr<Batch> batch, size_t batchBytes ) {
+            SortPhaseOne* partition;
+            {
+                mongo::mutex::scoped_lock lk( _mutex );
+                // no more batches run at once than there are threads, and so partitions
+                verify( !_idle.empty() );
+                partition = _idle.back();
+                _idle.pop_back();
+            }
+
+            try {
+                for ( Batch::const_iterator i = batch->begin(); i != batch->end(); ++i ) {
+                    BSONObjSet keys;
+                    try {
+                        _real->getKeys( i->first, &keys );
+                    }
+                    catch ( AssertionException& e ) {
+                        mongo::mutex::scoped_lock lk( _mutex );
+                        _badDocs.push_back( make_pair( i->second, e.toStatus() ) );
+                        continue;
+                    }
+                    partition->addKeys( keys, i->second, false );
+                }
+            }
+            catch ( DBException& e ) {
+                _fail( e.toStatus() );
+            }
+            catch ( std::exception& e ) {
+                _fail( Status( ErrorCodes::InternalError, e.what() ) );
+            }
+
+            mongo::mutex::scoped_lock lk( _mutex );
+            _idle.push_back( partition );
+            _batchesInFlight--;
+            _bytesInFlight -= batchBytes;
+            _batchDone.notify_all();
+        }
+
+        /** the keys of all partitions in order.  the partitions sort their last runs in parallel */
+        BSONObjExternalSorter::Iterator* _sortedKeys( bool mayInterrupt ) {
+            if ( !_pool )
+                return _phase1.sorter->iterator().release();
+
+            // the pool threads have no client of their own; they check ours while we wait
+            Client* client = mayInterrupt ? &cc() : NULL;
+            vector< shared_ptr<BSONObjExternalSorter::Iterator> > runs( _partitions.size() );
+            for ( size_t i = 0; i < _partitions.size(); i++ ) {
+                if ( client )
+                    _partitions[i]->sorter->sortFor( client );
+                else
+                    _partitions[i]->sorter->sort( false );
+                _pool->schedule( &BtreeBulk::_sortPartition, this, _partitions[i].get(), &runs[i] );
+            }
+            _pool->join();
+            uassertStatusOK( _failure );
+
+            return BSONObjExternalSorter::merge( runs, _phase1.sortCmp.get() ).release();
+        }
+
+        void _sortPartition( SortPhaseOne* partition,
+                             shared_ptr<BSONObjExternalSorter::Iterator>* out ) {
+            try {
+                out->reset( partition->sorter->iterator().release() );
+            }
+            catch ( DBException& e ) {
+                _fail( e.toStatus() );
+            }
+            catch ( std::exception& e ) {
+                _fail( Status( ErrorCodes::InternalError, e.what() ) );
+            }
+        }
+
+        void _fail( const Status& status ) {
+            mongo::mutex::scoped_lock lk( _mutex );
+            if ( _failure.isOK() )
+                _failure = status;
+        }
+
+        /** what currentOp shows: the phase, then how long each earlier phase took */
+        string _phaseMessage( const char* phase ) const {
+            StringBuilder ss;
+            ss << "Index Bulk Build: " << phase;
+            for ( size_t i = 0; i < _phaseMillis.size(); i++ ) {
+                ss << ( i ? ", " : " (" ) << _phaseMillis[i].first << ": "
+                   << _phaseMillis[i].second << "ms";
+            }
+            if ( !_phaseMillis.empty() )
+                ss << ")";
+            return ss.str();
+        }
+
         Status _notAllowed() const {
             return Status( ErrorCodes::InternalError, "cannot use bulk for this yet" );
         }
 
         BtreeBasedAccessMethod* _real; // now owned here
         SortPhaseOne _phase1;
+
+        Timer _timer; // of the current phase
+        vector< pair<const char*, int> > _phaseMillis;
+
+        // with more than one thread, keys are generated and sorted in _partitions rather than
+        // _phase1, and the scan only gathers documents into _batch
+        Batch _batch;
+        size_t _batchBytes; // objsize() of the documents in _batch
+        vector< shared_ptr<SortPhaseOne> > _partitions;
+
+        mongo::mutex _mutex; // guards the members below
+        boost::condition _batchDone;
+        size_t _batchesInFlight;
+        size_t _bytesInFlight;
+        vector<SortPhaseOne*> _idle;
+        vector< pair<DiskLoc, Status> > _badDocs;
+        Status _failure;
+
+        scoped_ptr<ThreadPool> _pool; // last, so its threads are joined first
     };
 
     int oldCompare(const BSONObj& l,const BSONObj& r, const Ordering &o); // key.cpp
@@ -527,7 +766,8 @@ namespace mongo {
         if ( 0 == version ) {
             return new BtreeExternalSortComparisonV0( keyPattern );
         }
-        else if ( 1 == version ) {
+        else if ( 1 == version || 2 == version ) {
+            // v:2 keys are v:1 keys, only stored differently
             return new BtreeExternalSortComparisonV1( keyPattern );
         }
         verify( 0 );
@@ -545,7 +785,19 @@ namespace mongo {
                                                     _descriptor->keyPattern() ) );
 
         bulk->_phase1.sorter.reset( new BSONObjExternalSorter(bulk->_phase1.sortCmp.get()) );
-        bulk->_phase1.sorter->hintNumObjects( _btreeState->collection()->numRecords() );
+        long long numRecords = _btreeState->collection()->numRecords();
+        bulk->_phase1.sorter->hintNumObjects( numRecords );
+
+        // a few batches are not worth the threads
+        if ( indexBuildThreads != 1 &&
+             numRecords >= static_cast<long long>( 4 * BtreeBulk::BatchDocs ) ) {
+            unsigned nThreads = indexBuildThreads > 0 ? indexBuildThreads
+                                                      : ProcessInfo().getNumCores();
+            if ( nThreads > BtreeBulk::MaxThreads )
+                nThreads = BtreeBulk::MaxThreads;
+            if ( nThreads > 1 )
+                bulk->startThreads( nThreads );
+        }
 
         return bulk.release();
     }
@@ -568,15 +820,18 @@ namespace mongo {
         string ns = _btreeState->collection()->ns().ns();
 
         BtreeBulk* bulk = static_cast<BtreeBulk*>( bulkRaw );
+        bulk->finishKeys( dupsToDrop, _descriptor->dropDups() );
         if ( bulk->_phase1.multi )
             _btreeState->setMultikey();
 
-        bulk->_phase1.sorter->sort( false );
+        bulk->_phase1.sorter->sort( mayInterrupt );
 
         if ( _descriptor->version() == 0 )
             bulk->commit<V0>( dupsToDrop, cc().curop(), mayInterrupt );
         else if ( _descriptor->version() == 1 )
             bulk->commit<V1>( dupsToDrop, cc().curop(), mayInterrupt );
+        else if ( _descriptor->version() == 2 )
+            bulk->commit<V2>( dupsToDrop, cc().curop(), mayInterrupt );
         else
             return Status( ErrorCodes::InternalError, "bad btree version" );
 
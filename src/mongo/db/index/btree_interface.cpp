@@ -221,7 +221,8 @@ namespace mongo {
 
     BtreeInterfaceImpl<V0> interface_v0;
     BtreeInterfaceImpl<V1> interface_v1;
-    BtreeInterface* BtreeInterface::interfaces[] = { &interface_v0, &interface_v1 };
+    BtreeInterfaceImpl<V2> interface_v2;
+    BtreeInterface* BtreeInterface::interfaces[] = { &interface_v0, &interface_v1, &interface_v2 };
 
 }  // namespace mongo
 
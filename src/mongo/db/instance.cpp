@@ -87,6 +87,7 @@
 #include "mongo/util/gcov.h"
 #include "mongo/util/goodies.h"
 #include "mongo/util/mongoutils/str.h"
+#include "mongo/util/net/blocking_section.h"
 #include "mongo/util/time_support.h"
 
 namespace mongo {
@@ -613,7 +614,7 @@ namespace mongo {
         UpdateExecutor executor(&request, &op.debug());
         uassertStatusOK(executor.prepare());
 
-        Lock::DBWrite lk(ns.ns());
+        Lock::DBWrite lk(ns.ns(), Lock::DBWrite::collectionScope);
 
         // if this ever moves to outside of lock, need to adjust check
         // Client::Context::_finishInit
@@ -656,7 +657,7 @@ namespace mongo {
                 request.setUpdateOpLog(true);
                 DeleteExecutor executor(&request);
                 uassertStatusOK(executor.prepare());
-                Lock::DBWrite lk(ns.ns());
+                Lock::DBWrite lk(ns.ns(), Lock::DBWrite::collectionScope);
 
                 // if this ever moves to outside of lock, need to adjust check Client::Context::_finishInit
                 if ( ! broadcast && handlePossibleShardedMessage( m , 0 ) )
@@ -693,6 +694,7 @@ namespace mongo {
 
         shared_ptr<AssertionException> ex;
         scoped_ptr<Timer> timer;
+        scoped_ptr<BlockingSection> awaitingData;
         int pass = 0;
         bool exhaust = false;
         QueryResult* msgdata = 0;
@@ -750,9 +752,11 @@ namespace mongo {
                 massert(13073, "shutting down", !inShutdown() );
                 if ( ! timer ) {
                     timer.reset( new Timer() );
+                    awaitingData.reset( new BlockingSection() );
                 }
                 else {
-                    if ( timer->seconds() >= 4 ) {
+                    // with no worker to spare, the client asks again rather than hold one
+                    if ( timer->seconds() >= 4 || awaitingData->shouldEndEarly() ) {
                         // after about 4 seconds, return. pass stops at 1000 normally.
                         // we want to return occasionally so slave can checkpoint.
                         pass = 10000;
@@ -905,7 +909,7 @@ namespace mongo {
         PageFaultRetryableSection s;
         while ( true ) {
             try {
-                Lock::DBWrite lk(ns);
+                Lock::DBWrite lk(ns, Lock::DBWrite::collectionScope);
 
                 // CONCURRENCY TODO: is being read locked in big log sufficient here?
                 // writelock is used to synchronize stepdowns w/ writes
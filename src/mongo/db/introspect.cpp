@@ -36,6 +36,7 @@
 #include "mongo/db/auth/user_set.h"
 #include "mongo/db/curop.h"
 #include "mongo/db/catalog/database_holder.h"
+#include "mongo/db/client.h"
 #include "mongo/db/introspect.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/pdfile.h"
@@ -79,10 +80,7 @@ namespace {
     }
 } // namespace
 
-    static void _profile(const Client& c, CurOp& currentOp, BufBuilder& profileBufBuilder) {
-        Database *db = c.database();
-        DEV verify( db );
-
+    static BSONObj _profileEntry(const Client& c, CurOp& currentOp, BufBuilder& profileBufBuilder) {
         // build object
         BSONObjBuilder b(profileBufBuilder);
 
@@ -118,39 +116,90 @@ namespace {
             p = b.done();
         }
 
-        // write: not replicated
-        // get or create the profiling collection
-        Collection* profileCollection = getOrCreateProfileCollection(db);
-        if ( profileCollection ) {
-            profileCollection->insertDocument( p, false );
-        }
+        return p;
     }
 
-    void profile(const Client& c, int op, CurOp& currentOp) {
-        // initialize with 1kb to start, to avoid realloc later
-        // doing this outside the dblock to improve performance
-        BufBuilder profileBufBuilder(1024);
-
+    static void _profile(const string& ns, int op, const BSONObj& p) {
         try {
             // NOTE: It's kind of weird that we lock the op's namespace, but have to for now since
             // we're sometimes inside the lock already
-            Lock::DBWrite lk( currentOp.getNS() );
-            if (dbHolder()._isLoaded(nsToDatabase(currentOp.getNS()), storageGlobalParams.dbpath)) {
-                Client::Context cx(currentOp.getNS(), storageGlobalParams.dbpath, false);
-                _profile(c, currentOp, profileBufBuilder);
+            Lock::DBWrite lk( ns );
+            if (dbHolder()._isLoaded(nsToDatabase(ns), storageGlobalParams.dbpath)) {
+                Client::Context cx(ns, storageGlobalParams.dbpath, false);
+                Database *db = cx.db();
+                DEV verify( db );
+
+                // write: not replicated
+                // get or create the profiling collection
+                Collection* profileCollection = getOrCreateProfileCollection(db);
+                if ( profileCollection ) {
+                    profileCollection->insertDocument( p, false );
+                }
             }
             else {
                 mongo::log() << "note: not profiling because db went away - probably a close on: "
-                             << currentOp.getNS() << endl;
+                             << ns << endl;
             }
         }
         catch (const AssertionException& assertionEx) {
             warning() << "Caught Assertion while trying to profile " << opToString(op)
-                      << " against " << currentOp.getNS()
+                      << " against " << ns
                       << ": " << assertionEx.toString() << endl;
         }
     }
 
+    namespace {
+        struct DeferredProfile {
+            string ns;
+            int op;
+            BSONObj entry;
+        };
+
+        // entries profile()d while this thread held a collection lock, see profileDeferred()
+        boost::thread_specific_ptr< vector<DeferredProfile> > deferredProfiles;
+    }
+
+    void profile(const Client& c, int op, CurOp& currentOp) {
+        // initialize with 1kb to start, to avoid realloc later
+        // doing this outside the dblock to improve performance
+        BufBuilder profileBufBuilder(1024);
+        BSONObj p = _profileEntry(c, currentOp, profileBufBuilder);
+
+        if ( Lock::isCollectionLocked() ) {
+            // a collection lock only excludes writers to that one collection, while inserting
+            // into (or creating) system.profile needs the database: write it once released
+            vector<DeferredProfile>* deferred = deferredProfiles.get();
+            if ( !deferred ) {
+                deferred = new vector<DeferredProfile>();
+                deferredProfiles.reset( deferred );
+            }
+            DeferredProfile d = { currentOp.getNS(), op, p.getOwned() };
+            deferred->push_back( d );
+            return;
+        }
+
+        _profile(currentOp.getNS(), op, p);
+    }
+
+    void profileDeferred() {
+        vector<DeferredProfile>* deferred = deferredProfiles.get();
+        if ( !deferred || deferred->empty() || cc().lockState().threadState() )
+            return;
+
+        vector<DeferredProfile> entries;
+        entries.swap( *deferred );
+        for ( vector<DeferredProfile>::const_iterator i = entries.begin();
+              i != entries.end(); ++i ) {
+            _profile( i->ns, i->op, i->entry );
+        }
+    }
+
+    void discardDeferredProfiles() {
+        vector<DeferredProfile>* deferred = deferredProfiles.get();
+        if ( deferred )
+            deferred->clear();
+    }
+
     Collection* getOrCreateProfileCollection(Database *db, bool force, string* errmsg ) {
         fassert(16372, db);
         const char* profileName = db->getProfilingNS();
@@ -47,6 +47,16 @@ namespace mongo {
 
     void profile(const Client& c, int op, CurOp& currentOp);
 
+    /**
+     * profile() doesn't write system.profile while the thread holds a collection lock (see
+     * Lock::DBWrite::collectionScope), as that needs the database; it queues the entry instead.
+     * Writes the queued entries, if the thread holds no lock any more.
+     */
+    void profileDeferred();
+
+    /** Drops the queued entries, e.g. when their operation is unwinding. */
+    void discardDeferredProfiles();
+
     /**
      * Get (or create) the profile collection
      *
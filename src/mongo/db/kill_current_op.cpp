@@ -170,6 +170,10 @@ namespace {
             return;
         }
 
+        checkForInterrupt(c);
+    }
+
+    void KillCurrentOp::checkForInterrupt(Client& c) {
         uassert(ErrorCodes::InterruptedAtShutdown, "interrupted at shutdown", !_globalKill);
 
         if (c.curop()->maxTimeHasExpired()) {
@@ -38,6 +38,8 @@
 
 namespace mongo {
 
+    class Client;
+
     /* _globalKill: we are shutting down
        otherwise kill attribute set on specified CurOp
        this class does not handle races between interruptJs and the checkForInterrupt functions - those must be
@@ -69,6 +71,12 @@ namespace mongo {
          */
         void checkForInterrupt( bool heedMutex = true );
 
+        /**
+         * as checkForInterrupt(false), but for the current operation of 'c', from a thread
+         * doing part of that operation for it while 'c''s own thread waits
+         */
+        void checkForInterrupt( Client& c );
+
         /** @return "" if not interrupted.  otherwise, you should stop. */
         const char *checkForInterruptNoAssert();
 
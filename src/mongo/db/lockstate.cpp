@@ -48,6 +48,7 @@ namespace mongo {
           _nestableCount(0), 
           _otherCount(0), 
           _otherLock(NULL),
+          _collectionLock(NULL),
           _scopedLk(NULL),
           _lockPending(false),
           _lockPendingParallelWriter(false)
@@ -136,9 +137,15 @@ namespace mongo {
         }
         if( _otherCount ) { 
             WrapperForRWLock *k = _otherLock;
+            WrapperForRWLock *c = _collectionLock;
             if( k ) {
                 string s = "^";
                 s += k->name();
+                b.append(s, c ? "w" : kind(_otherCount));
+            }
+            if( c ) {
+                string s = "^";
+                s += c->name();
                 b.append(s, kind(_otherCount));
             }
         }
@@ -167,6 +174,9 @@ namespace mongo {
             if( _otherCount ) {
                 ss << " otherdb:" << _otherName;
             }
+            if( _collectionLock ) {
+                ss << " collection:" << _collectionLock->name();
+            }
             if( _nestableCount ) {
                 ss << " nestableCount:" << _nestableCount << " which:";
                 if( _whichNestable == Lock::local ) 
@@ -217,6 +227,19 @@ namespace mongo {
         _otherCount = type;
     }
 
+    WrapperForRWLock::WrapperForRWLock(const StringData& name)
+        : rw(name), m(name) {
+        // For the local datbase, all operations are short,
+        // either writing one entry, or doing a tail.
+        // In tests, use a SimpleMutex is much faster for the local db.
+        sharedLatching = name != "local";
+
+        // only collection level locking needs QLock's intent locks; otherwise keep the
+        // SimpleRWLock and its scheduling
+        if ( sharedLatching && Lock::collectionLevelLockingEnabled() )
+            q.reset( new QLock() );
+    }
+
     void LockState::lockedOther( const StringData& other , int type , WrapperForRWLock* lock ) {
         fassert( 16170 , _otherCount == 0 );
         _otherName = other.toString();
@@ -230,10 +253,22 @@ namespace mongo {
         _otherCount = 0;
     }
 
+    void LockState::lockedCollection( WrapperForRWLock* lock ) {
+        fassert( 18604 , _otherCount > 0 && _collectionLock == NULL );
+        _collectionLock = lock;
+    }
+
+    void LockState::unlockedCollection() {
+        _collectionLock = NULL;
+    }
+
     LockStat* LockState::getRelevantLockStat() {
         if ( _whichNestable )
             return Lock::nestableLockStat( _whichNestable );
 
+        if ( _collectionLock )
+            return &_collectionLock->stats;
+
         if ( _otherCount && _otherLock )
             return &_otherLock->stats;
         
@@ -31,7 +31,11 @@
 
 #pragma once
 
+#include <boost/scoped_ptr.hpp>
+
 #include "mongo/db/d_concurrency.h"
+#include "mongo/util/concurrency/qlock.h"
+#include "mongo/util/concurrency/simplerwlock.h"
 
 namespace mongo {
 
@@ -91,6 +95,10 @@ namespace mongo {
         void lockedOther( const StringData& db , int type , WrapperForRWLock* lock );
         void lockedOther( int type );  // "same lock as last time" case 
         void unlockedOther();
+        /** we hold lock, a collection lock, under an intent lock on otherLock() */
+        void lockedCollection( WrapperForRWLock* lock );
+        void unlockedCollection();
+        WrapperForRWLock* collectionLock() const { return _collectionLock; }
         bool _batchWriter;
 
         LockStat* getRelevantLockStat();
@@ -110,6 +118,7 @@ namespace mongo {
         int _otherCount;               //   >0 means write lock, <0 read lock - XXX change name
         string _otherName;             // which database are we locking and working with (besides local/admin) 
         WrapperForRWLock* _otherLock;  // so we don't have to check the map too often (the map has a mutex)
+        WrapperForRWLock* _collectionLock; // non-null while collection locked (_otherLock is then intent locked)
 
         // for temprelease
         // for the nonrecursive case. otherwise there would be many
@@ -123,24 +132,36 @@ namespace mongo {
         friend class AcquiringParallelWriter;
     };
 
+    /**
+     * A database or collection lock. With collection level locking, a database lock can also be
+     * intent locked by threads that then exclusively lock one of its collections: intent locks
+     * are compatible with each other but not with shared or exclusive locks. This is the r/w/R/W
+     * hierarchy of QLock, one level down, and only locks made while collection level locking is
+     * on use a QLock. Otherwise an intent lock is an exclusive one.
+     */
     class WrapperForRWLock : boost::noncopyable {
         SimpleRWLock rw;
+        boost::scoped_ptr<QLock> q; // used instead of rw, if set
         SimpleMutex m;
         bool sharedLatching;
     public:
         string name() const { return rw.name; }
         LockStat stats;
-        WrapperForRWLock(const StringData& name)
-            : rw(name), m(name) {
-            // For the local datbase, all operations are short,
-            // either writing one entry, or doing a tail.
-            // In tests, use a SimpleMutex is much faster for the local db.
-            sharedLatching = name != "local";
+        WrapperForRWLock(const StringData& name);
+        void lock() {
+            if ( q ) q->lock_W(); else if ( sharedLatching ) rw.lock(); else m.lock();
+        }
+        void lock_shared() {
+            if ( q ) q->lock_R(); else if ( sharedLatching ) rw.lock_shared(); else m.lock();
+        }
+        void unlock() {
+            if ( q ) q->unlock_W(); else if ( sharedLatching ) rw.unlock(); else m.unlock();
+        }
+        void unlock_shared() {
+            if ( q ) q->unlock_R(); else if ( sharedLatching ) rw.unlock_shared(); else m.unlock();
         }
-        void lock()          { if ( sharedLatching ) { rw.lock(); } else { m.lock(); } }
-        void lock_shared()   { if ( sharedLatching ) { rw.lock_shared(); } else { m.lock(); } }
-        void unlock()        { if ( sharedLatching ) { rw.unlock(); } else { m.unlock(); } }
-        void unlock_shared() { if ( sharedLatching ) { rw.unlock_shared(); } else { m.unlock(); } }
+        void lock_intent()   { if ( q ) { q->lock_w(); } else { lock(); } }
+        void unlock_intent() { if ( q ) { q->unlock_w(); } else { unlock(); } }
     };
 
     class ScopedLock;
@@ -0,0 +1,194 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/matcher/compiled_matcher.h"
+
+#include <algorithm>
+
+#include "mongo/db/field_ref.h"
+#include "mongo/db/matcher/expression_leaf.h"
+#include "mongo/db/matcher/expression_parser.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    namespace {
+
+        // leaves whose matching only depends on the element at their path
+        bool isCompilableLeaf( MatchExpression::MatchType type ) {
+            switch ( type ) {
+            case MatchExpression::LTE:
+            case MatchExpression::LT:
+            case MatchExpression::EQ:
+            case MatchExpression::GT:
+            case MatchExpression::GTE:
+            case MatchExpression::REGEX:
+            case MatchExpression::MOD:
+            case MatchExpression::EXISTS:
+            case MatchExpression::MATCH_IN:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        // orders predicates by path, with interpreted predicates last
+        struct InstructionOrder {
+            template <typename T>
+            bool operator()( const T& lhs, const T& rhs ) const {
+                if ( lhs.pathIndex < 0 || rhs.pathIndex < 0 )
+                    return lhs.pathIndex >= 0 && rhs.pathIndex < 0;
+                return lhs.pathIndex < rhs.pathIndex;
+            }
+        };
+
+    }
+
+    CompiledMatcher::CompiledMatcher( const BSONObj& pattern )
+        : _pattern( pattern ) {
+
+        StatusWithMatchExpression result = MatchExpressionParser::parse( pattern );
+        uassert( 18600,
+                 mongoutils::str::stream() << "bad query: " << result.toString(),
+                 result.isOK() );
+
+        _expression.reset( result.getValue() );
+
+        compile( _expression.get() );
+        std::stable_sort( _program.begin(), _program.end(), InstructionOrder() );
+    }
+
+    void CompiledMatcher::compile( const MatchExpression* expression ) {
+        if ( expression->matchType() == MatchExpression::AND ) {
+            for ( size_t i = 0; i < expression->numChildren(); i++ )
+                compile( expression->getChild( i ) );
+            return;
+        }
+
+        Instruction instruction;
+        instruction.pathIndex = -1;
+        instruction.expression = expression;
+
+        if ( isCompilableLeaf( expression->matchType() ) && !expression->path().empty() )
+            instruction.pathIndex = addPath( expression->path() );
+
+        _program.push_back( instruction );
+    }
+
+    int CompiledMatcher::addPath( const StringData& path ) {
+        FieldRef fieldRef;
+        fieldRef.parse( path );
+
+        std::vector<std::string> parts;
+        for ( size_t i = 0; i < fieldRef.numParts(); i++ )
+            parts.push_back( fieldRef.getPart( i ).toString() );
+
+        for ( size_t i = 0; i < _paths.size(); i++ ) {
+            if ( _paths[i] == parts )
+                return i;
+        }
+
+        _paths.push_back( parts );
+        return _paths.size() - 1;
+    }
+
+    size_t CompiledMatcher::numCompiledPredicates() const {
+        size_t count = 0;
+        for ( size_t i = 0; i < _program.size(); i++ ) {
+            if ( _program[i].pathIndex >= 0 )
+                count++;
+        }
+        return count;
+    }
+
+    bool CompiledMatcher::resolvePath( const BSONObj& doc,
+                                       const std::vector<std::string>& path,
+                                       BSONElement* out ) {
+        BSONObj curr = doc;
+        for ( size_t i = 0; i < path.size(); i++ ) {
+            BSONElement e = curr.getField( path[i] );
+
+            switch ( e.type() ) {
+            case EOO:
+                *out = e;
+                return true;
+            case Array:
+                return false;
+            case Object:
+                if ( i + 1 == path.size() ) {
+                    *out = e;
+                    return true;
+                }
+                curr = e.Obj();
+                break;
+            default:
+                // a scalar in the middle of the path means the path doesn't exist
+                *out = ( i + 1 == path.size() ) ? e : BSONElement();
+                return true;
+            }
+        }
+
+        // not reached, paths always have at least one part
+        *out = BSONElement();
+        return true;
+    }
+
+    bool CompiledMatcher::matches( const BSONObj& doc ) const {
+        int resolvedPathIndex = -1;
+        bool resolved = false;
+        BSONElement e;
+
+        for ( size_t i = 0; i < _program.size(); i++ ) {
+            const Instruction& instruction = _program[i];
+
+            if ( instruction.pathIndex < 0 ) {
+                if ( !instruction.expression->matchesBSON( doc, NULL ) )
+                    return false;
+                continue;
+            }
+
+            if ( instruction.pathIndex != resolvedPathIndex ) {
+                resolvedPathIndex = instruction.pathIndex;
+                resolved = resolvePath( doc, _paths[resolvedPathIndex], &e );
+            }
+
+            bool match = resolved ?
+                static_cast<const LeafMatchExpression*>( instruction.expression )
+                    ->matchesSingleElement( e ) :
+                instruction.expression->matchesBSON( doc, NULL );
+
+            if ( !match )
+                return false;
+        }
+
+        return true;
+    }
+
+}  // namespace mongo
@@ -0,0 +1,105 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <boost/scoped_ptr.hpp>
+#include <string>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/bson/bsonobj.h"
+#include "mongo/db/matcher/expression.h"
+
+namespace mongo {
+
+    /**
+     * CompiledMatcher parses a query like Matcher2, then flattens the conjunction at the top of
+     * the resulting MatchExpression tree into a linear program for matching many small
+     * documents against the same filter, as pubsub does with subscription filters.
+     *
+     * Each field path used by a leaf predicate is split once at compile time, and predicates
+     * on the same path share a single lookup per document. A leaf is matched directly against
+     * the element at its path as long as no arrays are found along the path; otherwise, and
+     * for operators that aren't compiled (OR, NOR, NOT, array operators, $where, ...), the
+     * predicate is matched by the MatchExpression interpreter. Results are always the same as
+     * those of Matcher2 on the same query.
+     */
+    class CompiledMatcher {
+        MONGO_DISALLOW_COPYING( CompiledMatcher );
+
+    public:
+        explicit CompiledMatcher( const BSONObj& pattern );
+
+        bool matches( const BSONObj& doc ) const;
+
+        const BSONObj* getQuery() const { return &_pattern; };
+
+        std::string toString() const { return _pattern.toString(); }
+
+        /**
+         * Number of predicates that are matched without the interpreter, unless an array is
+         * found along their path. For testing.
+         */
+        size_t numCompiledPredicates() const;
+
+    private:
+        struct Instruction {
+            // index into _paths of the path this predicate is matched against,
+            // or -1 if the predicate is always matched by the interpreter
+            int pathIndex;
+
+            // a LeafMatchExpression if pathIndex is set. owned by _expression.
+            const MatchExpression* expression;
+        };
+
+        void compile( const MatchExpression* expression );
+
+        int addPath( const StringData& path );
+
+        /**
+         * Finds the element at 'path' in 'doc' the same way ElementPath does, except that
+         * arrays are not traversed. Returns false if an array is found along the path, in which
+         * case predicates on it must be matched by the interpreter.
+         */
+        static bool resolvePath( const BSONObj& doc,
+                                 const std::vector<std::string>& path,
+                                 BSONElement* out );
+
+        BSONObj _pattern;
+
+        boost::scoped_ptr<MatchExpression> _expression;
+
+        // each path split into its parts
+        std::vector<std::vector<std::string> > _paths;
+
+        // predicates on the same path are adjacent, and interpreted predicates come last
+        std::vector<Instruction> _program;
+    };
+
+}  // namespace mongo
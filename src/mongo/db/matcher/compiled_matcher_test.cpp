@@ -0,0 +1,139 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+/** Unit tests for CompiledMatcher, checked against the MatchExpression interpreter. */
+
+#include "mongo/unittest/unittest.h"
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/json.h"
+#include "mongo/db/matcher/compiled_matcher.h"
+#include "mongo/db/matcher/expression_parser.h"
+
+namespace mongo {
+
+    namespace {
+
+        // documents covering missing fields, scalars along paths, nested objects and arrays
+        const char* const kDocs[] = {
+            "{}",
+            "{a: 1}",
+            "{a: 5, b: 'x'}",
+            "{a: null}",
+            "{a: 'abc'}",
+            "{a: {b: 1}}",
+            "{a: {b: 5, c: {d: 2}}}",
+            "{a: {b: null}}",
+            "{a: {b: [1, 5]}}",
+            "{a: [1, 2, 3]}",
+            "{a: [{b: 1}, {b: 7}]}",
+            "{a: [[1], 4]}",
+            "{a: {'0': 3}}",
+            "{a: 1, b: {c: 3}}",
+            "{a: 6, b: {c: [3, 4]}}",
+            "{a: 2, b: 2, c: 'x'}",
+        };
+
+        void assertSameAsInterpreter( const char* query ) {
+            BSONObj queryObj = fromjson( query );
+            CompiledMatcher compiled( queryObj );
+
+            StatusWithMatchExpression result = MatchExpressionParser::parse( queryObj );
+            ASSERT( result.isOK() );
+            scoped_ptr<MatchExpression> interpreted( result.getValue() );
+
+            for ( size_t i = 0; i < sizeof( kDocs ) / sizeof( kDocs[0] ); i++ ) {
+                BSONObj doc = fromjson( kDocs[i] );
+                ASSERT_EQUALS( interpreted->matchesBSON( doc, NULL ), compiled.matches( doc ) );
+            }
+        }
+
+    }
+
+    TEST( CompiledMatcher, Empty ) {
+        BSONObj empty;
+        CompiledMatcher compiled( empty );
+        ASSERT( compiled.matches( fromjson( "{a: 1}" ) ) );
+        ASSERT_EQUALS( 0U, compiled.numCompiledPredicates() );
+    }
+
+    TEST( CompiledMatcher, Comparisons ) {
+        assertSameAsInterpreter( "{a: 1}" );
+        assertSameAsInterpreter( "{a: null}" );
+        assertSameAsInterpreter( "{a: {$gt: 1}}" );
+        assertSameAsInterpreter( "{a: {$gte: 1, $lt: 5}}" );
+        assertSameAsInterpreter( "{a: {$lte: 'b'}}" );
+        assertSameAsInterpreter( "{a: {b: 1}}" );
+    }
+
+    TEST( CompiledMatcher, DottedPaths ) {
+        assertSameAsInterpreter( "{'a.b': 1}" );
+        assertSameAsInterpreter( "{'a.b': null}" );
+        assertSameAsInterpreter( "{'a.b': {$gt: 2}}" );
+        assertSameAsInterpreter( "{'a.c.d': 2}" );
+        assertSameAsInterpreter( "{'a.0': 3}" );
+        assertSameAsInterpreter( "{'b.c': 3, a: {$gt: 0}}" );
+    }
+
+    TEST( CompiledMatcher, OtherLeaves ) {
+        assertSameAsInterpreter( "{a: {$exists: true}}" );
+        assertSameAsInterpreter( "{'a.b': {$exists: false}}" );
+        assertSameAsInterpreter( "{a: {$in: [1, 5, null]}}" );
+        assertSameAsInterpreter( "{a: /^a/}" );
+        assertSameAsInterpreter( "{a: {$mod: [2, 0]}}" );
+        assertSameAsInterpreter( "{a: {$type: 2}}" );
+    }
+
+    TEST( CompiledMatcher, Trees ) {
+        assertSameAsInterpreter( "{$and: [{a: {$gt: 0}}, {$and: [{b: 2}, {c: 'x'}]}]}" );
+        assertSameAsInterpreter( "{$or: [{a: 1}, {'a.b': 1}]}" );
+        assertSameAsInterpreter( "{a: {$not: {$gt: 2}}, b: {$exists: false}}" );
+        assertSameAsInterpreter( "{$nor: [{a: 1}, {a: 5}]}" );
+        assertSameAsInterpreter( "{a: {$nin: [1, 2]}}" );
+    }
+
+    TEST( CompiledMatcher, Arrays ) {
+        assertSameAsInterpreter( "{a: 2}" );
+        assertSameAsInterpreter( "{a: [1, 2, 3]}" );
+        assertSameAsInterpreter( "{'a.b': 7}" );
+        assertSameAsInterpreter( "{'b.c': 4}" );
+        assertSameAsInterpreter( "{a: {$size: 3}}" );
+        assertSameAsInterpreter( "{a: {$elemMatch: {b: 7}}}" );
+        assertSameAsInterpreter( "{a: {$all: [1, 2]}}" );
+    }
+
+    TEST( CompiledMatcher, CompilesConjunctions ) {
+        CompiledMatcher compiled( fromjson( "{a: {$gt: 1, $lt: 5}, 'b.c': 3, "
+                                            "$or: [{d: 1}, {e: 1}]}" ) );
+        ASSERT_EQUALS( 3U, compiled.numCompiledPredicates() );
+        ASSERT( compiled.matches( fromjson( "{a: 2, b: {c: 3}, e: 1}" ) ) );
+        ASSERT( !compiled.matches( fromjson( "{a: 2, b: {c: 3}}" ) ) );
+        ASSERT( !compiled.matches( fromjson( "{a: 6, b: {c: 3}, d: 1}" ) ) );
+    }
+
+}  // namespace mongo
@@ -30,12 +30,17 @@
 
 #include "mongo/db/ops/count.h"
 
+#include <boost/bind.hpp>
+#include <vector>
+
 #include "mongo/db/client.h"
 #include "mongo/db/clientcursor.h"
 #include "mongo/db/catalog/database.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/curop.h"
+#include "mongo/db/query/canonical_query.h"
 #include "mongo/db/query/get_runner.h"
+#include "mongo/db/query/parallel_scan.h"
 #include "mongo/db/query/type_explain.h"
 
 namespace {
@@ -62,6 +67,42 @@ namespace {
         return false;
     }
 
+    void countRange(std::vector<long long>* counts, size_t range, ExtentRangeScan* scan) {
+        BSONObj obj;
+        while (scan->getNext(&obj)) {
+            ++(*counts)[range];
+        }
+    }
+
+    /**
+     * Counts the documents of 'collection' matching 'query' on several threads, each scanning a
+     * range of the collection's extents, if the query has to scan the whole collection.
+     *
+     * Returns the count, or -1 if the count should be run on one thread.
+     */
+    long long parallelCount(Database* db, Collection* collection, const BSONObj& query) {
+        CanonicalQuery* rawQuery;
+        if (!CanonicalQuery::canonicalize(collection->ns().ns(), query, &rawQuery).isOK()) {
+            return -1;
+        }
+        scoped_ptr<CanonicalQuery> cq(rawQuery);
+
+        const size_t nThreads = ParallelScan::threadsFor(db, collection, cq.get());
+        if (nThreads < 2) {
+            return -1;
+        }
+
+        ParallelScan scan(db, collection, query, nThreads);
+        std::vector<long long> counts(scan.numRanges(), 0);
+        uassertStatusOK(scan.run(boost::bind(&countRange, &counts, _1, _2)));
+
+        long long count = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            count += counts[i];
+        }
+        return count;
+    }
+
 } // namespace
 
 namespace mongo {
@@ -92,6 +133,16 @@ namespace mongo {
         return num;
     }
 
+    static long long countFailed(const string& ns, const BSONObj& query,
+                                 const string& err, int errCode) {
+        // Historically we have returned zero in many count assertion cases - see SERVER-2291.
+        log() << "Count with ns: " << ns << " and query: " << query
+              << " failed with exception: " << err << " code: " << errCode
+              << endl;
+
+        return -2;
+    }
+
     long long runCount( const string& ns, const BSONObj &cmd, string &err, int &errCode ) {
         // Lock 'ns'.
         Client::Context cx(ns);
@@ -119,6 +170,20 @@ namespace mongo {
             limit = -limit;
         }
 
+        if (0 == skip && 0 == limit && hintObj.isEmpty()) {
+            try {
+                const long long count = parallelCount(cx.db(), collection, query);
+                if (count >= 0) {
+                    return count;
+                }
+            }
+            catch (const DBException &e) {
+                err = e.toString();
+                errCode = e.getCode();
+                return countFailed(ns, query, err, errCode);
+            }
+        }
+
         uassertStatusOK(getRunnerCount(collection, query, hintObj, &rawRunner));
         auto_ptr<Runner> runner(rawRunner);
 
@@ -181,12 +246,7 @@ namespace mongo {
             errCode = 0;
         } 
 
-        // Historically we have returned zero in many count assertion cases - see SERVER-2291.
-        log() << "Count with ns: " << ns << " and query: " << query
-              << " failed with exception: " << err << " code: " << errCode
-              << endl;
-
-        return -2;
+        return countFailed(ns, query, err, errCode);
     }
     
 } // namespace mongo
@@ -730,6 +730,7 @@ namespace mongo {
 
                     // Broadcast the mutation so that query results stay correct.
                     collection->cursorCache()->invalidateDocument(loc, INVALIDATION_MUTATION);
+                    collection->infoCache()->notifyOfInPlaceUpdate();
 
                     collection->details()->paddingFits();
 
@@ -136,10 +136,19 @@ namespace {
 
     // Handles object-typed values including the top-level for ParsedDeps::extractFields
     Document documentHelper(const BSONObj& bson, const Document& neededFields) {
-        MutableDocument md(neededFields.size());
+        size_t nNeeded = 0;
+        size_t neededNameBytes = 0;
+        for (FieldIterator it(neededFields); it.more(); ) {
+            nNeeded++;
+            neededNameBytes += it.next().first.size();
+        }
+
+        MutableDocument md(nNeeded, neededNameBytes);
 
+        // Once every needed field has been seen, the rest of the BSON is left unread.
+        size_t notSeen = nNeeded;
         BSONObjIterator it(bson);
-        while (it.more()) {
+        while (notSeen && it.more()) {
             BSONElement bsonElement (it.next());
             StringData fieldName = bsonElement.fieldNameStringData();
             Value isNeeded = neededFields[fieldName];
@@ -147,6 +156,9 @@ namespace {
             if (isNeeded.missing())
                 continue;
 
+            if (md.peek()[fieldName].missing())
+                notSeen--; // not a repeat of a field name already seen
+
             if (isNeeded.getType() == Bool) {
                 md.addField(fieldName, Value(bsonElement));
                 continue;
@@ -164,6 +164,20 @@ namespace mongo {
     }
 
     void DocumentStorage::reserveFields(size_t expectedFields) {
+        // Using expectedFields+1 to allow space for long field names
+        allocReserved(expectedFields,
+                      (expectedFields+1) * ValueElement::align(sizeof(ValueElement)));
+    }
+
+    void DocumentStorage::reserveFields(size_t expectedFields, size_t fieldNameBytes) {
+        // Each field takes sizeof(ValueElement) plus its name, padded to the next boundary.
+        const size_t maxPadding = ValueElement::align(1) - 1;
+        allocReserved(expectedFields,
+                      ValueElement::align(expectedFields * (sizeof(ValueElement) + maxPadding)
+                                          + fieldNameBytes));
+    }
+
+    void DocumentStorage::allocReserved(size_t expectedFields, size_t elementBytes) {
         fassert(16487, !_buffer);
 
         unsigned buckets = HASH_TAB_INIT_SIZE;
@@ -171,14 +185,11 @@ namespace mongo {
             buckets *= 2;
         _hashTabMask = buckets - 1;
 
-        // Using expectedFields+1 to allow space for long field names
-        const size_t newSize = (expectedFields+1) * ValueElement::align(sizeof(ValueElement));
-
         uassert(16491, "Tried to make oversized document",
-                newSize <= size_t(BufferMaxSize));
+                elementBytes <= size_t(BufferMaxSize));
 
-        _buffer = new char[newSize + hashTabBytes()];
-        _bufferEnd = _buffer + newSize;
+        _buffer = new char[elementBytes + hashTabBytes()];
+        _bufferEnd = _buffer + elementBytes;
     }
 
     intrusive_ptr<DocumentStorage> DocumentStorage::clone() const {
@@ -215,7 +226,16 @@ namespace mongo {
     }
 
     Document::Document(const BSONObj& bson) {
-        MutableDocument md(bson.nFields());
+        // Sizing the document up front takes one pass over the BSON, which is cheaper than
+        // growing the buffer as fields are added.
+        size_t nFields = 0;
+        size_t fieldNameBytes = 0;
+        BSONForEach(elem, bson) {
+            nFields++;
+            fieldNameBytes += elem.fieldNameSize() - 1;
+        }
+
+        MutableDocument md(nFields, fieldNameBytes);
 
         BSONObjIterator it(bson);
         while(it.more()) {
@@ -284,6 +304,15 @@ namespace mongo {
         }
     }
 
+    MutableDocument::MutableDocument(size_t expectedFields, size_t fieldNameBytes)
+        : _storageHolder(NULL)
+        , _storage(_storageHolder)
+    {
+        if (expectedFields) {
+            storage().reserveFields(expectedFields, fieldNameBytes);
+        }
+    }
+
     MutableValue MutableDocument::getNestedFieldHelper(const FieldPath& dottedField,
                                                        size_t level) {
         if (level == dottedField.getPathLength()-1) {
@@ -283,11 +283,12 @@ namespace mongo {
          *  @param expectedFields a hint at what the number of fields will be, if known.
          *         this can be used to increase memory allocation efficiency. There is
          *         no impact on correctness if this field over or under estimates.
-         *
-         *  TODO: find some way to convey field-name sizes to make even more efficient
+         *  @param fieldNameBytes the total length of those fields' names, if known. With it
+         *         the document is allocated once, at about the size it will end up.
          */
         MutableDocument() :_storageHolder(NULL), _storage(_storageHolder) {}
         explicit MutableDocument(size_t expectedFields);
+        MutableDocument(size_t expectedFields, size_t fieldNameBytes);
 
         /// No copy yet. Copy-on-write. See storage()
         explicit MutableDocument(const Document& d) : _storageHolder(NULL)
@@ -222,6 +222,11 @@ namespace mongo {
          */
         void reserveFields(size_t expectedFields);
 
+        /** Like reserveFields(), but allocates just enough for fields whose names add up to
+         *  fieldNameBytes, so that adding them neither grows the buffer nor leaves much unused.
+         */
+        void reserveFields(size_t expectedFields, size_t fieldNameBytes);
+
         /// This skips missing values
         DocumentStorageIterator iterator() const {
             return DocumentStorageIterator(_firstElement, end(), false);
@@ -277,6 +282,9 @@ namespace mongo {
         /// Initialize empty hash table
         void hashTabInit() { memset(_hashTab, -1, hashTabBytes()); }
 
+        /// Allocates elementBytes for fields and a hash table big enough for expectedFields
+        void allocReserved(size_t expectedFields, size_t elementBytes);
+
         static unsigned hashKey(StringData name) {
             // TODO consider FNV-1a once we have a better benchmark corpus
             unsigned out;
@@ -44,6 +44,7 @@
 #include "mongo/db/pipeline/value.h"
 #include "mongo/db/projection.h"
 #include "mongo/db/sorter/sorter.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/s/shard.h"
 #include "mongo/s/strategy.h"
 #include "mongo/util/intrusive_counter.h"
@@ -55,6 +56,8 @@ namespace mongo {
     class ExpressionFieldPath;
     class ExpressionObject;
     class DocumentSourceLimit;
+    class ExtentRangeScan;
+    class Pipeline;
     class Runner;
 
     class DocumentSource : public IntrusiveCounterUnsigned {
@@ -418,6 +421,81 @@ namespace mongo {
     };
 
 
+    /**
+     * Runs the stages of a pipeline up to and including its first $group on several threads, each
+     * scanning a range of the collection's extents, and returns the partial groups of every range.
+     * A $group merging them (as for shards) goes after this source.  Only for a pipeline whose
+     * query must scan the whole collection; see ParallelScan::threadsFor().
+     *
+     * The partial groups are held in memory until the scan ends, within the memory limit of
+     * $group.  Past it, the stages are run again over the whole collection on one thread, as if
+     * there were no parallel scan, if external sort is allowed, and the pipeline fails if not.
+     */
+    class DocumentSourceParallelScan : public DocumentSource {
+    public:
+        // virtuals from DocumentSource
+        virtual boost::optional<Document> getNext();
+        virtual const char *getSourceName() const;
+        virtual Value serialize(bool explain = false) const;
+        virtual void dispose();
+        virtual bool isValidInitialSource() const { return true; }
+
+        /**
+         * @param query the query selecting the documents to scan
+         * @param rangeStages the serialized stages each range runs, ending with the $group's
+         *                    shard source
+         * @param deps the fields the stages need, or none to pass whole documents
+         * @param nThreads from ParallelScan::threadsFor()
+         */
+        static intrusive_ptr<DocumentSourceParallelScan> create(
+            const BSONObj& query,
+            const vector<Value>& rangeStages,
+            const boost::optional<ParsedDeps>& deps,
+            size_t nThreads,
+            const intrusive_ptr<ExpressionContext>& pExpCtx);
+
+    private:
+        DocumentSourceParallelScan(const BSONObj& query,
+                                   const vector<Value>& rangeStages,
+                                   const boost::optional<ParsedDeps>& deps,
+                                   size_t nThreads,
+                                   const intrusive_ptr<ExpressionContext>& pExpCtx);
+
+        ~DocumentSourceParallelScan();
+
+        /**
+         * Runs the range stages over every range, filling _results, or sets up _serialPipeline if
+         * they output too much to hold.
+         */
+        void scan();
+
+        /** Called on a scan thread for each range, to run the stages in 'rangeCommand' on it. */
+        void scanRange(const BSONObj& rangeCommand, size_t range, ExtentRangeScan* scan);
+
+        /** The stages in 'rangeCommand', reading the documents 'scan' returns. */
+        intrusive_ptr<Pipeline> rangePipeline(const BSONObj& rangeCommand, ExtentRangeScan* scan);
+
+        const BSONObj _query;
+        const vector<Value> _rangeStages;
+        const boost::optional<ParsedDeps> _dependencies;
+        const size_t _nThreads;
+
+        const long long _maxMemoryUsageBytes;
+
+        bool _scanned;
+        vector<std::deque<Document> > _results; // one per range
+        size_t _currentRange;
+
+        // the approximate size of _results, added to by every scan thread
+        AtomicInt64 _resultBytes;
+
+        // only used once _results grew past _maxMemoryUsageBytes with external sort allowed
+        AtomicUInt32 _serialAbort; // never set; the operation's own thread checks for kills
+        boost::scoped_ptr<ExtentRangeScan> _serialScan;
+        intrusive_ptr<Pipeline> _serialPipeline;
+    };
+
+
     class DocumentSourceGroup : public DocumentSource
                               , public SplittableDocumentSource {
     public:
@@ -457,6 +535,21 @@ namespace mongo {
         /// Tell this source if it is doing a merge from shards. Defaults to false.
         void setDoingMerge(bool doingMerge) { _doingMerge = doingMerge; }
 
+        /**
+         * Returns true if input sorted by 'sortPattern' brings together all the documents of each
+         * group: that is, if the _id is built only from field paths, and those fields make up the
+         * leading fields of the pattern in any order and direction.  Those fields are added to
+         * 'idFields', if given.
+         */
+        bool isGroupedBySort(const BSONObj& sortPattern, set<string>* idFields = NULL) const;
+
+        /**
+         * Tell this source that its input is sorted so that isGroupedBySort() holds.  Each group is
+         * then returned as soon as its last document has been read, holding only one group at a
+         * time in memory.
+         */
+        void setStreaming() { _streaming = true; }
+
         /**
           Create a grouping DocumentSource from BSON.
 
@@ -481,11 +574,46 @@ namespace mongo {
     private:
         DocumentSourceGroup(const intrusive_ptr<ExpressionContext> &pExpCtx);
 
-        /// Spill groups map to disk and returns an iterator to the file.
-        shared_ptr<Sorter<Value, Value>::Iterator> spill();
+        typedef vector<intrusive_ptr<Accumulator> > Accumulators;
+        typedef boost::unordered_map<Value, Accumulators, Value::Hash> GroupsMap;
+
+        /**
+         * Spilled groups are written, unsorted, to one of kSpillPartitions files chosen by the hash
+         * of their _id, so that each file can be grouped on its own once the input is exhausted.
+         */
+        typedef SortedFileWriter<Value, Value> PartitionWriter;
+        typedef std::vector<boost::shared_ptr<PartitionWriter> > PartitionWriters;
+        struct Partition {
+            boost::shared_ptr<Sorter<Value, Value>::Iterator> file;
+            int level; // number of times its groups have been split by hash
+        };
+
+        /// Writes the groups map to the level 0 partitions and clears it.
+        void spill();
+
+        /**
+         * Writes the groups map and whatever remains of 'partition' to new partitions a level
+         * below it, to be read back in turn.  Used when a partition doesn't fit in memory.
+         */
+        void splitPartition(const Partition& partition);
+
+        /// Appends a group's _id and accumulator state to its partition at 'level'.
+        void writeToPartition(PartitionWriters* writers,
+                              int level,
+                              const Value& id,
+                              const Value& state);
+
+        /// Reads the spilled partitions back into the groups map until one yields a group.
+        void loadNextPartition();
+
+        /// Returns the state of 'accums' in the form written to the partition files.
+        Value accumulatorState(const Accumulators& accums) const;
+
+        /// Merges a state returned by accumulatorState() into 'accums'.
+        void mergeAccumulatorState(const Value& state, const Accumulators& accums);
 
-        // Only used by spill. Would be function-local if that were legal in C++03.
-        class SpillSTLComparator;
+        /// Returns the next group when the input is sorted on the group _id.
+        boost::optional<Document> getNextStreaming();
 
         /*
           Before returning anything, this source must fetch everything from
@@ -513,8 +641,6 @@ namespace mongo {
         Value expandId(const Value& val);
 
 
-        typedef vector<intrusive_ptr<Accumulator> > Accumulators;
-        typedef boost::unordered_map<Value, Accumulators, Value::Hash> GroupsMap;
         GroupsMap groups;
 
         /*
@@ -538,23 +664,140 @@ namespace mongo {
 
         bool _doingMerge;
         bool _spilled;
+        bool _streaming;
         const bool _extSortAllowed;
         const int _maxMemoryUsageBytes;
         boost::scoped_ptr<Variables> _variables;
         std::vector<std::string> _idFieldNames; // used when id is a document
         std::vector<intrusive_ptr<Expression> > _idExpressions;
 
-        // only used when !_spilled
+        // used when !_streaming; when _spilled it iterates the partition last loaded
         GroupsMap::iterator groupsIterator;
 
         // only used when _spilled
-        scoped_ptr<Sorter<Value, Value>::Iterator> _sorterIterator;
-        pair<Value, Value> _firstPartOfNextGroup;
-        Value _currentId;
+        PartitionWriters _spillWriters; // level 0, open until the input is exhausted
+        std::vector<Partition> _partitions; // files still to be grouped, the next one last
+
+        // only used when _streaming
+        boost::optional<Document> _firstDocOfNextGroup;
         Accumulators _currentAccumulators;
     };
 
 
+    /**
+     * Joins each document to the documents of another, unsharded collection in the same database
+     * whose 'foreignField' equals its 'localField', adding them as an array in its 'as' field:
+     *
+     *     {$lookup: {from: "coll", localField: "a", foreignField: "b", as: "joined"}}
+     *
+     * Equality is query equality: a missing field is null, and a foreign array equals each of its
+     * elements as well as itself.  If an index leads with 'foreignField', each document is joined
+     * by a query on it.  Otherwise the foreign collection is read once into a hash table.  A table
+     * over the memory limit is spilled, along with the input, to partitions by hash of the join
+     * key, which are joined one at a time.  That needs allowDiskUse.
+     */
+    class DocumentSourceLookup : public DocumentSource
+                               , public SplittableDocumentSource
+                               , public DocumentSourceNeedsMongod {
+    public:
+        // virtuals from DocumentSource
+        virtual boost::optional<Document> getNext();
+        virtual const char *getSourceName() const;
+        virtual GetDepsReturn getDependencies(DepsTracker* deps) const;
+        virtual void dispose();
+        virtual Value serialize(bool explain = false) const;
+
+        // Virtuals for SplittableDocumentSource
+        // The foreign collection is only on the primary shard, so the merger does the join.
+        virtual intrusive_ptr<DocumentSource> getShardSource() { return NULL; }
+        virtual intrusive_ptr<DocumentSource> getMergeSource() { return this; }
+
+        /**
+          Create a $lookup from its BSON specification.
+
+          @param pBsonElement the BSONElement with an object named $lookup
+          @param pExpCtx the expression context for the pipeline
+          @returns the created lookup
+         */
+        static intrusive_ptr<DocumentSource> createFromBson(
+            BSONElement elem,
+            const intrusive_ptr<ExpressionContext> &pExpCtx);
+
+        static const char lookupName[];
+
+    private:
+        DocumentSourceLookup(const NamespaceString& fromNs,
+                             const string& as,
+                             const string& localField,
+                             const string& foreignField,
+                             const intrusive_ptr<ExpressionContext> &pExpCtx);
+
+        /// Foreign documents by each of their join keys.
+        typedef boost::unordered_map<Value, vector<Value>, Value::Hash> HashTable;
+
+        /**
+         * Spilled partitions hold (join key, foreign document) pairs on the build side and
+         * (input position, input document) pairs on the probe side, so that joined documents can
+         * be put back in input order.
+         */
+        typedef SortedFileWriter<Value, Document> PartitionWriter;
+        typedef std::vector<boost::shared_ptr<PartitionWriter> > PartitionWriters;
+        struct Partition {
+            boost::shared_ptr<Sorter<Value, Document>::Iterator> build; // NULL if no matches
+            boost::shared_ptr<Sorter<Value, Document>::Iterator> probe;
+            int level; // number of times it has been split by hash
+        };
+
+        /// Returns true if an ascending or descending index on 'from' leads with 'foreignField'.
+        bool foreignFieldIndexed() const;
+
+        /// Reads 'from' into _table, spilling it and the input to partitions if it doesn't fit.
+        void buildTable();
+
+        /// Joins the spilled partitions in turn, leaving their output in _output.
+        void joinPartitions();
+
+        /// Writes _table and the rest of 'partition' to partitions a level below it.
+        void splitPartition(const Partition& partition);
+
+        /// Writes the contents of _table to 'writers' at 'level' and clears it.
+        void spillTable(PartitionWriters* writers, int level);
+
+        /// Appends a pair to partition 'partition' of 'writers', opening it if need be.
+        void writeToPartition(PartitionWriters* writers,
+                              size_t partition,
+                              const Value& key,
+                              const Document& doc);
+
+        /// Adds 'foreign' to _table under each of its join keys, returning the memory it took.
+        size_t addToTable(const Document& foreign, const BSONObj& foreignObj);
+
+        /// Returns the join key of an input document.
+        Value localKey(const Document& input) const;
+
+        /// Returns 'input' with its matches from 'from' in the 'as' field.
+        Document join(const Document& input);
+
+        const NamespaceString _fromNs;
+        const FieldPath _as;
+        const string _localField;
+        const string _foreignField;
+        const intrusive_ptr<ExpressionFieldPath> _localPath;
+        const bool _extSortAllowed;
+        const size_t _maxMemoryUsageBytes;
+
+        bool _started;
+        bool _indexed; // join by querying 'from' rather than through _table
+        HashTable _table;
+
+        // only used when the table was spilled
+        PartitionWriters _buildWriters; // level 0, open until 'from' has been read
+        PartitionWriters _probeWriters; // level 0, open until the input has been read
+        std::vector<Partition> _partitions; // still to be joined, the next one last
+        boost::scoped_ptr<Sorter<Value, Document>::Iterator> _output; // in input order
+    };
+
+
     class DocumentSourceMatch : public DocumentSource {
     public:
         // virtuals from DocumentSource
@@ -171,10 +171,8 @@ namespace {
         if (info->isScanAndOrderSet())
             out[TypeExplain::scanAndOrder()] = Value(info->getScanAndOrder());
 
-#if 0 // Disabled pending SERVER-12015 since until then no aggs will be index only.
         if (info->isIndexOnlySet())
             out[TypeExplain::indexOnly()] = Value(info->getIndexOnly());
-#endif
 
         if (info->isIndexBoundsSet())
             out[TypeExplain::indexBounds()] = Value(info->getIndexBounds());
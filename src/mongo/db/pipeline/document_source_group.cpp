@@ -47,72 +47,95 @@ namespace mongo {
     boost::optional<Document> DocumentSourceGroup::getNext() {
         pExpCtx->checkForInterrupt();
 
+        if (_streaming)
+            return getNextStreaming();
+
         if (!populated)
             populate();
 
-        if (_spilled) {
-            if (!_sorterIterator)
-                return boost::none;
+        if (_spilled && groupsIterator == groups.end())
+            loadNextPartition();
 
-            const size_t numAccumulators = vpAccumulatorFactory.size();
-            for (size_t i=0; i < numAccumulators; i++) {
-                _currentAccumulators[i]->reset(); // prep accumulators for a new group
-            }
+        if (groups.empty())
+            return boost::none;
 
-            _currentId = _firstPartOfNextGroup.first;
-            while (_currentId == _firstPartOfNextGroup.first) {
-                // Inside of this loop, _firstPartOfNextGroup is the current data being processed.
-                // At loop exit, it is the first value to be processed in the next group.
+        Document out = makeDocument(groupsIterator->first,
+                                    groupsIterator->second,
+                                    pExpCtx->inShard);
 
-                switch (numAccumulators) { // mirrors switch in spill()
-                case 0: // no Accumulators so no Values
-                    break;
+        if (++groupsIterator == groups.end() && _partitions.empty())
+            dispose();
 
-                case 1: // single accumulators serialize as a single Value
-                    _currentAccumulators[0]->process(_firstPartOfNextGroup.second,
-                                                     /*merging=*/true);
-                    break;
-
-                default: { // multiple accumulators serialize as an array
-                    const vector<Value>& accumulatorStates =
-                        _firstPartOfNextGroup.second.getArray();
-                    for (size_t i=0; i < numAccumulators; i++) {
-                        _currentAccumulators[i]->process(accumulatorStates[i],
-                                                         /*merging=*/true);
-                    }
-                    break;
-                }
-                }
+        return out;
+    }
 
-                if (!_sorterIterator->more()) {
-                    dispose();
-                    break;
-                }
+    boost::optional<Document> DocumentSourceGroup::getNextStreaming() {
+        const size_t numAccumulators = vpAccumulatorFactory.size();
 
-                _firstPartOfNextGroup = _sorterIterator->next();
+        if (!populated) {
+            _currentAccumulators.reserve(numAccumulators);
+            for (size_t i = 0; i < numAccumulators; i++) {
+                _currentAccumulators.push_back(vpAccumulatorFactory[i]());
             }
 
-            return makeDocument(_currentId, _currentAccumulators, pExpCtx->inShard);
+            _firstDocOfNextGroup = pSource->getNext();
+            populated = true;
+        }
 
-        } else {
-            if (groups.empty())
-                return boost::none;
+        if (!_firstDocOfNextGroup)
+            return boost::none;
 
-            Document out = makeDocument(groupsIterator->first,
-                                        groupsIterator->second,
-                                        pExpCtx->inShard);
+        for (size_t i = 0; i < numAccumulators; i++) {
+            _currentAccumulators[i]->reset(); // prep accumulators for a new group
+        }
+
+        _variables->setRoot(*_firstDocOfNextGroup);
+        Value currentId = computeId(_variables.get());
+        if (currentId.missing())
+            currentId = Value(BSONNULL);
 
-            if (++groupsIterator == groups.end())
+        while (true) {
+            // Inside of this loop the ROOT document is the current input being processed.  At
+            // loop exit, _firstDocOfNextGroup is the first input of the next group, if any.
+            int memoryUsageBytes = currentId.getApproximateSize();
+            for (size_t i = 0; i < numAccumulators; i++) {
+                _currentAccumulators[i]->process(vpExpression[i]->evaluate(_variables.get()),
+                                                 _doingMerge);
+                memoryUsageBytes += _currentAccumulators[i]->memUsageForSorter();
+            }
+            _variables->clearRoot();
+
+            // The one group held can't be spilled, whether or not external sort is allowed.
+            uassert(16945, "Exceeded memory limit for $group on a single group",
+                    memoryUsageBytes <= _maxMemoryUsageBytes);
+
+            _firstDocOfNextGroup = pSource->getNext();
+            if (!_firstDocOfNextGroup) {
+                Document out = makeDocument(currentId, _currentAccumulators, pExpCtx->inShard);
                 dispose();
+                return out;
+            }
+
+            _variables->setRoot(*_firstDocOfNextGroup);
+            Value id = computeId(_variables.get());
+            if (id.missing())
+                id = Value(BSONNULL);
 
-            return out;
+            if (id != currentId)
+                break;
         }
+
+        _variables->clearRoot();
+        return makeDocument(currentId, _currentAccumulators, pExpCtx->inShard);
     }
 
     void DocumentSourceGroup::dispose() {
         // free our resources
         GroupsMap().swap(groups);
-        _sorterIterator.reset();
+        _spillWriters.clear();
+        _partitions.clear();
+        _firstDocOfNextGroup = boost::none;
+        _currentAccumulators.clear();
 
         // make us look done
         groupsIterator = groups.end();
@@ -185,6 +208,41 @@ namespace mongo {
         return EXHAUSTIVE_ALL;
     }
 
+    bool DocumentSourceGroup::isGroupedBySort(const BSONObj& sortPattern,
+                                              set<string>* idFieldsOut) const {
+        // The _id must be made of plain field paths into the input document.
+        set<string> idFields;
+        for (size_t i = 0; i < _idExpressions.size(); i++) {
+            if (!dynamic_cast<ExpressionFieldPath*>(_idExpressions[i].get()))
+                return false;
+
+            DepsTracker deps;
+            _idExpressions[i]->addDependencies(&deps);
+            if (deps.needWholeDocument || deps.fields.size() != 1)
+                return false;
+
+            idFields.insert(*deps.fields.begin());
+        }
+
+        // Those fields, and only those, must lead the sort pattern.
+        set<string> leadingFields;
+        BSONObjIterator it(sortPattern);
+        while (leadingFields.size() < idFields.size() && it.more()) {
+            const BSONElement field = it.next();
+            if (!field.isNumber() || !idFields.count(field.fieldName()))
+                return false;
+
+            leadingFields.insert(field.fieldName());
+        }
+
+        if (leadingFields != idFields)
+            return false;
+
+        if (idFieldsOut)
+            idFieldsOut->insert(idFields.begin(), idFields.end());
+        return true;
+    }
+
     intrusive_ptr<DocumentSourceGroup> DocumentSourceGroup::create(
         const intrusive_ptr<ExpressionContext> &pExpCtx) {
         intrusive_ptr<DocumentSourceGroup> pSource(
@@ -197,6 +255,7 @@ namespace mongo {
         , populated(false)
         , _doingMerge(false)
         , _spilled(false)
+        , _streaming(false)
         , _extSortAllowed(pExpCtx->extSortAllowed && !pExpCtx->inRouter)
         , _maxMemoryUsageBytes(100*1024*1024)
     {}
@@ -338,22 +397,32 @@ namespace mongo {
     }
 
     namespace {
-        class SorterComparator {
-        public:
-            typedef pair<Value, Value> Data;
-            int operator() (const Data& lhs, const Data& rhs) const {
-                return Value::compare(lhs.first, rhs.first);
-            }
-        };
+        // Each spill is divided among this many partition files.
+        const size_t kSpillPartitions = 16;
+        const int kSpillPartitionBits = 4;
+
+        // A partition is split by the next kSpillPartitionBits of its groups' hashes, so the
+        // groups of one partition land in different partitions one level down.
+        const int kMaxSpillPartitionLevel = (sizeof(size_t) * 8) / kSpillPartitionBits;
+
+        size_t partitionFor(const Value& id, int level) {
+            // Mix the bits since Value::Hash leaves small integers unchanged.
+            unsigned long long hash = Value::Hash()(id);
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdULL;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53ULL;
+            hash ^= hash >> 33;
+            return size_t(hash >> (level * kSpillPartitionBits)) & (kSpillPartitions - 1);
+        }
     }
 
     void DocumentSourceGroup::populate() {
         const size_t numAccumulators = vpAccumulatorFactory.size();
         dassert(numAccumulators == vpExpression.size());
 
-        // pushed to on spill()
-        vector<shared_ptr<Sorter<Value, Value>::Iterator> > sortedFiles;
         int memoryUsageBytes = 0;
+        int numDebugSpills = 0;
 
         // This loop consumes all input from pSource and buckets it based on pIdExpression.
         while (boost::optional<Document> input = pSource->getNext()) {
@@ -361,7 +430,7 @@ namespace mongo {
                 uassert(16945, "Exceeded memory limit for $group, but didn't allow external sort."
                                " Pass allowDiskUse:true to opt in.",
                         _extSortAllowed);
-                sortedFiles.push_back(spill());
+                spill();
                 memoryUsageBytes = 0;
             }
 
@@ -412,88 +481,182 @@ namespace mongo {
                 if (!inserted // is a dup
                         && !pExpCtx->inRouter // can't spill to disk in router
                         && !_extSortAllowed // don't change behavior when testing external sort
-                        && sortedFiles.size() < 20 // don't open too many FDs
+                        && numDebugSpills++ < 20 // don't write too many times
                         ) {
-                    sortedFiles.push_back(spill());
+                    spill();
                 }
             }
         }
 
         // These blocks do any final steps necessary to prepare to output results.
-        if (!sortedFiles.empty()) {
+        if (!_spillWriters.empty()) {
             _spilled = true;
             if (!groups.empty()) {
-                sortedFiles.push_back(spill());
+                spill();
             }
 
-            // We won't be using groups again so free its memory.
+            // We won't be using groups again until the partitions are read back.
             GroupsMap().swap(groups);
 
-            _sorterIterator.reset(
-                    Sorter<Value,Value>::Iterator::merge(
-                        sortedFiles, SortOptions(), SorterComparator()));
+            for (size_t i = 0; i < _spillWriters.size(); i++) {
+                if (!_spillWriters[i])
+                    continue;
 
-            // prepare current to accumulate data
-            _currentAccumulators.reserve(numAccumulators);
-            for (size_t i = 0; i < numAccumulators; i++) {
-                _currentAccumulators.push_back(vpAccumulatorFactory[i]());
+                Partition partition;
+                partition.file.reset(_spillWriters[i]->done());
+                partition.level = 0;
+                _partitions.push_back(partition);
             }
-
-            verify(_sorterIterator->more()); // we put data in, we should get something out.
-            _firstPartOfNextGroup = _sorterIterator->next();
-        } else {
-            // start the group iterator
-            groupsIterator = groups.begin();
+            _spillWriters.clear();
         }
 
+        // start the group iterator
+        groupsIterator = groups.begin();
+
         populated = true;
     }
 
-    class DocumentSourceGroup::SpillSTLComparator {
-    public:
-        bool operator() (const GroupsMap::value_type* lhs, const GroupsMap::value_type* rhs) const {
-            return Value::compare(lhs->first, rhs->first) < 0;
-        }
-    };
-
-    shared_ptr<Sorter<Value, Value>::Iterator> DocumentSourceGroup::spill() {
-        vector<const GroupsMap::value_type*> ptrs; // using pointers to speed sorting
-        ptrs.reserve(groups.size());
-        for (GroupsMap::const_iterator it=groups.begin(), end=groups.end(); it != end; ++it) {
-            ptrs.push_back(&*it);
-        }
+    Value DocumentSourceGroup::accumulatorState(const Accumulators& accums) const {
+        switch (accums.size()) { // mirrors switch in mergeAccumulatorState()
+        case 0: // no values, essentially a distinct
+            return Value();
 
-        stable_sort(ptrs.begin(), ptrs.end(), SpillSTLComparator());
+        case 1: // just one value, use optimized serialization as single Value
+            return accums[0]->getValue(/*toBeMerged=*/true);
 
-        SortedFileWriter<Value, Value> writer(SortOptions().TempDir(pExpCtx->tempDir));
-        switch (vpAccumulatorFactory.size()) { // same as ptrs[i]->second.size() for all i.
-        case 0: // no values, essentially a distinct
-            for (size_t i=0; i < ptrs.size(); i++) {
-                writer.addAlreadySorted(ptrs[i]->first, Value());
+        default: { // multiple values, serialize as array-typed Value
+            vector<Value> states;
+            states.reserve(accums.size());
+            for (size_t i = 0; i < accums.size(); i++) {
+                states.push_back(accums[i]->getValue(/*toBeMerged=*/true));
             }
+            return Value::consume(states);
+        }
+        }
+    }
+
+    void DocumentSourceGroup::mergeAccumulatorState(const Value& state,
+                                                    const Accumulators& accums) {
+        switch (accums.size()) { // mirrors switch in accumulatorState()
+        case 0: // no Accumulators so no Values
             break;
 
-        case 1: // just one value, use optimized serialization as single Value
-            for (size_t i=0; i < ptrs.size(); i++) {
-                writer.addAlreadySorted(ptrs[i]->first,
-                                        ptrs[i]->second[0]->getValue(/*toBeMerged=*/true));
-            }
+        case 1: // single accumulators serialize as a single Value
+            accums[0]->process(state, /*merging=*/true);
             break;
 
-        default: // multiple values, serialize as array-typed Value
-            for (size_t i=0; i < ptrs.size(); i++) {
-                vector<Value> accums;
-                for (size_t j=0; j < ptrs[i]->second.size(); j++) {
-                    accums.push_back(ptrs[i]->second[j]->getValue(/*toBeMerged=*/true));
-                }
-                writer.addAlreadySorted(ptrs[i]->first, Value::consume(accums));
+        default: { // multiple accumulators serialize as an array
+            const vector<Value>& states = state.getArray();
+            for (size_t i = 0; i < accums.size(); i++) {
+                accums[i]->process(states[i], /*merging=*/true);
             }
             break;
         }
+        }
+    }
+
+    void DocumentSourceGroup::writeToPartition(PartitionWriters* writers,
+                                               int level,
+                                               const Value& id,
+                                               const Value& state) {
+        // Writers are only opened for partitions that get data: their files can't be empty.
+        writers->resize(kSpillPartitions);
+        boost::shared_ptr<PartitionWriter>& writer = (*writers)[partitionFor(id, level)];
+        if (!writer)
+            writer.reset(new PartitionWriter(SortOptions().TempDir(pExpCtx->tempDir)));
+
+        // The writers don't require sorted input; they just append to their file.
+        writer->addAlreadySorted(id, state);
+    }
+
+    void DocumentSourceGroup::spill() {
+        for (GroupsMap::const_iterator it=groups.begin(), end=groups.end(); it != end; ++it) {
+            writeToPartition(&_spillWriters, 0, it->first, accumulatorState(it->second));
+        }
 
         groups.clear();
+    }
+
+    void DocumentSourceGroup::splitPartition(const Partition& partition) {
+        const int level = partition.level + 1;
+
+        PartitionWriters writers;
+        for (GroupsMap::const_iterator it=groups.begin(), end=groups.end(); it != end; ++it) {
+            writeToPartition(&writers, level, it->first, accumulatorState(it->second));
+        }
+        groups.clear();
+
+        while (partition.file->more()) {
+            const pair<Value, Value> data = partition.file->next();
+            writeToPartition(&writers, level, data.first, data.second);
+        }
+
+        for (size_t i = 0; i < writers.size(); i++) {
+            if (!writers[i])
+                continue;
+
+            Partition child;
+            child.file.reset(writers[i]->done());
+            child.level = level;
+            _partitions.push_back(child);
+        }
+    }
+
+    void DocumentSourceGroup::loadNextPartition() {
+        const size_t numAccumulators = vpAccumulatorFactory.size();
+
+        groups.clear();
+        while (groups.empty() && !_partitions.empty()) {
+            const Partition partition = _partitions.back();
+            _partitions.pop_back();
+
+            int memoryUsageBytes = 0;
+            while (partition.file->more()) {
+                // A partition holding too much to group in memory is split further, unless
+                // it is down to one group, which no split would make smaller.
+                if (memoryUsageBytes > _maxMemoryUsageBytes
+                        && groups.size() > 1
+                        && partition.level + 1 < kMaxSpillPartitionLevel) {
+                    splitPartition(partition);
+                    break;
+                }
+
+                const pair<Value, Value> data = partition.file->next();
+
+                const size_t oldSize = groups.size();
+                Accumulators& group = groups[data.first];
+                const bool inserted = groups.size() != oldSize;
+
+                if (inserted) {
+                    memoryUsageBytes += data.first.getApproximateSize();
+
+                    group.reserve(numAccumulators);
+                    for (size_t i = 0; i < numAccumulators; i++) {
+                        group.push_back(vpAccumulatorFactory[i]());
+                    }
+                } else {
+                    for (size_t i = 0; i < numAccumulators; i++) {
+                        memoryUsageBytes -= group[i]->memUsageForSorter();
+                    }
+                }
+
+                mergeAccumulatorState(data.second, group);
+                for (size_t i = 0; i < numAccumulators; i++) {
+                    memoryUsageBytes += group[i]->memUsageForSorter();
+                }
+
+                DEV {
+                    // In debug mode, split first level partitions on a duplicate to stress
+                    // the split logic.
+                    if (!inserted && partition.level == 0 && groups.size() > 1) {
+                        splitPartition(partition);
+                        break;
+                    }
+                }
+            }
+        }
 
-        return shared_ptr<Sorter<Value, Value>::Iterator>(writer.done());
+        groupsIterator = groups.begin();
     }
 
     void DocumentSourceGroup::parseIdExpression(BSONElement groupField,
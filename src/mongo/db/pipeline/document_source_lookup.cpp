@@ -0,0 +1,441 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/pch.h"
+
+#include "mongo/db/pipeline/document_source.h"
+
+#include "mongo/client/dbclientcursor.h"
+#include "mongo/db/pipeline/expression.h"
+
+namespace mongo {
+
+    const char DocumentSourceLookup::lookupName[] = "$lookup";
+
+namespace {
+    // Each spill is divided among this many partition files, as in $group.
+    const size_t kSpillPartitions = 16;
+    const int kSpillPartitionBits = 4;
+
+    // A partition is split by the next kSpillPartitionBits of its keys' hashes, so the keys of
+    // one partition land in different partitions one level down.
+    const int kMaxSpillPartitionLevel = (sizeof(size_t) * 8) / kSpillPartitionBits;
+
+    size_t partitionFor(const Value& key, int level) {
+        // Mix the bits since Value::Hash leaves small integers unchanged.
+        unsigned long long hash = Value::Hash()(key);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return size_t(hash >> (level * kSpillPartitionBits)) & (kSpillPartitions - 1);
+    }
+
+    // Orders joined documents by their position in the input.
+    class InputOrder {
+    public:
+        int operator()(const Sorter<Value, Document>::Data& lhs,
+                       const Sorter<Value, Document>::Data& rhs) const {
+            return Value::compare(lhs.first, rhs.first);
+        }
+    };
+
+    // The key of a document without the foreign field.
+    const BSONObj nullKey = BSON("" << BSONNULL);
+
+    /**
+     * Returns the join keys of 'foreign', those a query for equality on 'field' would match: each
+     * value of 'field', arrays and their elements alike, or null if there is none.
+     */
+    BSONElementSet foreignKeys(const BSONObj& foreign, const string& field) {
+        BSONElementSet keys;
+        foreign.getFieldsDotted(field, keys, /*expandLastArray=*/false);
+        foreign.getFieldsDotted(field, keys, /*expandLastArray=*/true);
+        if (keys.empty())
+            keys.insert(nullKey.firstElement());
+        return keys;
+    }
+
+    bool hasForeignKey(const BSONObj& foreign, const string& field, const Value& key) {
+        const BSONElementSet keys = foreignKeys(foreign, field);
+        for (BSONElementSet::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            if (Value::compare(Value(*it), key) == 0)
+                return true;
+        }
+        return false;
+    }
+}
+
+    DocumentSourceLookup::DocumentSourceLookup(const NamespaceString& fromNs,
+                                               const string& as,
+                                               const string& localField,
+                                               const string& foreignField,
+                                               const intrusive_ptr<ExpressionContext> &pExpCtx)
+        : DocumentSource(pExpCtx)
+        , _fromNs(fromNs)
+        , _as(as)
+        , _localField(localField)
+        , _foreignField(foreignField)
+        , _localPath(ExpressionFieldPath::create(localField))
+        , _extSortAllowed(pExpCtx->extSortAllowed && !pExpCtx->inRouter)
+        , _maxMemoryUsageBytes(100*1024*1024)
+        , _started(false)
+        , _indexed(false)
+    {}
+
+    const char *DocumentSourceLookup::getSourceName() const {
+        return lookupName;
+    }
+
+    boost::optional<Document> DocumentSourceLookup::getNext() {
+        pExpCtx->checkForInterrupt();
+
+        if (!_started) {
+            verify(_mongod);
+            uassert(18617, str::stream() << "namespace '" << _fromNs.ns()
+                                         << "' is sharded so it can't be used for $lookup",
+                    !_mongod->isSharded(_fromNs));
+
+            _indexed = foreignFieldIndexed();
+            if (!_indexed)
+                buildTable();
+            _started = true;
+        }
+
+        if (_output) {
+            // the table was spilled, and the input joined partition by partition
+            if (!_output->more())
+                return boost::none;
+            return _output->next().second;
+        }
+
+        boost::optional<Document> input = pSource->getNext();
+        if (!input)
+            return boost::none;
+
+        return join(*input);
+    }
+
+    bool DocumentSourceLookup::foreignFieldIndexed() const {
+        scoped_ptr<DBClientCursor> indexes(
+            _mongod->directClient()->getIndexes(_fromNs.ns()).release());
+        while (indexes && indexes->more()) {
+            const BSONObj index = indexes->nextSafe();
+            const BSONElement first = index["key"].embeddedObject().firstElement();
+            if (first.isNumber() && first.fieldNameStringData() == _foreignField)
+                return true;
+        }
+        return false;
+    }
+
+    void DocumentSourceLookup::buildTable() {
+        scoped_ptr<DBClientCursor> cursor(
+            _mongod->directClient()->query(_fromNs.ns(), Query()).release());
+        uassert(18618, str::stream() << "$lookup failed to read '" << _fromNs.ns() << "'",
+                cursor);
+
+        size_t memoryUsageBytes = 0;
+        while (cursor->more()) {
+            pExpCtx->checkForInterrupt();
+
+            const BSONObj foreignObj = cursor->nextSafe().getOwned();
+            const Document foreign(foreignObj);
+
+            if (_buildWriters.empty()) {
+                memoryUsageBytes += addToTable(foreign, foreignObj);
+                if (memoryUsageBytes > _maxMemoryUsageBytes) {
+                    uassert(18619, "Exceeded memory limit for $lookup, but didn't allow external"
+                                   " sort. Pass allowDiskUse:true to opt in.",
+                            _extSortAllowed);
+                    spillTable(&_buildWriters, 0);
+                }
+                continue;
+            }
+
+            const BSONElementSet keys = foreignKeys(foreignObj, _foreignField);
+            for (BSONElementSet::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+                const Value key(*it);
+                writeToPartition(&_buildWriters, partitionFor(key, 0), key, foreign);
+            }
+        }
+
+        if (_buildWriters.empty())
+            return;
+
+        // The table didn't fit, so split the input the same way, numbering the documents to put
+        // them back in order once joined.
+        long long position = 0;
+        while (boost::optional<Document> input = pSource->getNext()) {
+            writeToPartition(&_probeWriters,
+                             partitionFor(localKey(*input), 0),
+                             Value(position++),
+                             *input);
+        }
+
+        for (size_t i = 0; i < _probeWriters.size(); i++) {
+            // Partitions without input have nothing to join.
+            if (!_probeWriters[i])
+                continue;
+
+            Partition partition;
+            partition.probe.reset(_probeWriters[i]->done());
+            if (_buildWriters[i])
+                partition.build.reset(_buildWriters[i]->done());
+            partition.level = 0;
+            _partitions.push_back(partition);
+        }
+        _buildWriters.clear();
+        _probeWriters.clear();
+
+        joinPartitions();
+    }
+
+    void DocumentSourceLookup::joinPartitions() {
+        SortOptions opts;
+        opts.maxMemoryUsageBytes = _maxMemoryUsageBytes;
+        opts.extSortAllowed = true;
+        opts.tempDir = pExpCtx->tempDir;
+        scoped_ptr<Sorter<Value, Document> > sorter(
+            Sorter<Value, Document>::make(opts, InputOrder()));
+
+        while (!_partitions.empty()) {
+            const Partition partition = _partitions.back();
+            _partitions.pop_back();
+
+            _table.clear();
+            size_t memoryUsageBytes = 0;
+            bool split = false;
+            while (partition.build && partition.build->more()) {
+                // A partition holding too much to join in memory is split further, unless it
+                // is down to one key, which no split would make smaller.
+                if (memoryUsageBytes > _maxMemoryUsageBytes
+                        && _table.size() > 1
+                        && partition.level + 1 < kMaxSpillPartitionLevel) {
+                    splitPartition(partition);
+                    split = true;
+                    break;
+                }
+
+                const pair<Value, Document> data = partition.build->next();
+                _table[data.first].push_back(Value(data.second));
+                memoryUsageBytes += data.first.getApproximateSize()
+                                  + data.second.getApproximateSize();
+            }
+            if (split)
+                continue;
+
+            while (partition.probe->more()) {
+                pExpCtx->checkForInterrupt();
+
+                const pair<Value, Document> data = partition.probe->next();
+                sorter->add(data.first, join(data.second));
+            }
+        }
+
+        _table.clear();
+        _output.reset(sorter->done());
+    }
+
+    void DocumentSourceLookup::splitPartition(const Partition& partition) {
+        const int level = partition.level + 1;
+
+        PartitionWriters buildWriters;
+        spillTable(&buildWriters, level);
+        while (partition.build->more()) {
+            const pair<Value, Document> data = partition.build->next();
+            writeToPartition(&buildWriters, partitionFor(data.first, level), data.first, data.second);
+        }
+
+        PartitionWriters probeWriters;
+        while (partition.probe->more()) {
+            const pair<Value, Document> data = partition.probe->next();
+            writeToPartition(&probeWriters,
+                             partitionFor(localKey(data.second), level),
+                             data.first,
+                             data.second);
+        }
+
+        for (size_t i = 0; i < probeWriters.size(); i++) {
+            if (!probeWriters[i])
+                continue;
+
+            Partition child;
+            child.probe.reset(probeWriters[i]->done());
+            if (i < buildWriters.size() && buildWriters[i])
+                child.build.reset(buildWriters[i]->done());
+            child.level = level;
+            _partitions.push_back(child);
+        }
+    }
+
+    void DocumentSourceLookup::spillTable(PartitionWriters* writers, int level) {
+        for (HashTable::const_iterator it = _table.begin(); it != _table.end(); ++it) {
+            const size_t partition = partitionFor(it->first, level);
+            for (size_t i = 0; i < it->second.size(); i++) {
+                writeToPartition(writers, partition, it->first, it->second[i].getDocument());
+            }
+        }
+        _table.clear();
+    }
+
+    void DocumentSourceLookup::writeToPartition(PartitionWriters* writers,
+                                                size_t partition,
+                                                const Value& key,
+                                                const Document& doc) {
+        // Writers are only opened for partitions that get data: their files can't be empty.
+        writers->resize(kSpillPartitions);
+        boost::shared_ptr<PartitionWriter>& writer = (*writers)[partition];
+        if (!writer)
+            writer.reset(new PartitionWriter(SortOptions().TempDir(pExpCtx->tempDir)));
+
+        // The writers don't require sorted input; they just append to their file.
+        writer->addAlreadySorted(key, doc);
+    }
+
+    size_t DocumentSourceLookup::addToTable(const Document& foreign, const BSONObj& foreignObj) {
+        // The document is shared by the entries for each of its keys.
+        size_t memoryUsageBytes = foreign.getApproximateSize();
+
+        const BSONElementSet keys = foreignKeys(foreignObj, _foreignField);
+        for (BSONElementSet::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            const Value key(*it);
+            _table[key].push_back(Value(foreign));
+            memoryUsageBytes += key.getApproximateSize() + sizeof(Value);
+        }
+        return memoryUsageBytes;
+    }
+
+    Value DocumentSourceLookup::localKey(const Document& input) const {
+        const Value key = _localPath->evaluate(input);
+        return key.missing() ? Value(BSONNULL) : key;
+    }
+
+    Document DocumentSourceLookup::join(const Document& input) {
+        const Value key = localKey(input);
+
+        vector<Value> matches;
+        if (_indexed) {
+            // $in rather than equality so that a document key isn't taken for query operators.
+            BSONArrayBuilder in;
+            key.addToBsonArray(&in);
+            scoped_ptr<DBClientCursor> cursor(
+                _mongod->directClient()->query(_fromNs.ns(),
+                                               BSON(_foreignField << BSON("$in" << in.arr())))
+                                       .release());
+            uassert(18618, str::stream() << "$lookup failed to read '" << _fromNs.ns() << "'",
+                    cursor);
+
+            while (cursor->more()) {
+                const BSONObj foreignObj = cursor->nextSafe();
+                // $in also matches a regular expression as a pattern, which the table doesn't.
+                if (hasForeignKey(foreignObj, _foreignField, key))
+                    matches.push_back(Value(foreignObj.getOwned()));
+            }
+        }
+        else {
+            HashTable::const_iterator it = _table.find(key);
+            if (it != _table.end())
+                matches = it->second;
+        }
+
+        MutableDocument out(input);
+        out.setNestedField(_as, Value::consume(matches));
+        return out.freeze();
+    }
+
+    void DocumentSourceLookup::dispose() {
+        _table.clear();
+        _buildWriters.clear();
+        _probeWriters.clear();
+        _partitions.clear();
+        _output.reset();
+        pSource->dispose();
+    }
+
+    DocumentSource::GetDepsReturn DocumentSourceLookup::getDependencies(DepsTracker* deps) const {
+        deps->fields.insert(_localField);
+        return SEE_NEXT;
+    }
+
+    Value DocumentSourceLookup::serialize(bool explain) const {
+        MutableDocument spec(DOC("from" << _fromNs.coll()
+                              << "localField" << _localField
+                              << "foreignField" << _foreignField
+                              << "as" << _as.getPath(false)));
+
+        if (explain && _mongod) {
+            const bool indexed = _started ? _indexed : foreignFieldIndexed();
+            spec["strategy"] = Value(indexed ? "indexedLoop" : "hashTable");
+        }
+
+        return Value(DOC(getSourceName() << spec.freeze()));
+    }
+
+    intrusive_ptr<DocumentSource> DocumentSourceLookup::createFromBson(
+            BSONElement elem,
+            const intrusive_ptr<ExpressionContext> &pExpCtx) {
+        uassert(18612, str::stream() << "$lookup requires an object, not "
+                                     << typeName(elem.type()),
+                elem.type() == Object);
+
+        string from;
+        string as;
+        string localField;
+        string foreignField;
+        BSONForEach(arg, elem.embeddedObject()) {
+            const StringData name = arg.fieldNameStringData();
+            uassert(18613, str::stream() << "$lookup argument '" << name
+                                         << "' must be a string, not " << typeName(arg.type()),
+                    arg.type() == String);
+
+            if (name == "from")
+                from = arg.str();
+            else if (name == "as")
+                as = arg.str();
+            else if (name == "localField")
+                localField = arg.str();
+            else if (name == "foreignField")
+                foreignField = arg.str();
+            else
+                uasserted(18614, str::stream() << "unknown argument to $lookup: " << name);
+        }
+
+        uassert(18615, "$lookup requires 'from', 'localField', 'foreignField' and 'as' arguments",
+                !from.empty() && !as.empty() && !localField.empty() && !foreignField.empty());
+
+        NamespaceString fromNs(pExpCtx->ns.db().toString() + '.' + from);
+        uassert(18616, "invalid $lookup namespace: " + fromNs.ns(), fromNs.isValid());
+
+        return new DocumentSourceLookup(fromNs, as, localField, foreignField, pExpCtx);
+    }
+}
+
+#include "db/sorter/sorter.cpp"
+// Explicit instantiation unneeded since we aren't exposing Sorter outside of this file.
@@ -0,0 +1,228 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/pch.h"
+
+#include "mongo/db/pipeline/document_source.h"
+
+#include <boost/bind.hpp>
+
+#include "mongo/db/client.h"
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/pipeline/document.h"
+#include "mongo/db/pipeline/expression_context.h"
+#include "mongo/db/pipeline/pipeline.h"
+#include "mongo/db/query/parallel_scan.h"
+
+namespace mongo {
+
+namespace {
+    /**
+     * The initial source of a range's pipeline: the documents an ExtentRangeScan returns.
+     */
+    class DocumentSourceExtentRange : public DocumentSource {
+    public:
+        DocumentSourceExtentRange(ExtentRangeScan* scan,
+                                  const boost::optional<ParsedDeps>& deps,
+                                  const intrusive_ptr<ExpressionContext>& pExpCtx)
+            : DocumentSource(pExpCtx)
+            , _scan(scan)
+            , _dependencies(deps)
+        {}
+
+        virtual boost::optional<Document> getNext() {
+            BSONObj obj;
+            if (!_scan->getNext(&obj))
+                return boost::none;
+
+            // Both copy out of 'obj', which is only valid while the scan's extent is locked.
+            return _dependencies ? _dependencies->extractFields(obj) : Document(obj);
+        }
+
+        virtual const char *getSourceName() const { return "$extentRange"; }
+        virtual bool isValidInitialSource() const { return true; }
+
+        // never parsed, and explained by the DocumentSourceParallelScan
+        virtual Value serialize(bool explain = false) const { return Value(); }
+
+    private:
+        ExtentRangeScan* _scan;
+        const boost::optional<ParsedDeps>& _dependencies;
+    };
+}
+
+    DocumentSourceParallelScan::DocumentSourceParallelScan(
+            const BSONObj& query,
+            const vector<Value>& rangeStages,
+            const boost::optional<ParsedDeps>& deps,
+            size_t nThreads,
+            const intrusive_ptr<ExpressionContext>& pExpCtx)
+        : DocumentSource(pExpCtx)
+        , _query(query.getOwned())
+        , _rangeStages(rangeStages)
+        , _dependencies(deps)
+        , _nThreads(nThreads)
+        , _maxMemoryUsageBytes(100*1024*1024)
+        , _scanned(false)
+        , _currentRange(0)
+    {}
+
+    DocumentSourceParallelScan::~DocumentSourceParallelScan() {}
+
+    intrusive_ptr<DocumentSourceParallelScan> DocumentSourceParallelScan::create(
+            const BSONObj& query,
+            const vector<Value>& rangeStages,
+            const boost::optional<ParsedDeps>& deps,
+            size_t nThreads,
+            const intrusive_ptr<ExpressionContext>& pExpCtx) {
+        return new DocumentSourceParallelScan(query, rangeStages, deps, nThreads, pExpCtx);
+    }
+
+    const char *DocumentSourceParallelScan::getSourceName() const {
+        return "$parallelScan";
+    }
+
+    boost::optional<Document> DocumentSourceParallelScan::getNext() {
+        pExpCtx->checkForInterrupt();
+
+        if (!_scanned) {
+            scan();
+            _scanned = true;
+        }
+
+        if (_serialPipeline)
+            return _serialPipeline->output()->getNext();
+
+        while (_currentRange < _results.size()) {
+            std::deque<Document>& results = _results[_currentRange];
+            if (!results.empty()) {
+                Document out = results.front();
+                results.pop_front();
+                return out;
+            }
+            _currentRange++;
+        }
+        return boost::none;
+    }
+
+    void DocumentSourceParallelScan::scan() {
+        const string& ns = pExpCtx->ns.ns();
+
+        scoped_ptr<ParallelScan> parallelScan;
+        {
+            Client::ReadContext ctx(ns);
+            Database* db = ctx.ctx().db();
+            Collection* collection = db->getCollection(ns);
+            if (!collection)
+                return; // dropped since the pipeline was planned
+
+            parallelScan.reset(new ParallelScan(db, collection, _query, _nThreads));
+        }
+
+        // Each range parses its own copy of the stages, as a shard would, so that their $group
+        // returns partial results for the $group after this source to merge.
+        MutableDocument cmd;
+        cmd[Pipeline::commandName] = Value(pExpCtx->ns.coll());
+        cmd["pipeline"] = Value(_rangeStages);
+        cmd["fromRouter"] = Value(true);
+        cmd["allowDiskUse"] = Value(pExpCtx->extSortAllowed);
+        const BSONObj rangeCommand = cmd.freeze().toBson();
+
+        _results.resize(parallelScan->numRanges());
+        const Status status = parallelScan->run(
+                boost::bind(&DocumentSourceParallelScan::scanRange,
+                            this, boost::cref(rangeCommand), _1, _2));
+
+        if (_resultBytes.load() > _maxMemoryUsageBytes) {
+            uassert(16945, "Exceeded memory limit for $group, but didn't allow external sort."
+                           " Pass allowDiskUse:true to opt in.",
+                    pExpCtx->extSortAllowed);
+
+            // The $group of a single range can spill where the buffered output of all of them
+            // can't, so give up on the threads and stream one range over every extent instead.
+            vector<std::deque<Document> >().swap(_results);
+            _serialScan.reset(new ExtentRangeScan(ns, parallelScan->extents(), _query,
+                                                  &_serialAbort));
+            _serialPipeline = rangePipeline(rangeCommand, _serialScan.get());
+            return;
+        }
+
+        uassertStatusOK(status);
+    }
+
+    void DocumentSourceParallelScan::scanRange(const BSONObj& rangeCommand,
+                                               size_t range,
+                                               ExtentRangeScan* scan) {
+        intrusive_ptr<Pipeline> pipeline = rangePipeline(rangeCommand, scan);
+
+        std::deque<Document>& results = _results[range];
+        DocumentSource* output = pipeline->output();
+        while (boost::optional<Document> next = output->getNext()) {
+            results.push_back(*next);
+
+            // Stops the other ranges too; scan() tells this failure from the others by the size.
+            const long long bytes = _resultBytes.addAndFetch(next->getApproximateSize());
+            uassert(18620, "parallel scan output exceeded the $group memory limit",
+                    bytes <= _maxMemoryUsageBytes);
+        }
+    }
+
+    intrusive_ptr<Pipeline> DocumentSourceParallelScan::rangePipeline(const BSONObj& rangeCommand,
+                                                                      ExtentRangeScan* scan) {
+        intrusive_ptr<ExpressionContext> rangeCtx =
+            new ExpressionContext(pExpCtx->interruptStatus, pExpCtx->ns);
+        rangeCtx->tempDir = pExpCtx->tempDir;
+
+        string errmsg;
+        intrusive_ptr<Pipeline> pipeline = Pipeline::parseCommand(errmsg, rangeCommand, rangeCtx);
+        massert(18611, str::stream() << "can't parse the stages of a parallel scan: " << errmsg,
+                pipeline);
+
+        pipeline->addInitialSource(new DocumentSourceExtentRange(scan, _dependencies, rangeCtx));
+        pipeline->stitch();
+        return pipeline;
+    }
+
+    void DocumentSourceParallelScan::dispose() {
+        vector<std::deque<Document> >().swap(_results);
+        _serialPipeline.reset();
+        _serialScan.reset(); // lets go of the extent it was scanning
+    }
+
+    Value DocumentSourceParallelScan::serialize(bool explain) const {
+        // we never parse a DocumentSourceParallelScan, so we only serialize for explain
+        if (!explain)
+            return Value();
+
+        return Value(DOC(getSourceName() <<
+                         DOC("query" << Value(_query)
+                          << "threads" << static_cast<long long>(_nThreads)
+                          << "pipeline" << Value(_rangeStages))));
+    }
+}
@@ -73,6 +73,8 @@ namespace mongo {
          DocumentSourceGroup::createFromBson},
         {DocumentSourceLimit::limitName,
          DocumentSourceLimit::createFromBson},
+        {DocumentSourceLookup::lookupName,
+         DocumentSourceLookup::createFromBson},
         {DocumentSourceMatch::matchName,
          DocumentSourceMatch::createFromBson},
         {DocumentSourceMergeCursors::name,
@@ -211,6 +213,7 @@ namespace mongo {
         // The order in which optimizations are applied can have significant impact on the
         // efficiency of the final pipeline. Be Careful!
         Optimizations::Local::moveMatchBeforeSort(pPipeline.get());
+        Optimizations::Local::moveLimitToSort(pPipeline.get());
         Optimizations::Local::moveLimitBeforeSkip(pPipeline.get());
         Optimizations::Local::coalesceAdjacent(pPipeline.get());
         Optimizations::Local::optimizeEachDocumentSource(pPipeline.get());
@@ -239,6 +242,35 @@ namespace mongo {
         }
     }
 
+    void Pipeline::Optimizations::Local::moveLimitToSort(Pipeline* pipeline) {
+        SourceContainer& sources = pipeline->sources;
+        for (size_t i = 1; i < sources.size(); i++) {
+            DocumentSourceLimit* limit = dynamic_cast<DocumentSourceLimit*>(sources[i].get());
+            if (!limit)
+                continue;
+
+            // Look back past the projects and skips for a sort, counting what the skips drop.
+            long long skipped = 0;
+            size_t j = i;
+            while (j > 0 && (dynamic_cast<DocumentSourceProject*>(sources[j-1].get())
+                             || dynamic_cast<DocumentSourceSkip*>(sources[j-1].get()))) {
+                if (DocumentSourceSkip* skip =
+                        dynamic_cast<DocumentSourceSkip*>(sources[j-1].get())) {
+                    skipped += skip->getSkip();
+                }
+                j--;
+            }
+            if (j == i || j == 0 || !dynamic_cast<DocumentSourceSort*>(sources[j-1].get()))
+                continue;
+
+            // [$sort, $project, $skip, $limit] -> [$sort, $limit, $project, $skip]
+            intrusive_ptr<DocumentSource> moved = sources[i];
+            limit->setLimit(limit->getLimit() + skipped);
+            sources.erase(sources.begin() + i);
+            sources.insert(sources.begin() + j, moved);
+        }
+    }
+
     void Pipeline::Optimizations::Local::moveLimitBeforeSkip(Pipeline* pipeline) {
         SourceContainer& sources = pipeline->sources;
         if (sources.empty())
@@ -345,6 +377,21 @@ namespace mongo {
                 actions.addAction(ActionType::insert);
                 out->push_back(Privilege(ResourcePattern::forExactNamespace(outputNs), actions));
             }
+            else if (str::equals(stage.firstElementFieldName(), "$lookup")) {
+                // the stage itself refuses a missing or misspelled 'from' when it is parsed
+                BSONElement from = stage.firstElement();
+                if (from.type() == Object)
+                    from = from.embeddedObject()["from"];
+                if (from.type() != String)
+                    continue;
+
+                NamespaceString fromNs(db, from.str());
+                uassert(18621,
+                        mongoutils::str::stream() << "Invalid $lookup namespace, " << fromNs.ns(),
+                        fromNs.isValid());
+                out->push_back(Privilege(ResourcePattern::forExactNamespace(fromNs),
+                                         ActionType::find));
+            }
         }
     }
 
@@ -533,8 +580,20 @@ namespace mongo {
         if (explain)
             return false;
 
-        if (!sources.empty() && dynamic_cast<DocumentSourceNeedsMongod*>(sources.back().get()))
-            return false;
+        for (SourceContainer::const_iterator it = sources.begin(); it != sources.end(); ++it) {
+            if (dynamic_cast<DocumentSourceNeedsMongod*>(it->get()))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Pipeline::readsOnlyInput() const {
+        for (SourceContainer::const_iterator it = sources.begin(); it != sources.end(); ++it) {
+            if (dynamic_cast<DocumentSourceOut*>(it->get())
+                || dynamic_cast<DocumentSourceLookup*>(it->get()))
+                return false;
+        }
 
         return true;
     }
@@ -121,6 +121,9 @@ namespace mongo {
         /// Returns true if this pipeline only uses features that work in mongos.
         bool canRunInMongos() const;
 
+        /// Returns true if the results depend only on the input collection: no $out or $lookup.
+        bool readsOnlyInput() const;
+
         /**
          * Write the pipeline's operators to a vector<Value>, with the
          * explain flag true (for DocumentSource::serializeToArray()).
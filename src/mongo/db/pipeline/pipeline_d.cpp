@@ -32,11 +32,14 @@
 
 #include "mongo/client/dbclientinterface.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/db/catalog/index_catalog.h"
+#include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/pipeline/document_source.h"
 #include "mongo/db/pipeline/pipeline.h"
 #include "mongo/db/query/get_runner.h"
+#include "mongo/db/query/parallel_scan.h"
 #include "mongo/db/query/query_planner.h"
 #include "mongo/s/d_logic.h"
 
@@ -61,6 +64,132 @@ namespace {
     private:
         DBDirectClient _client;
     };
+
+    /**
+     * Returns true if an index of 'ns' on any field of 'sortPattern' is multikey.  An array
+     * sorts in such an index by each of its elements, so documents with equal arrays need not
+     * be returned next to each other.
+     */
+    bool hasMultikeyIndexOn(const NamespaceString& ns, const BSONObj& sortPattern) {
+        Collection* collection = cc().database()->getCollection(ns);
+        if (!collection)
+            return false;
+
+        IndexCatalog::IndexIterator ii = collection->getIndexCatalog()->getIndexIterator(false);
+        while (ii.more()) {
+            const IndexDescriptor* desc = ii.next();
+            if (!desc->isMultikey())
+                continue;
+
+            BSONForEach(field, sortPattern) {
+                if (desc->keyPattern().hasField(field.fieldName()))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Returns true if a document must have the field 'e' tests to match it.  Only tests no
+     * missing field passes are counted: $exists:true, and equality, comparison or $in with
+     * values other than null (which a missing field equals) and MinKey and MaxKey.
+     */
+    bool requiresField(const BSONElement& e) {
+        if (e.type() != Object || e.embeddedObject().firstElementFieldName()[0] != '$') {
+            return e.type() != jstNULL && e.type() != Undefined
+                && e.type() != MinKey && e.type() != MaxKey;
+        }
+
+        BSONForEach(op, e.embeddedObject()) {
+            const StringData name = op.fieldNameStringData();
+            if (name == "$exists") {
+                if (op.trueValue())
+                    return true;
+            }
+            else if (name == "$gt" || name == "$gte" || name == "$lt" || name == "$lte") {
+                if (op.type() != jstNULL && op.type() != Undefined
+                        && op.type() != MinKey && op.type() != MaxKey)
+                    return true;
+            }
+            else if (name == "$in" && op.type() == Array && !op.embeddedObject().isEmpty()) {
+                bool allRequire = true;
+                BSONForEach(value, op.embeddedObject()) {
+                    allRequire = allRequire && value.type() != jstNULL
+                                            && value.type() != Undefined
+                                            && value.type() != MinKey
+                                            && value.type() != MaxKey;
+                }
+                if (allRequire)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    /** Adds the fields a document must have to match 'query' to 'fields'. */
+    void addRequiredFields(const BSONObj& query, set<string>* fields) {
+        BSONForEach(e, query) {
+            const StringData name = e.fieldNameStringData();
+            if (name == "$and" && e.type() == Array) {
+                BSONForEach(clause, e.embeddedObject()) {
+                    if (clause.type() == Object)
+                        addRequiredFields(clause.embeddedObject(), fields);
+                }
+            }
+            else if (name[0] != '$' && requiresField(e)) {
+                fields->insert(name.toString());
+            }
+        }
+    }
+
+    /**
+     * Returns true if every document matching 'query' has each of 'fields', or a field under
+     * it.  An index key holds null for a missing field, so a covered projection can only be used
+     * for fields known to be there.
+     */
+    bool queryRequiresFields(const BSONObj& query, const set<string>& fields) {
+        set<string> required;
+        addRequiredFields(query, &required);
+
+        for (set<string>::const_iterator it = fields.begin(); it != fields.end(); ++it) {
+            if (*it == "_id")
+                continue; // every document has one
+
+            if (required.count(*it))
+                continue;
+
+            // the fields under it, if any, sort first from its prefix
+            const string prefix = *it + '.';
+            set<string>::const_iterator r = required.lower_bound(prefix);
+            if (r == required.end() || !str::startsWith(*r, prefix))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Returns a Runner that answers 'queryObj', in 'sortObj' order, from the keys of an index
+     * that holds every field of 'projection', or NULL if there is none.
+     */
+    Runner* coveredRunner(const NamespaceString& ns,
+                          const BSONObj& queryObj,
+                          const BSONObj& sortObj,
+                          const BSONObj& projection,
+                          size_t runnerOptions) {
+        if (projection.isEmpty())
+            return NULL;
+
+        CanonicalQuery* cq;
+        if (!CanonicalQuery::canonicalize(ns, queryObj, sortObj, projection, &cq).isOK())
+            return NULL;
+
+        Runner* rawRunner;
+        runnerOptions |= QueryPlannerParams::NO_UNCOVERED_PROJECTIONS;
+        if (!getRunner(cq, &rawRunner, runnerOptions).isOK())
+            return NULL;
+
+        return rawRunner;
+    }
 }
 
     boost::shared_ptr<Runner> PipelineD::prepareCursorSource(
@@ -107,10 +236,21 @@ namespace {
         const DepsTracker deps = pPipeline->getDependencies(queryObj);
 
         // Passing query an empty projection since it is faster to use ParsedDeps::extractFields().
-        // This will need to change to support covering indexes (SERVER-12015). There is an
-        // exception for textScore since that can only be retrieved by a query projection.
+        // There is an exception for textScore since that can only be retrieved by a query
+        // projection.
         const BSONObj projectionForQuery = deps.needTextScore ? deps.toProjection() : BSONObj();
 
+        // If the pipeline needs only some fields, an index holding all of them can answer the
+        // query without fetching documents. The query system only plans that way when asked for
+        // the projection. Shard filtering always fetches, and so does a field the query doesn't
+        // require, which the index can't tell apart from null.
+        const BSONObj coveredProjection =
+            deps.needWholeDocument || deps.needTextScore || deps.fields.empty()
+                    || shardingState.needCollectionMetadata(fullName)
+                    || !queryRequiresFields(queryObj, deps.fields)
+                ? BSONObj()
+                : deps.toProjection();
+
         /*
           Look for an initial sort; we'll try to add this to the
           Cursor we create.  If we're successful in doing that (further down),
@@ -128,6 +268,50 @@ namespace {
             }
         }
 
+        // A $group that reads the whole collection can have several threads each run it, and the
+        // stages before it, over a range of the collection, with a $group merging their results
+        // as it would the results of shards.  The stages before it must work on one document at
+        // a time.  A sharded collection is left to the Runner, which filters out orphans.
+        if (!sortStage && !deps.needTextScore && !shardingState.needCollectionMetadata(fullName)) {
+            size_t nPrefix = 0;
+            while (nPrefix < sources.size()
+                    && (dynamic_cast<DocumentSourceMatch*>(sources[nPrefix].get())
+                        || dynamic_cast<DocumentSourceProject*>(sources[nPrefix].get())
+                        || dynamic_cast<DocumentSourceRedact*>(sources[nPrefix].get())
+                        || dynamic_cast<DocumentSourceUnwind*>(sources[nPrefix].get()))) {
+                nPrefix++;
+            }
+
+            intrusive_ptr<DocumentSourceGroup> group;
+            if (nPrefix < sources.size())
+                group = dynamic_cast<DocumentSourceGroup*>(sources[nPrefix].get());
+
+            size_t nThreads = 0;
+            CanonicalQuery* cq;
+            if (group && CanonicalQuery::canonicalize(fullName, queryObj, &cq).isOK()) {
+                scoped_ptr<CanonicalQuery> scanQuery(cq);
+                Database* db = cc().database();
+                nThreads = ParallelScan::threadsFor(db, db->getCollection(fullName), cq);
+            }
+
+            if (nThreads > 1) {
+                vector<Value> rangeStages;
+                for (size_t i = 0; i < nPrefix; i++)
+                    sources[i]->serializeToArray(rangeStages);
+                group->getShardSource()->serializeToArray(rangeStages);
+
+                sources.erase(sources.begin(), sources.begin() + nPrefix + 1);
+                sources.push_front(group->getMergeSource());
+
+                pPipeline->addInitialSource(DocumentSourceParallelScan::create(queryObj,
+                                                                               rangeStages,
+                                                                               deps.toParsedDeps(),
+                                                                               nThreads,
+                                                                               pExpCtx));
+                return boost::shared_ptr<Runner>(); // the scan threads read the collection
+            }
+        }
+
         // Create the Runner.
         //
         // If we try to create a Runner that includes both the match and the
@@ -143,6 +327,9 @@ namespace {
         // If we are able to incorporate the sort into the Runner, remove it
         // from the head of the pipeline.
         //
+        // Each of these is first tried with a covered projection, if there is one, so that a
+        // Runner that can read just index keys does.
+        //
         // LATER - we should be able to find this out before we create the
         // cursor.  Either way, we can then apply other optimizations there
         // are tickets for, such as SERVER-4507.
@@ -153,17 +340,24 @@ namespace {
         boost::shared_ptr<Runner> runner;
         bool sortInRunner = false;
         if (sortStage) {
-            CanonicalQuery* cq;
-            Status status =
-                CanonicalQuery::canonicalize(pExpCtx->ns,
-                                             queryObj,
-                                             sortObj,
-                                             projectionForQuery,
-                                             &cq);
-            Runner* rawRunner;
-            if (status.isOK() && getRunner(cq, &rawRunner, runnerOptions).isOK()) {
+            runner.reset(coveredRunner(pExpCtx->ns, queryObj, sortObj,
+                                       coveredProjection, runnerOptions));
+
+            if (!runner.get()) {
+                CanonicalQuery* cq;
+                Status status =
+                    CanonicalQuery::canonicalize(pExpCtx->ns,
+                                                 queryObj,
+                                                 sortObj,
+                                                 projectionForQuery,
+                                                 &cq);
+                Runner* rawRunner;
+                if (status.isOK() && getRunner(cq, &rawRunner, runnerOptions).isOK())
+                    runner.reset(rawRunner);
+            }
+
+            if (runner.get()) {
                 // success: The Runner will handle sorting for us using an index.
-                runner.reset(rawRunner);
                 sortInRunner = true;
 
                 sources.pop_front();
@@ -174,6 +368,12 @@ namespace {
             }
         }
 
+        if (!runner.get()) {
+            const BSONObj noSort;
+            runner.reset(coveredRunner(pExpCtx->ns, queryObj, noSort,
+                                       coveredProjection, runnerOptions));
+        }
+
         if (!runner.get()) {
             const BSONObj noSort;
             CanonicalQuery* cq;
@@ -209,6 +409,21 @@ namespace {
             sources.pop_front();
         }
 
+        // If the index that sorts the Runner's output brings each group's documents together, a
+        // $group that follows can return groups as it goes rather than hold them all.  A compound
+        // _id keeps a missing field missing, where the index sorts it as null, so then the query
+        // must require each of the _id's fields.
+        if (sortInRunner && !sources.empty()) {
+            DocumentSourceGroup* group = dynamic_cast<DocumentSourceGroup*>(sources.front().get());
+            set<string> idFields;
+            if (group
+                    && group->isGroupedBySort(sortObj, &idFields)
+                    && !hasMultikeyIndexOn(pExpCtx->ns, sortObj)
+                    && (idFields.size() == 1 || queryRequiresFields(queryObj, idFields))) {
+                group->setStreaming();
+            }
+        }
+
         pPipeline->addInitialSource(pSource);
 
         return runner;
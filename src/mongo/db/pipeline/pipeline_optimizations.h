@@ -52,6 +52,15 @@ namespace mongo {
          */
         static void moveMatchBeforeSort(Pipeline* pipeline);
 
+        /**
+         * Moves a limit back to the sort it follows if only projects and skips are between them.
+         *
+         * Projects neither drop nor add documents, so the limit can be applied before them,
+         * increased by any skips it passes. Once next to the sort, coalesceAdjacent() folds it
+         * in, so the sort only ever keeps the top documents rather than sorting all of them.
+         */
+        static void moveLimitToSort(Pipeline* pipeline);
+
         /**
          * Moves limits before any adjacent skip phases.
          *
@@ -158,6 +158,7 @@ namespace mongo {
 
         case Array: {
             intrusive_ptr<RCVector> vec (new RCVector);
+            vec->vec.reserve(elem.embeddedObject().nFields());
             BSONForEach(sub, elem.embeddedObject()) {
                 vec->vec.push_back(Value(sub));
             }
@@ -218,6 +219,7 @@ namespace mongo {
 
     Value::Value(const BSONArray& arr) : _storage(Array) {
         intrusive_ptr<RCVector> vec (new RCVector);
+        vec->vec.reserve(arr.nFields());
         BSONForEach(sub, arr) {
             vec->vec.push_back(Value(sub));
         }
@@ -843,6 +845,8 @@ namespace mongo {
             for(size_t i = 0; i < n; ++i) {
                 size += getArray()[i].getApproximateSize();
             }
+            // space the vector has allocated but not yet used
+            size += (getArray().capacity() - n) * sizeof(Value);
             return size;
         }
 
@@ -33,9 +33,12 @@
 #include <time.h>
 #include <zmq.hpp>
 
+#include "mongo/db/commands/server_status.h"
 #include "mongo/db/pubsub_sendsock.h"
+#include "mongo/db/pubsub_stats.h"
 #include "mongo/db/server_options_helpers.h"
 #include "mongo/db/server_parameters.h"
+#include "mongo/util/net/blocking_section.h"
 
 namespace mongo {
 
@@ -49,13 +52,22 @@ namespace mongo {
     SubscriptionMessage::SubscriptionMessage(SubscriptionId _subscriptionId,
                                              std::string _channel,
                                              BSONObj _message,
-                                             unsigned long long _timestamp) {
+                                             unsigned long long _timestamp,
+                                             OID _origin,
+                                             unsigned long long _sequence,
+                                             unsigned long long _recvOrder) {
         subscriptionId = _subscriptionId;
         channel = _channel;
         message = _message;
         timestamp = _timestamp;
+        origin = _origin;
+        sequence = _sequence;
+        recvOrder = _recvOrder;
     }
 
+    // messages on the same subscription and channel are returned in the order they were
+    // received, which keeps messages from each origin in sequence order regardless of the
+    // clocks on the publishing nodes
     bool operator<(const SubscriptionMessage& m1, const SubscriptionMessage& m2) {
         if (m1.subscriptionId < m2.subscriptionId)
             return true;
@@ -63,7 +75,7 @@ namespace mongo {
             return true;
         if (m1.subscriptionId == m2.subscriptionId &&
             m1.channel == m2.channel &&
-            m1.timestamp > m2.timestamp)
+            m1.recvOrder > m2.recvOrder)
             return true;
         return false;
     }
@@ -153,10 +165,24 @@ namespace mongo {
                             catch (zmq::error_t& e) {
                                 log() << "Error closing zmq socket." << causedBy(e);
                             }
+                            // lets any poll group holding this subscription drop it
+                            s->shouldUnsub = 1;
                             subscriptions.erase(it);
                         }
                 }
+
+                for (PollGroupMap::iterator it = pollGroups.begin(); it != pollGroups.end();) {
+                    shared_ptr<PollGroup> g = it->second;
+                    if (g->polledRecently || g->inUse) {
+                        g->polledRecently = 0;
+                        it++;
+                    }
+                    else {
+                        pollGroups.erase(it++);
+                    }
+                }
             }
+            PubSubSendSocket::pruneChannelSequences();
             sleepmillis(maxTimeoutMillis);
         }
     }
@@ -174,6 +200,7 @@ namespace mongo {
      */
 
     PubSub::SubscriptionMap PubSub::subscriptions;
+    PubSub::PollGroupMap PubSub::pollGroups;
 
     const long PubSub::maxPollInterval = 1000; // milliseconds
 
@@ -203,13 +230,20 @@ namespace mongo {
 
         shared_ptr<SubscriptionInfo> s(new SubscriptionInfo());
         s->sock.reset(subSocket);
+        s->channel = channel;
+        s->messagesDelivered = 0;
+        s->messagesFiltered = 0;
+        s->lastPollMillis = curTimeMillis64();
+        s->lastPollBacklog = 0;
+        s->lastPollLagMicros = 0;
+        s->lastSequencesPrunedMillis = curTimeMillis64();
         s->inUse = 0;
         s->shouldUnsub = 0;
         s->polledRecently = 1;
 
         s->filter.reset(NULL);
         if (!filter.isEmpty())
-            s->filter.reset(new Matcher2(filter.getOwned()));
+            s->filter.reset(new CompiledMatcher(filter.getOwned()));
 
         s->projection.reset(NULL);
         if (!projection.isEmpty()){
@@ -227,14 +261,56 @@ namespace mongo {
             std::set<SubscriptionId>& subscriptionIds,
             long timeout, long long& millisPolled,
             bool& pollAgain,
-            std::map<SubscriptionId, std::string>& errors) {
+            std::map<SubscriptionId, std::string>& errors,
+            std::vector<SequenceGap>& gaps) {
+
+        // a single id may refer to a poll group, in which case the prebuilt
+        // subscriptions and poll items of the group are used directly
+        if (subscriptionIds.size() == 1) {
+            SubscriptionId pollGroupId = *subscriptionIds.begin();
+            std::string errmsg;
+            shared_ptr<PollGroup> g = PubSub::checkoutPollGroup(pollGroupId, errmsg, errors);
+
+            if (!errmsg.empty()) {
+                errors.insert(std::make_pair(pollGroupId, errmsg));
+                return std::priority_queue<SubscriptionMessage>();
+            }
+
+            if (g) {
+                std::priority_queue<SubscriptionMessage> messages;
+                try {
+                    messages = PubSub::pollSubscriptions(g->items, g->subs, timeout,
+                                                         millisPolled, pollAgain, errors, gaps);
+                }
+                catch (DBException&) {
+                    PubSub::checkinPollGroup(g);
+                    throw;
+                }
+                PubSub::checkinPollGroup(g);
+                return messages;
+            }
+        }
 
-        std::priority_queue<SubscriptionMessage> messages;
         SubscriptionVector subs;
         std::vector<zmq::pollitem_t> items;
 
         PubSub::getSubscriptions(subscriptionIds, items, subs, errors);
 
+        return PubSub::pollSubscriptions(items, subs, timeout, millisPolled, pollAgain,
+                                         errors, gaps);
+    }
+
+    std::priority_queue<SubscriptionMessage> PubSub::pollSubscriptions(
+            std::vector<zmq::pollitem_t>& items,
+            SubscriptionVector& subs,
+            long timeout,
+            long long& millisPolled,
+            bool& pollAgain,
+            std::map<SubscriptionId, std::string>& errors,
+            std::vector<SequenceGap>& gaps) {
+
+        std::priority_queue<SubscriptionMessage> messages;
+
         // if there are no valid subscriptions to check, return. there may have
         // been errors during getSubscriptions which will be returned.
         if (items.size() == 0)
@@ -247,8 +323,18 @@ namespace mongo {
             timeout = maxTimeoutMillis;
         long long pollRuntime = 0LL;
         long currPollInterval = std::min(PubSub::maxPollInterval, timeout);
+        bool endedEarly = false;
 
         try {
+            BlockingSection blocking;
+
+            // with no worker to spare, poll just once and have the client poll again
+            if (blocking.shouldEndEarly()) {
+                endedEarly = timeout > 1;
+                timeout = std::min(timeout, 1L);
+                currPollInterval = timeout;
+            }
+
             // while no messages have been received on any of the subscriptions,
             // continue polling coming up for air in intervals to check if any of the
             // subscriptions have been canceled
@@ -295,7 +381,9 @@ namespace mongo {
 
         // if we reach this point, then we know at least 1 message
         // has been received on some subscription
-        messages = PubSub::recvMessages(subs, errors);
+        messages = PubSub::recvMessages(subs, errors, gaps);
+        if (endedEarly && messages.empty())
+            pollAgain = true;
 
         millisPolled = pollRuntime;
         return messages;
@@ -357,19 +445,28 @@ namespace mongo {
     }
 
     void PubSub::checkinSocket(shared_ptr<SubscriptionInfo> s) {
+        s->lastPollMillis = curTimeMillis64();
+        // the flags share a word with shouldUnsub, which other threads set under the lock
+        SimpleMutex::scoped_lock lk(mapMutex);
         s->polledRecently = 1;
         s->inUse = 0;
     }
 
     std::priority_queue<SubscriptionMessage> PubSub::recvMessages(
                                 SubscriptionVector& subs,
-                                std::map<SubscriptionId, std::string>& errors) {
+                                std::map<SubscriptionId, std::string>& errors,
+                                std::vector<SequenceGap>& gaps) {
 
         std::priority_queue<SubscriptionMessage> outbox;
+        unsigned long long now = curTimeMicros64();
+        unsigned long long recvOrder = 0;
+        PubSubStats::PollCounts pollCounts;
 
         for (SubscriptionVector::iterator subIt = subs.begin(); subIt != subs.end(); subIt++) {
             SubscriptionId subscriptionId = subIt->first;
             shared_ptr<SubscriptionInfo> s = subIt->second;
+            long long backlog = 0;
+            long long lagMicros = 0;
 
             try {
                 zmq::message_t msg;
@@ -389,15 +486,56 @@ namespace mongo {
                     unsigned long long timestamp = *((unsigned long long*)(msg.data()));
                     msg.rebuild();
 
+                    // receive origin
+                    s->sock->recv(&msg);
+                    OID origin(*static_cast<const unsigned char(*)[OID::kOIDSize]>(msg.data()));
+                    msg.rebuild();
+
+                    // receive sequence number
+                    s->sock->recv(&msg);
+                    unsigned long long sequence = *((unsigned long long*)(msg.data()));
+                    msg.rebuild();
+
+                    // check for messages from this origin that never arrived. the first
+                    // message seen from an origin can't be checked, since the subscription
+                    // may have started after earlier messages were published.
+                    SubscriptionInfo::LastSequence& last =
+                        s->lastSequences[std::make_pair(origin, channel)];
+                    last.receivedRecently = true;
+                    unsigned long long& lastSequence = last.sequence;
+                    if (lastSequence != 0 && sequence > lastSequence + 1) {
+                        SequenceGap gap;
+                        gap.subscriptionId = subscriptionId;
+                        gap.channel = channel;
+                        gap.origin = origin;
+                        gap.first = lastSequence + 1;
+                        gap.last = sequence - 1;
+                        gaps.push_back(gap);
+                        pollCounts.recordMissed(channel, gap.last - gap.first + 1);
+                    }
+                    lastSequence = sequence;
+
+                    // messages are read oldest first, so the first one carries the lag
+                    long long latencyMicros = static_cast<long long>(now - timestamp);
+                    if (backlog++ == 0)
+                        lagMicros = latencyMicros;
+
                     // if subscription has filter, continue only if message matches filter
-                    if (s->filter && !s->filter->matches(message))
+                    if (s->filter && !s->filter->matches(message)) {
+                        s->messagesFiltered++;
+                        pollCounts.recordFiltered(channel);
                         continue;
+                    }
+
+                    s->messagesDelivered++;
+                    pollCounts.recordDelivery(channel, latencyMicros);
 
                     // if subscription has projection, apply projection to message
                     if (s->projection)
                         message = s->projection->transform(message);
 
-                    SubscriptionMessage m(subscriptionId, channel, message, timestamp);
+                    SubscriptionMessage m(subscriptionId, channel, message, timestamp,
+                                          origin, sequence, recvOrder++);
                     outbox.push(m);
                 }
             }
@@ -406,6 +544,25 @@ namespace mongo {
                                              "Error receiving messages from zmq socket."));
             }
 
+            s->lastPollBacklog = backlog;
+            s->lastPollLagMicros = lagMicros;
+
+            // forget origins and channels this subscription no longer hears from
+            long long nowMillis = static_cast<long long>(now / 1000);
+            if (nowMillis - s->lastSequencesPrunedMillis >= maxTimeoutMillis) {
+                SubscriptionInfo::SequenceMap::iterator it = s->lastSequences.begin();
+                while (it != s->lastSequences.end()) {
+                    if (it->second.receivedRecently) {
+                        it->second.receivedRecently = false;
+                        ++it;
+                    }
+                    else {
+                        s->lastSequences.erase(it++);
+                    }
+                }
+                s->lastSequencesPrunedMillis = nowMillis;
+            }
+
             // done receiving from ZMQ socket
             PubSub::checkinSocket(s);
         }
@@ -437,8 +594,154 @@ namespace mongo {
             catch (zmq::error_t& e) {
                 errors.insert(std::make_pair(subscriptionId, "Error closing zmq socket."));
             }
+            // lets any poll group holding this subscription drop it
+            s->shouldUnsub = 1;
             subscriptions.erase(it);
         }
     }
 
+    SubscriptionId PubSub::createPollGroup(std::set<SubscriptionId>& subscriptionIds,
+                                           std::map<SubscriptionId, std::string>& errors) {
+        SubscriptionId pollGroupId;
+        pollGroupId.init();
+
+        shared_ptr<PollGroup> g(new PollGroup());
+        g->inUse = 0;
+        g->polledRecently = 1;
+
+        SimpleMutex::scoped_lock lk(mapMutex);
+        for (std::set<SubscriptionId>::iterator it = subscriptionIds.begin();
+             it != subscriptionIds.end();
+             it++) {
+                SubscriptionMap::iterator subIt = subscriptions.find(*it);
+                if (subIt == subscriptions.end() || subIt->second->shouldUnsub) {
+                    errors.insert(std::make_pair(*it, "Subscription not found."));
+                    continue;
+                }
+
+                shared_ptr<SubscriptionInfo> s = subIt->second;
+                zmq::pollitem_t pollItem = { *(s->sock), 0, ZMQ_POLLIN, 0 };
+                g->items.push_back(pollItem);
+                g->subs.push_back(std::make_pair(*it, s));
+        }
+
+        pollGroups.insert(std::make_pair(pollGroupId, g));
+
+        return pollGroupId;
+    }
+
+    void PubSub::destroyPollGroup(const SubscriptionId& pollGroupId,
+                                  std::map<SubscriptionId, std::string>& errors) {
+        SimpleMutex::scoped_lock lk(mapMutex);
+        PollGroupMap::iterator it = pollGroups.find(pollGroupId);
+
+        if (it == pollGroups.end()) {
+            errors.insert(std::make_pair(pollGroupId, "Poll group not found."));
+            return;
+        }
+
+        // an active poll on the group holds its own reference to the group
+        // and checks its members back in when it finishes
+        pollGroups.erase(it);
+    }
+
+    shared_ptr<PubSub::PollGroup> PubSub::checkoutPollGroup(
+                                        const SubscriptionId& pollGroupId,
+                                        std::string& errmsg,
+                                        std::map<SubscriptionId, std::string>& errors) {
+        SimpleMutex::scoped_lock lk(mapMutex);
+        PollGroupMap::iterator groupIt = pollGroups.find(pollGroupId);
+
+        if (groupIt == pollGroups.end())
+            return shared_ptr<PollGroup>();
+
+        shared_ptr<PollGroup> g = groupIt->second;
+        if (g->inUse) {
+            errmsg = "Poll currently active.";
+            return shared_ptr<PollGroup>();
+        }
+
+        // drop members that were unsubscribed since the last poll on this group
+        for (size_t i = 0; i < g->subs.size(); i++) {
+            if (g->subs[i].second->shouldUnsub) {
+                errors.insert(std::make_pair(g->subs[i].first, "Subscription not found."));
+                g->items.erase(g->items.begin() + i);
+                g->subs.erase(g->subs.begin() + i);
+                i--;
+            }
+        }
+
+        // members checked out by another poll can't be polled on here
+        for (size_t i = 0; i < g->subs.size(); i++) {
+            if (g->subs[i].second->inUse) {
+                errmsg = "Poll currently active.";
+                return shared_ptr<PollGroup>();
+            }
+        }
+
+        for (size_t i = 0; i < g->subs.size(); i++) {
+            g->subs[i].second->inUse = 1;
+        }
+        g->inUse = 1;
+        return g;
+    }
+
+    void PubSub::checkinPollGroup(shared_ptr<PollGroup> g) {
+        // the cleanup thread clears polledRecently under the lock, in the same word
+        SimpleMutex::scoped_lock lk(mapMutex);
+        g->polledRecently = 1;
+        g->inUse = 0;
+    }
+
+    void PubSub::appendStats(BSONObjBuilder& b, bool includeSubscriptions) {
+        {
+            SimpleMutex::scoped_lock lk(mapMutex);
+            b.appendNumber("numSubscriptions", static_cast<long long>(subscriptions.size()));
+            b.appendNumber("numPollGroups", static_cast<long long>(pollGroups.size()));
+
+            if (includeSubscriptions) {
+                long long now = curTimeMillis64();
+                BSONObjBuilder subsBuilder(b.subobjStart("subscriptions"));
+                for (SubscriptionMap::const_iterator it = subscriptions.begin();
+                     it != subscriptions.end();
+                     it++) {
+                        const shared_ptr<SubscriptionInfo>& s = it->second;
+                        BSONObjBuilder subBuilder(subsBuilder.subobjStart(it->first.toString()));
+                        subBuilder.append("channel", s->channel);
+                        subBuilder.appendBool("polling", s->inUse);
+                        subBuilder.appendNumber("millisSinceLastPoll", now - s->lastPollMillis);
+                        subBuilder.appendNumber("delivered", s->messagesDelivered);
+                        subBuilder.appendNumber("filtered", s->messagesFiltered);
+                        subBuilder.appendNumber("lastPollBacklog", s->lastPollBacklog);
+                        subBuilder.appendNumber("lastPollLagMicros", s->lastPollLagMicros);
+                        subBuilder.done();
+                }
+                subsBuilder.done();
+            }
+        }
+
+        BSONArrayBuilder channelsBuilder(b.subarrayStart("channels"));
+        PubSubStats::appendChannelStats(channelsBuilder);
+        channelsBuilder.done();
+    }
+
+    /**
+     * serverStatus section for pubsub. Use { pubsub: { subscriptions: 1 } } to include
+     * stats for each subscription.
+     */
+    class PubSubServerStatusSection : public ServerStatusSection {
+    public:
+        PubSubServerStatusSection() : ServerStatusSection("pubsub") {}
+        virtual bool includeByDefault() const { return pubsubEnabled; }
+
+        BSONObj generateSection(const BSONElement& configElement) const {
+            bool includeSubscriptions = configElement.type() == Object &&
+                                        configElement.Obj()["subscriptions"].trueValue();
+            BSONObjBuilder b;
+            PubSub::appendStats(b, includeSubscriptions);
+            return b.obj();
+        }
+
+    } pubSubServerStatusSection;
+
 }  // namespace mongo
@@ -34,7 +34,7 @@
 #include "mongo/bson/oid.h"
 #include "mongo/util/concurrency/mutex.h"
 #include "mongo/util/net/hostandport.h"
-#include "mongo/db/matcher/matcher.h"
+#include "mongo/db/matcher/compiled_matcher.h"
 #include "mongo/db/projection.h"
 
 namespace mongo {
@@ -52,16 +52,40 @@ namespace mongo {
         SubscriptionId subscriptionId;
         std::string channel;
         BSONObj message;
+
+        // time of publication on the publishing node. only comparable between messages
+        // from the same origin, since clocks across nodes may be skewed.
         unsigned long long timestamp;
 
+        // process that published the message and its sequence number on the channel
+        OID origin;
+        unsigned long long sequence;
+
+        // order in which the message was received by this node. messages from the same
+        // origin are always received in sequence order.
+        unsigned long long recvOrder;
+
         SubscriptionMessage(SubscriptionId _subscriptionId,
                             std::string _channel,
                             BSONObj _message,
-                            unsigned long long _timestamp);
+                            unsigned long long _timestamp,
+                            OID _origin,
+                            unsigned long long _sequence,
+                            unsigned long long _recvOrder);
 
         friend bool operator<(const SubscriptionMessage& m1, const SubscriptionMessage& m2);
     };
 
+    // Messages from origin on channel with sequence numbers first through last (inclusive)
+    // were never received by a subscription.
+    struct SequenceGap {
+        SubscriptionId subscriptionId;
+        std::string channel;
+        OID origin;
+        unsigned long long first;
+        unsigned long long last;
+    };
+
     class PubSub {
     public:
 
@@ -74,7 +98,8 @@ namespace mongo {
                 long timeout,
                 long long& millisPolled,
                 bool& pollAgain,
-                std::map<SubscriptionId, std::string>& errors);
+                std::map<SubscriptionId, std::string>& errors,
+                std::vector<SequenceGap>& gaps);
         // force is an option used internally if a poll is interrupted by an unsubscribe to 
         // allow the unsubscribe to happen without having to check the subscription in and
         // back out. it is always false if this method is called from the unsubscribe command.
@@ -82,6 +107,15 @@ namespace mongo {
                                 std::map<SubscriptionId, std::string>& errors,
                                 bool force=false);
 
+        // Poll groups bind a set of subscriptions once so that repeated polls on the same
+        // subscriptions don't have to look up each one and rebuild the zmq poll items.
+        // Polling on the returned id (through poll() above) polls on every member.
+        // Subscriptions that can't be found are left out of the group and reported in errors.
+        static SubscriptionId createPollGroup(std::set<SubscriptionId>& subscriptionIds,
+                                              std::map<SubscriptionId, std::string>& errors);
+        static void destroyPollGroup(const SubscriptionId& pollGroupId,
+                                     std::map<SubscriptionId, std::string>& errors);
+
         // to be included in all files using the client's sub sockets
         static const char* const kIntPubSubEndpoint;
 
@@ -96,12 +130,19 @@ namespace mongo {
         static zmq::socket_t intPubSocket;
         static zmq::socket_t* extRecvSocket;
 
+        // appends the pubsub serverStatus section. per-subscription stats are only
+        // included if includeSubscriptions is set, since there can be many subscriptions.
+        static void appendStats(BSONObjBuilder& b, bool includeSubscriptions);
+
     private:
 
         // contains information about a single subscription
         struct SubscriptionInfo {
             scoped_ptr<zmq::socket_t> sock;
 
+            // channel (prefix) subscribed to, for reporting in serverStatus
+            std::string channel;
+
             // If currently polling, all other polls return error. Set in checkoutSocket
             // (which locks the map of all subscriptions) to ensure that sockets are only
             // used by one thread at a time.
@@ -117,10 +158,54 @@ namespace mongo {
             int polledRecently : 1;
 
             // Only return documents for this subscription that match this filter
-            scoped_ptr<Matcher2> filter;
+            scoped_ptr<CompiledMatcher> filter;
 
             // Only return the fields in each document that match the projection
             scoped_ptr<Projection> projection;
+
+            // last sequence number received from each origin on each channel, used to
+            // detect messages that were lost before reaching this subscription. Entries not
+            // received on for a cleanup period are dropped by the next poll after it, at
+            // lastSequencesPrunedMillis.
+            struct LastSequence {
+                LastSequence() : sequence(0), receivedRecently(false) {}
+
+                unsigned long long sequence;
+                bool receivedRecently;
+            };
+            typedef std::map<std::pair<OID, std::string>, LastSequence> SequenceMap;
+            SequenceMap lastSequences;
+            long long lastSequencesPrunedMillis;
+
+            // Delivery stats for serverStatus. Only updated while the subscription is
+            // checked out, so they are read without synchronization when reported.
+            long long messagesDelivered;
+            long long messagesFiltered;
+            long long lastPollMillis;
+
+            // number of messages read from the socket by the last poll, and the age of the
+            // oldest of them. a consumer that keeps falling behind shows large values here.
+            long long lastPollBacklog;
+            long long lastPollLagMicros;
+        };
+
+        typedef std::vector<std::pair<SubscriptionId,
+                                      shared_ptr<SubscriptionInfo> > > SubscriptionVector;
+
+        // contains a prebuilt set of subscriptions to poll on together
+        struct PollGroup {
+            // If currently polling, all other polls on this group return error. Members are
+            // checked out along with the group, so they cannot be polled individually either.
+            // Like the flags of SubscriptionInfo, only written while holding mapMutex.
+            int inUse : 1;
+
+            // Same as in SubscriptionInfo, used to clean up abandoned poll groups.
+            int polledRecently : 1;
+
+            // subs and items have corresponding info at the same indexes. Members that are
+            // unsubscribed are removed from both the next time the group is polled.
+            SubscriptionVector subs;
+            std::vector<zmq::pollitem_t> items;
         };
 
         // max poll length so we can check if unsubscribe has been called
@@ -130,13 +215,16 @@ namespace mongo {
         typedef std::map<SubscriptionId, shared_ptr<SubscriptionInfo> > SubscriptionMap;
         static SubscriptionMap subscriptions;
 
-        // for locking around the subscriptions map in subscribe, poll, and unsubscribe
+        // data structure mapping poll group ids to their prebuilt poll groups
+        typedef std::map<SubscriptionId, shared_ptr<PollGroup> > PollGroupMap;
+        static PollGroupMap pollGroups;
+
+        // for locking around the subscriptions and poll groups maps in subscribe, poll,
+        // unsubscribe and the poll group methods
         static SimpleMutex mapMutex;
 
         // Helper method to end all polls on subscriptions passed in. This is used in the case
         // that poll() gets cut off by an error or by hitting the max poll timeout.
-        typedef std::vector<std::pair<SubscriptionId,
-                                      shared_ptr<SubscriptionInfo> > > SubscriptionVector;
         static void endCurrentPolls(SubscriptionVector& subs);
 
         // Gets the SubscriptionInfo object for each SubscriptionId passed in. Fills in the
@@ -159,11 +247,35 @@ namespace mongo {
                                                            std::string& errmsg);
         static void checkinSocket(shared_ptr<SubscriptionInfo> s);
 
+        // Checks out a poll group and all of its members while taking the map lock once.
+        // Members that have been unsubscribed are dropped from the group and reported in
+        // errors. Returns NULL if pollGroupId is not a poll group, or sets errmsg and returns
+        // NULL if the group is already being polled.
+        static shared_ptr<PollGroup> checkoutPollGroup(const SubscriptionId& pollGroupId,
+                                                       std::string& errmsg,
+                                                       std::map<SubscriptionId,
+                                                                std::string>& errors);
+        static void checkinPollGroup(shared_ptr<PollGroup> g);
+
+        // Polls on the checked out subscriptions in subs until a message arrives or the
+        // timeout passes. Shared by polls on lists of subscriptions and on poll groups.
+        // Subscriptions interrupted by unsubscribe are removed from items and subs.
+        static std::priority_queue<SubscriptionMessage> pollSubscriptions(
+                std::vector<zmq::pollitem_t>& items,
+                SubscriptionVector& subs,
+                long timeout,
+                long long& millisPolled,
+                bool& pollAgain,
+                std::map<SubscriptionId, std::string>& errors,
+                std::vector<SequenceGap>& gaps);
+
         // This method receives messages on all subscriptions passed in. In the event of an error,
         // this method inserts an error message in the errors map for the given SubscriptionId.
+        // Any gaps in the sequence numbers received on a subscription are added to gaps.
         static std::priority_queue<SubscriptionMessage> recvMessages(
                 SubscriptionVector& subs,
-                std::map<SubscriptionId, std::string>& errors);
+                std::map<SubscriptionId, std::string>& errors,
+                std::vector<SequenceGap>& gaps);
     };
 
 }  // namespace mongo
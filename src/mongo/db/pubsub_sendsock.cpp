@@ -33,7 +33,9 @@
 #include <zmq.hpp>
 
 #include "mongo/db/server_options_helpers.h"
+#include "mongo/db/pubsub_stats.h"
 #include "mongo/db/server_parameters.h"
+#include "mongo/util/fail_point_service.h"
 #include "mongo/util/stringutils.h"
 
 namespace mongo {
@@ -49,6 +51,11 @@ namespace mongo {
     zmq::socket_t* PubSubSendSocket::extSendSocket = NULL;
     zmq::socket_t* PubSubSendSocket::dbEventSocket = NULL;
     std::map<HostAndPort, bool> PubSubSendSocket::rsMembers;
+    OID PubSubSendSocket::originId;
+    std::map<std::string, PubSubSendSocket::ChannelSequence> PubSubSendSocket::channelSequences;
+
+    // drops publications after numbering them, so tests can make subscribers see gaps
+    MONGO_FP_DECLARE(pubsubDropPublications);
 
     bool PubSubSendSocket::publish(const std::string& channel, const BSONObj& message) {
         uassert(18560, "PubSub should be enabled on all calls to publish!", pubsubEnabled);
@@ -58,6 +65,15 @@ namespace mongo {
             // zmq sockets are not thread-safe
             SimpleMutex::scoped_lock lk(sendMutex);
 
+            if (!originId.isSet())
+                originId.init();
+            ChannelSequence& channelSequence = channelSequences[channel];
+            channelSequence.publishedRecently = true;
+            unsigned long long sequence = ++channelSequence.last;
+
+            if (MONGO_FAIL_POINT(pubsubDropPublications))
+                return true;
+
             // dbEventSocket is non-null iff mongod is in a sharded environment
             // workaround to compile on mongos without including d_logic.cpp
             if (!serverGlobalParams.configsvr &&
@@ -67,13 +83,17 @@ namespace mongo {
                     // only publish database events to config servers
                     dbEventSocket->send(channel.c_str(), channel.size() + 1, ZMQ_SNDMORE);
                     dbEventSocket->send(message.objdata(), message.objsize(), ZMQ_SNDMORE);
-                    dbEventSocket->send(&timestamp, sizeof(timestamp));
+                    dbEventSocket->send(&timestamp, sizeof(timestamp), ZMQ_SNDMORE);
+                    dbEventSocket->send(originId.getData(), OID::kOIDSize, ZMQ_SNDMORE);
+                    dbEventSocket->send(&sequence, sizeof(sequence));
             }
 
             // publications and writes to config servers are published normally
             extSendSocket->send(channel.c_str(), channel.size() + 1, ZMQ_SNDMORE);
             extSendSocket->send(message.objdata(), message.objsize(), ZMQ_SNDMORE);
-            extSendSocket->send(&timestamp, sizeof(timestamp));
+            extSendSocket->send(&timestamp, sizeof(timestamp), ZMQ_SNDMORE);
+            extSendSocket->send(originId.getData(), OID::kOIDSize, ZMQ_SNDMORE);
+            extSendSocket->send(&sequence, sizeof(sequence));
         }
         catch (zmq::error_t& e) {
             // can't uassert here - this method is used for database events.
@@ -82,9 +102,24 @@ namespace mongo {
             return false;
         }
 
+        PubSubStats::recordPublish(channel, message.objsize());
         return true;
     }
 
+    void PubSubSendSocket::pruneChannelSequences() {
+        SimpleMutex::scoped_lock lk(sendMutex);
+        std::map<std::string, ChannelSequence>::iterator it = channelSequences.begin();
+        while (it != channelSequences.end()) {
+            if (it->second.publishedRecently) {
+                it->second.publishedRecently = false;
+                ++it;
+            }
+            else {
+                channelSequences.erase(it++);
+            }
+        }
+    }
+
     void PubSubSendSocket::initSharding(const std::string configServers) {
         if (!pubsubEnabled)
             return;
@@ -30,6 +30,7 @@
 
 #include <zmq.hpp>
 
+#include "mongo/bson/oid.h"
 #include "mongo/util/net/hostandport.h"
 
 namespace mongo {
@@ -63,6 +64,27 @@ namespace mongo {
         // bool is set to indicate live or not live during each call to initFromConfig
         // after which pruneReplSetMembers (above) removes the not live members
         static std::map<HostAndPort, bool> rsMembers;
+
+        // forgets the sequence numbers of channels not published to since the last call.
+        // called from the subscription cleanup thread on each pass.
+        static void pruneChannelSequences();
+
+    private:
+        struct ChannelSequence {
+            ChannelSequence() : last(0), publishedRecently(false) {}
+
+            unsigned long long last;
+            bool publishedRecently;
+        };
+
+        // Every message is stamped with the id of the process that published it and a
+        // sequence number that increases by one per message on each channel, so that
+        // subscribers can order messages and detect lost ones without relying on clocks.
+        // A new origin id is generated each time the process starts. A channel left idle for
+        // a cleanup period starts again from 1, which subscribers take as a restart rather
+        // than a gap. Both guarded by sendMutex.
+        static OID originId;
+        static std::map<std::string, ChannelSequence> channelSequences;
     };
 
 }
@@ -0,0 +1,160 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/pubsub_stats.h"
+
+namespace mongo {
+
+    namespace {
+        // exponential buckets from 10 micros up to ~2.6 seconds
+        Histogram::Options latencyHistogramOptions() {
+            Histogram::Options opts;
+            opts.numBuckets = 20;
+            opts.bucketSize = 10;
+            opts.exponential = true;
+            return opts;
+        }
+    }
+
+    const size_t PubSubStats::kMaxTrackedChannels = 1000;
+    const char* const PubSubStats::kOtherChannels = "$others";
+
+    PubSubStats::ChannelStatsMap PubSubStats::channels;
+    SimpleMutex PubSubStats::statsMutex("pubsubstats");
+
+    PubSubStats::ChannelStats::ChannelStats()
+        : published(0),
+          publishedBytes(0),
+          delivered(0),
+          filtered(0),
+          missed(0),
+          totalLatencyMicros(0),
+          latencyMicros(latencyHistogramOptions()) {
+    }
+
+    PubSubStats::ChannelStats* PubSubStats::getChannelStats(const std::string& channel) {
+        ChannelStatsMap::iterator it = channels.find(channel);
+        if (it != channels.end())
+            return it->second;
+
+        if (channels.size() >= kMaxTrackedChannels) {
+            it = channels.find(kOtherChannels);
+            if (it != channels.end())
+                return it->second;
+            return channels[kOtherChannels] = new ChannelStats();
+        }
+
+        return channels[channel] = new ChannelStats();
+    }
+
+    void PubSubStats::recordPublish(const std::string& channel, int bytes) {
+        SimpleMutex::scoped_lock lk(statsMutex);
+        ChannelStats* stats = getChannelStats(channel);
+        stats->published++;
+        stats->publishedBytes += bytes;
+    }
+
+    void PubSubStats::PollCounts::recordDelivery(const std::string& channel,
+                                                 unsigned long long latencyMicros) {
+        // clamp to the range of the histogram. latency can appear negative
+        // if the publishing node's clock is ahead of ours.
+        if (static_cast<long long>(latencyMicros) < 0)
+            latencyMicros = 0;
+        uint32_t clamped = latencyMicros > 0xffffffffULL ?
+                           0xffffffffU : static_cast<uint32_t>(latencyMicros);
+
+        Counts& counts = _counts[channel];
+        counts.delivered++;
+        counts.totalLatencyMicros += latencyMicros;
+        counts.latencyMicros.push_back(clamped);
+    }
+
+    void PubSubStats::PollCounts::recordFiltered(const std::string& channel) {
+        _counts[channel].filtered++;
+    }
+
+    void PubSubStats::PollCounts::recordMissed(const std::string& channel,
+                                               unsigned long long numMessages) {
+        _counts[channel].missed += numMessages;
+    }
+
+    void PubSubStats::PollCounts::flush() {
+        if (_counts.empty())
+            return;
+
+        SimpleMutex::scoped_lock lk(statsMutex);
+        for (std::map<std::string, Counts>::const_iterator it = _counts.begin();
+             it != _counts.end();
+             ++it) {
+                const Counts& counts = it->second;
+                ChannelStats* stats = getChannelStats(it->first);
+                stats->delivered += counts.delivered;
+                stats->filtered += counts.filtered;
+                stats->missed += counts.missed;
+                stats->totalLatencyMicros += counts.totalLatencyMicros;
+                for (size_t i = 0; i < counts.latencyMicros.size(); i++) {
+                    stats->latencyMicros.insert(counts.latencyMicros[i]);
+                }
+        }
+        _counts.clear();
+    }
+
+    void PubSubStats::appendChannelStats(BSONArrayBuilder& b) {
+        SimpleMutex::scoped_lock lk(statsMutex);
+        for (ChannelStatsMap::const_iterator it = channels.begin(); it != channels.end(); ++it) {
+            const ChannelStats* stats = it->second;
+
+            // channel names may hold '.' or start with '$', so they can't be field names
+            BSONObjBuilder channelBuilder(b.subobjStart());
+            channelBuilder.append("channel", it->first);
+            channelBuilder.appendNumber("published", stats->published);
+            channelBuilder.appendNumber("publishedBytes", stats->publishedBytes);
+            channelBuilder.appendNumber("delivered", stats->delivered);
+            channelBuilder.appendNumber("filtered", stats->filtered);
+            channelBuilder.appendNumber("missed", stats->missed);
+            channelBuilder.appendNumber("avgLatencyMicros",
+                                        stats->delivered ?
+                                        stats->totalLatencyMicros / stats->delivered : 0);
+
+            // each bucket counts the deliveries with latency up to and including upTo
+            BSONArrayBuilder histogramBuilder(channelBuilder.subarrayStart("latencyMicros"));
+            const Histogram& h = stats->latencyMicros;
+            for (uint32_t i = 0; i < h.getBucketsNum(); i++) {
+                BSONObjBuilder bucketBuilder(histogramBuilder.subobjStart());
+                bucketBuilder.appendNumber("upTo", static_cast<long long>(h.getBoundary(i)));
+                bucketBuilder.appendNumber("count", static_cast<long long>(h.getCount(i)));
+                bucketBuilder.done();
+            }
+            histogramBuilder.done();
+            channelBuilder.done();
+        }
+    }
+
+}  // namespace mongo
@@ -0,0 +1,115 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/histogram.h"
+
+namespace mongo {
+
+    /**
+     * Per-channel counters for pubsub, reported in the pubsub serverStatus section.
+     *
+     * Publishes are counted on the node the message was published to, deliveries, filtered
+     * and missed messages on the node the subscriber polls from. A message is missed if a
+     * subscription receives a later sequence number from the same origin but never receives
+     * the message itself. Latency is measured from the timestamp taken in
+     * PubSubSendSocket::publish to the poll that returns the message, so across nodes it
+     * includes any clock skew between them.
+     */
+    class PubSubStats {
+    public:
+        static void recordPublish(const std::string& channel, int bytes);
+
+        /**
+         * Counts the messages received by one poll. The counts are added to the channel stats
+         * all at once by flush(), or on destruction, so that polls delivering many messages
+         * take the stats lock once rather than once per message.
+         */
+        class PollCounts {
+        public:
+            ~PollCounts() { flush(); }
+
+            void recordDelivery(const std::string& channel, unsigned long long latencyMicros);
+            void recordFiltered(const std::string& channel);
+            void recordMissed(const std::string& channel, unsigned long long numMessages);
+
+            void flush();
+
+        private:
+            struct Counts {
+                Counts() : delivered(0), filtered(0), missed(0), totalLatencyMicros(0) {}
+
+                long long delivered;
+                long long filtered;
+                long long missed;
+                long long totalLatencyMicros;
+                std::vector<uint32_t> latencyMicros;
+            };
+
+            std::map<std::string, Counts> _counts;
+        };
+
+        // appends an array with one object per channel, the name in its "channel" field
+        static void appendChannelStats(BSONArrayBuilder& b);
+
+        // at most this many channels are tracked separately. messages on any further
+        // channels are counted under kOtherChannels.
+        static const size_t kMaxTrackedChannels;
+        static const char* const kOtherChannels;
+
+    private:
+        struct ChannelStats {
+            ChannelStats();
+
+            long long published;
+            long long publishedBytes;
+            long long delivered;
+            long long filtered;
+            long long missed;
+            long long totalLatencyMicros;
+            Histogram latencyMicros;
+        };
+
+        // returns the stats for channel, creating them if needed. must hold statsMutex.
+        static ChannelStats* getChannelStats(const std::string& channel);
+
+        // owns the ChannelStats, which are never removed
+        typedef std::map<std::string, ChannelStats*> ChannelStatsMap;
+        static ChannelStatsMap channels;
+
+        static SimpleMutex statsMutex;
+    };
+
+}  // namespace mongo
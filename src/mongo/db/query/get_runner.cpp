@@ -32,6 +32,8 @@
 
 #include "mongo/base/parse_number.h"
 #include "mongo/client/dbclientinterface.h"
+#include "mongo/db/catalog/index_catalog_entry.h"
+#include "mongo/db/catalog/index_stats_sampler.h"
 #include "mongo/db/query/cached_plan_runner.h"
 #include "mongo/db/query/canonical_query.h"
 #include "mongo/db/query/eof_runner.h"
@@ -152,6 +154,18 @@ namespace mongo {
                                                         desc->isSparse(),
                                                         desc->indexName(),
                                                         desc->infoObj()));
+
+            // Intersections are costed with the index's key histogram, remade in the
+            // background when missing or stale.
+            IndexCatalogEntry* entry = ii.entry(desc);
+            IndexEntry& indexEntry = plannerParams->indices.back();
+            indexEntry.keyHistogram = entry->keyHistogram();
+            if (internalQueryPlannerEnableIndexIntersection
+                && internalQueryPlannerIntersectionCostPruning
+                && INDEX_BTREE == indexEntry.type
+                && entry->keyHistogramIsStale()) {
+                requestIndexKeySample(collection->ns().ns(), desc->indexName());
+            }
         }
 
         // If query supports index filters, filter params.indices by indices in query settings.
@@ -28,10 +28,12 @@
 
 #pragma once
 
+#include <boost/shared_ptr.hpp>
 #include <string>
 
 #include "mongo/db/index_names.h"
 #include "mongo/db/jsobj.h"
+#include "mongo/db/query/index_key_histogram.h"
 
 namespace mongo {
 
@@ -102,6 +104,10 @@ namespace mongo {
         // by the keyPattern?)
         IndexType type;
 
+        // Sampled statistics of the keys, if the index has been sampled.  Lets the enumerator
+        // cost index intersections before they are tried.
+        boost::shared_ptr<const IndexKeyHistogram> keyHistogram;
+
         std::string toString() const {
             mongoutils::str::stream ss;
             ss << "kp: "  << keyPattern.toString();
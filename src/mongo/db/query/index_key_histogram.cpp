@@ -0,0 +1,112 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/db/query/index_key_histogram.h"
+
+#include <algorithm>
+
+namespace {
+
+    using mongo::BSONElement;
+
+    bool elementLess(const BSONElement& l, const BSONElement& r) {
+        return l.woCompare(r, false) < 0;
+    }
+
+} // namespace
+
+namespace mongo {
+
+    IndexKeyHistogram::Builder::Builder(long long expectedKeys, int numSamples)
+        : _step(std::max(1LL, expectedKeys / std::max(1, numSamples))),
+          _numKeys(0) { }
+
+    void IndexKeyHistogram::Builder::add(const BSONObj& key) {
+        if (0 == _numKeys % _step) {
+            _samples.append(key.firstElement());
+        }
+        ++_numKeys;
+    }
+
+    IndexKeyHistogram* IndexKeyHistogram::Builder::done() {
+        return new IndexKeyHistogram(_numKeys, _samples.arr());
+    }
+
+    IndexKeyHistogram::IndexKeyHistogram(long long numKeys, const BSONObj& samples)
+        : _numKeys(numKeys),
+          _samplesObj(samples.getOwned()) {
+        BSONObjIterator it(_samplesObj);
+        while (it.more()) {
+            _samples.push_back(it.next());
+        }
+        // Descending indexes are walked from the largest key.
+        std::sort(_samples.begin(), _samples.end(), elementLess);
+    }
+
+    double IndexKeyHistogram::fraction(const OrderedIntervalList& oil) const {
+        if (_samples.empty()) {
+            return 0;
+        }
+
+        double samples = 0;
+        for (size_t i = 0; i < oil.intervals.size(); ++i) {
+            const Interval& ival = oil.intervals[i];
+
+            // Bounds are aligned to the scan direction by now, so order them ourselves.
+            bool reversed = ival.start.woCompare(ival.end, false) > 0;
+            const BSONElement& low = reversed ? ival.end : ival.start;
+            const BSONElement& high = reversed ? ival.start : ival.end;
+            bool lowInclusive = reversed ? ival.endInclusive : ival.startInclusive;
+            bool highInclusive = reversed ? ival.startInclusive : ival.endInclusive;
+
+            std::vector<BSONElement>::const_iterator first = lowInclusive
+                ? std::lower_bound(_samples.begin(), _samples.end(), low, elementLess)
+                : std::upper_bound(_samples.begin(), _samples.end(), low, elementLess);
+            std::vector<BSONElement>::const_iterator last = highInclusive
+                ? std::upper_bound(first, _samples.end(), high, elementLess)
+                : std::lower_bound(first, _samples.end(), high, elementLess);
+
+            samples += (last == first) ? 0.5 : static_cast<double>(last - first);
+        }
+
+        return std::min(1.0, samples / _samples.size());
+    }
+
+    BSONObj IndexKeyHistogram::toBSON() const {
+        BSONObjBuilder bob;
+        bob.appendNumber("numKeys", _numKeys);
+        bob.appendNumber("numSamples", static_cast<long long>(_samples.size()));
+        if (!_samples.empty()) {
+            bob.appendAs(_samples.front(), "min");
+            bob.appendAs(_samples.back(), "max");
+        }
+        return bob.obj();
+    }
+
+}  // namespace mongo
@@ -0,0 +1,99 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/query/index_bounds.h"
+
+namespace mongo {
+
+    /**
+     * An equi-depth histogram of the leading field of an index's keys.  It holds every step-th
+     * key of the index in key order, so each sample stands for about the same number of keys,
+     * and estimates what fraction of the index a scan over some bounds on that field reads.
+     *
+     * Built from the sorted keys of a bulk index build, or by the index stats sampler walking
+     * the index.  Immutable once built, so it may be shared between threads.
+     */
+    class IndexKeyHistogram {
+        MONGO_DISALLOW_COPYING(IndexKeyHistogram);
+    public:
+        class Builder {
+            MONGO_DISALLOW_COPYING(Builder);
+        public:
+            /**
+             * 'expectedKeys' spaces the samples so there are about 'numSamples' of them.  It may
+             * be a guess: more keys than expected only makes for more samples.
+             */
+            Builder(long long expectedKeys, int numSamples);
+
+            /**
+             * Keys must be added in index order, in either direction.
+             */
+            void add(const BSONObj& key);
+
+            /**
+             * Caller owns the returned histogram.
+             */
+            IndexKeyHistogram* done();
+
+        private:
+            long long _step;
+            long long _numKeys;
+            BSONArrayBuilder _samples;
+        };
+
+        long long numKeys() const { return _numKeys; }
+
+        size_t numSamples() const { return _samples.size(); }
+
+        /**
+         * Estimated fraction of the index's keys whose leading field lies in one of the intervals
+         * of 'oil'.  A scan that falls between two samples is taken to read half a sample's worth
+         * of keys rather than none.
+         */
+        double fraction(const OrderedIntervalList& oil) const;
+
+        BSONObj toBSON() const;
+
+    private:
+        IndexKeyHistogram(long long numKeys, const BSONObj& samples);
+
+        long long _numKeys;
+
+        // The leading field of each sampled key, ascending.  Points into _samplesObj.
+        BSONObj _samplesObj;
+        std::vector<BSONElement> _samples;
+    };
+
+}  // namespace mongo
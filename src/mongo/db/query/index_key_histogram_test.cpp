@@ -0,0 +1,115 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/db/query/index_key_histogram.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/unittest/unittest.h"
+
+namespace {
+
+    using boost::scoped_ptr;
+    using mongo::BSONObj;
+    using mongo::IndexKeyHistogram;
+    using mongo::Interval;
+    using mongo::OrderedIntervalList;
+
+    // 'n' keys 0..n-1, in ascending or descending order, with 'samples' samples.
+    IndexKeyHistogram* build(int n, int samples, bool descending = false) {
+        IndexKeyHistogram::Builder builder(n, samples);
+        for (int i = 0; i < n; ++i) {
+            builder.add(BSON("" << (descending ? n - 1 - i : i) << "" << "trailing"));
+        }
+        return builder.done();
+    }
+
+    OrderedIntervalList oil(int start, int end, bool startInclusive, bool endInclusive) {
+        OrderedIntervalList list("a");
+        list.intervals.push_back(Interval(BSON("" << start << "" << end),
+                                          startInclusive, endInclusive));
+        return list;
+    }
+
+    TEST(IndexKeyHistogram, Samples) {
+        scoped_ptr<IndexKeyHistogram> hist(build(1000, 100));
+        ASSERT_EQUALS(1000, hist->numKeys());
+        ASSERT_EQUALS(100U, hist->numSamples());
+
+        // More keys than expected make more samples.
+        IndexKeyHistogram::Builder builder(100, 10);
+        for (int i = 0; i < 200; ++i) {
+            builder.add(BSON("" << i));
+        }
+        hist.reset(builder.done());
+        ASSERT_EQUALS(200, hist->numKeys());
+        ASSERT_EQUALS(20U, hist->numSamples());
+    }
+
+    TEST(IndexKeyHistogram, Ranges) {
+        scoped_ptr<IndexKeyHistogram> hist(build(1000, 100));
+        ASSERT_EQUALS(1.0, hist->fraction(oil(0, 999, true, true)));
+        ASSERT_EQUALS(0.5, hist->fraction(oil(0, 500, true, false)));
+        ASSERT_EQUALS(0.1, hist->fraction(oil(900, 2000, true, true)));
+
+        // Aligned to a descending scan.
+        ASSERT_EQUALS(0.5, hist->fraction(oil(500, 0, false, true)));
+
+        // Exclusive bounds leave out the samples on them.
+        ASSERT_EQUALS(0.09, hist->fraction(oil(900, 999, false, true)));
+    }
+
+    TEST(IndexKeyHistogram, BetweenSamples) {
+        scoped_ptr<IndexKeyHistogram> hist(build(1000, 100));
+        ASSERT_EQUALS(0.005, hist->fraction(oil(5, 5, true, true)));
+        ASSERT_EQUALS(0.005, hist->fraction(oil(-10, -1, true, true)));
+
+        OrderedIntervalList points("a");
+        points.intervals.push_back(Interval(BSON("" << 5 << "" << 5), true, true));
+        points.intervals.push_back(Interval(BSON("" << 10 << "" << 10), true, true));
+        ASSERT_EQUALS(0.015, hist->fraction(points));
+    }
+
+    TEST(IndexKeyHistogram, Descending) {
+        scoped_ptr<IndexKeyHistogram> hist(build(1000, 100, true));
+        ASSERT_EQUALS(100U, hist->numSamples());
+        ASSERT_EQUALS(0.5, hist->fraction(oil(500, 999, true, true)));
+        ASSERT_EQUALS(BSON("numKeys" << 1000 << "numSamples" << 100
+                           << "min" << 9 << "max" << 999),
+                      hist->toBSON());
+    }
+
+    TEST(IndexKeyHistogram, Empty) {
+        scoped_ptr<IndexKeyHistogram> hist(build(0, 100));
+        ASSERT_EQUALS(0U, hist->numSamples());
+        ASSERT_EQUALS(0.0, hist->fraction(oil(0, 10, true, true)));
+    }
+
+} // namespace
@@ -41,12 +41,14 @@
 #include "mongo/db/query/canonical_query.h"
 #include "mongo/db/query/explain_plan.h"
 #include "mongo/db/query/plan_cache.h"
+#include "mongo/db/query/plan_cache_stats.h"
 #include "mongo/db/query/plan_executor.h"
 #include "mongo/db/query/qlog.h"
 #include "mongo/db/query/query_knobs.h"
 #include "mongo/db/query/query_solution.h"
 #include "mongo/db/query/type_explain.h"
 #include "mongo/db/catalog/collection.h"
+#include "mongo/util/timer.h"
 
 namespace mongo {
 
@@ -352,11 +354,16 @@ namespace mongo {
 
         // Work the plans, stopping when a plan hits EOF or returns some
         // fixed number of results.
+        Timer trialTimer;
         for (size_t i = 0; i < numWorks; ++i) {
             bool moreToDo = workAllPlans(objOut, numResults);
             if (!moreToDo) { break; }
         }
 
+        if (PlanCache::shouldCacheQuery(*_query)) {
+            planCacheShapeStats.recordTrial(*_query, trialTimer.micros());
+        }
+
         if (_failure || _killed) { return false; }
 
         // After picking best plan, ranking will own plan stats from
@@ -41,6 +41,7 @@
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/query/qlog.h"
 #include "mongo/db/query/query_planner_params.h"
+#include "mongo/db/query/query_result_cache.h"
 #include "mongo/db/query/single_solution_runner.h"
 #include "mongo/db/query/type_explain.h"
 #include "mongo/db/repl/repl_reads_ok.h"
@@ -104,6 +105,43 @@ namespace {
         return mongoutils::str::equals(me->path().rawData(), "ts");
     }
 
+    /**
+     * Returns true if the whole result of 'cq' over 'collection' may be served from, and kept in,
+     * the query result cache.  Queries that leave a cursor open, or whose results can change
+     * without a write to the collection, may not.
+     */
+    bool isResultCacheable(const mongo::Collection* collection, const mongo::CanonicalQuery* cq) {
+        if (!mongo::queryResultCacheEnabled
+            || !mongo::QueryResultCache::canCacheFor(collection)) {
+            return false;
+        }
+
+        const mongo::LiteParsedQuery& pq = cq->getParsed();
+        if (pq.isExplain()
+            || pq.hasOption(mongo::QueryOption_CursorTailable)
+            || pq.hasOption(mongo::QueryOption_OplogReplay)
+            || pq.hasOption(mongo::QueryOption_Exhaust)) {
+            return false;
+        }
+
+        // A $where may read anything, and needs the JS engine to run whatever the cache says.
+        return 0 == mongo::CanonicalQuery::countNodes(cq->root(), mongo::MatchExpression::WHERE);
+    }
+
+    /**
+     * The query result cache key for 'q': everything in the query message that can change what
+     * is returned.
+     */
+    mongo::BSONObj resultCacheKey(const mongo::QueryMessage& q) {
+        mongo::BSONObjBuilder bob;
+        bob.append("q", q.query);
+        bob.append("f", q.fields);
+        bob.append("skip", q.ntoskip);
+        bob.append("n", q.ntoreturn);
+        bob.append("options", q.queryOptions);
+        return bob.obj();
+    }
+
 }  // namespace
 
 namespace mongo {
@@ -458,12 +496,50 @@ namespace mongo {
         QLOG() << "Running query:\n" << cq->toString();
         LOG(2) << "Running query: " << cq->toStringShort();
 
-        // Parse, canonicalize, plan, transcribe, and get a runner.
-        Runner* rawRunner = NULL;
-
         // We use this a lot below.
         const LiteParsedQuery& pq = cq->getParsed();
 
+        // A repeat of a query whose whole result was cached at the collection's current write
+        // generation is answered from the cache, without planning or running anything.
+        BSONObj cacheKey;
+        unsigned long long writeGeneration = 0;
+        if (isResultCacheable(collection, cq)) {
+            cacheKey = resultCacheKey(q);
+            writeGeneration = collection->infoCache()->getWriteGeneration();
+
+            BSONObj cached;
+            if (queryResultCache().get(pq.ns(), cacheKey, writeGeneration, &cached)) {
+                replVerifyReadsOk(&pq);
+
+                int len;
+                const char* data = cached["docs"].binData(len);
+                int numResults = cached["n"].numberInt();
+
+                BufBuilder bb(sizeof(QueryResult) + len);
+                bb.skip(sizeof(QueryResult));
+                bb.appendBuf(data, len);
+                result.appendData(bb.buf(), bb.len());
+                bb.decouple();
+
+                QueryResult* qr = static_cast<QueryResult*>(result.header());
+                qr->cursorId = 0;
+                qr->setResultFlagsToOk();
+                qr->setOperation(opReply);
+                qr->startingFrom = 0;
+                qr->nReturned = numResults;
+
+                curop.debug().cursorid = -1;
+                curop.debug().ntoskip = pq.getSkip();
+                curop.debug().nreturned = numResults;
+                curop.debug().planSummary = "RESULT_CACHE";
+                delete cq;
+                return "";
+            }
+        }
+
+        // Parse, canonicalize, plan, transcribe, and get a runner.
+        Runner* rawRunner = NULL;
+
         // We'll now try to get the query runner that will execute this query for us. There
         // are a few cases in which we know upfront which runner we should get and, therefore,
         // we shortcut the selection process here.
@@ -773,6 +849,20 @@ namespace mongo {
             QLOG() << "Not caching runner but returning " << numResults << " results.\n";
         }
 
+        // Keep a complete result that nothing wrote under while it was read.  Yields may have
+        // let writes in, or dropped the collection.
+        if (!cacheKey.isEmpty() && 0 == ccId && Runner::RUNNER_DEAD != state) {
+            Collection* readCollection = ctx.ctx().db()->getCollection(pq.ns());
+            if (NULL != readCollection
+                && readCollection->infoCache()->getWriteGeneration() == writeGeneration) {
+                BSONObjBuilder cached;
+                cached.append("n", numResults);
+                cached.appendBinData("docs", bb.len() - sizeof(QueryResult), BinDataGeneral,
+                                     bb.buf() + sizeof(QueryResult));
+                queryResultCache().put(pq.ns(), cacheKey, writeGeneration, cached.obj());
+            }
+        }
+
         // Add the results from the query into the output buffer.
         result.appendData(bb.buf(), bb.len());
         bb.decouple();
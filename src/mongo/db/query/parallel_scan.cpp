@@ -0,0 +1,307 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/db/query/parallel_scan.h"
+
+#include <algorithm>
+
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/db.h"
+#include "mongo/db/exec/collection_scan.h"
+#include "mongo/db/exec/working_set.h"
+#include "mongo/db/kill_current_op.h"
+#include "mongo/db/query/canonical_query.h"
+#include "mongo/db/query/get_runner.h"
+#include "mongo/db/query/plan_executor.h"
+#include "mongo/db/query/query_planner.h"
+#include "mongo/db/query/query_planner_common.h"
+#include "mongo/db/query/query_solution.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/extent.h"
+#include "mongo/db/storage/extent_manager.h"
+#include "mongo/db/structure/catalog/namespace_details.h"
+#include "mongo/util/concurrency/thread_pool.h"
+#include "mongo/util/processinfo.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_SERVER_PARAMETER(parallelScanThreads, int, 1);
+
+    namespace {
+        // Collections smaller than this are not worth the threads.
+        const uint64_t kMinParallelScanBytes = 16 * 1024 * 1024;
+
+        void checkNotAborted(const AtomicUInt32* abort) {
+            uassert(ErrorCodes::Interrupted, "parallel scan stopped", !abort->load());
+        }
+    }
+
+    ExtentRangeScan::ExtentRangeScan(const std::string& ns,
+                                     const std::vector<DiskLoc>& extents,
+                                     const BSONObj& query,
+                                     const AtomicUInt32* abort)
+        : _ns(ns),
+          _extents(extents),
+          _abort(abort),
+          _nextExtent(0),
+          _docsSinceAbortCheck(0),
+          _walkedCollection(NULL),
+          _walkedFreeGeneration(0) {
+
+        CanonicalQuery* cq;
+        uassertStatusOK(CanonicalQuery::canonicalize(ns, query, &cq));
+        _query.reset(cq);
+    }
+
+    ExtentRangeScan::~ExtentRangeScan() { }
+
+    bool ExtentRangeScan::getNext(BSONObj* out) {
+        while (NULL != _exec.get() || startNextExtent()) {
+            if (++_docsSinceAbortCheck >= 1024) {
+                _docsSinceAbortCheck = 0;
+                checkNotAborted(_abort);
+            }
+
+            Runner::RunnerState state = _exec->getNext(out, NULL);
+            if (Runner::RUNNER_ADVANCED == state) {
+                return true;
+            }
+
+            massert(18610, str::stream() << "scan of an extent of " << _ns << " failed",
+                    Runner::RUNNER_EOF == state);
+            _exec.reset();
+        }
+        return false;
+    }
+
+    bool ExtentRangeScan::startNextExtent() {
+        _exec.reset();
+        _lock.reset();
+
+        while (_nextExtent < _extents.size()) {
+            checkNotAborted(_abort);
+            const DiskLoc extentLoc = _extents[_nextExtent++];
+
+            _lock.reset(new Client::ReadContext(_ns));
+            Database* db = _lock->ctx().db();
+            Collection* collection = db->getCollection(_ns);
+            if (NULL == collection) {
+                // Dropped: nothing more to read.
+                _lock.reset();
+                return false;
+            }
+
+            // Writes may have freed the extent since the ranges were drawn.
+            const ExtentManager& em = db->getExtentManager();
+            if (!inCollection(em, collection, extentLoc)) {
+                _lock.reset();
+                continue;
+            }
+
+            const Extent* extent = em.getExtent(extentLoc);
+            if (extent->firstRecord.isNull()) {
+                _lock.reset();
+                continue;
+            }
+
+            CollectionScanParams params;
+            params.ns = _ns;
+            params.start = extent->firstRecord;
+            params.end = extent->lastRecord;
+
+            WorkingSet* ws = new WorkingSet();
+            _exec.reset(new PlanExecutor(ws, new CollectionScan(params, ws, _query->root())));
+            return true;
+        }
+        return false;
+    }
+
+    bool ExtentRangeScan::inCollection(const ExtentManager& em, const Collection* collection,
+                                       const DiskLoc& extentLoc) {
+        // An extent leaves a collection only by being freed, and a dropped and recreated
+        // collection frees its extents first, so an unchanged generation means the walk holds.
+        const unsigned long long freeGeneration = ExtentManager::freeGeneration();
+        if (collection != _walkedCollection || freeGeneration != _walkedFreeGeneration) {
+            _collectionExtents.clear();
+            for (DiskLoc loc = collection->details()->firstExtent(); !loc.isNull();
+                 loc = em.getExtent(loc)->xnext) {
+                _collectionExtents.insert(loc);
+            }
+            _walkedCollection = collection;
+            _walkedFreeGeneration = freeGeneration;
+        }
+        return _collectionExtents.count(extentLoc) > 0;
+    }
+
+    // static
+    size_t ParallelScan::threadsFor(Database* db, Collection* collection,
+                                    CanonicalQuery* query) {
+        if (1 == parallelScanThreads || NULL == collection || collection->isCapped()) {
+            return 0;
+        }
+
+        if (collection->dataSize() < kMinParallelScanBytes) {
+            return 0;
+        }
+
+        // $where would run JavaScript on every scan thread.
+        if (QueryPlannerCommon::hasNode(query->root(), MatchExpression::WHERE)) {
+            return 0;
+        }
+
+        // Only a collection scan can answer the query.
+        QueryPlannerParams plannerParams;
+        fillOutPlannerParams(collection, query, &plannerParams);
+
+        std::vector<QuerySolution*> solutions;
+        Status status = QueryPlanner::plan(*query, plannerParams, &solutions);
+        bool scanOnly = status.isOK() && !solutions.empty();
+        for (size_t i = 0; i < solutions.size(); ++i) {
+            if (STAGE_COLLSCAN != solutions[i]->root->getType()) {
+                scanOnly = false;
+            }
+            delete solutions[i];
+        }
+        if (!scanOnly) {
+            return 0;
+        }
+
+        size_t nExtents = 0;
+        const ExtentManager& em = db->getExtentManager();
+        for (DiskLoc loc = collection->details()->firstExtent(); !loc.isNull();
+             loc = em.getExtent(loc)->xnext) {
+            ++nExtents;
+        }
+
+        const size_t nThreads = std::min<size_t>(nExtents,
+                                                 parallelScanThreads > 0
+                                                     ? parallelScanThreads
+                                                     : ProcessInfo().getNumCores());
+        return nThreads > 1 ? nThreads : 0;
+    }
+
+    ParallelScan::ParallelScan(Database* db, Collection* collection, const BSONObj& query,
+                               size_t nThreads)
+        : _ns(collection->ns().ns()),
+          _query(query.getOwned()),
+          _mutex("ParallelScan"),
+          _failure(Status::OK()) {
+
+        invariant(nThreads > 0);
+
+        std::vector<DiskLoc> extents;
+        std::vector<long long> offsets;
+        long long totalLength = 0;
+        const ExtentManager& em = db->getExtentManager();
+        for (DiskLoc loc = collection->details()->firstExtent(); !loc.isNull();
+             loc = em.getExtent(loc)->xnext) {
+            extents.push_back(loc);
+            offsets.push_back(totalLength);
+            totalLength += em.getExtent(loc)->length;
+        }
+
+        // Range i holds the extents starting in the i'th nThreads part of the collection's bytes.
+        // Ranges that no extent starts in are left out.
+        size_t lastRange = 0;
+        for (size_t i = 0; i < extents.size(); ++i) {
+            const size_t range = static_cast<size_t>(offsets[i] * nThreads / totalLength);
+            if (_ranges.empty() || range != lastRange) {
+                _ranges.push_back(std::vector<DiskLoc>());
+                lastRange = range;
+            }
+            _ranges.back().push_back(extents[i]);
+        }
+    }
+
+    std::vector<DiskLoc> ParallelScan::extents() const {
+        std::vector<DiskLoc> all;
+        for (size_t i = 0; i < _ranges.size(); ++i) {
+            all.insert(all.end(), _ranges[i].begin(), _ranges[i].end());
+        }
+        return all;
+    }
+
+    Status ParallelScan::run(const ScanRangeFunction& scanRange) {
+        dbtempreleasecond unlock;
+
+        if (Lock::isLocked()) {
+            // The scan threads would wait for a lock we can't let go of.
+            for (size_t i = 0; i < _ranges.size() && !_abort.load(); ++i) {
+                _scanRange(i, scanRange);
+            }
+            return _failure;
+        }
+
+        {
+            ThreadPool pool(_ranges.size());
+            for (size_t i = 0; i < _ranges.size(); ++i) {
+                pool.schedule(&ParallelScan::_scanRange, this, i, scanRange);
+            }
+
+            // The scan threads can't see this operation being killed, so watch for it here.
+            while (pool.tasks_remaining() > 0) {
+                if (*killCurrentOp.checkForInterruptNoAssert()) {
+                    _abort.store(1);
+                }
+                sleepmillis(10);
+            }
+            pool.join();
+        }
+
+        killCurrentOp.checkForInterrupt(false);
+        return _failure;
+    }
+
+    void ParallelScan::_scanRange(size_t range, const ScanRangeFunction& scanRange) {
+        if (!ClientBasic::getCurrent()) {
+            Client::initThread("parallel scan");
+        }
+
+        try {
+            ExtentRangeScan scan(_ns, _ranges[range], _query, &_abort);
+            scanRange(range, &scan);
+        }
+        catch (const DBException& e) {
+            _fail(e.toStatus());
+        }
+        catch (const std::exception& e) {
+            _fail(Status(ErrorCodes::InternalError, e.what()));
+        }
+    }
+
+    void ParallelScan::_fail(const Status& status) {
+        scoped_lock lk(_mutex);
+        if (_failure.isOK()) {
+            _failure = status;
+        }
+        _abort.store(1);
+    }
+
+} // namespace mongo
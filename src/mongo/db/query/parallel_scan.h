@@ -0,0 +1,164 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#pragma once
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/status.h"
+#include "mongo/db/client.h"
+#include "mongo/db/diskloc.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/mutex.h"
+
+namespace mongo {
+
+    class CanonicalQuery;
+    class Collection;
+    class Database;
+    class ExtentManager;
+    class PlanExecutor;
+
+    /**
+     * Threads scanning a collection for an aggregation or a count that has to read all of it.  0
+     * means one per core; 1 scans on the thread running the operation, as before.
+     */
+    extern int parallelScanThreads;
+
+    /**
+     * Returns the documents matching a query in a range of a collection's extents, reading them
+     * with one CollectionScan per extent.  The database is read locked while an extent is scanned,
+     * and unlocked between extents so that writes can go ahead.  Extents that have left the
+     * collection by the time they are reached are skipped.
+     */
+    class ExtentRangeScan {
+        MONGO_DISALLOW_COPYING(ExtentRangeScan);
+    public:
+        /** Stops with an Interrupted error at the next extent, or soon after, once 'abort' is set. */
+        ExtentRangeScan(const std::string& ns,
+                        const std::vector<DiskLoc>& extents,
+                        const BSONObj& query,
+                        const AtomicUInt32* abort);
+        ~ExtentRangeScan();
+
+        /**
+         * Sets 'out' to the next matching document and returns true, or returns false at the end
+         * of the range.  'out' points into the data files, so is only valid until the next call.
+         */
+        bool getNext(BSONObj* out);
+
+    private:
+        /** Locks the database and starts scanning the next extent that is still in use. */
+        bool startNextExtent();
+
+        /**
+         * Returns true if 'extentLoc' is one of the extents of 'collection'.  Call with the
+         * collection read locked.  Walks the collection's extents only when extents have been
+         * freed since the last walk.
+         */
+        bool inCollection(const ExtentManager& em, const Collection* collection,
+                          const DiskLoc& extentLoc);
+
+        const std::string _ns;
+        const std::vector<DiskLoc> _extents;
+        const AtomicUInt32* _abort;
+        boost::scoped_ptr<CanonicalQuery> _query;
+        size_t _nextExtent;
+        unsigned _docsSinceAbortCheck;
+
+        // the collection's extents at the last walk, good while no extents have been freed
+        std::set<DiskLoc> _collectionExtents;
+        const Collection* _walkedCollection;
+        unsigned long long _walkedFreeGeneration;
+
+        // the extent being scanned; the executor must go before the lock
+        boost::scoped_ptr<Client::ReadContext> _lock;
+        boost::scoped_ptr<PlanExecutor> _exec;
+    };
+
+    /**
+     * Splits a collection into ranges of its extents and scans them on a thread each, for
+     * operations that would otherwise read the whole collection on one thread.
+     */
+    class ParallelScan {
+        MONGO_DISALLOW_COPYING(ParallelScan);
+    public:
+        typedef boost::function<void (size_t range, ExtentRangeScan* scan)> ScanRangeFunction;
+
+        /**
+         * Returns how many threads should scan 'collection' for 'query', or 0 if it isn't worth
+         * scanning in parallel.  That is the case if parallelScanThreads is 1, if an index can
+         * answer 'query' or it has a $where, or if the collection is small or capped (a capped
+         * collection is read in insertion order, not extent order).  Call with the collection
+         * read locked.
+         */
+        static size_t threadsFor(Database* db, Collection* collection, CanonicalQuery* query);
+
+        /**
+         * Splits 'collection' into at most 'nThreads' ranges of neighbouring extents, each holding
+         * about the same number of bytes.  Call with the collection read locked.
+         */
+        ParallelScan(Database* db, Collection* collection, const BSONObj& query, size_t nThreads);
+
+        size_t numRanges() const { return _ranges.size(); }
+
+        /** The extents of every range, in order. */
+        std::vector<DiskLoc> extents() const;
+
+        /**
+         * Calls 'scanRange' for each range on a thread of its own.  Returns once every range has
+         * been scanned, with the first error a range failed with, if any.  The caller's lock is
+         * released in the meantime; if it can't be released (it is recursive), the ranges are
+         * scanned one after another on the calling thread instead.
+         */
+        Status run(const ScanRangeFunction& scanRange);
+
+    private:
+        /** Runs on a scan thread. */
+        void _scanRange(size_t range, const ScanRangeFunction& scanRange);
+
+        void _fail(const Status& status);
+
+        const std::string _ns;
+        const BSONObj _query;
+        std::vector<std::vector<DiskLoc> > _ranges;
+
+        AtomicUInt32 _abort; // set when a range fails or the operation is interrupted
+
+        mongo::mutex _mutex; // guards _failure
+        Status _failure;
+    };
+
+} // namespace mongo
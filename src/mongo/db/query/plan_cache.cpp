@@ -34,6 +34,7 @@
 #include "boost/thread/locks.hpp"
 #include "mongo/base/owned_pointer_vector.h"
 #include "mongo/client/dbclientinterface.h"   // For QueryOption_foobar
+#include "mongo/db/query/plan_cache_stats.h"
 #include "mongo/db/query/plan_ranker.h"
 #include "mongo/db/query/query_solution.h"
 #include "mongo/db/query/qlog.h"
@@ -130,7 +131,8 @@ namespace mongo {
     PlanCacheEntry::PlanCacheEntry(const std::vector<QuerySolution*>& solutions,
                                    PlanRankingDecision* why)
         : plannerData(solutions.size()),
-          decision(why) {
+          decision(why),
+          writeEpoch(0) {
         invariant(why);
 
         // The caller of this constructor is responsible for ensuring
@@ -178,6 +180,7 @@ namespace mongo {
         }
         entry->averageScore = averageScore;
         entry->stddevScore = stddevScore;
+        entry->writeEpoch = writeEpoch;
         return entry;
     }
 
@@ -323,6 +326,7 @@ namespace mongo {
         entry->query = pq.getFilter().getOwned();
         entry->sort = pq.getSort().getOwned();
         entry->projection = pq.getProj().getOwned();
+        entry->writeEpoch = _writeEpoch.load();
 
         // If the winning solution uses a blocking stage, then try and
         // find a fallback solution that has no blocking stage.
@@ -415,6 +419,29 @@ namespace mongo {
         return false;
     }
 
+    /**
+     * Results per unit of work.  This is the part of a plan's score that follows the data: it
+     * drops when the index bounds or the filter start matching a smaller share of what is read.
+     */
+    static double productivity(const PlanStageStats* stats) {
+        if (0 == stats->common.works) {
+            return 0;
+        }
+        return static_cast<double>(stats->common.advanced) / stats->common.works;
+    }
+
+    /**
+     * The first cached run of 'entry' after a burst of writes samples the collection as it is
+     * now.  Returns true if the plan is much less productive than it was when it won its trial,
+     * which means the writes changed the data enough that the plan should be picked again.
+     */
+    static bool hasDataShiftedUnderCachedPlan(const PlanCacheEntry* entry,
+                                              const PlanCacheEntryFeedback* latestFeedback) {
+        double then = productivity(entry->decision->stats.vector()[0]);
+        double now = productivity(latestFeedback->stats.get());
+        return now < then * internalQueryCacheRevalidationRatio;
+    }
+
     Status PlanCache::feedback(const CanonicalQuery& cq, PlanCacheEntryFeedback* feedback) {
         if (NULL == feedback) {
             return Status(ErrorCodes::BadValue, "feedback is NULL");
@@ -430,6 +457,28 @@ namespace mongo {
         }
         invariant(entry);
 
+        const unsigned writeEpoch = _writeEpoch.load();
+        if (entry->writeEpoch != writeEpoch) {
+            if (hasDataShiftedUnderCachedPlan(entry, autoFeedback.get())) {
+                LOG(1) << _ns << ": removing plan cache entry " << entry->toString()
+                       << " - cached solution is much less productive after writes.";
+                _cache.remove(ck);
+                planCacheShapeStats.recordReplan(_ns, cq);
+                return Status::OK();
+            }
+
+            // Still a good plan.  Its feedback so far describes the data before the writes, so
+            // start collecting it afresh.
+            for (size_t i = 0; i < entry->feedback.size(); ++i) {
+                delete entry->feedback[i];
+            }
+            entry->feedback.clear();
+            entry->averageScore.reset();
+            entry->stddevScore.reset();
+            entry->writeEpoch = writeEpoch;
+            planCacheShapeStats.recordRevalidation(_ns, cq);
+        }
+
         if (entry->feedback.size() >= size_t(internalQueryCacheFeedbacksStored)) {
             // If we have enough feedback, then use it to determine whether
             // we should get rid of the cached solution.
@@ -437,6 +486,7 @@ namespace mongo {
                 LOG(1) << _ns << ": removing plan cache entry " << entry->toString()
                        << " - detected degradation in performance of cached solution.";
                 _cache.remove(ck);
+                planCacheShapeStats.recordReplan(_ns, cq);
             }
         }
         else {
@@ -504,10 +554,21 @@ namespace mongo {
             return;
         }
 
-        LOG(1) << _ns << ": clearing collection plan cache - "
+        if (!internalQueryCacheRevalidateAfterWrites) {
+            LOG(1) << _ns << ": clearing collection plan cache - "
+                   << internalQueryCacheWriteOpsBetweenFlush
+                   << " write operations detected since last refresh.";
+            clear();
+            return;
+        }
+
+        // Keep the entries, but have each one checked against the data by its next run rather
+        // than paying for a full replan of every shape after every burst of writes.
+        LOG(1) << _ns << ": marking collection plan cache for revalidation - "
                << internalQueryCacheWriteOpsBetweenFlush
                << " write operations detected since last refresh.";
-        clear();
+        _writeOperations.store(0);
+        _writeEpoch.fetchAndAdd(1);
     }
 
 }  // namespace mongo
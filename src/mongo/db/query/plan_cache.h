@@ -263,6 +263,11 @@ namespace mongo {
         // The standard deviation of the scores from stored as feedback.
         boost::optional<double> stddevScore;
 
+        // The plan cache's write epoch when this entry was added or last revalidated.  An entry
+        // from an earlier epoch has seen a burst of writes since its plan won, and is checked
+        // against the data on its next cached run.
+        unsigned writeEpoch;
+
         // In order to justify eviction, the deviation from the mean must exceed a
         // minimum threshold.
         static const double kMinDeviation;
@@ -334,7 +339,8 @@ namespace mongo {
          * statistics about the plan.  Status::OK() is returned.
          *
          * May cause the cache entry to be removed if it is determined that the cached plan
-         * is badly performing.
+         * is badly performing, or if this is the entry's first run since a burst of writes and
+         * it is much less productive than it was when it won its trial.
          */
         Status feedback(const CanonicalQuery& cq, PlanCacheEntryFeedback* feedback);
 
@@ -382,7 +388,9 @@ namespace mongo {
 
         /**
          *  You must notify the cache if you are doing writes, as query plan utility will change.
-         *  Cache is flushed after every 1000 notifications.
+         *  After every internalQueryCacheWriteOpsBetweenFlush notifications, every entry is marked
+         *  for revalidation by its next cached run (see feedback(...)), or the cache is flushed
+         *  if internalQueryCacheRevalidateAfterWrites is off.
          */
         void notifyOfWriteOp();
 
@@ -408,6 +416,12 @@ namespace mongo {
          */
         AtomicInt32 _writeOperations;
 
+        /**
+         * Bumped every time _writeOperations reaches the flush threshold.  Entries stamped with
+         * an older epoch must be revalidated.
+         */
+        AtomicUInt32 _writeEpoch;
+
         /**
          * Full namespace of collection.
          */
@@ -0,0 +1,137 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/query/plan_cache_stats.h"
+
+#include <algorithm>
+#include <vector>
+#include "boost/thread/locks.hpp"
+
+namespace mongo {
+
+    PlanCacheShapeStats planCacheShapeStats;
+
+    void PlanCacheShapeStats::Counts::appendTo(BSONObjBuilder* builder) const {
+        builder->appendNumber("trials", trials);
+        builder->appendNumber("trialMicros", trialMicros);
+        builder->appendNumber("replans", replans);
+        builder->appendNumber("revalidations", revalidations);
+    }
+
+    PlanCacheShapeStats::Shape* PlanCacheShapeStats::_shape(const std::string& ns,
+                                                            const CanonicalQuery& cq) {
+        ShapeKey key(ns, cq.getPlanCacheKey());
+        ShapeMap::iterator it = _shapes.find(key);
+        if (it != _shapes.end()) {
+            return &it->second;
+        }
+        if (_shapes.size() >= kMaxShapes) {
+            return NULL;
+        }
+
+        Shape* shape = &_shapes[key];
+        const LiteParsedQuery& pq = cq.getParsed();
+        shape->query = pq.getFilter().getOwned();
+        shape->sort = pq.getSort().getOwned();
+        shape->projection = pq.getProj().getOwned();
+        return shape;
+    }
+
+    void PlanCacheShapeStats::recordTrial(const CanonicalQuery& cq, long long micros) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _totals.trials++;
+        _totals.trialMicros += micros;
+        Shape* shape = _shape(cq.ns(), cq);
+        if (NULL != shape) {
+            shape->counts.trials++;
+            shape->counts.trialMicros += micros;
+        }
+    }
+
+    void PlanCacheShapeStats::recordReplan(const std::string& ns, const CanonicalQuery& cq) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _totals.replans++;
+        Shape* shape = _shape(ns, cq);
+        if (NULL != shape) {
+            shape->counts.replans++;
+        }
+    }
+
+    void PlanCacheShapeStats::recordRevalidation(const std::string& ns,
+                                                 const CanonicalQuery& cq) {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _totals.revalidations++;
+        Shape* shape = _shape(ns, cq);
+        if (NULL != shape) {
+            shape->counts.revalidations++;
+        }
+    }
+
+    namespace {
+        // Orders (trialMicros, shape) pairs so that the most expensive shapes come first.
+        struct LongerTrialsFirst {
+            template <typename Pair>
+            bool operator()(const Pair& a, const Pair& b) const {
+                return a.first > b.first;
+            }
+        };
+    }
+
+    void PlanCacheShapeStats::append(BSONObjBuilder* builder, size_t maxShapes) const {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _totals.appendTo(builder);
+        builder->appendNumber("shapesTracked", static_cast<long long>(_shapes.size()));
+
+        std::vector<std::pair<long long, ShapeMap::const_iterator> > order;
+        for (ShapeMap::const_iterator it = _shapes.begin(); it != _shapes.end(); ++it) {
+            order.push_back(std::make_pair(it->second.counts.trialMicros, it));
+        }
+        size_t n = std::min(maxShapes, order.size());
+        std::partial_sort(order.begin(), order.begin() + n, order.end(), LongerTrialsFirst());
+
+        BSONArrayBuilder shapes(builder->subarrayStart("shapes"));
+        for (size_t i = 0; i < n; ++i) {
+            ShapeMap::const_iterator it = order[i].second;
+            BSONObjBuilder b(shapes.subobjStart());
+            b.append("ns", it->first.first);
+            b.append("query", it->second.query);
+            b.append("sort", it->second.sort);
+            b.append("projection", it->second.projection);
+            it->second.counts.appendTo(&b);
+            b.doneFast();
+        }
+        shapes.doneFast();
+    }
+
+    void PlanCacheShapeStats::reset() {
+        boost::lock_guard<boost::mutex> lk(_mutex);
+        _totals = Counts();
+        _shapes.clear();
+    }
+
+}  // namespace mongo
@@ -0,0 +1,118 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <boost/thread/mutex.hpp>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/query/canonical_query.h"
+
+namespace mongo {
+
+    /**
+     * Process wide counters of how much planning each query shape costs: how often its candidate
+     * plans were raced and for how long, and how often its cached plan was thrown out (so that
+     * the next query of that shape is planned again) or kept after a burst of writes.
+     *
+     * Shapes are keyed by namespace and plan cache key, so queries that differ only in their
+     * literal values share a record.  At most kMaxShapes shapes are tracked; the totals count
+     * every shape.
+     */
+    class PlanCacheShapeStats {
+        MONGO_DISALLOW_COPYING(PlanCacheShapeStats);
+    public:
+        static const size_t kMaxShapes = 1000;
+
+        PlanCacheShapeStats() { }
+
+        /**
+         * The candidate plans for 'cq' were raced for 'micros' microseconds.
+         */
+        void recordTrial(const CanonicalQuery& cq, long long micros);
+
+        /**
+         * The cached plan for the shape of 'cq' in 'ns' was evicted for performing badly.
+         */
+        void recordReplan(const std::string& ns, const CanonicalQuery& cq);
+
+        /**
+         * The cached plan for the shape of 'cq' in 'ns' was found to still be good after writes.
+         */
+        void recordRevalidation(const std::string& ns, const CanonicalQuery& cq);
+
+        /**
+         * Appends the totals and the 'maxShapes' shapes that spent the longest in plan trials.
+         */
+        void append(BSONObjBuilder* builder, size_t maxShapes) const;
+
+        /**
+         * Forget everything.  Used for testing.
+         */
+        void reset();
+
+    private:
+        struct Counts {
+            Counts() : trials(0), trialMicros(0), replans(0), revalidations(0) { }
+
+            void appendTo(BSONObjBuilder* builder) const;
+
+            long long trials;
+            long long trialMicros;
+            long long replans;
+            long long revalidations;
+        };
+
+        struct Shape {
+            Counts counts;
+
+            // An example query of this shape, for display.
+            BSONObj query;
+            BSONObj sort;
+            BSONObj projection;
+        };
+
+        typedef std::pair<std::string, PlanCacheKey> ShapeKey;
+        typedef std::map<ShapeKey, Shape> ShapeMap;
+
+        /**
+         * Returns the record for the shape of 'cq' in 'ns', or NULL if the shape is not tracked
+         * and there is no room for it.  Must hold _mutex.
+         */
+        Shape* _shape(const std::string& ns, const CanonicalQuery& cq);
+
+        mutable boost::mutex _mutex;
+        Counts _totals;
+        ShapeMap _shapes;
+    };
+
+    extern PlanCacheShapeStats planCacheShapeStats;
+
+}  // namespace mongo
@@ -377,7 +377,70 @@ namespace {
         ASSERT_EQUALS(planCache.size(), 1U);
     }
 
+    /**
+     * Feedback from a cached run that advanced 'advanced' times in 'works' works.
+     */
+    PlanCacheEntryFeedback* createFeedback(size_t advanced, size_t works) {
+        auto_ptr<PlanCacheEntryFeedback> feedback(new PlanCacheEntryFeedback());
+        feedback->stats.reset(new PlanStageStats(CommonStats(), STAGE_COLLSCAN));
+        feedback->stats->common.advanced = advanced;
+        feedback->stats->common.works = works;
+        feedback->score = 0;
+        return feedback.release();
+    }
+
+    /**
+     * A decision whose winning plan advanced 'advanced' times in 'works' works during its trial.
+     */
+    PlanRankingDecision* createDecision(size_t advanced, size_t works) {
+        PlanRankingDecision* why = createDecision(1U);
+        why->stats.vector()[0]->common.advanced = advanced;
+        why->stats.vector()[0]->common.works = works;
+        return why;
+    }
+
     TEST(PlanCacheTest, NotifyOfWriteOp) {
+        PlanCache planCache;
+        auto_ptr<CanonicalQuery> cq(canonicalize("{a: 1}"));
+        QuerySolution qs;
+        qs.cacheData.reset(new SolutionCacheData());
+        qs.cacheData->tree.reset(new PlanCacheIndexTree());
+        std::vector<QuerySolution*> solns;
+        solns.push_back(&qs);
+        ASSERT_OK(planCache.add(*cq, solns, createDecision(50U, 100U)));
+        ASSERT_EQUALS(planCache.size(), 1U);
+
+        // Write ops never flush the cache; the N-th marks its entries for revalidation.
+        for (int i = 0; i < internalQueryCacheWriteOpsBetweenFlush; ++i) {
+            planCache.notifyOfWriteOp();
+        }
+        ASSERT_EQUALS(planCache.size(), 1U);
+
+        // A run about as productive as the trial keeps the entry, and is the first feedback
+        // collected against the data as it is now.
+        ASSERT_OK(planCache.feedback(*cq, createFeedback(45U, 100U)));
+        ASSERT_TRUE(planCache.contains(*cq));
+        PlanCacheEntry* entry;
+        ASSERT_OK(planCache.getEntry(*cq, &entry));
+        ASSERT_EQUALS(entry->feedback.size(), 1U);
+        delete entry;
+
+        // Revalidated entries are not checked again until the next burst of writes.
+        ASSERT_OK(planCache.feedback(*cq, createFeedback(1U, 100U)));
+        ASSERT_TRUE(planCache.contains(*cq));
+
+        // After it, a run much less productive than the trial evicts the entry.
+        for (int i = 0; i < internalQueryCacheWriteOpsBetweenFlush; ++i) {
+            planCache.notifyOfWriteOp();
+        }
+        ASSERT_OK(planCache.feedback(*cq, createFeedback(10U, 100U)));
+        ASSERT_FALSE(planCache.contains(*cq));
+    }
+
+    TEST(PlanCacheTest, NotifyOfWriteOpFlush) {
+        bool oldRevalidate = internalQueryCacheRevalidateAfterWrites;
+        internalQueryCacheRevalidateAfterWrites = false;
+
         PlanCache planCache;
         auto_ptr<CanonicalQuery> cq(canonicalize("{a: 1}"));
         QuerySolution qs;
@@ -415,6 +478,8 @@ namespace {
         // Notification after clearing will not flush cache.
         planCache.notifyOfWriteOp();
         ASSERT_EQUALS(planCache.size(), 1U);
+
+        internalQueryCacheRevalidateAfterWrites = oldRevalidate;
     }
 
     /**
@@ -31,6 +31,7 @@
 #include <set>
 
 #include "mongo/db/query/indexability.h"
+#include "mongo/db/query/index_bounds_builder.h"
 #include "mongo/db/query/index_tag.h"
 #include "mongo/db/query/qlog.h"
 
@@ -66,7 +67,9 @@ namespace mongo {
           _indices(params.indices),
           _ixisect(params.intersect),
           _orLimit(params.maxSolutionsPerOr),
-          _intersectLimit(params.maxIntersectPerAnd) { }
+          _intersectLimit(params.maxIntersectPerAnd),
+          _intersectCostPruning(params.intersectCostPruning),
+          _intersectFetchCost(params.intersectFetchCost) { }
 
     PlanEnumerator::~PlanEnumerator() {
         typedef unordered_map<MemoID, NodeAssignment*> MemoMap;
@@ -877,6 +880,14 @@ namespace mongo {
                     continue;
                 }
 
+                // Skip the pair if its histograms already say that one of the two
+                // single index assignments, output by enumerateOneIndex(...), will win.
+                if (_intersectCostPruning && !intersectionMayPay(firstAssign, secondAssign)) {
+                    QLOG() << "Not intersecting " << ie1.keyPattern.toString() << " and "
+                           << ie2.keyPattern.toString() << ": too unselective" << endl;
+                    continue;
+                }
+
                 // We're done with this particular pair of indices; output
                 // the resulting assignments.
                 AndEnumerableState state;
@@ -903,6 +914,66 @@ namespace mongo {
         }
     }
 
+    bool PlanEnumerator::estimateScanFraction(const OneIndexAssignment& assign,
+                                              double* fractionOut) const {
+        const IndexEntry& index = (*_indices)[assign.index];
+        if (INDEX_BTREE != index.type || NULL == index.keyHistogram.get()) {
+            return false;
+        }
+
+        // Only bounds on the leading field are estimated.  Compounded predicates make the
+        // scan more selective than this, so the estimate errs toward intersecting.
+        BSONElement leading = index.keyPattern.firstElement();
+        OrderedIntervalList oil(leading.fieldName());
+        bool haveBounds = false;
+        for (size_t i = 0; i < assign.preds.size(); ++i) {
+            if (0 != assign.positions[i]) {
+                continue;
+            }
+            // The bounds of a pred under a NOT are those of the NOT.
+            MatchExpression* pred = assign.preds[i];
+            unordered_map<MatchExpression*, MatchExpression*>::const_iterator notIt =
+                _notParents.find(pred);
+            if (_notParents.end() != notIt) {
+                pred = notIt->second;
+            }
+
+            IndexBoundsBuilder::BoundsTightness tightness;
+            if (!haveBounds) {
+                IndexBoundsBuilder::translate(pred, leading, index, &oil, &tightness);
+                haveBounds = true;
+            }
+            else {
+                IndexBoundsBuilder::translateAndIntersect(pred, leading, index, &oil, &tightness);
+            }
+        }
+        if (!haveBounds) {
+            return false;
+        }
+
+        *fractionOut = index.keyHistogram->fraction(oil);
+        return true;
+    }
+
+    bool PlanEnumerator::intersectionMayPay(const OneIndexAssignment& first,
+                                            const OneIndexAssignment& second) const {
+        double firstFraction, secondFraction;
+        if (!estimateScanFraction(first, &firstFraction) ||
+            !estimateScanFraction(second, &secondFraction)) {
+            // Let the trial runs decide.
+            return true;
+        }
+
+        double low = std::min(firstFraction, secondFraction);
+        double high = std::max(firstFraction, secondFraction);
+
+        // Scanning the more selective index alone reads 'low' keys and fetches as many
+        // documents.  Intersecting reads both scans and fetches only what both return.
+        double single = low * (1 + _intersectFetchCost);
+        double intersected = low + high + low * high * _intersectFetchCost;
+        return intersected <= single;
+    }
+
     bool PlanEnumerator::partitionPreds(MatchExpression* node,
                                         PrepMemoContext context,
                                         vector<MatchExpression*>* indexOut,
@@ -929,6 +1000,7 @@ namespace mongo {
                 indexOut->push_back(child);
             }
             else if (Indexability::isBoundsGeneratingNot(child)) {
+                _notParents[child->getChild(0)] = child;
                 partitionPreds(child, context, indexOut, subnodesOut, mandatorySubnodes);
             }
             else if (MatchExpression::ELEM_MATCH_OBJECT == child->matchType()) {
@@ -43,7 +43,9 @@ namespace mongo {
 
         PlanEnumeratorParams() : intersect(false),
                                  maxSolutionsPerOr(internalQueryEnumerationMaxOrSolutions),
-                                 maxIntersectPerAnd(internalQueryEnumerationMaxIntersectPerAnd) { }
+                                 maxIntersectPerAnd(internalQueryEnumerationMaxIntersectPerAnd),
+                                 intersectCostPruning(internalQueryPlannerIntersectionCostPruning),
+                                 intersectFetchCost(internalQueryPlannerIntersectionFetchCost) { }
 
         // Do we provide solutions that use more indices than the minimum required to provide
         // an indexed solution?
@@ -64,6 +66,13 @@ namespace mongo {
         // all-pairs approach, we could wind up creating a lot of enumeration possibilities for
         // certain inputs.
         size_t maxIntersectPerAnd;
+
+        // Do we drop intersect plans whose indices' key histograms say one of the two indices
+        // alone would do better?  Indices without histograms are always intersected.
+        bool intersectCostPruning;
+
+        // What fetching a document costs, in index keys read, when costing intersections.
+        double intersectFetchCost;
     };
 
     /**
@@ -403,6 +412,22 @@ namespace mongo {
                       const IndexEntry& thisIndex,
                       OneIndexAssignment* assign);
 
+        /**
+         * Estimates, from the key histogram of its index, the fraction of the index that the
+         * predicates 'assign' places over the index's leading field will scan.  Returns false
+         * if the index has no histogram or is not a btree.
+         */
+        bool estimateScanFraction(const OneIndexAssignment& assign, double* fractionOut) const;
+
+        /**
+         * Returns false if key histograms say that intersecting the scans of 'first' and
+         * 'second' costs more than fetching everything the more selective of the two scans
+         * returns.  The cost of a plan is the keys it reads plus intersectFetchCost for each
+         * document it fetches, taking the two scans' predicates to be independent.
+         */
+        bool intersectionMayPay(const OneIndexAssignment& first,
+                                const OneIndexAssignment& second) const;
+
         /**
          * Return the memo entry for 'node'.  Does some sanity checking to ensure that a memo entry
          * actually exists.
@@ -417,6 +442,9 @@ namespace mongo {
         // Map from MemoID to its precomputed solution info.
         unordered_map<MemoID, NodeAssignment*> _memo;
 
+        // Map from a predicate under a bounds generating NOT to the NOT.
+        unordered_map<MatchExpression*, MatchExpression*> _notParents;
+
         // If true, there are no further enumeration states, and getNext should return false.
         // We could be _done immediately after init if we're unable to output an indexed plan.
         bool _done;
@@ -439,6 +467,12 @@ namespace mongo {
 
         // How many things do we want from each AND?
         size_t _intersectLimit;
+
+        // Do we skip intersections that cost more than one of their indices alone?
+        bool _intersectCostPruning;
+
+        // What fetching a document costs in index keys.
+        double _intersectFetchCost;
     };
 
 } // namespace mongo
@@ -33,11 +33,12 @@
 #include "mongo/db/exec/working_set.h"
 #include "mongo/db/exec/working_set_common.h"
 #include "mongo/db/pdfile.h"
+#include "mongo/db/query/query_knobs.h"
 
 namespace mongo {
 
     PlanExecutor::PlanExecutor(WorkingSet* ws, PlanStage* rt)
-        : _workingSet(ws) , _root(rt) , _killed(false) { }
+        : _workingSet(ws) , _root(rt) , _killed(false), _batchPos(0) { }
 
     PlanExecutor::~PlanExecutor() { }
 
@@ -61,7 +62,18 @@ namespace mongo {
     }
 
     void PlanExecutor::invalidate(const DiskLoc& dl, InvalidationType type) {
-        if (!_killed) { _root->invalidate(dl, type); }
+        if (_killed) { return; }
+
+        _root->invalidate(dl, type);
+
+        // Results we're holding for the caller can't keep pointing at 'dl'.
+        for (size_t i = _batchPos; i < _batch.size(); ++i) {
+            if (WorkingSet::INVALID_ID == _batch[i]) { continue; }
+            WorkingSetMember* member = _workingSet->get(_batch[i]);
+            if (member->hasLoc() && (member->loc == dl)) {
+                WorkingSetCommon::fetchAndInvalidateLoc(member);
+            }
+        }
     }
 
     void PlanExecutor::setYieldPolicy(Runner::YieldPolicy policy) {
@@ -77,16 +89,54 @@ namespace mongo {
         if (_killed) { return Runner::RUNNER_DEAD; }
 
         for (;;) {
-            // Yield, if we can yield ourselves.
-            if (NULL != _yieldPolicy.get() && _yieldPolicy->shouldYield()) {
-                saveState();
-                _yieldPolicy->yield();
-                if (_killed) { return Runner::RUNNER_DEAD; }
-                restoreState();
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            PlanStage::StageState code;
+
+            if (_batchPos < _batch.size()) {
+                // Hand out what the last batch produced before doing any more work.
+                id = _batch[_batchPos++];
+                code = PlanStage::ADVANCED;
             }
+            else {
+                // Yield, if we can yield ourselves.
+                if (NULL != _yieldPolicy.get() && _yieldPolicy->shouldYield()) {
+                    saveState();
+                    _yieldPolicy->yield();
+                    if (_killed) { return Runner::RUNNER_DEAD; }
+                    restoreState();
+                }
 
-            WorkingSetID id = WorkingSet::INVALID_ID;
-            PlanStage::StageState code = _root->work(&id);
+                if (internalQueryExecBatchSize <= 1) {
+                    code = _root->work(&id);
+                }
+                else {
+                    _batch.clear();
+                    _batchPos = 0;
+                    code = _root->workBatch(internalQueryExecBatchSize, &_batch, &id);
+
+                    if (PlanStage::ADVANCED == code || PlanStage::NEED_TIME == code) {
+                        continue;
+                    }
+                    else if (PlanStage::NEED_FETCH == code) {
+                        // Page in before handing out the batch; our next call to the plan
+                        // assumes it's done.
+                        if (!fetchRequested(id)) { return Runner::RUNNER_DEAD; }
+                        continue;
+                    }
+                    else if (PlanStage::IS_EOF == code && !_batch.empty()) {
+                        // Hand out the batch first.  The plan stays EOF.
+                        continue;
+                    }
+
+                    // Anything else ends the query; what's left of the batch goes unreturned.
+                    for (size_t i = 0; i < _batch.size(); ++i) {
+                        if (WorkingSet::INVALID_ID != _batch[i]) {
+                            _workingSet->free(_batch[i]);
+                        }
+                    }
+                    _batch.clear();
+                }
+            }
 
             if (PlanStage::ADVANCED == code) {
                 // Fast count.
@@ -138,38 +188,7 @@ namespace mongo {
                 // Fall through to yield check at end of large conditional.
             }
             else if (PlanStage::NEED_FETCH == code) {
-                // id has a loc and refers to an obj we need to fetch.
-                WorkingSetMember* member = _workingSet->get(id);
-
-                // This must be true for somebody to request a fetch and can only change when an
-                // invalidation happens, which is when we give up a lock.  Don't give up the
-                // lock between receiving the NEED_FETCH and actually fetching(?).
-                verify(member->hasLoc());
-
-                // Actually bring record into memory.
-                Record* record = member->loc.rec();
-
-                // If we're allowed to, go to disk outside of the lock.
-                if (NULL != _yieldPolicy.get()) {
-                    saveState();
-                    _yieldPolicy->yield(record);
-                    if (_killed) { return Runner::RUNNER_DEAD; }
-                    restoreState();
-                }
-                else {
-                    // We're set to manually yield.  We go to disk in the lock.
-                    record->touch();
-                }
-
-                // Record should be in memory now.  Log if it's not.
-                if (!Record::likelyInPhysicalMemory(record->dataNoThrowing())) {
-                    OCCASIONALLY {
-                        warning() << "Record wasn't in memory immediately after fetch: "
-                                  << member->loc.toString() << endl;
-                    }
-                }
-
-                // Note that we're not freeing id.  Fetch semantics say that we shouldn't.
+                if (!fetchRequested(id)) { return Runner::RUNNER_DEAD; }
             }
             else if (PlanStage::IS_EOF == code) {
                 return Runner::RUNNER_EOF;
@@ -187,8 +206,44 @@ namespace mongo {
         }
     }
 
+    bool PlanExecutor::fetchRequested(WorkingSetID id) {
+        // id has a loc and refers to an obj we need to fetch.
+        WorkingSetMember* member = _workingSet->get(id);
+
+        // This must be true for somebody to request a fetch and can only change when an
+        // invalidation happens, which is when we give up a lock.  Don't give up the
+        // lock between receiving the NEED_FETCH and actually fetching(?).
+        verify(member->hasLoc());
+
+        // Actually bring record into memory.
+        Record* record = member->loc.rec();
+
+        // If we're allowed to, go to disk outside of the lock.
+        if (NULL != _yieldPolicy.get()) {
+            saveState();
+            _yieldPolicy->yield(record);
+            if (_killed) { return false; }
+            restoreState();
+        }
+        else {
+            // We're set to manually yield.  We go to disk in the lock.
+            record->touch();
+        }
+
+        // Record should be in memory now.  Log if it's not.
+        if (!Record::likelyInPhysicalMemory(record->dataNoThrowing())) {
+            OCCASIONALLY {
+                warning() << "Record wasn't in memory immediately after fetch: "
+                          << member->loc.toString() << endl;
+            }
+        }
+
+        // Note that we're not freeing id.  Fetch semantics say that we shouldn't.
+        return true;
+    }
+
     bool PlanExecutor::isEOF() {
-        return _killed || _root->isEOF();
+        return _killed || (_batchPos >= _batch.size() && _root->isEOF());
     }
 
     void PlanExecutor::kill() {
@@ -29,8 +29,10 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <vector>
 
 #include "mongo/base/status.h"
+#include "mongo/db/exec/working_set.h"
 #include "mongo/db/query/runner.h"
 #include "mongo/db/query/runner_yield_policy.h"
 
@@ -40,7 +42,6 @@ namespace mongo {
     class DiskLoc;
     class PlanStage;
     struct PlanStageStats;
-    class WorkingSet;
 
     /**
      * A PlanExecutor is the abstraction that knows how to crank a tree of stages into execution.
@@ -99,6 +100,12 @@ namespace mongo {
         void kill();
 
     private:
+        /**
+         * Pages in the record that the WSM 'id' refers to, as asked for by a NEED_FETCH.  Returns
+         * false if we were killed while yielding for it.
+         */
+        bool fetchRequested(WorkingSetID id);
+
         boost::scoped_ptr<WorkingSet> _workingSet;
         boost::scoped_ptr<PlanStage> _root;
         boost::scoped_ptr<RunnerYieldPolicy> _yieldPolicy;
@@ -106,6 +113,11 @@ namespace mongo {
         // Did somebody drop an index we care about or the namespace we're looking at?  If so,
         // we'll be killed.
         bool _killed;
+
+        // With internalQueryExecBatchSize above 1, the results of the plan's last workBatch(...)
+        // that getNext(...) has yet to return, from _batchPos on.
+        std::vector<WorkingSetID> _batch;
+        size_t _batchPos;
     };
 
 }  // namespace mongo
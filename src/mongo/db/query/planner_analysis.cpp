@@ -654,6 +654,13 @@ namespace mongo {
                 }
             }
 
+            // If the caller can do without the projection rather than fetch for it, bail out.
+            if (solnRoot->fetched()
+                    && (params.options & QueryPlannerParams::NO_UNCOVERED_PROJECTIONS)) {
+                delete solnRoot;
+                return NULL;
+            }
+
             // We now know we have whatever data is required for the projection.
             ProjectionNode* projNode = new ProjectionNode();
             projNode->children.push_back(solnRoot);
@@ -46,6 +46,10 @@ namespace mongo {
 
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryCacheWriteOpsBetweenFlush, int, 1000);
 
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryCacheRevalidateAfterWrites, bool, true);
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryCacheRevalidationRatio, double, 0.5);
+
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlannerMaxIndexedSolutions, int, 64);
 
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryEnumerationMaxOrSolutions, int, 10);
@@ -58,4 +62,12 @@ namespace mongo {
 
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlanOrChildrenIndependently, bool, true);
 
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlannerIntersectionCostPruning, bool, true);
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryPlannerIntersectionFetchCost, double, 10.0);
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryIndexStatsSamples, int, 200);
+
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryExecBatchSize, int, 0);
+
 }  // namespace mongo
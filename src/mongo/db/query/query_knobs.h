@@ -66,9 +66,17 @@ namespace mongo {
     // entry from the cache?
     extern double internalQueryCacheStdDeviations;
 
-    // How many write ops should we allow in a collection before tossing all cache entries?
+    // How many write ops should we allow in a collection before tossing all cache entries?  With
+    // internalQueryCacheRevalidateAfterWrites, entries are revalidated rather than tossed.
     extern int internalQueryCacheWriteOpsBetweenFlush;
 
+    // Should a write burst mark cache entries for revalidation instead of flushing them?
+    extern bool internalQueryCacheRevalidateAfterWrites;
+
+    // A cached plan's first run after a write burst must be at least this fraction as productive
+    // (results per unit of work) as it was when it won its trial, or the entry is evicted.
+    extern double internalQueryCacheRevalidationRatio;
+
     //
     // Planning and enumeration.
     //
@@ -85,4 +93,22 @@ namespace mongo {
     // Do we want to plan each child of the OR independently?
     extern bool internalQueryPlanOrChildrenIndependently;
 
+    // Do we skip intersection plans that index key histograms say can't beat one of their
+    // indices alone?
+    extern bool internalQueryPlannerIntersectionCostPruning;
+
+    // How many index keys is fetching one document worth, when costing an intersection?
+    extern double internalQueryPlannerIntersectionFetchCost;
+
+    // How many samples does an index key histogram keep?
+    extern int internalQueryIndexStatsSamples;
+
+    //
+    // Execution.
+    //
+
+    // How many units of work does a PlanExecutor ask of its plan at a time?  Above 1, results
+    // are produced a batch ahead of the caller (see PlanStage::workBatch); 0 or 1 is one at a time.
+    extern int internalQueryExecBatchSize;
+
 }  // namespace mongo
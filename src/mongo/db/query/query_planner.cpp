@@ -791,7 +791,12 @@ namespace mongo {
         if (!hintIndex.isEmpty()) {
             if (0 == out->size()) {
                 QuerySolution* soln = buildWholeIXSoln(params.indices[hintIndexNumber], query, params);
-                verify(NULL != soln);
+                if (NULL == soln) {
+                    // The options ruled out scanning the index this way, e.g. by requiring that
+                    // it cover the projection.
+                    return Status(ErrorCodes::BadValue,
+                                  "hinted index cannot be used with the given planner options");
+                }
                 QLOG() << "Planner: outputting soln that uses hinted index as scan." << endl;
                 out->push_back(soln);
             }
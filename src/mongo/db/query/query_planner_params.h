@@ -81,7 +81,12 @@ namespace mongo {
             // Set this if you want to handle batchSize properly with sort(). If limits on SORT
             // stages are always actually limits, then this should be left off. If they are
             // sometimes to be interpreted as batchSize, then this should be turned on.
-            SPLIT_LIMITED_SORT = 1 << 7
+            SPLIT_LIMITED_SORT = 1 << 7,
+
+            // Set this if you only want plans that answer the projection from index keys, without
+            // fetching documents.  Plans that would need a fetch are dropped, so planning fails
+            // if no index covers the query.  Has no effect on queries without a projection.
+            NO_UNCOVERED_PROJECTIONS = 1 << 8
         };
 
         // See Options enum above.
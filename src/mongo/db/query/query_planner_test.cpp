@@ -90,6 +90,18 @@ namespace {
             params.indices.push_back(IndexEntry(keyPattern, false, false, "foo", infoObj));
         }
 
+        /**
+         * Gives the last index added a histogram of 'numKeys' keys spread evenly over the
+         * values 0 to 'distinct' - 1.
+         */
+        void setHistogram(int numKeys, int distinct) {
+            IndexKeyHistogram::Builder builder(numKeys, internalQueryIndexStatsSamples);
+            for (int i = 0; i < numKeys; ++i) {
+                builder.add(BSON("" << i / (numKeys / distinct)));
+            }
+            params.indices.back().keyHistogram.reset(builder.done());
+        }
+
         //
         // Execute planner.
         //
@@ -3815,6 +3827,44 @@ namespace {
                                 "{filter: null, pattern: {a: 1}}}}}]}}}}");
     }
 
+    TEST_F(QueryPlannerTest, NoUncoveredProjectionsBasic) {
+        params.options = QueryPlannerParams::NO_UNCOVERED_PROJECTIONS;
+        addIndex(BSON("a" << 1 << "b" << 1));
+        addIndex(BSON("a" << 1 << "c" << 1));
+
+        // Only the index holding b covers the projection.
+        runQuerySortProj(fromjson("{a: {$gt: 1}}"), BSONObj(), fromjson("{_id: 0, a: 1, b: 1}"));
+        assertNumSolutions(1U);
+        assertSolutionExists("{proj: {spec: {_id: 0, a: 1, b: 1}, node: "
+                                "{ixscan: {filter: null, pattern: {a: 1, b: 1}}}}}");
+
+        // A filter on a field not in the index makes a fetch.
+        runQuerySortProj(fromjson("{a: {$gt: 1}, d: 2}"), BSONObj(),
+                         fromjson("{_id: 0, a: 1, b: 1}"));
+        assertNumSolutions(0U);
+
+        // Without a projection the option changes nothing.
+        runQuery(fromjson("{a: {$gt: 1}}"));
+        assertNumSolutions(2U);
+    }
+
+    TEST_F(QueryPlannerTest, NoUncoveredProjectionsMultikey) {
+        params.options = QueryPlannerParams::NO_UNCOVERED_PROJECTIONS;
+        addIndex(BSON("a" << 1 << "b" << 1), true);
+        runQuerySortProj(fromjson("{a: {$gt: 1}}"), BSONObj(), fromjson("{_id: 0, a: 1, b: 1}"));
+        assertNumSolutions(0U);
+    }
+
+    TEST_F(QueryPlannerTest, NoUncoveredProjectionsSort) {
+        params.options = QueryPlannerParams::NO_UNCOVERED_PROJECTIONS
+                       | QueryPlannerParams::NO_BLOCKING_SORT;
+        addIndex(BSON("a" << 1 << "b" << 1));
+        runQuerySortProj(BSONObj(), fromjson("{a: 1}"), fromjson("{_id: 0, a: 1, b: 1}"));
+        assertNumSolutions(1U);
+        assertSolutionExists("{proj: {spec: {_id: 0, a: 1, b: 1}, node: "
+                                "{ixscan: {filter: null, pattern: {a: 1, b: 1}}}}}");
+    }
+
     //
     // Index Intersection.
     //
@@ -3834,6 +3884,38 @@ namespace {
                                     "{ixscan: {filter: null, pattern: {b:1}}}]}}}}");
     }
 
+    // The histograms say the scan of {b: 1} reads half the index and that of {a: 1} 1%.
+    // Intersecting them can't beat scanning {a: 1} alone.
+    TEST_F(QueryPlannerTest, IntersectPrunedByHistograms) {
+        params.options = QueryPlannerParams::NO_TABLE_SCAN | QueryPlannerParams::INDEX_INTERSECTION;
+        addIndex(BSON("a" << 1));
+        setHistogram(1000, 1000);
+        addIndex(BSON("b" << 1));
+        setHistogram(1000, 2);
+        runQuery(fromjson("{a: {$gte: 500, $lt: 510}, b: 1}"));
+
+        assertNumSolutions(2U);
+        assertSolutionExists("{fetch: {filter: {b: 1}, node: "
+                                 "{ixscan: {filter: null, pattern: {a: 1}}}}}");
+        assertSolutionExists("{fetch: {filter: {a: {$gte: 500, $lt: 510}}, node: "
+                                 "{ixscan: {filter: null, pattern: {b: 1}}}}}");
+    }
+
+    // Both scans read 10% of their index, so intersecting them fetches far fewer documents.
+    TEST_F(QueryPlannerTest, IntersectKeptByHistograms) {
+        params.options = QueryPlannerParams::NO_TABLE_SCAN | QueryPlannerParams::INDEX_INTERSECTION;
+        addIndex(BSON("a" << 1));
+        setHistogram(1000, 1000);
+        addIndex(BSON("b" << 1));
+        setHistogram(1000, 10);
+        runQuery(fromjson("{a: {$gte: 0, $lt: 100}, b: 3}"));
+
+        assertNumSolutions(3U);
+        assertSolutionExists("{fetch: {filter: null, node: {andHash: {nodes: ["
+                                    "{ixscan: {filter: null, pattern: {a:1}}},"
+                                    "{ixscan: {filter: null, pattern: {b:1}}}]}}}}");
+    }
+
     TEST_F(QueryPlannerTest, IntersectBasicTwoPredCompound) {
         params.options = QueryPlannerParams::NO_TABLE_SCAN | QueryPlannerParams::INDEX_INTERSECTION;
         addIndex(BSON("a" << 1 << "c" << 1));
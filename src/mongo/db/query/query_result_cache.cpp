@@ -0,0 +1,184 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/db/query/query_result_cache.h"
+
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/s/d_logic.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_SERVER_PARAMETER(queryResultCacheEnabled, bool, false);
+
+    MONGO_EXPORT_SERVER_PARAMETER(queryResultCacheMaxBytes, int, 64 * 1024 * 1024);
+
+    namespace {
+
+        // What an entry costs beyond its key and results: list node, map node and header.
+        const int kEntryOverhead = 128;
+
+        // No entry may take more than this fraction of the cache.
+        const int kMaxEntryFraction = 8;
+
+        std::string makeKey(const StringData& ns, const BSONObj& key) {
+            std::string s = ns.toString();
+            s.push_back('\0');
+            s.append(key.objdata(), key.objsize());
+            return s;
+        }
+
+        long long entrySize(const std::string& key, const BSONObj& results) {
+            return key.size() + results.objsize() + kEntryOverhead;
+        }
+
+    } // namespace
+
+    QueryResultCache::QueryResultCache()
+        : _mutex("QueryResultCache"),
+          _bytes(0),
+          _hits(0),
+          _misses(0),
+          _invalidations(0),
+          _evictions(0) { }
+
+    bool QueryResultCache::get(const StringData& ns, const BSONObj& key,
+                               unsigned long long generation, BSONObj* out) {
+        std::string k = makeKey(ns, key);
+
+        SimpleMutex::scoped_lock lk(_mutex);
+        EntryMap::iterator it = _entries.find(k);
+        if (_entries.end() == it) {
+            ++_misses;
+            return false;
+        }
+
+        if (it->second->generation != generation) {
+            // The collection has been written since; the entry can never be served again.
+            ++_misses;
+            ++_invalidations;
+            _erase(it);
+            return false;
+        }
+
+        ++_hits;
+        _lru.splice(_lru.begin(), _lru, it->second);
+        *out = it->second->results;
+        return true;
+    }
+
+    void QueryResultCache::put(const StringData& ns, const BSONObj& key,
+                               unsigned long long generation, const BSONObj& results) {
+        std::string k = makeKey(ns, key);
+        long long size = entrySize(k, results);
+        if (size > queryResultCacheMaxBytes / kMaxEntryFraction) {
+            return;
+        }
+        BSONObj owned = results.getOwned();
+
+        SimpleMutex::scoped_lock lk(_mutex);
+        EntryMap::iterator it = _entries.find(k);
+        if (_entries.end() != it) {
+            _erase(it);
+        }
+
+        while (!_lru.empty() && _bytes + size > queryResultCacheMaxBytes) {
+            ++_evictions;
+            _erase(_entries.find(_lru.back().key));
+        }
+
+        Entry entry;
+        entry.key = k;
+        entry.generation = generation;
+        entry.results = owned;
+        _lru.push_front(entry);
+        _entries[k] = _lru.begin();
+        _bytes += size;
+    }
+
+    void QueryResultCache::clear() {
+        SimpleMutex::scoped_lock lk(_mutex);
+        _lru.clear();
+        _entries.clear();
+        _bytes = 0;
+    }
+
+    void QueryResultCache::_erase(EntryMap::iterator it) {
+        _bytes -= entrySize(it->second->key, it->second->results);
+        _lru.erase(it->second);
+        _entries.erase(it);
+    }
+
+    void QueryResultCache::appendStats(BSONObjBuilder* b) const {
+        SimpleMutex::scoped_lock lk(_mutex);
+        b->append("enabled", queryResultCacheEnabled);
+        b->appendNumber("entries", static_cast<long long>(_entries.size()));
+        b->appendNumber("bytes", _bytes);
+        b->appendNumber("maxBytes", queryResultCacheMaxBytes);
+        b->appendNumber("hits", _hits);
+        b->appendNumber("misses", _misses);
+        b->appendNumber("invalidations", _invalidations);
+        b->appendNumber("evictions", _evictions);
+    }
+
+    // static
+    bool QueryResultCache::canCacheFor(const Collection* collection) {
+        if (NULL == collection || collection->isCapped()) {
+            return false;
+        }
+        const NamespaceString& ns = collection->ns();
+        if (ns.isSystem()) {
+            return false;
+        }
+        return !shardingState.needCollectionMetadata(ns.ns());
+    }
+
+    QueryResultCache& queryResultCache() {
+        static QueryResultCache cache;
+        return cache;
+    }
+
+    //
+    // Hits, misses and evictions.
+    //
+
+    class QueryResultCacheServerStatus : public ServerStatusSection {
+    public:
+        QueryResultCacheServerStatus() : ServerStatusSection("queryResultCache") { }
+        virtual bool includeByDefault() const { return true; }
+
+        BSONObj generateSection(const BSONElement& configElement) const {
+            BSONObjBuilder b;
+            queryResultCache().appendStats(&b);
+            return b.obj();
+        }
+    } queryResultCacheServerStatus;
+
+}  // namespace mongo
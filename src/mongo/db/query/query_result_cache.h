@@ -0,0 +1,125 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#pragma once
+
+#include <boost/unordered_map.hpp>
+#include <list>
+#include <string>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/util/concurrency/mutex.h"
+
+namespace mongo {
+
+    class Collection;
+
+    // Do we serve repeated reads from the result cache?  Off by default.
+    extern bool queryResultCacheEnabled;
+
+    // How many bytes of results may the cache hold?
+    extern int queryResultCacheMaxBytes;
+
+    /**
+     * Complete results of read queries, so that a query repeated against a collection that has
+     * not been written since is answered without planning or running anything.
+     *
+     * Entries are keyed by namespace and a BSON description of the query, and remember the
+     * collection's write generation (CollectionInfoCache::getWriteGeneration) when they were
+     * read.  An entry is served only while the generation is unchanged, and dropped the first
+     * time it is found to be stale.  One cache is shared by all collections; it holds at most
+     * queryResultCacheMaxBytes of results, evicting the least recently used entries.
+     *
+     * Thread safe.
+     */
+    class QueryResultCache {
+        MONGO_DISALLOW_COPYING(QueryResultCache);
+    public:
+        QueryResultCache();
+
+        /**
+         * Returns true and fills 'out' with what put() was given for the query if it is cached
+         * at 'generation'.
+         */
+        bool get(const StringData& ns, const BSONObj& key, unsigned long long generation,
+                 BSONObj* out);
+
+        /**
+         * Caches 'results', read at 'generation', for the query.  Results too large to leave
+         * room for a few others are not cached.
+         */
+        void put(const StringData& ns, const BSONObj& key, unsigned long long generation,
+                 const BSONObj& results);
+
+        /**
+         * Drops every entry.
+         */
+        void clear();
+
+        /**
+         * Appends entry, byte and hit/miss/eviction counts to 'b'.
+         */
+        void appendStats(BSONObjBuilder* b) const;
+
+        /**
+         * True if a query over 'collection' may be cached at all: not capped (its documents can
+         * be truncated without a write), and not sharded (chunk migrations change what a shard
+         * should return without writing to the collection), and not a system collection.
+         */
+        static bool canCacheFor(const Collection* collection);
+
+    private:
+        struct Entry {
+            std::string key;
+            unsigned long long generation;
+            BSONObj results;
+        };
+
+        typedef std::list<Entry> EntryList;
+        typedef boost::unordered_map<std::string, EntryList::iterator> EntryMap;
+
+        void _erase(EntryMap::iterator it);
+
+        mutable SimpleMutex _mutex;
+
+        // Most recently used first.
+        EntryList _lru;
+        EntryMap _entries;
+
+        long long _bytes;
+        long long _hits;
+        long long _misses;
+        long long _invalidations;
+        long long _evictions;
+    };
+
+    QueryResultCache& queryResultCache();
+
+}  // namespace mongo
@@ -427,6 +427,10 @@ namespace replset {
         return _buffer.peek(*op);
     }
 
+    void BackgroundSync::peekAhead(size_t skip, size_t limit, std::vector<BSONObj>* ops) {
+        _buffer.peekRange(skip, limit, ops);
+    }
+
     void BackgroundSync::waitForMore() {
         BSONObj op;
         // Block for one second before timing out.
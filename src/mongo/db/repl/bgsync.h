@@ -49,6 +49,10 @@ namespace replset {
         // false if the queue was empty.
         virtual bool peek(BSONObj* op) = 0;
 
+        // Copies up to 'limit' ops that follow the first 'skip' in the buffer into 'ops',
+        // without removing them; used to prefetch ops ahead of the batch being applied.
+        virtual void peekAhead(size_t skip, size_t limit, std::vector<BSONObj>* ops) = 0;
+
         // Deletes objects in the queue;
         // called by sync thread after it has applied an op
         virtual void consume() = 0;
@@ -141,6 +145,7 @@ namespace replset {
         // Interface implementation
 
         virtual bool peek(BSONObj* op);
+        virtual void peekAhead(size_t skip, size_t limit, std::vector<BSONObj>* ops);
         virtual void consume();
         virtual const Member* getSyncTarget();
         virtual void waitForMore();
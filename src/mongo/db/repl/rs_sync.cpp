@@ -84,10 +84,18 @@ namespace replset {
     static Counter64 opsAppliedStats;
     static ServerStatusMetricField<Counter64> displayOpsApplied( "repl.apply.ops",
                                                                 &opsAppliedStats );
+    //The oplog entries prefetched while an earlier batch was being applied
+    static Counter64 prefetchAheadStats;
+    static ServerStatusMetricField<Counter64> displayPrefetchAhead( "repl.preload.aheadOps",
+                                                                   &prefetchAheadStats );
+
+    // How far ahead of the batch being applied to prefetch, in batches of
+    // replBatchLimitOperations ops.  0 prefetches each batch only once it is ready to apply.
+    MONGO_EXPORT_SERVER_PARAMETER(replPrefetchDepth, int, 1);
 
 
     SyncTail::SyncTail(BackgroundSyncInterface *q) :
-        Sync(""), oplogVersion(0), _networkQueue(q)
+        Sync(""), oplogVersion(0), _networkQueue(q), _prefetchedAhead(0)
     {}
 
     SyncTail::~SyncTail() {}
@@ -139,6 +147,9 @@ namespace replset {
     void initializePrefetchThread() {
         if (!ClientBasic::getCurrent()) {
             Client::initThread("repl prefetch worker");
+            // prefetchAhead() runs while a batch is applied.  prefetching only pages data in, so
+            // it may see the batch half applied.
+            Lock::ParallelBatchWriterMode::iAmABatchParticipant();
             replLocalAuth();
         }
     }
@@ -233,15 +244,33 @@ namespace replset {
     }
 
     // Doles out all the work to the reader pool threads and waits for them to complete
-    void SyncTail::prefetchOps(const std::deque<BSONObj>& ops) {
+    void SyncTail::prefetchOps(const std::deque<BSONObj>& ops, size_t skip) {
         threadpool::ThreadPool& prefetcherPool = theReplSet->getPrefetchPool();
-        for (std::deque<BSONObj>::const_iterator it = ops.begin();
+        for (std::deque<BSONObj>::const_iterator it = ops.begin() + skip;
              it != ops.end();
              ++it) {
             prefetcherPool.schedule(&prefetchOp, *it);
         }
         prefetcherPool.join();
     }
+
+    // Doles out the ops waiting in the network queue to the reader pool threads, up to
+    // replPrefetchDepth batches' worth, and returns without waiting for them
+    void SyncTail::prefetchAhead() {
+        const size_t depthOps = std::max(replPrefetchDepth, 0) * replBatchLimitOperations;
+        if (_prefetchedAhead >= depthOps)
+            return;
+
+        std::vector<BSONObj> ops;
+        _networkQueue->peekAhead(_prefetchedAhead, depthOps - _prefetchedAhead, &ops);
+
+        threadpool::ThreadPool& prefetcherPool = theReplSet->getPrefetchPool();
+        for (std::vector<BSONObj>::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+            prefetcherPool.schedule(&prefetchOp, *it);
+        }
+        _prefetchedAhead += ops.size();
+        prefetchAheadStats.increment(ops.size());
+    }
     
     // Doles out all the work to the writer pool threads and waits for them to complete
     void SyncTail::applyOps(const std::vector< std::vector<BSONObj> >& writerVectors, 
@@ -261,12 +290,19 @@ namespace replset {
     // Doles out all the work to the writer pool threads and waits for them to complete
     void SyncTail::multiApply( std::deque<BSONObj>& ops, MultiSyncApplyFunc applyFunc ) {
 
-        // Use a ThreadPool to prefetch all the operations in a batch.
-        prefetchOps(ops);
+        // Use a ThreadPool to prefetch all the operations in a batch.  The first of them may
+        // have been scheduled by prefetchAhead() while the previous batch was applied.
+        size_t prefetched = std::min(_prefetchedAhead, ops.size());
+        _prefetchedAhead -= prefetched;
+        prefetchOps(ops, prefetched);
         
         std::vector< std::vector<BSONObj> > writerVectors(theReplSet->replWriterThreadCount);
         fillWriterVectors(ops, &writerVectors);
         LOG(2) << "replication batch size is " << ops.size() << endl;
+
+        // Page in the ops queued behind this batch while it is applied
+        prefetchAhead();
+
         // We must grab this because we're going to grab write locks later.
         // We hold this mutex the entire time we're writing; it doesn't matter
         // because all readers are blocked anyway.
@@ -123,11 +123,18 @@ namespace replset {
     private:
         BackgroundSyncInterface* _networkQueue;
 
-        // Doles out all the work to the reader pool threads and waits for them to complete
-        void prefetchOps(const std::deque<BSONObj>& ops);
+        // Doles out all the work, after the first 'skip' ops, to the reader pool threads and
+        // waits for them to complete
+        void prefetchOps(const std::deque<BSONObj>& ops, size_t skip);
+        // Starts the reader pool on the ops queued after the batch about to be applied, without
+        // waiting for them
+        void prefetchAhead();
         // Used by the thread pool readers to prefetch an op
         static void prefetchOp(const BSONObj& op);
 
+        // Ops at the front of the network queue that prefetchAhead() has already scheduled
+        size_t _prefetchedAhead;
+
         // Doles out all the work to the writer pool threads and waits for them to complete
         void applyOps(const std::vector< std::vector<BSONObj> >& writerVectors, 
                       MultiSyncApplyFunc applyFunc);
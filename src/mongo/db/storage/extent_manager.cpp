@@ -38,6 +38,8 @@
 #include "mongo/db/storage/data_file.h"
 #include "mongo/db/storage/extent.h"
 #include "mongo/db/storage/extent_manager.h"
+#include "mongo/db/storage/extent_prewarmer.h"
+#include "mongo/util/file_allocator.h"
 
 #include "mongo/db/pdfile.h"
 
@@ -48,7 +50,12 @@ namespace mongo {
                                   bool directoryPerDB )
         : _dbname( dbname.toString() ),
           _path( path.toString() ),
-          _directoryPerDB( directoryPerDB ) {
+          _directoryPerDB( directoryPerDB ),
+          _allocationMutex( "ExtentManager::_allocationMutex" ),
+          _lastFileAddedMillis( 0 ) {
+        // collection level writers read _files while another may be adding a file, so it must
+        // never be reallocated
+        _files.reserve( DiskLoc::MaxFiles );
     }
 
     ExtentManager::~ExtentManager() {
@@ -60,6 +67,7 @@ namespace mongo {
             delete _files[i];
         }
         _files.clear();
+        _numFiles.store( 0 );
     }
 
     boost::filesystem::path ExtentManager::fileName( int n ) const {
@@ -97,6 +105,7 @@ namespace mongo {
 
             _files.push_back( df.release() );
         }
+        _numFiles.store( _files.size() );
 
         return Status::OK();
     }
@@ -104,9 +113,10 @@ namespace mongo {
     const DataFile* ExtentManager::_getOpenFile( int n ) const {
         verify(this);
         DEV Lock::assertAtLeastReadLocked( _dbname );
-        if ( n < 0 || n >= static_cast<int>(_files.size()) )
+        const int numFiles = static_cast<int>( _numFiles.load() );
+        if ( n < 0 || n >= numFiles )
             log() << "uh oh: " << n;
-        verify( n >= 0 && n < static_cast<int>(_files.size()) );
+        verify( n >= 0 && n < numFiles );
         return _files[n];
     }
 
@@ -128,26 +138,29 @@ namespace mongo {
         }
         DataFile* p = 0;
         if ( !preallocateOnly ) {
-            while ( n >= (int) _files.size() ) {
+            if ( n >= static_cast<int>( _numFiles.load() ) ) {
                 verify(this);
-                if( !Lock::isWriteLocked(_dbname) ) {
+                if( !Lock::atLeastIntentWriteLocked(_dbname) ) {
                     log() << "error: getFile() called in a read lock, yet file to return is not yet open" << endl;
-                    log() << "       getFile(" << n << ") _files.size:" <<_files.size() << ' ' << fileName(n).string() << endl;
+                    log() << "       getFile(" << n << ") _files.size:" << _numFiles.load() << ' ' << fileName(n).string() << endl;
                     log() << "       context ns: " << cc().ns() << endl;
                     verify(false);
                 }
-                _files.push_back(0);
+                // only addAFile() grows _files without an exclusive lock, and it holds
+                // _allocationMutex, so there is a single writer here
+                while ( n >= static_cast<int>( _files.size() ) )
+                    _files.push_back(0);
             }
             p = _files[n];
         }
         if ( p == 0 ) {
             if ( n == 0 ) audit::logCreateDatabase( currentClient.get(), _dbname );
-            DEV Lock::assertWriteLocked( _dbname );
+            DEV verify( Lock::atLeastIntentWriteLocked( _dbname ) );
             boost::filesystem::path fullName = fileName( n );
             string fullNameString = fullName.string();
             p = new DataFile(n);
             int minSize = 0;
-            if ( n != 0 && _files[ n - 1 ] )
+            if ( n != 0 && n <= static_cast<int>( _files.size() ) && _files[ n - 1 ] )
                 minSize = _files[ n - 1 ]->getHeader()->fileLength;
             if ( sizeNeeded + DataFileHeader::HeaderSize > minSize )
                 minSize = sizeNeeded + DataFileHeader::HeaderSize;
@@ -165,24 +178,43 @@ namespace mongo {
             }
             if ( preallocateOnly )
                 delete p;
-            else
+            else {
                 _files[n] = p;
+                if ( n >= static_cast<int>( _numFiles.load() ) )
+                    _numFiles.store( _files.size() );
+            }
         }
         return preallocateOnly ? 0 : p;
     }
 
     DataFile* ExtentManager::addAFile( int sizeNeeded, bool preallocateNextFile ) {
-        DEV Lock::assertWriteLocked( _dbname );
-        int n = (int) _files.size();
+        DEV verify( Lock::atLeastIntentWriteLocked( _dbname ) );
+        int n = static_cast<int>( _numFiles.load() );
         DataFile *ret = getFile( n, sizeNeeded );
-        if ( preallocateNextFile )
-            preallocateAFile();
+        if ( preallocateNextFile ) {
+            int ahead = _filesToPreallocate();
+            for ( int i = n + 1; i <= n + ahead && i < DiskLoc::MaxFiles; i++ )
+                getFile( i, 0, true );
+        }
         return ret;
     }
 
+    int ExtentManager::_filesToPreallocate() {
+        // allocate far enough ahead that, at the pace the FileAllocator made its last file, the
+        // next files are ready before writes fill the one just added as fast as the last one
+        const int maxAhead = 3;
+        long long now = curTimeMillis64();
+        long long fillMillis = _lastFileAddedMillis ? now - _lastFileAddedMillis : 0;
+        _lastFileAddedMillis = now;
+        if ( fillMillis <= 0 )
+            return 1;
+        long long allocMillis = FileAllocator::get()->lastAllocationMillis();
+        return static_cast<int>( std::min<long long>( maxAhead, 1 + allocMillis / fillMillis ) );
+    }
+
     size_t ExtentManager::numFiles() const {
         DEV Lock::assertAtLeastReadLocked( _dbname );
-        return _files.size();
+        return _numFiles.load();
     }
 
     long long ExtentManager::fileSize() const {
@@ -194,9 +226,9 @@ namespace mongo {
 
     void ExtentManager::flushFiles( bool sync ) {
         DEV Lock::assertAtLeastReadLocked( _dbname );
-        for( vector<DataFile*>::iterator i = _files.begin(); i != _files.end(); i++ ) {
-            DataFile *f = *i;
-            f->flush(sync);
+        const size_t numFiles = _numFiles.load();
+        for( size_t i = 0; i < numFiles; i++ ) {
+            _files[i]->flush(sync);
         }
     }
 
@@ -381,7 +413,7 @@ namespace mongo {
         // no space in an existing file
         // allocate files until we either get one big enough or hit maxSize
         for ( int i = 0; i < 8; i++ ) {
-            DataFile* f = addAFile( size, false );
+            DataFile* f = addAFile( size, true );
 
             if ( f->getHeader()->unusedLength >= size ) {
                 return _createExtentInFile( numFiles() - 1, f, size, maxFileNoForQuota );
@@ -483,24 +515,33 @@ namespace mongo {
                                                 int quotaMax ) {
 
         bool fromFreeList = true;
-        DiskLoc eloc = allocFromFreeList( size, details->isCapped() );
-        if ( eloc.isNull() ) {
-            fromFreeList = false;
-            eloc = createExtent( size, quotaMax );
+        DiskLoc eloc;
+        {
+            // the free list and the files are shared by all collections, which may be written
+            // concurrently under collection level locking
+            SimpleMutex::scoped_lock lk( _allocationMutex );
+            eloc = allocFromFreeList( size, details->isCapped() );
+            if ( eloc.isNull() ) {
+                fromFreeList = false;
+                eloc = createExtent( size, quotaMax );
+            }
         }
 
         verify( !eloc.isNull() );
         verify( eloc.isValid() );
 
+        Extent *e = getExtent( eloc, false );
+        verify( e );
+
+        if ( !fromFreeList )
+            prewarmExtent( _dbname, _path, eloc, e->length );
+
         LOG(1) << "ExtentManager::increaseStorageSize"
                << " ns:" << ns
                << " desiredSize:" << size
                << " fromFreeList: " << fromFreeList
                << " eloc: " << eloc;
 
-        Extent *e = getExtent( eloc, false );
-        verify( e );
-
         DiskLoc emptyLoc = getDur().writing(e)->reuse( ns,
                                                        details->isCapped() );
 
@@ -526,11 +567,24 @@ namespace mongo {
         return e;
     }
 
+    namespace {
+        AtomicUInt64 freeGenerationCounter;
+    }
+
+    // static
+    unsigned long long ExtentManager::freeGeneration() {
+        return freeGenerationCounter.load();
+    }
+
     void ExtentManager::freeExtents(DiskLoc firstExt, DiskLoc lastExt) {
 
         if ( firstExt.isNull() && lastExt.isNull() )
             return;
 
+        freeGenerationCounter.fetchAndAdd( 1 );
+
+        SimpleMutex::scoped_lock lk( _allocationMutex );
+
         {
             verify( !firstExt.isNull() && !lastExt.isNull() );
             Extent *f = getExtent( firstExt );
@@ -556,27 +610,27 @@ namespace mongo {
     }
 
     DiskLoc ExtentManager::_getFreeListStart() const {
-        if ( _files.empty() )
+        if ( _numFiles.load() == 0 )
             return DiskLoc();
         const DataFile* file = _getOpenFile(0);
         return file->header()->freeListStart;
     }
 
     DiskLoc ExtentManager::_getFreeListEnd() const {
-        if ( _files.empty() )
+        if ( _numFiles.load() == 0 )
             return DiskLoc();
         const DataFile* file = _getOpenFile(0);
         return file->header()->freeListEnd;
     }
 
     void ExtentManager::_setFreeListStart( DiskLoc loc ) {
-        invariant( !_files.empty() );
+        invariant( _numFiles.load() != 0 );
         DataFile* file = _files[0];
         getDur().writingDiskLoc( file->header()->freeListStart ) = loc;
     }
 
     void ExtentManager::_setFreeListEnd( DiskLoc loc ) {
-        invariant( !_files.empty() );
+        invariant( _numFiles.load() != 0 );
         DataFile* file = _files[0];
         getDur().writingDiskLoc( file->header()->freeListEnd ) = loc;
     }
@@ -38,6 +38,8 @@
 #include "mongo/base/status.h"
 #include "mongo/base/string_data.h"
 #include "mongo/db/diskloc.h"
+#include "mongo/platform/atomic_word.h"
+#include "mongo/util/concurrency/mutex.h"
 
 namespace mongo {
 
@@ -87,6 +89,10 @@ namespace mongo {
 
         DataFile* getFile( int n, int sizeNeeded = 0, bool preallocateOnly = false );
 
+        /**
+         * @param preallocateNextFile - also start allocating the files after it: one, or more
+         *        if files are filling up faster than the FileAllocator can make them
+         */
         DataFile* addAFile( int sizeNeeded, bool preallocateNextFile );
 
         void preallocateAFile() { getFile( numFiles() , 0, true ); }// XXX-ERH
@@ -119,6 +125,12 @@ namespace mongo {
          */
         void freeExtents( DiskLoc firstExt, DiskLoc lastExt );
 
+        /**
+         * changes whenever any database frees extents, so that a list of a collection's extents
+         * taken under a read lock can be reused under a later one while it is unchanged
+         */
+        static unsigned long long freeGeneration();
+
         void printFreeList() const;
 
         void freeListStats( int* numExtents, int64_t* totalFreeSize ) const;
@@ -179,6 +191,8 @@ namespace mongo {
 
         boost::filesystem::path fileName( int n ) const;
 
+        int _filesToPreallocate();
+
 // -----
 
         std::string _dbname; // i.e. "test"
@@ -190,6 +204,17 @@ namespace mongo {
         //   to others and we are in the dbholder lock then.
         std::vector<DataFile*> _files;
 
+        // number of entries of _files readers may look at. Under collection level locking a
+        // writer may add a file while others read, so readers use this rather than
+        // _files.size(); it is stored only once the new entries are filled in.
+        AtomicUInt32 _numFiles;
+
+        // protects the extent free list and adding files; see increaseStorageSize()
+        SimpleMutex _allocationMutex;
+
+        // when addAFile() last added a file, to tell how fast files are filling up
+        long long _lastFileAddedMillis;
+
     };
 
 }
@@ -0,0 +1,163 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/storage/extent_prewarmer.h"
+
+#include <deque>
+
+#include "mongo/base/counter.h"
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/catalog/database_holder.h"
+#include "mongo/db/client.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/d_concurrency.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/storage/data_file.h"
+#include "mongo/db/storage/extent_manager.h"
+#include "mongo/util/background.h"
+#include "mongo/util/touch_pages.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_SERVER_PARAMETER(prewarmNewExtents, bool, true);
+
+    static Counter64 prewarmedBytes;
+    static ServerStatusMetricField<Counter64> displayPrewarmedBytes( "storage.prewarmedBytes",
+                                                                     &prewarmedBytes );
+
+    namespace {
+
+        // smaller extents fill up before a background pass would get to them
+        const int MinPrewarmBytes = 1024 * 1024;
+        // paged in per lock acquisition, so writers are not held off for long
+        const int PrewarmChunkBytes = 1024 * 1024;
+        // prewarming is only a hint, so extents beyond this are not queued
+        const size_t MaxQueuedExtents = 64;
+
+        struct PrewarmRequest {
+            std::string dbname;
+            std::string path;
+            DiskLoc loc;
+            int length;
+        };
+
+        class ExtentPrewarmer : public BackgroundJob {
+        public:
+            ExtentPrewarmer() : _mutex( "ExtentPrewarmer" ) {}
+            virtual ~ExtentPrewarmer() {}
+
+            virtual string name() const { return "ExtentPrewarmer"; }
+
+            void add( const PrewarmRequest& r ) {
+                scoped_lock lk( _mutex );
+                if ( _queue.size() >= MaxQueuedExtents )
+                    return;
+                _queue.push_back( r );
+                _queueNotEmpty.notify_one();
+            }
+
+            virtual void run() {
+                Client::initThread( name().c_str() );
+
+                while ( !inShutdown() ) {
+                    PrewarmRequest r;
+                    {
+                        scoped_lock lk( _mutex );
+                        while ( _queue.empty() )
+                            _queueNotEmpty.wait( lk.boost() );
+                        r = _queue.front();
+                        _queue.pop_front();
+                    }
+
+                    try {
+                        for ( int done = 0; done < r.length; done += PrewarmChunkBytes ) {
+                            if ( !_prewarmChunk( r, done,
+                                                 std::min( PrewarmChunkBytes, r.length - done ) ) )
+                                break;
+                        }
+                    }
+                    catch ( DBException& e ) {
+                        LOG(1) << "ExtentPrewarmer: skipping extent " << r.loc << " in "
+                               << r.dbname << causedBy( e );
+                    }
+                }
+
+                cc().shutdown();
+            }
+
+        private:
+            /** @return false if the extent's database or file has gone away */
+            bool _prewarmChunk( const PrewarmRequest& r, int ofs, int len ) {
+                Lock::DBRead lk( r.dbname );
+                Database* db = dbHolder().get( r.dbname, r.path );
+                if ( !db )
+                    return false;
+
+                ExtentManager& em = db->getExtentManager();
+                if ( r.loc.a() >= static_cast<int>( em.numFiles() ) )
+                    return false;
+                DataFile* f = em.getFile( r.loc.a() );
+                if ( r.loc.getOfs() + ofs + len > f->getHeader()->fileLength )
+                    return false;
+
+                const char* extent = reinterpret_cast<const char*>( em.getExtent( r.loc, false ) );
+                touch_pages( extent + ofs, len );
+                prewarmedBytes.increment( len );
+                return true;
+            }
+
+            mongo::mutex _mutex;
+            boost::condition _queueNotEmpty;
+            std::deque<PrewarmRequest> _queue;
+        };
+
+        ExtentPrewarmer* prewarmer = NULL;
+
+    } // namespace
+
+    void prewarmExtent( const std::string& dbname, const std::string& path,
+                        const DiskLoc& loc, int length ) {
+        if ( !prewarmer || !prewarmNewExtents || length < MinPrewarmBytes )
+            return;
+        PrewarmRequest r;
+        r.dbname = dbname;
+        r.path = path;
+        r.loc = loc;
+        r.length = length;
+        prewarmer->add( r );
+    }
+
+    void startExtentPrewarmer() {
+        verify( !prewarmer );
+        prewarmer = new ExtentPrewarmer();
+        prewarmer->go();
+    }
+
+} // namespace mongo
@@ -358,7 +358,7 @@ namespace mongo {
         KeyNode kn = keyNode(this->n-1);
         recLoc = kn.recordLoc;
         key.assign(kn.key);
-        int keysize = kn.key.dataSize();
+        int keysize = storedKeySize(this->n-1);
 
         massert( 10283 , "rchild not null in btree popBack()", this->nextChild.isNull());
 
@@ -376,7 +376,8 @@ namespace mongo {
     /** add a key.  must be > all existing.  be careful to set next ptr right. */
     template< class V >
     bool BucketBasics<V>::_pushBack(const DiskLoc recordLoc, const Key& key, const Ordering &order, const DiskLoc prevChild) {
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
+        int keySize = keySizeHere(key);
+        int bytesNeeded = keySize + sizeof(_KeyNode);
         if ( bytesNeeded > this->emptySize )
             return false;
         verify( bytesNeeded <= this->emptySize );
@@ -394,10 +395,8 @@ namespace mongo {
         _KeyNode& kn = k(this->n++);
         kn.prevChildBucket = prevChild;
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs( (short) _alloc(key.dataSize()) );
-        short ofs = kn.keyDataOfs();
-        char *p = dataAt(ofs);
-        memcpy(p, key.data(), key.dataSize());
+        kn.setKeyDataOfs( (short) _alloc(keySize) );
+        storeKey(kn.keyDataOfs(), key);
 
         return true;
     }
@@ -414,11 +413,16 @@ namespace mongo {
     bool BucketBasics<V>::basicInsert(const DiskLoc thisLoc, int &keypos, const DiskLoc recordLoc, const Key& key, const Ordering &order) const {
         check( this->n < 1024 );
         check( keypos >= 0 && keypos <= this->n );
-        int bytesNeeded = key.dataSize() + sizeof(_KeyNode);
+        int bytesNeeded = keySizeHere(key) + sizeof(_KeyNode);
         if ( bytesNeeded > this->emptySize ) {
             _pack(thisLoc, order, keypos);
-            if ( bytesNeeded > this->emptySize )
-                return false;
+            if ( bytesNeeded > this->emptySize ) {
+                if ( !_compress(thisLoc, order) )
+                    return false;
+                bytesNeeded = keySizeHere(key) + sizeof(_KeyNode);
+                if ( bytesNeeded > this->emptySize )
+                    return false;
+            }
         }
 
         BucketBasics *b;
@@ -446,10 +450,10 @@ namespace mongo {
         _KeyNode& kn = b->k(keypos);
         kn.prevChildBucket.Null();
         kn.recordLoc = recordLoc;
-        kn.setKeyDataOfs((short) b->_alloc(key.dataSize()) );
-        char *p = b->dataAt(kn.keyDataOfs());
-        getDur().declareWriteIntent(p, key.dataSize());
-        memcpy(p, key.data(), key.dataSize());
+        int keySize = bytesNeeded - sizeof(_KeyNode);
+        kn.setKeyDataOfs((short) b->_alloc(keySize) );
+        getDur().declareWriteIntent(b->dataAt(kn.keyDataOfs()), keySize);
+        b->storeKey(kn.keyDataOfs(), key);
         return true;
     }
 
@@ -467,12 +471,12 @@ namespace mongo {
         if ( this->flags & Packed ) {
             return V::BucketSize - this->emptySize - headerSize();
         }
-        int size = 0;
+        int size = this->keyPrefixLen();
         for( int j = 0; j < this->n; ++j ) {
             if ( mayDropKey( j, refPos ) ) {
                 continue;
             }
-            size += keyNode( j ).key.dataSize() + sizeof( _KeyNode );
+            size += storedKeySize( j ) + sizeof( _KeyNode );
         }
         return size;
     }
@@ -508,6 +512,14 @@ namespace mongo {
         char temp[V::BucketSize];
         int ofs = tdz;
         this->topSize = 0;
+        // the key prefix stays on top, so keys keep their storage
+        int prefixLen = this->keyPrefixLen();
+        if ( prefixLen ) {
+            ofs -= prefixLen;
+            this->topSize += prefixLen;
+            memcpy(temp+ofs, this->keyPrefix(), prefixLen);
+        }
+        int prefixOfs = ofs;
         int i = 0;
         for ( int j = 0; j < this->n; j++ ) {
             if( mayDropKey( j, refPos ) ) {
@@ -520,7 +532,7 @@ namespace mongo {
                 k( i ) = k( j );
             }
             short ofsold = k(i).keyDataOfs();
-            int sz = keyNode(i).key.dataSize();
+            int sz = storedKeySize(i);
             ofs -= sz;
             this->topSize += sz;
             memcpy(temp+ofs, dataAt(ofsold), sz);
@@ -533,6 +545,9 @@ namespace mongo {
         this->n = i;
         int dataUsed = tdz - ofs;
         memcpy(this->data + ofs, temp + ofs, dataUsed);
+        if ( prefixLen ) {
+            this->setKeyPrefix(prefixOfs, prefixLen);
+        }
 
         // assertWritable();
         // TEMP TEST getDur().declareWriteIntent(this, sizeof(*this));
@@ -584,7 +599,7 @@ namespace mongo {
         // TODO I think we only want to do the 90% split on the rhs node of the tree.
         int rightSizeLimit = ( this->topSize + sizeof( _KeyNode ) * this->n ) / ( keypos == this->n ? 10 : 2 );
         for( int i = this->n - 1; i > -1; --i ) {
-            rightSize += keyNode( i ).key.dataSize() + sizeof( _KeyNode );
+            rightSize += storedKeySize( i ) + sizeof( _KeyNode );
             if ( rightSize > rightSizeLimit ) {
                 split = i;
                 break;
@@ -616,10 +631,9 @@ namespace mongo {
         _KeyNode &kn = k( i );
         kn.recordLoc = recordLoc;
         kn.prevChildBucket = prevChildBucket;
-        short ofs = (short) _alloc( key.dataSize() );
+        short ofs = (short) _alloc( keySizeHere( key ) );
         kn.setKeyDataOfs( ofs );
-        char *p = dataAt( ofs );
-        memcpy( p, key.data(), key.dataSize() );
+        storeKey( ofs, key );
     }
 
     template< class V >
@@ -632,6 +646,87 @@ namespace mongo {
         _packReadyForMod( order, refpos );
     }
 
+    template< class V >
+    bool BucketBasics<V>::_compress( const DiskLoc thisLoc, const Ordering &order ) const {
+        if ( !V::PrefixCompressed || this->n < 2 )
+            return false;
+
+        VERIFYTHISLOC
+
+        return thisLoc.btreemod<V>()->_compressReadyForMod( order );
+    }
+
+    template< class V >
+    bool BucketBasics<V>::_compressReadyForMod( const Ordering &order ) {
+        if ( !V::PrefixCompressed || this->n < 2 )
+            return false;
+
+        assertWritable();
+        verify( this->flags & Packed );
+
+        // The prefix is the middle key up to the last byte it has in common
+        // with another key: a longer prefix never makes a key's storage
+        // larger, it only costs its own bytes.
+        string prefix;
+        {
+            int mid = this->n / 2;
+            Key midKey = keyNode( mid ).key;
+            int len = 0;
+            for ( int i = 0; i < this->n; ++i ) {
+                if ( i == mid ) {
+                    continue;
+                }
+                Key key = keyNode( i ).key;
+                len = max( len, KeyV2::commonPrefixLen( midKey.data(), midKey.dataSize(),
+                                                        key.data(), key.dataSize() ) );
+            }
+            prefix.assign( midKey.data(), len );
+        }
+        int prefixLen = prefix.size();
+
+        int size = prefixLen;
+        for ( int i = 0; i < this->n; ++i ) {
+            size += V::KeyStorage::sizeToStore( prefix.data(), prefixLen, keyNode( i ).key );
+        }
+        if ( size >= this->topSize ) {
+            return false;
+        }
+
+        // Keys are decoded against the old prefix, still in place until the
+        // final memcpy, and restored into temp against the new one.
+        int tdz = totalDataSize();
+        char temp[V::BucketSize];
+        int ofs = tdz - prefixLen;
+        int prefixOfs = ofs;
+        memcpy( temp + prefixOfs, prefix.data(), prefixLen );
+        for ( int i = 0; i < this->n; ++i ) {
+            Key key = keyNode( i ).key;
+            ofs -= V::KeyStorage::sizeToStore( temp + prefixOfs, prefixLen, key );
+            V::KeyStorage::store( temp + prefixOfs, prefixLen, key, temp + ofs );
+            k( i ).setKeyDataOfsSavingUse( ofs );
+        }
+        verify( tdz - ofs == size );
+        memcpy( this->data + ofs, temp + ofs, size );
+        this->setKeyPrefix( prefixOfs, prefixLen );
+        this->topSize = size;
+        this->emptySize = tdz - size - this->n * sizeof( _KeyNode );
+
+        assertValid( order );
+        return true;
+    }
+
+    template< class V >
+    void BucketBasics<V>::_copyKeyPrefix( const BucketBasics &from ) {
+        verify( this->n == 0 && this->topSize == 0 );
+        int len = from.keyPrefixLen();
+        if ( len == 0 ) {
+            return;
+        }
+        int ofs = _alloc( len );
+        memcpy( dataAt( ofs ), from.keyPrefix(), len );
+        this->setKeyPrefix( ofs, len );
+    }
+
     /* - BtreeBucket --------------------------------------------------- */
 
     /** @return largest key in the subtree. */
@@ -796,8 +891,8 @@ namespace mongo {
             m = h;
         }
         while ( l <= h ) {
-            KeyNode M = this->keyNode(m);
-            int x = key.woCompare(M.key, btreeState->ordering());
+            const _KeyNode& M = this->k(m);
+            int x = this->compareToStored(key, M.keyDataOfs(), btreeState->ordering());
             if ( x == 0 ) {
                 if( assertIfDup ) {
                     if( k(m).isUnused() ) {
@@ -1017,7 +1112,19 @@ namespace mongo {
         {
             const BtreeBucket *l = leftNodeLoc.btree<V>();
             const BtreeBucket *r = rightNodeLoc.btree<V>();
-            if ( ( this->headerSize() + l->packedDataSize( pos ) + r->packedDataSize( pos ) + keyNode( leftIndex ).key.dataSize() + sizeof(_KeyNode) > unsigned( V::BucketSize ) ) ) {
+            int rightSize = 0;
+            if ( V::PrefixCompressed ) {
+                // r's keys are restored against l's key prefix when merged
+                for ( int i = 0; i < r->n; ++i ) {
+                    if ( !r->mayDropKey( i, pos ) ) {
+                        rightSize += l->keySizeHere( r->keyNode( i ).key ) + sizeof( _KeyNode );
+                    }
+                }
+            }
+            else {
+                rightSize = r->packedDataSize( pos );
+            }
+            if ( ( this->headerSize() + l->packedDataSize( pos ) + rightSize + l->keySizeHere( keyNode( leftIndex ).key ) + sizeof(_KeyNode) > unsigned( V::BucketSize ) ) ) {
                 return false;
             }
         }
@@ -1263,6 +1370,21 @@ namespace mongo {
         bool mayBalanceRight = ( ( parentIdx < p->n ) && !p->childForPos( parentIdx + 1 ).isNull() );
         bool mayBalanceLeft = ( ( parentIdx > 0 ) && !p->childForPos( parentIdx - 1 ).isNull() );
 
+        // Keys change size when moved into a bucket with another key prefix,
+        // which the sizing in rebalancedSeparatorPos() doesn't allow for, so
+        // buckets with key prefixes are only merged.
+        if ( V::PrefixCompressed ) {
+            if ( mayBalanceRight && p->canMergeChildren( this->parent, parentIdx ) ) {
+                BTREEMOD(this->parent)->doMergeChildren( btreeState, this->parent, parentIdx );
+                return true;
+            }
+            if ( mayBalanceLeft && p->canMergeChildren( this->parent, parentIdx - 1 ) ) {
+                BTREEMOD(this->parent)->doMergeChildren( btreeState, this->parent, parentIdx - 1 );
+                return true;
+            }
+            return false;
+        }
+
         // Balance if possible on one side - we merge only if absolutely necessary
         // to preserve btree bucket utilization constraints since that's a more
         // heavy duty operation (especially if we must re-split later).
@@ -1431,6 +1553,7 @@ namespace mongo {
         int split = this->splitPos( keypos );
         DiskLoc rLoc = addBucket(btreeState);
         BtreeBucket *r = rLoc.btreemod<V>();
+        r->_copyKeyPrefix( *this );
         if ( split_debug )
             out() << "     split:" << split << ' ' << keyNode(split).key.toString() << " n:" << this->n << endl;
         for ( int i = split+1; i < this->n; i++ ) {
@@ -1963,8 +2086,10 @@ namespace mongo {
 
     template class BucketBasics<V0>;
     template class BucketBasics<V1>;
+    template class BucketBasics<V2>;
     template class BtreeBucket<V0>;
     template class BtreeBucket<V1>;
+    template class BtreeBucket<V2>;
     template struct __KeyNode<DiskLoc>;
     template struct __KeyNode<DiskLoc56Bit>;
 
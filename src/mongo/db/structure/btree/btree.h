@@ -142,6 +142,24 @@ namespace mongo {
         }
     };
 
+    /**
+     * How the key data of a bucket is laid out.  v:0 and v:1 buckets store each
+     * key verbatim and have no key prefix; v:2 buckets use KeyV2's storage.
+     */
+    template< class Key >
+    struct VerbatimKeyStorage {
+        static Key fromStored(const char *prefix, int prefixLen, const char *p) { return Key(p); }
+        static int storedSize(const char *prefix, int prefixLen, const char *p) { return Key(p).dataSize(); }
+        static int sizeToStore(const char *prefix, int prefixLen, const Key& key) { return key.dataSize(); }
+        static void store(const char *prefix, int prefixLen, const Key& key, char *p) {
+            memcpy(p, key.data(), key.dataSize());
+        }
+        static int compareStored(const char *prefix, int prefixLen, const char *p,
+                                 const Key& key, const Ordering &o) {
+            return key.woCompare(Key(p), o);
+        }
+    };
+
     /**
      * This structure represents header data for a btree bucket.  An object of
      * this type is typically allocated inside of a buffer of size BucketSize,
@@ -190,12 +208,18 @@ namespace mongo {
         /* Beginning of the bucket's body */
         char data[4];
 
+        const char * keyPrefix() const { return 0; }
+        int keyPrefixLen() const { return 0; }
+        void setKeyPrefix(int ofs, int len) { verify( len == 0 ); }
+
     public:
         typedef __KeyNode<DiskLoc> _KeyNode;
         typedef DiskLoc Loc;
         typedef KeyBson Key;
         typedef KeyBson KeyOwned;
+        typedef VerbatimKeyStorage<KeyBson> KeyStorage;
         enum { BucketSize = 8192 };
+        enum { PrefixCompressed = 0 };
 
         // largest key size we allow.  note we very much need to support bigger keys (somehow) in the future.
         static const int KeyMax = OldBucketSize / 10;
@@ -287,7 +311,9 @@ namespace mongo {
         typedef __KeyNode<Loc> _KeyNode;
         typedef KeyV1 Key;
         typedef KeyV1Owned KeyOwned;
+        typedef VerbatimKeyStorage<KeyV1> KeyStorage;
         enum { BucketSize = 8192-16 }; // leave room for Record header
+        enum { PrefixCompressed = 0 };
         // largest key size we allow.  note we very much need to support bigger keys (somehow) in the future.
         static const int KeyMax = 1024;
         // A sentinel value sometimes used to identify a deallocated bucket.
@@ -313,10 +339,75 @@ namespace mongo {
         char data[4];
 
         void _init() { }
+
+        const char * keyPrefix() const { return 0; }
+        int keyPrefixLen() const { return 0; }
+        void setKeyPrefix(int ofs, int len) { verify( len == 0 ); }
+    };
+
+    /**
+     * v:2 buckets are v:1 buckets that may also hold a key prefix, allocated in
+     * the top region like key data.  Keys sharing enough leading bytes with the
+     * prefix are stored without them (see KeyV2), so buckets of keys with long
+     * common beginnings - compound keys on a low cardinality first field, urls,
+     * paths - hold more keys and the tree is shallower.
+     *
+     * The prefix is chosen when a bucket fills up (see _compressReadyForMod())
+     * and is kept by pack(); a bucket split off another starts with its prefix.
+     */
+    class BtreeData_V2 {
+    public:
+        typedef DiskLoc56Bit Loc;
+        typedef __KeyNode<Loc> _KeyNode;
+        typedef KeyV2 Key;
+        typedef KeyV2 KeyOwned;
+        typedef KeyV2 KeyStorage;
+        enum { BucketSize = 8192-16 }; // leave room for Record header
+        enum { PrefixCompressed = 1 };
+        // largest key size we allow.  note we very much need to support bigger keys (somehow) in the future.
+        static const int KeyMax = 1024;
+        // A sentinel value sometimes used to identify a deallocated bucket.
+        static const unsigned short INVALID_N_SENTINEL = 0xffff;
+    protected:
+        /** Parent bucket of this bucket, which isNull() for the root bucket. */
+        Loc parent;
+        /** Given that there are n keys, this is the n index child. */
+        Loc nextChild;
+
+        unsigned short flags;
+
+        /** basicInsert() assumes the next three members are consecutive and in this order: */
+
+        /** Size of the empty region. */
+        unsigned short emptySize;
+        /** Size used for bson storage, including storage of old keys. */
+        unsigned short topSize;
+        /* Number of keys in the bucket. */
+        unsigned short n;
+
+        /** Offset and size of the key prefix in the body; _prefixLen is 0 when there is none. */
+        unsigned short _prefixOfs;
+        unsigned short _prefixLen;
+
+        /* Beginning of the bucket's body */
+        char data[4];
+
+        void _init() {
+            _prefixOfs = 0;
+            _prefixLen = 0;
+        }
+
+        const char * keyPrefix() const { return _prefixLen ? data + _prefixOfs : 0; }
+        int keyPrefixLen() const { return _prefixLen; }
+        void setKeyPrefix(int ofs, int len) {
+            _prefixOfs = ofs;
+            _prefixLen = len;
+        }
     };
 
     typedef BtreeData_V0 V0;
     typedef BtreeData_V1 V1;
+    typedef BtreeData_V2 V2;
 
     /**
      * This class adds functionality to BtreeData for managing a single bucket.
@@ -366,7 +457,7 @@ namespace mongo {
             KeyNode(const BucketBasics<Version>& bb, const _KeyNode &k);
             const Loc& prevChildBucket;
             const Loc& recordLoc;
-            /* Points to the bson key storage for a _KeyNode */
+            /* Points to the bson key storage for a _KeyNode, or to a decoded copy when the key is stored prefixed */
             Key key;
         };
         friend class KeyNode;
@@ -411,6 +502,29 @@ namespace mongo {
     protected:
         char * dataAt(short ofs) { return this->data + ofs; }
 
+        /** @return the key whose storage begins at ofs in the body */
+        Key keyFromStorage(short ofs) const {
+            return Version::KeyStorage::fromStored(this->keyPrefix(), this->keyPrefixLen(), this->data + ofs);
+        }
+        /** @return the number of body bytes used by the storage of the i-indexed key */
+        int storedKeySize(int i) const {
+            return Version::KeyStorage::storedSize(this->keyPrefix(), this->keyPrefixLen(),
+                                                   this->data + k(i).keyDataOfs());
+        }
+        /** @return the number of body bytes 'key' would use if stored in this bucket */
+        int keySizeHere(const Key& key) const {
+            return Version::KeyStorage::sizeToStore(this->keyPrefix(), this->keyPrefixLen(), key);
+        }
+        /** @return key.woCompare() of the key whose storage begins at ofs, without decoding it */
+        int compareToStored(const Key& key, short ofs, const Ordering &o) const {
+            return Version::KeyStorage::compareStored(this->keyPrefix(), this->keyPrefixLen(),
+                                                      this->data + ofs, key, o);
+        }
+        /** Writes the storage of 'key', keySizeHere( key ) bytes, at ofs in the body. */
+        void storeKey(short ofs, const Key& key) {
+            Version::KeyStorage::store(this->keyPrefix(), this->keyPrefixLen(), key, dataAt(ofs));
+        }
+
         /** Initialize the header for a new node. */
         void init();
 
@@ -523,6 +637,25 @@ namespace mongo {
 
         /** @return the size the bucket's body would have if we were to call pack() */
         int packedDataSize( int refPos ) const;
+
+        /**
+         * Choose a key prefix for a full bucket of a prefix compressed version
+         * and restore the keys against it, if that uses less space.  Key
+         * indexes are unchanged.  This function may cast away const and perform
+         * a write.
+         * Preconditions: 'this' is packed
+         * @return true if space was freed; false always for versions without
+         *  key prefixes
+         */
+        bool _compress(const DiskLoc thisLoc, const Ordering &order) const;
+        /** Compress when already writable */
+        bool _compressReadyForMod(const Ordering &order);
+        /**
+         * Preconditions: 'this' is empty
+         * Postconditions: 'this' has the key prefix of 'from'.  Used so that
+         *  keys moved out of 'from' in order take the same space in 'this'.
+         */
+        void _copyKeyPrefix(const BucketBasics &from);
         void setNotPacked() { this->flags &= ~Packed; }
         void setPacked() { this->flags |= Packed; }
         /**
@@ -963,7 +1096,7 @@ namespace mongo {
         Key keyAt(int i) const {
             if( i >= this->n ) 
                 return Key();
-            return Key(this->data + k(i).keyDataOfs());
+            return this->keyFromStorage(k(i).keyDataOfs());
         }
     protected:
 
@@ -1070,7 +1203,7 @@ namespace mongo {
     template< class V >
     BucketBasics<V>::KeyNode::KeyNode(const BucketBasics<V>& bb, const _KeyNode &k) :
         prevChildBucket(k.prevChildBucket),
-        recordLoc(k.recordLoc), key(bb.data+k.keyDataOfs())
+        recordLoc(k.recordLoc), key(bb.keyFromStorage(k.keyDataOfs()))
     { }
 
     template< class V >
@@ -55,7 +55,8 @@ namespace mongo {
     BtreeBuilder<V>::BtreeBuilder(bool dupsAllowed, IndexCatalogEntry* btreeState ):
         _dupsAllowed(dupsAllowed),
         _btreeState(btreeState),
-        _numAdded(0) {
+        _numAdded(0),
+        _curCompressed(false) {
         first = cur = BtreeBucket<V>::addBucket(btreeState);
         b = _getModifiableBucket( cur );
         committed = false;
@@ -75,8 +76,12 @@ namespace mongo {
     void BtreeBuilder<V>::newBucket() {
         DiskLoc L = BtreeBucket<V>::addBucket(_btreeState);
         b->setTempNext(L);
+        BtreeBucket<V> *prev = b;
         cur = L;
         b = _getModifiableBucket( cur );
+        // keys arrive in order, so the next ones likely share the last bucket's key prefix
+        b->_copyKeyPrefix( *prev );
+        _curCompressed = false;
     }
 
     template<class V>
@@ -111,9 +116,14 @@ namespace mongo {
         }
 
         if ( ! b->_pushBack(loc, *key, _btreeState->ordering(), DiskLoc()) ) {
-            // bucket was full
-            newBucket();
-            b->pushBack(loc, *key, _btreeState->ordering(), DiskLoc());
+            // bucket was full.  compress it if the version allows, but only once, as doing it
+            // every time the bucket fills again would be quadratic.
+            bool compressed = !_curCompressed && b->_compressReadyForMod( _btreeState->ordering() );
+            _curCompressed = true;
+            if ( !compressed || !b->_pushBack(loc, *key, _btreeState->ordering(), DiskLoc()) ) {
+                newBucket();
+                b->pushBack(loc, *key, _btreeState->ordering(), DiskLoc());
+            }
         }
         keyLast = key;
         _numAdded++;
@@ -134,6 +144,7 @@ namespace mongo {
             DiskLoc upLoc = BtreeBucket<V>::addBucket(_btreeState);
             DiskLoc upStart = upLoc;
             BtreeBucket<V> *up = _getModifiableBucket( upLoc );
+            bool upCompressed = false;
 
             DiskLoc xloc = loc;
             while( !xloc.isNull() ) {
@@ -152,12 +163,19 @@ namespace mongo {
                 DiskLoc keepLoc = keepX ? xloc : x->nextChild;
 
                 if ( ! up->_pushBack(r, k, _btreeState->ordering(), keepLoc) ) {
-                    // current bucket full
-                    DiskLoc n = BtreeBucket<V>::addBucket(_btreeState);
-                    up->setTempNext(n);
-                    upLoc = n;
-                    up = _getModifiableBucket( upLoc );
-                    up->pushBack(r, k, _btreeState->ordering(), keepLoc);
+                    // current bucket full - compress once, as in addKey()
+                    bool compressed = !upCompressed && up->_compressReadyForMod( _btreeState->ordering() );
+                    upCompressed = true;
+                    if ( !compressed || !up->_pushBack(r, k, _btreeState->ordering(), keepLoc) ) {
+                        DiskLoc n = BtreeBucket<V>::addBucket(_btreeState);
+                        up->setTempNext(n);
+                        BtreeBucket<V> *prev = up;
+                        upLoc = n;
+                        up = _getModifiableBucket( upLoc );
+                        up->_copyKeyPrefix( *prev );
+                        upCompressed = false;
+                        up->pushBack(r, k, _btreeState->ordering(), keepLoc);
+                    }
                 }
 
                 DiskLoc nextLoc = x->tempNext(); // get next in chain at current level
@@ -193,5 +211,6 @@ namespace mongo {
 
     template class BtreeBuilder<V0>;
     template class BtreeBuilder<V1>;
+    template class BtreeBuilder<V2>;
 
 }
@@ -55,6 +55,8 @@ namespace mongo {
 
         DiskLoc cur, first;
         BtreeBucket<V> *b;
+        /** true once b has been compressed, see addKey(). */
+        bool _curCompressed;
 
         void newBucket();
         void buildNextLevel(DiskLoc loc, bool mayInterrupt);
@@ -367,6 +367,94 @@ namespace mongo {
         dassert( (*_keyData & cNOTUSED) == 0 );
     }
 
+    KeyV2::KeyV2(const BSONObj& obj) {
+        KeyV1Owned k(obj);
+        own(k.data(), k.dataSize());
+    }
+
+    KeyV2::KeyV2(const KeyV2& rhs) : KeyV1() {
+        assign(rhs);
+    }
+
+    void KeyV2::assign(const KeyV2& rhs) {
+        if( rhs._owned.empty() ) {
+            _owned.clear();
+            _keyData = rhs._keyData;
+        }
+        else {
+            own(rhs._owned.data(), rhs._owned.size());
+        }
+    }
+
+    BSONObj KeyV2::toBson() const {
+        BSONObj o = KeyV1::toBson();
+        return _owned.empty() ? o : o.getOwned();
+    }
+
+    void KeyV2::own(const char *data, int len) {
+        _owned.assign(data, len);
+        _keyData = (const unsigned char *) _owned.data();
+    }
+
+    int KeyV2::commonPrefixLen(const char *a, int aLen, const char *b, int bLen) {
+        int n = min(aLen, bLen);
+        int i = 0;
+        while( i < n && a[i] == b[i] )
+            i++;
+        return i;
+    }
+
+    int KeyV2::sharedLen(const char *prefix, int prefixLen, const KeyV2& key) {
+        if( prefixLen == 0 )
+            return 0;
+        int shared = commonPrefixLen(prefix, prefixLen, key.data(), key.dataSize());
+        // only worth it when the header costs less than what it replaces
+        return shared > PrefixedHeaderSize ? shared : 0;
+    }
+
+    KeyV2 KeyV2::fromStored(const char *prefix, int prefixLen, const char *p) {
+        if( (unsigned char) *p != PrefixedMarker )
+            return KeyV2(p);
+        unsigned short shared, suffix;
+        memcpy(&shared, p + 1, sizeof(shared)); // endian
+        memcpy(&suffix, p + 3, sizeof(suffix));
+        dassert( shared <= prefixLen );
+        KeyV2 k;
+        k._owned.reserve(shared + suffix);
+        k._owned.assign(prefix, shared);
+        k._owned.append(p + PrefixedHeaderSize, suffix);
+        k._keyData = (const unsigned char *) k._owned.data();
+        dassert( k.dataSize() == shared + suffix );
+        return k;
+    }
+
+    int KeyV2::storedSize(const char *prefix, int prefixLen, const char *p) {
+        if( (unsigned char) *p != PrefixedMarker )
+            return KeyV1(p).dataSize();
+        unsigned short suffix;
+        memcpy(&suffix, p + 3, sizeof(suffix));
+        return PrefixedHeaderSize + suffix;
+    }
+
+    int KeyV2::sizeToStore(const char *prefix, int prefixLen, const KeyV2& key) {
+        int shared = sharedLen(prefix, prefixLen, key);
+        return shared ? PrefixedHeaderSize + key.dataSize() - shared : key.dataSize();
+    }
+
+    void KeyV2::store(const char *prefix, int prefixLen, const KeyV2& key, char *p) {
+        int size = key.dataSize();
+        int shared = sharedLen(prefix, prefixLen, key);
+        if( shared == 0 ) {
+            memcpy(p, key.data(), size);
+            return;
+        }
+        unsigned short s = shared, suffix = size - shared;
+        *p = (char) PrefixedMarker;
+        memcpy(p + 1, &s, sizeof(s)); // endian
+        memcpy(p + 3, &suffix, sizeof(suffix));
+        memcpy(p + PrefixedHeaderSize, key.data() + shared, suffix);
+    }
+
     BSONObj KeyV1::toBson() const { 
         verify( _keyData != 0 );
         if( !isCompactFormat() )
@@ -616,6 +704,75 @@ namespace mongo {
         return p - _keyData;
     }
 
+    int KeyV2::compareStored(const char *prefix, int prefixLen, const char *p,
+                             const KeyV2& key, const Ordering &order) {
+        if( (unsigned char) *p != PrefixedMarker )
+            return key.woCompare(KeyV1(p), order);
+        if( !key.isCompactFormat() || (unsigned char) *prefix == IsBSON )
+            return key.woCompare(fromStored(prefix, prefixLen, p), order);
+
+        unsigned short shared;
+        memcpy(&shared, p + 1, sizeof(shared)); // endian
+        dassert( shared <= prefixLen );
+        const unsigned char *head = (const unsigned char *) prefix;
+        const unsigned char *tail = (const unsigned char *) p + PrefixedHeaderSize;
+
+        // as KeyV1::woCompare(), taking each element of the stored key from the prefix or the
+        // suffix; only an element split between the two is put together, on the stack
+        unsigned char split[2 + 255];
+        const unsigned char *l = key._keyData;
+        int ofs = 0; // in the stored key
+        unsigned mask = 1;
+        while( 1 ) {
+            const unsigned char *r;
+            if( ofs >= shared ) {
+                r = tail + (ofs - shared);
+            }
+            else {
+                unsigned char start[2];
+                start[0] = head[ofs];
+                int type = start[0] & cCANONTYPEMASK;
+                if( type == cstring || type == cbindata ) // the only ones with a length byte
+                    start[1] = ofs + 1 < shared ? head[ofs + 1] : tail[ofs + 1 - shared];
+                int sz = sizeOfElement(start);
+                if( ofs + sz <= shared ) {
+                    r = head + ofs;
+                }
+                else {
+                    int inHead = shared - ofs;
+                    memcpy(split, head + ofs, inHead);
+                    memcpy(split + inHead, tail, sz - inHead);
+                    r = split;
+                }
+            }
+
+            const unsigned char *rStart = r;
+            char lval = *l;
+            char rval = *r;
+            {
+                int x = compare(l, r); // updates l and r pointers
+                if( x ) {
+                    if( order.descending(mask) )
+                        x = -x;
+                    return x;
+                }
+            }
+
+            {
+                int x = ((int)(lval & cHASMORE)) - ((int)(rval & cHASMORE));
+                if( x )
+                    return x;
+                if( (lval & cHASMORE) == 0 )
+                    break;
+            }
+
+            ofs += r - rStart;
+            mask <<= 1;
+        }
+
+        return 0;
+    }
+
     bool KeyV1::woEqual(const KeyV1& right) const {
         const unsigned char *l = _keyData;
         const unsigned char *r = right._keyData;
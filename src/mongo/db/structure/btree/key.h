@@ -39,6 +39,8 @@ namespace mongo {
         KeyBson is a legacy wrapper implementation for old BSONObj style keys for v:0 indexes.
 
         KeyV1 is the new implementation.
+
+        KeyV2 is KeyV1 with the per bucket prefix compression of v:2 indexes.
     */
     class KeyBson /* "KeyV0" */ { 
     public:
@@ -127,4 +129,68 @@ namespace mongo {
         void traditional(const BSONObj& obj); // store as traditional bson not as compact format
     };
 
+    /** corresponding to BtreeData_V2.  The key format is the same as KeyV1's; what differs is how
+        a key is stored in a bucket.  A v:2 bucket may hold a key prefix, and a key that shares
+        more than a few leading bytes with it is stored as
+
+            PrefixedMarker, unsigned short shared length, unsigned short suffix length, suffix
+
+        while other keys are stored verbatim.  PrefixedMarker can't begin a KeyV1, as compact
+        format keys never have the high bit of their first byte set and bson ones begin with
+        IsBSON.
+
+        A key decoded from prefixed storage owns a copy of its data; a verbatim one points at the
+        bucket as KeyV1 does.
+    */
+    class KeyV2 : public KeyV1 {
+        void operator=(const KeyV2&);
+    public:
+        KeyV2() { }
+        explicit KeyV2(const char *keyData) : KeyV1(keyData) { }
+
+        /** @obj a BSON object to be translated to KeyV1 format, owned by this key. */
+        explicit KeyV2(const BSONObj& obj);
+
+        KeyV2(const KeyV2& rhs);
+
+        void assign(const KeyV2& rhs);
+
+        /** as KeyV1::toBson(), but a bson format key that owns its data returns an owned copy,
+            as its data goes away with it. */
+        BSONObj toBson() const;
+
+        /** @return the key stored at p in a bucket whose key prefix is prefix[0..prefixLen) */
+        static KeyV2 fromStored(const char *prefix, int prefixLen, const char *p);
+
+        /** @return the number of bytes stored at p */
+        static int storedSize(const char *prefix, int prefixLen, const char *p);
+
+        /** @return the number of bytes store() will write for key */
+        static int sizeToStore(const char *prefix, int prefixLen, const KeyV2& key);
+
+        /** writes key's storage, sizeToStore() bytes, to p */
+        static void store(const char *prefix, int prefixLen, const KeyV2& key, char *p);
+
+        /**
+         * @return key.woCompare(fromStored(prefix, prefixLen, p), o), comparing against the
+         * shared part of the prefix and the stored suffix where they lie rather than decoding
+         */
+        static int compareStored(const char *prefix, int prefixLen, const char *p,
+                                 const KeyV2& key, const Ordering &o);
+
+        /** @return the number of leading bytes a and b have in common */
+        static int commonPrefixLen(const char *a, int aLen, const char *b, int bLen);
+
+    private:
+        enum { PrefixedMarker = 0xfe, PrefixedHeaderSize = 5 };
+
+        /** @return how many bytes of the prefix to share, or 0 to store key verbatim */
+        static int sharedLen(const char *prefix, int prefixLen, const KeyV2& key);
+
+        void own(const char *data, int len);
+
+        /** when nonempty, _keyData points at it */
+        string _owned;
+    };
+
 };
@@ -0,0 +1,352 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/db/structure/catalog/freelist_index.h"
+
+#include <algorithm>
+
+#include "mongo/base/counter.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/pdfile.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/platform/unordered_map.h"
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/timer.h"
+
+namespace mongo {
+
+    // when false, record allocation walks the on-disk deleted lists as it always has
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(freelistIndex, bool, true);
+
+    // a collection whose index would be bigger than this keeps walking its deleted lists
+    MONGO_EXPORT_SERVER_PARAMETER(freelistIndexMaxBytes, int, 64 * 1024 * 1024);
+
+    namespace {
+
+        Counter64 freelistIndexBuilds;
+        ServerStatusMetricField<Counter64> dFreelistIndexBuilds( "storage.freelist.index.builds",
+                                                                 &freelistIndexBuilds );
+        Counter64 freelistIndexOverflows;
+        ServerStatusMetricField<Counter64> dFreelistIndexOverflows(
+                "storage.freelist.index.overflows", &freelistIndexOverflows );
+
+        typedef unordered_map<const NamespaceDetails*, FreeListIndex*> Registry;
+
+        SimpleMutex registryMutex("freelistindex");
+        Registry& registry() {
+            static Registry* r = new Registry(); // don't destroy
+            return *r;
+        }
+
+        // what one entry costs in _entries plus _bySize: the values and a tree node for each
+        const size_t bytesPerEntry = sizeof(std::pair<DiskLoc, FreeListIndex::Entry>)
+                                   + sizeof(std::pair<int, DiskLoc>)
+                                   + 2 * 4 * sizeof(void*);
+
+        /** the same sanity check __stdAlloc() applies to each link it follows */
+        bool plausible(const DiskLoc& loc) {
+            return loc.a() >= -1 && loc.a() < 100000 && loc.getOfs() >= 0;
+        }
+
+    } // namespace
+
+    FreeListIndex* FreeListIndex::get(NamespaceDetails* d) {
+        bool unfinished;
+        return _get(d, -1, &unfinished);
+    }
+
+    FreeListIndex* FreeListIndex::getWithin(NamespaceDetails* d, int maxMicros,
+                                            bool* unfinished) {
+        return _get(d, maxMicros, unfinished);
+    }
+
+    FreeListIndex* FreeListIndex::_get(NamespaceDetails* d, long long maxMicros,
+                                       bool* unfinished) {
+        *unfinished = false;
+        if ( !freelistIndex || d->isCapped() )
+            return NULL;
+
+        FreeListIndex* index = NULL;
+        {
+            SimpleMutex::scoped_lock lk(registryMutex);
+            Registry::const_iterator i = registry().find(d);
+            if ( i != registry().end() ) {
+                if ( i->second->_overflowed ) {
+                    if ( --i->second->_getsBeforeRetry > 0 )
+                        return NULL;
+                }
+                else if ( i->second->_matches(d) ) {
+                    if ( i->second->_complete() )
+                        return i->second;
+                    index = i->second; // carry on where an earlier build stopped
+                }
+            }
+        }
+
+        // build outside the registry mutex; our write lock on the collection keeps anyone else
+        // from building or using an index for 'd' meanwhile
+        std::auto_ptr<FreeListIndex> fresh;
+        if ( !index ) {
+            fresh.reset(new FreeListIndex());
+            index = fresh.get();
+        }
+        bool ok = index->_build(d, maxMicros);
+
+        SimpleMutex::scoped_lock lk(registryMutex);
+        Registry::iterator i = registry().find(d);
+        if ( i != registry().end() && i->second != index ) {
+            delete i->second;
+            registry().erase(i);
+        }
+        fresh.release();
+        if ( !ok ) {
+            if ( index->_overflowed ) {
+                // the walk cost about as much as this many allocations from the lists will, so
+                // retrying no sooner keeps the cost of failed builds to a constant per allocation
+                freelistIndexOverflows.increment();
+                index->_getsBeforeRetry = static_cast<long long>( index->_entries.size() );
+                index->_entries.clear();
+                index->_bySize.clear();
+                registry()[d] = index;
+            }
+            else {
+                // a damaged list is left for __stdAlloc() to report as it always has
+                registry().erase(d);
+                delete index;
+            }
+            return NULL;
+        }
+        registry()[d] = index;
+        if ( !index->_complete() ) {
+            *unfinished = true;
+            return NULL;
+        }
+        freelistIndexBuilds.increment();
+        return index;
+    }
+
+    FreeListIndex* FreeListIndex::find(const NamespaceDetails* d) {
+        FreeListIndex* index = findInStep(d);
+        return index && index->_complete() ? index : NULL;
+    }
+
+    FreeListIndex* FreeListIndex::findInStep(const NamespaceDetails* d) {
+        if ( !freelistIndex || d->isCapped() )
+            return NULL;
+
+        SimpleMutex::scoped_lock lk(registryMutex);
+        Registry::iterator i = registry().find(d);
+        if ( i == registry().end() || i->second->_overflowed )
+            return NULL;
+        if ( !i->second->_matches(d) ) {
+            delete i->second;
+            registry().erase(i);
+            return NULL;
+        }
+        return i->second;
+    }
+
+    void FreeListIndex::forget(const NamespaceDetails* d) {
+        SimpleMutex::scoped_lock lk(registryMutex);
+        Registry::iterator i = registry().find(d);
+        if ( i != registry().end() ) {
+            delete i->second;
+            registry().erase(i);
+        }
+    }
+
+    void FreeListIndex::forgetAll() {
+        SimpleMutex::scoped_lock lk(registryMutex);
+        for ( Registry::iterator i = registry().begin(); i != registry().end(); ++i )
+            delete i->second;
+        registry().clear();
+    }
+
+    void FreeListIndex::_startBucket(const NamespaceDetails* d) {
+        _heads[_buildBucket] = d->deletedListEntry(_buildBucket);
+        _buildNext = _heads[_buildBucket];
+        _buildPrev = DiskLoc();
+    }
+
+    bool FreeListIndex::_build(const NamespaceDetails* d, long long maxMicros) {
+        const size_t maxEntries = std::max( freelistIndexMaxBytes, 0 ) / bytesPerEntry;
+        Timer t;
+        size_t added = 0;
+        if ( _buildBucket < 0 ) {
+            _buildBucket = 0;
+            _startBucket(d);
+        }
+        while ( !_complete() ) {
+            if ( _buildNext.isNull() ) {
+                if ( ++_buildBucket < Buckets )
+                    _startBucket(d);
+                continue;
+            }
+            // at least one record per call, however short
+            if ( maxMicros >= 0 && added > 0 &&
+                 t.micros() >= static_cast<unsigned long long>( maxMicros ) )
+                return true;
+
+            const DiskLoc cur = _buildNext;
+            if ( !plausible(cur) )
+                return false;
+            if ( _entries.size() >= maxEntries ) {
+                _overflowed = true;
+                return false;
+            }
+            const DeletedRecord* r = cur.drec();
+            Entry e;
+            e.len = r->lengthWithHeaders();
+            e.bucket = _buildBucket;
+            e.prev = _buildPrev;
+            e.next = r->nextDeleted();
+            if ( !_entries.insert(std::make_pair(cur, e)).second )
+                return false; // on a list twice, or a cycle
+            _bySize.insert(std::make_pair(e.len, cur));
+            _buildPrev = cur;
+            _buildNext = e.next;
+            added++;
+        }
+        return true;
+    }
+
+    bool FreeListIndex::_matches(const NamespaceDetails* d) const {
+        // the lists not reached yet are read when the build gets to them
+        for ( int b = 0; b <= _buildBucket && b < Buckets; b++ ) {
+            if ( _heads[b] != d->deletedListEntry(b) )
+                return false;
+        }
+        return true;
+    }
+
+    DiskLoc FreeListIndex::bestFit(int len) const {
+        SizeSet::const_iterator i = _bySize.lower_bound(std::make_pair(len, DiskLoc()));
+        if ( i == _bySize.end() )
+            return DiskLoc();
+        return i->second;
+    }
+
+    const FreeListIndex::Entry* FreeListIndex::entry(const DiskLoc& loc) const {
+        EntryMap::const_iterator i = _entries.find(loc);
+        if ( i == _entries.end() )
+            return NULL;
+        return &i->second;
+    }
+
+    void FreeListIndex::inRange(const DiskLoc& from, const DiskLoc& to,
+                                std::vector<DiskLoc>* out) const {
+        for ( EntryMap::const_iterator i = _entries.lower_bound(from);
+              i != _entries.end() && i->first < to; ++i ) {
+            out->push_back(i->first);
+        }
+    }
+
+    void FreeListIndex::pushed(int bucket, const DiskLoc& loc, int len) {
+        if ( bucket > _buildBucket )
+            return; // the build reads the head of this list when it gets to it
+
+        Entry e;
+        e.len = len;
+        e.bucket = bucket;
+        e.next = _heads[bucket];
+        if ( bucket == _buildBucket && e.next == _buildNext )
+            _buildPrev = loc; // the build hasn't indexed the old head yet
+        else if ( !e.next.isNull() )
+            _entries[e.next].prev = loc;
+        _heads[bucket] = loc;
+        _entries[loc] = e;
+        _bySize.insert(std::make_pair(len, loc));
+    }
+
+    void FreeListIndex::removed(const DiskLoc& loc) {
+        EntryMap::iterator i = _entries.find(loc);
+        verify( i != _entries.end() );
+        const Entry& e = i->second;
+        if ( e.prev.isNull() )
+            _heads[e.bucket] = e.next;
+        else
+            _entries[e.prev].next = e.next;
+        if ( !e.next.isNull() )
+            _entries[e.next].prev = e.prev;
+        _bySize.erase(std::make_pair(e.len, loc));
+        _entries.erase(i);
+    }
+
+    void FreeListIndex::appendStats(const NamespaceDetails* d, BSONObjBuilder* out) {
+        long long count[Buckets] = { 0 };
+        long long bytes[Buckets] = { 0 };
+        long long largest = 0;
+
+        FreeListIndex* index = find(d);
+        if ( index ) {
+            for ( EntryMap::const_iterator i = index->_entries.begin();
+                  i != index->_entries.end(); ++i ) {
+                count[i->second.bucket]++;
+                bytes[i->second.bucket] += i->second.len;
+            }
+            if ( !index->_bySize.empty() )
+                largest = index->_bySize.rbegin()->first;
+        }
+        else if ( !d->isCapped() ) {
+            for ( int b = 0; b < Buckets; b++ ) {
+                for ( DiskLoc cur = d->deletedListEntry(b); !cur.isNull(); ) {
+                    massert( 18608, str::stream() << "deleted record list corrupted in bucket " << b
+                                                  << ", invalid link is " << cur.toString(),
+                             plausible(cur) );
+                    const DeletedRecord* r = cur.drec();
+                    count[b]++;
+                    bytes[b] += r->lengthWithHeaders();
+                    largest = std::max(largest, (long long) r->lengthWithHeaders());
+                    cur = r->nextDeleted();
+                }
+            }
+        }
+
+        long long totalCount = 0;
+        long long totalBytes = 0;
+        BSONArrayBuilder buckets(out->subarrayStart("buckets"));
+        for ( int b = 0; b < Buckets; b++ ) {
+            BSONObjBuilder bucket(buckets.subobjStart());
+            bucket.append("upTo", bucketSizes[b]);
+            bucket.appendNumber("count", count[b]);
+            bucket.appendNumber("bytes", bytes[b]);
+            bucket.done();
+            totalCount += count[b];
+            totalBytes += bytes[b];
+        }
+        buckets.done();
+
+        out->appendBool("indexed", index != NULL);
+        out->appendNumber("deletedRecords", totalCount);
+        out->appendNumber("deletedBytes", totalBytes);
+        out->appendNumber("largestDeletedRecord", largest);
+        out->append("avgDeletedRecordSize", totalCount ? (double) totalBytes / totalCount : 0.0);
+    }
+
+} // namespace mongo
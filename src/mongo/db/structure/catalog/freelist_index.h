@@ -0,0 +1,158 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/diskloc.h"
+#include "mongo/db/structure/catalog/namespace_details.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * An in-memory index over the deleted record lists of a non-capped collection, so that
+     * record allocation can find the best fitting deleted record in O(log n) without walking
+     * the on-disk lists.
+     *
+     * The on-disk lists in NamespaceDetails stay authoritative: this is built from them on first
+     * use (online compact builds it a little at a time, between which only addDeletedRec() can
+     * change the lists without finishing the build first), kept in step by
+     * NamespaceDetails::addDeletedRec() and __stdAlloc(), and thrown away
+     * and rebuilt whenever the list heads no longer match what it last saw (for example after
+     * compact orphans the lists).  Nothing here is journaled or persisted.
+     *
+     * The build stops once the index would take more than freelistIndexMaxBytes.  The collection
+     * then allocates by walking the lists, and the build is only tried again after about as many
+     * allocations as the failed build looked at deleted records.
+     *
+     * Callers hold the collection (or database) write lock, which serializes all use of one
+     * index; the registry of indexes has its own mutex.
+     */
+    class FreeListIndex {
+        MONGO_DISALLOW_COPYING(FreeListIndex);
+    public:
+        struct Entry {
+            int len;      // lengthWithHeaders
+            int bucket;   // the on-disk list it is on
+            DiskLoc prev; // null if at the head of its list
+            DiskLoc next;
+        };
+
+        /**
+         * @return the index for 'd', building it from the on-disk lists if there is none or the
+         * one there is stale.  NULL if 'd' is capped, its lists are damaged, or the index is
+         * disabled.
+         */
+        static FreeListIndex* get(NamespaceDetails* d);
+
+        /**
+         * like get() but spends no more than about 'maxMicros' building, carrying on from where
+         * an earlier call stopped.  NULL with *unfinished set if there is more to build.
+         */
+        static FreeListIndex* getWithin(NamespaceDetails* d, int maxMicros, bool* unfinished);
+
+        /** like get() but never builds; NULL if there is no up to date index for 'd' */
+        static FreeListIndex* find(const NamespaceDetails* d);
+
+        /**
+         * like find() but also returns an index that is only partly built, which changes to the
+         * lists have to be reported to as much as to a complete one
+         */
+        static FreeListIndex* findInStep(const NamespaceDetails* d);
+
+        /** discard the index for 'd', if any; call before its NamespaceDetails goes away */
+        static void forget(const NamespaceDetails* d);
+
+        /** discard all indexes, e.g. when a database is closed */
+        static void forgetAll();
+
+        /**
+         * Append size class counts and fragmentation figures for the deleted records of 'd',
+         * from the index if one is up to date, otherwise by walking the on-disk lists.
+         */
+        static void appendStats(const NamespaceDetails* d, BSONObjBuilder* out);
+
+        /** @return the smallest deleted record of at least 'len' bytes, null if none */
+        DiskLoc bestFit(int len) const;
+
+        /** @return the entry for 'loc', NULL if it isn't a deleted record we know of */
+        const Entry* entry(const DiskLoc& loc) const;
+
+        /** append the deleted records at or after 'from' and before 'to', in disk order */
+        void inRange(const DiskLoc& from, const DiskLoc& to, std::vector<DiskLoc>* out) const;
+
+        /** 'loc' was pushed on the front of list 'bucket' */
+        void pushed(int bucket, const DiskLoc& loc, int len);
+
+        /** 'loc' is being unlinked from its list */
+        void removed(const DiskLoc& loc);
+
+    private:
+        FreeListIndex() : _buildBucket(-1), _overflowed(false), _getsBeforeRetry(0) { }
+
+        /** 'maxMicros' < 0 means to the end */
+        static FreeListIndex* _get(NamespaceDetails* d, long long maxMicros, bool* unfinished);
+
+        /**
+         * index the lists from where the last call stopped, for at most 'maxMicros' if that is
+         * not negative.
+         * @return false if the on-disk lists are damaged or the index would go over its memory
+         * cap; _overflowed tells which
+         */
+        bool _build(const NamespaceDetails* d, long long maxMicros);
+        void _startBucket(const NamespaceDetails* d);
+        bool _complete() const { return _buildBucket == Buckets; }
+        bool _matches(const NamespaceDetails* d) const;
+
+        typedef std::map<DiskLoc, Entry> EntryMap;
+        typedef std::set<std::pair<int, DiskLoc> > SizeSet;
+
+        EntryMap _entries;
+        SizeSet _bySize;
+        DiskLoc _heads[Buckets];
+
+        // how far the build has got: the list being indexed (Buckets once all are), the next
+        // record on it to index and the last one indexed.  Lists after _buildBucket aren't
+        // tracked at all until the build reaches them.
+        int _buildBucket;
+        DiskLoc _buildNext;
+        DiskLoc _buildPrev;
+
+        // set, with everything else empty, on the placeholder left by a build that hit the cap
+        bool _overflowed;
+        long long _getsBeforeRetry;
+    };
+
+} // namespace mongo
@@ -45,6 +45,7 @@
 #include "mongo/db/ops/update.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/storage/durable_mapped_file.h"
+#include "mongo/db/structure/catalog/freelist_index.h"
 #include "mongo/db/structure/catalog/hashtab.h"
 #include "mongo/scripting/engine.h"
 #include "mongo/util/startup_test.h"
@@ -135,11 +136,17 @@ namespace mongo {
             }
         }
         else {
+            // look this up before changing the list head, or it would appear stale
+            FreeListIndex* index = FreeListIndex::findInStep(this);
+
             int b = bucket(d->lengthWithHeaders());
             DiskLoc& list = _deletedList[b];
             DiskLoc oldHead = list;
             getDur().writingDiskLoc(list) = dloc;
             d->nextDeleted() = oldHead;
+
+            if ( index )
+                index->pushed(b, dloc, d->lengthWithHeaders());
         }
     }
 
@@ -245,6 +252,14 @@ namespace mongo {
     */
     DiskLoc NamespaceDetails::__stdAlloc(int len, bool peekOnly) {
         freelistAllocs.increment();
+
+        if ( FreeListIndex* index = FreeListIndex::get(this) ) {
+            DiskLoc loc = _indexedAlloc(index, len, peekOnly);
+            if ( loc.isValid() )
+                return loc;
+            // the index didn't agree with the on-disk lists; they win
+        }
+
         DiskLoc *prev;
         DiskLoc *bestprev = 0;
         DiskLoc bestmatch;
@@ -331,6 +346,96 @@ namespace mongo {
         return bestmatch;
     }
 
+    /* best fit from the in-memory index.  the only pages touched are those of the record handed
+       out and of its predecessor on the deleted list, whose link has to change.
+       @return null if nothing fits, invalid if the index turned out to be out of step
+    */
+    DiskLoc NamespaceDetails::_indexedAlloc(FreeListIndex* index, int len, bool peekOnly) {
+        freelistIterations.increment();
+
+        DiskLoc loc = index->bestFit(len);
+        if ( loc.isNull() ) {
+            // out of space. alloc a new extent.
+            return loc;
+        }
+        if ( peekOnly )
+            return loc;
+
+        /* unlink ourself from the deleted list */
+        if ( !_unlinkIndexed(index, loc) ) {
+            DiskLoc invalid;
+            invalid.setInvalid();
+            return invalid;
+        }
+        verify(loc.drec()->extentOfs() < loc.getOfs());
+        return loc;
+    }
+
+    /* unlink 'loc' from its deleted list, finding its predecessor through the in-memory index.
+       @return false, having changed nothing on disk, if the index turned out to be out of step;
+               it has been thrown away then
+    */
+    bool NamespaceDetails::_unlinkIndexed(FreeListIndex* index, const DiskLoc& loc) {
+        const FreeListIndex::Entry* e = index->entry(loc);
+        DeletedRecord *r = loc.drec();
+        if ( e ) {
+            DiskLoc& link = e->prev.isNull() ? _deletedList[e->bucket]
+                                             : e->prev.drec()->nextDeleted();
+            if ( r->lengthWithHeaders() == e->len && r->nextDeleted() == e->next && link == loc ) {
+                index->removed(loc);
+                getDur().writingDiskLoc(link) = r->nextDeleted();
+                r->nextDeleted().writing().setInvalid(); // defensive.
+                return true;
+            }
+        }
+        warning() << "in-memory deleted record index out of step with the deleted lists at "
+                  << loc.toString() << ", rebuilding it" << endl;
+        FreeListIndex::forget(this);
+        return false;
+    }
+
+    bool NamespaceDetails::withholdDeletedRecords(const DiskLoc& extentLoc,
+                                                  vector<DiskLoc>* withheld) {
+        verify( !isCapped() );
+
+        // walking all the lists instead could take as long as there are deleted records
+        FreeListIndex* index = FreeListIndex::find(this);
+        if ( !index )
+            return false;
+
+        DiskLoc end = extentLoc;
+        end.inc(extentLoc.ext()->length);
+        vector<DiskLoc> locs;
+        index->inRange(extentLoc, end, &locs);
+        for ( size_t i = 0; i < locs.size(); i++ ) {
+            if ( !_unlinkIndexed(index, locs[i]) )
+                return false; // the index is gone
+            withheld->push_back(locs[i]);
+        }
+        return true;
+    }
+
+    bool NamespaceDetails::withholdDeletedRecord(const DiskLoc& loc) {
+        verify( !isCapped() );
+
+        if ( FreeListIndex* index = FreeListIndex::find(this) ) {
+            if ( _unlinkIndexed(index, loc) )
+                return true;
+        }
+
+        // addDeletedRec() pushes on the front, so this is normally found straight away
+        DiskLoc* link = &_deletedList[bucket(loc.drec()->lengthWithHeaders())];
+        for ( ; !link->isNull(); link = &link->drec()->nextDeleted() ) {
+            if ( *link == loc ) {
+                DeletedRecord *r = loc.drec();
+                getDur().writingDiskLoc(*link) = r->nextDeleted();
+                r->nextDeleted().writing().setInvalid(); // defensive.
+                return true;
+            }
+        }
+        return false;
+    }
+
     DiskLoc NamespaceDetails::firstRecord( const DiskLoc &startExtent ) const {
         for (DiskLoc i = startExtent.isNull() ? _firstExtent : startExtent;
                 !i.isNull(); i = i.ext()->xnext ) {
@@ -44,6 +44,7 @@
 namespace mongo {
 
     class Collection;
+    class FreeListIndex;
     class IndexCatalogEntry;
     class Database;
     class IndexCatalog;
@@ -383,6 +384,22 @@ namespace mongo {
         /* add a given record to the deleted chains for this NS */
         void addDeletedRec(DeletedRecord *d, DiskLoc dloc);
 
+        /**
+         * Take every deleted record inside the extent at 'extentLoc' off the deleted lists, so
+         * that nothing is allocated there, and append their locations to 'withheld'.  Used by
+         * online compact while it empties that extent; the space comes back when the extent is
+         * freed, or through addDeletedRec() if the compact gives up.  Not for capped collections.
+         *
+         * This finds them through the in-memory FreeListIndex and never walks the lists.
+         * @return false if there is no up to date index, or it turned out to be out of step;
+         *         'withheld' has what was taken off the lists before that
+         */
+        bool withholdDeletedRecords(const DiskLoc& extentLoc, std::vector<DiskLoc>* withheld);
+
+        /** like withholdDeletedRecords() for the single deleted record at 'loc'
+            @return false if it wasn't on a deleted list */
+        bool withholdDeletedRecord(const DiskLoc& loc);
+
         // Start from firstExtent by default.
         DiskLoc firstRecord( const DiskLoc &startExtent = DiskLoc() ) const;
         // Start from lastExtent by default.
@@ -411,6 +428,8 @@ namespace mongo {
         DiskLoc _alloc(Collection* collection, const StringData& ns, int len);
         void maybeComplain( const StringData& ns, int len ) const;
         DiskLoc __stdAlloc(int len, bool willBeAt);
+        DiskLoc _indexedAlloc(FreeListIndex* index, int len, bool peekOnly);
+        bool _unlinkIndexed(FreeListIndex* index, const DiskLoc& loc);
         void compact(); // combine adjacent deleted records
 
         friend class Database;
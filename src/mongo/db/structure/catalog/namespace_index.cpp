@@ -32,6 +32,7 @@
 
 #include <boost/filesystem/operations.hpp>
 
+#include "mongo/db/structure/catalog/freelist_index.h"
 #include "mongo/db/structure/catalog/namespace_details.h"
 
 
@@ -74,6 +75,8 @@ namespace mongo {
         if ( !_ht.get() )
             return;
         Namespace n(ns);
+        if ( NamespaceDetails* d = _ht->get(n) )
+            FreeListIndex::forget(d);
         _ht->kill(n);
 
         if (ns.size() <= Namespace::MaxNsColletionLen) {
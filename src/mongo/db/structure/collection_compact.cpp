@@ -40,10 +40,12 @@
 #include "mongo/db/catalog/index_key_validate.h"
 #include "mongo/db/index/index_access_method.h"
 #include "mongo/db/kill_current_op.h"
+#include "mongo/db/structure/catalog/freelist_index.h"
 #include "mongo/db/structure/catalog/namespace_details.h"
 #include "mongo/db/storage/extent.h"
 #include "mongo/db/storage/extent_manager.h"
 #include "mongo/db/structure/collection_iterator.h"
+#include "mongo/util/timer.h"
 #include "mongo/util/touch_pages.h"
 
 namespace mongo {
@@ -76,6 +78,33 @@ namespace mongo {
         size_t _allocationSize;
     };
 
+    /**
+     * @return the allocation size, with header, for the compacted copy of 'rec'
+     */
+    unsigned _compactRecordSize( const NamespaceDetails* d, const Record* rec, unsigned docSize,
+                                 const CompactOptions* compactOptions ) {
+        unsigned lenWHdr = docSize + Record::HeaderSize;
+        unsigned lenWPadding = lenWHdr;
+
+        switch( compactOptions->paddingMode ) {
+        case CompactOptions::NONE:
+            if ( d->isUserFlagSet(NamespaceDetails::Flag_UsePowerOf2Sizes) )
+                lenWPadding = NamespaceDetails::quantizePowerOf2AllocationSpace(lenWPadding);
+            break;
+        case CompactOptions::PRESERVE:
+            // if we are preserving the padding, the record should not change size
+            lenWPadding = rec->lengthWithHeaders();
+            break;
+        case CompactOptions::MANUAL:
+            lenWPadding = compactOptions->computeRecordSize(lenWPadding);
+            if (lenWPadding < lenWHdr || lenWPadding > BSONObjMaxUserSize / 2 ) {
+                lenWPadding = lenWHdr;
+            }
+            break;
+        }
+        return lenWPadding;
+    }
+
     void Collection::_compactExtent(const DiskLoc diskloc, int extentNumber,
                                     MultiIndexBlock& indexesToInsertTo,
                                     const CompactOptions* compactOptions, CompactStats* stats ) {
@@ -127,25 +156,8 @@ namespace mongo {
                         oldObjSize += docSize;
                         oldObjSizeWithPadding += recOld->netLength();
 
-                        unsigned lenWHdr = docSize + Record::HeaderSize;
-                        unsigned lenWPadding = lenWHdr;
-
-                        switch( compactOptions->paddingMode ) {
-                        case CompactOptions::NONE:
-                            if ( details()->isUserFlagSet(NamespaceDetails::Flag_UsePowerOf2Sizes) )
-                                lenWPadding = details()->quantizePowerOf2AllocationSpace(lenWPadding);
-                            break;
-                        case CompactOptions::PRESERVE:
-                            // if we are preserving the padding, the record should not change size
-                            lenWPadding = recOld->lengthWithHeaders();
-                            break;
-                        case CompactOptions::MANUAL:
-                            lenWPadding = compactOptions->computeRecordSize(lenWPadding);
-                            if (lenWPadding < lenWHdr || lenWPadding > BSONObjMaxUserSize / 2 ) {
-                                lenWPadding = lenWHdr;
-                            }
-                            break;
-                        }
+                        unsigned lenWPadding = _compactRecordSize( details(), recOld, docSize,
+                                                                   compactOptions );
 
                         CompactDocWriter writer( objOld, lenWPadding );
                         StatusWith<DiskLoc> status = _recordStore->insertRecord( &writer, 0 );
@@ -157,6 +169,9 @@ namespace mongo {
                         options.dupsAllowed = true; // in compact we should be doing no checking
 
                         indexesToInsertTo.insert( objOld, status.getValue(), options );
+
+                        // moved, so results in natural order may have changed
+                        _infoCache.notifyOfRecordMove();
                     }
 
                     if( L.isNull() ) {
@@ -205,9 +220,10 @@ namespace mongo {
         BSONObj::iterator i( oldSpec );
         while( i.more() ) {
             BSONElement e = i.next();
-            if ( str::equals( e.fieldName(), "v" ) ) {
+            if ( str::equals( e.fieldName(), "v" ) && e.numberInt() != 2 ) {
                 // Drop any preexisting index version spec.  The default index version will
-                // be used instead for the new index.
+                // be used instead for the new index.  v:2 is kept, as it is only ever used
+                // when asked for.
                 continue;
             }
             if ( str::equals( e.fieldName(), "background" ) ) {
@@ -320,5 +336,241 @@ namespace mongo {
         return StatusWith<CompactStats>( stats );
     }
 
+    // -----------
+    // online compact
+    //
+    // Empties one sparsely used extent at a time by moving its records into the free space of
+    // the other extents, through the ordinary allocator, and then frees it.  While an extent is
+    // being emptied its own deleted records are held off the deleted lists so nothing lands in
+    // it; if mongod goes down meanwhile that space stays unused until the extent is emptied by a
+    // later compact, which is all it costs.
+    //
+    // Extents are measured, and their deleted records found, through the in-memory FreeListIndex
+    // only, and the index is built a step at a time, so that no step walks the records or the
+    // deleted lists for longer than its pause.
+
+    DiskLoc Collection::_compactOnlinePickExtent( OnlineCompactState* state,
+                                                  FreeListIndex* index,
+                                                  const Timer& t, int maxMicros,
+                                                  bool* unfinished ) {
+        *unfinished = false;
+        int numExtents = 0;
+        long long storage = storageSize( &numExtents );
+        if ( numExtents < 2 )
+            return DiskLoc();
+
+        // whatever isn't an extent header or a record is on the deleted lists
+        long long freeBytes = storage
+            - static_cast<long long>( numExtents ) * Extent::HeaderSize()
+            - _details->dataSize()
+            - _details->numRecords() * Record::HeaderSize;
+
+        // from the end, so the data drifts towards the front of the collection
+        for ( DiskLoc L = _details->lastExtent(); !L.isNull(); L = L.ext()->xprev ) {
+            if ( state->visited.count( L ) )
+                continue;
+            if ( t.micros() >= static_cast<unsigned long long>( maxMicros ) ) {
+                *unfinished = true;
+                return DiskLoc();
+            }
+            state->visited.insert( L );
+
+            // without touching the extent's pages
+            Extent* e = L.ext();
+            long long usable = e->length - Extent::HeaderSize();
+            long long freeHere = 0;
+            DiskLoc end = L;
+            end.inc( e->length );
+            vector<DiskLoc> locs;
+            index->inRange( L, end, &locs );
+            for ( size_t i = 0; i < locs.size(); i++ )
+                freeHere += index->entry( locs[i] )->len;
+            long long live = usable - freeHere;
+
+            // worth it when at least a quarter of the extent is free, and possible when the
+            // other extents have room for what it holds, with slack as their space is
+            // fragmented too
+            if ( freeHere * 4 >= usable && freeBytes - freeHere >= live + live / 2 )
+                return L;
+        }
+        return DiskLoc();
+    }
+
+    void Collection::_compactOnlineRetryExtent( OnlineCompactState* state ) {
+        // the index went out of step with the deleted lists, so some of the extent's deleted
+        // records may not have been found; put back what was and pick again once it is rebuilt
+        LOG(1) << "compact online of " << _ns << " lost the deleted record index, retrying extent "
+               << state->extent << endl;
+        state->visited.erase( state->extent );
+        compactOnlineAbandon( state );
+    }
+
+    void Collection::_compactOnlineMove( OnlineCompactState* state, const DiskLoc& loc,
+                                         const CompactOptions* compactOptions,
+                                         CompactStats* stats ) {
+        Record* rec = _recordStore->recordFor( loc );
+        BSONObj obj = BSONObj::make( rec );
+
+        if ( compactOptions->validateDocuments && !obj.valid() ) {
+            stats->corruptDocuments++;
+            uasserted( 18609, str::stream() << "compact found a corrupt document at "
+                                            << loc.toString() << " in " << _ns.ns()
+                                            << ", it can only be skipped by an offline compact" );
+        }
+
+        CompactDocWriter writer( obj, _compactRecordSize( _details, rec, obj.objsize(),
+                                                          compactOptions ) );
+        StatusWith<DiskLoc> status = _recordStore->insertRecord( &writer, 0 );
+        uassertStatusOK( status.getStatus() );
+        const DiskLoc newLoc = status.getValue();
+
+        // same as an update that moves the document: nobody may see the old location again,
+        // and the new one takes its place in every index before the old record goes
+        _cursorCache.invalidateDocument( loc, INVALIDATION_DELETION );
+        _indexCatalog.unindexRecord( obj, loc, true );
+        try {
+            _indexCatalog.indexRecord( obj, newLoc );
+        }
+        catch ( AssertionException& ) {
+            _recordStore->deleteRecord( newLoc );
+            _indexCatalog.indexRecord( obj, loc );
+            throw;
+        }
+        _recordStore->deleteRecord( loc );
+
+        // the document is the same, but not where a collection scan finds it
+        _infoCache.notifyOfRecordMove();
+
+        // deleteRecord() put the old space on a deleted list; it belongs to the extent
+        if ( _details->withholdDeletedRecord( loc ) )
+            state->withheld.push_back( loc );
+
+        if ( newLoc.a() == state->extent.a() &&
+             _recordStore->recordFor( newLoc )->extentOfs() == state->extent.getOfs() ) {
+            // a foreground delete made room in this extent since we withheld its space; the
+            // record will be moved again
+            if ( !_details->withholdDeletedRecords( state->extent, &state->withheld ) )
+                _compactOnlineRetryExtent( state );
+            return;
+        }
+        stats->recordsMoved++;
+    }
+
+    void Collection::_compactOnlineFreeExtent( OnlineCompactState* state, CompactStats* stats ) {
+        const DiskLoc L = state->extent;
+        Extent* e = getExtentManager()->getExtent( L );
+        verify( e->firstRecord.isNull() );
+
+        // anything foreground deletes put back on the lists since the extent was picked
+        if ( !_details->withholdDeletedRecords( L, &state->withheld ) ) {
+            _compactOnlineRetryExtent( state );
+            return;
+        }
+
+        if ( e->xprev.isNull() )
+            _details->firstExtent().writing() = e->xnext;
+        else
+            e->xprev.ext()->xnext.writing() = e->xnext;
+        if ( e->xnext.isNull() )
+            _details->lastExtent().writing() = e->xprev;
+        else
+            e->xnext.ext()->xprev.writing() = e->xprev;
+
+        LOG(1) << "compact online freeing extent " << L << " of " << _ns
+               << " len=" << e->length << endl;
+        stats->extentsFreed++;
+        stats->bytesReclaimed += e->length;
+
+        getDur().writing(e)->markEmpty();
+        getExtentManager()->freeExtents( L, L );
+
+        state->extent.Null();
+        state->withheld.clear();
+        getDur().commitIfNeeded();
+    }
+
+    StatusWith<bool> Collection::compactOnlineStep( OnlineCompactState* state,
+                                                    const CompactOptions* compactOptions,
+                                                    int maxMicros,
+                                                    CompactStats* stats ) {
+
+        if ( isCapped() )
+            return StatusWith<bool>( ErrorCodes::BadValue,
+                                     "cannot compact capped collection" );
+
+        if ( _indexCatalog.numIndexesInProgress() )
+            return StatusWith<bool>( ErrorCodes::BadValue,
+                                     "cannot compact when indexes in progress" );
+
+        if ( _cursorCache.numCursorsAndRunners() ) {
+            // the cursors can't tell which records were moved behind them, see collection.h
+            if ( !stats->stepsPaused++ )
+                log() << "compact online of " << _ns << " waiting for the cursors open on it";
+            return StatusWith<bool>( true );
+        }
+
+        Timer t;
+
+        bool unfinished;
+        FreeListIndex* index = FreeListIndex::getWithin( _details, maxMicros, &unfinished );
+        if ( !index ) {
+            if ( unfinished )
+                return StatusWith<bool>( true );
+            return StatusWith<bool>( ErrorCodes::IllegalOperation,
+                                     "online compact needs the in-memory deleted record index, "
+                                     "which is disabled or would be larger than "
+                                     "freelistIndexMaxBytes; use an offline compact" );
+        }
+
+        if ( state->extent.isNull() ) {
+            state->extent = _compactOnlinePickExtent( state, index, t, maxMicros, &unfinished );
+            if ( state->extent.isNull() )
+                return StatusWith<bool>( unfinished );
+            LOG(1) << "compact online emptying extent " << state->extent << " of " << _ns << endl;
+            if ( !_details->withholdDeletedRecords( state->extent, &state->withheld ) ) {
+                _compactOnlineRetryExtent( state );
+                return StatusWith<bool>( true );
+            }
+        }
+
+        Extent* e = getExtentManager()->getExtent( state->extent );
+        const DiskLoc lastExtent = _details->lastExtent();
+
+        // at least one record per step however short the step
+        DiskLoc L = e->firstRecord;
+        while ( !L.isNull() ) {
+            DiskLoc next = getExtentManager()->getNextRecordInExtent( L );
+            _compactOnlineMove( state, L, compactOptions, stats );
+            if ( state->extent.isNull() )
+                return StatusWith<bool>( true ); // see _compactOnlineRetryExtent()
+
+            if ( _details->lastExtent() != lastExtent ) {
+                // the other extents didn't have room after all; don't grow the collection
+                log() << "compact online of " << _ns << " ran out of free space, stopping";
+                stats->bytesReclaimed -= _details->lastExtent().ext()->length;
+                compactOnlineAbandon( state );
+                return StatusWith<bool>( false );
+            }
+
+            L = next;
+            if ( t.micros() >= static_cast<unsigned long long>( maxMicros ) )
+                break;
+        }
+
+        if ( e->firstRecord.isNull() )
+            _compactOnlineFreeExtent( state, stats ); // or retries the extent
+
+        return StatusWith<bool>( true );
+    }
+
+    void Collection::compactOnlineAbandon( OnlineCompactState* state ) {
+        for ( size_t i = 0; i < state->withheld.size(); i++ ) {
+            const DiskLoc& loc = state->withheld[i];
+            _details->addDeletedRec( loc.drec(), loc );
+        }
+        state->withheld.clear();
+        state->extent.Null();
+    }
+
 
 }
@@ -34,6 +34,7 @@
 #include "mongo/db/repl/write_concern.h"
 #include "mongo/db/stats/timer_stats.h"
 #include "mongo/db/write_concern.h"
+#include "mongo/util/net/blocking_section.h"
 
 namespace mongo {
 
@@ -138,7 +139,8 @@ namespace mongo {
         switch( writeConcern.syncMode ) {
         case WriteConcernOptions::NONE:
             break;
-        case WriteConcernOptions::FSYNC:
+        case WriteConcernOptions::FSYNC: {
+            BlockingSection blocking;
             if ( !getDur().isDurable() ) {
                 result->fsyncFiles = MemoryMappedFile::flushAll( true );
             }
@@ -147,10 +149,13 @@ namespace mongo {
                 getDur().awaitCommit();
             }
             break;
-        case WriteConcernOptions::JOURNAL:
+        }
+        case WriteConcernOptions::JOURNAL: {
+            BlockingSection blocking;
             getDur().awaitCommit();
             break;
         }
+        }
 
         result->syncMillis = syncTimer.millis();
 
@@ -185,6 +190,7 @@ namespace mongo {
         // TODO: Make this cleaner
         Status replStatus = Status::OK();
         try {
+            BlockingSection blocking;
             while ( 1 ) {
 
                 if ( writeConcern.wNumNodes > 0 ) {
@@ -0,0 +1,237 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+
+#include "mongo/pch.h"
+
+#include "mongo/db/instance.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/structure/btree/key.h"
+#include "mongo/dbtests/dbtests.h"
+
+namespace BtreeKeyV2Tests {
+
+    static int sign( int x ) {
+        return x < 0 ? -1 : ( x > 0 ? 1 : 0 );
+    }
+
+    static bool sameKey( const KeyV2& a, const KeyV2& b ) {
+        return a.dataSize() == b.dataSize() && memcmp( a.data(), b.data(), a.dataSize() ) == 0;
+    }
+
+    /**
+     * Keys with long common leading bytes, so that most share enough of a prefix to be stored
+     * prefixed, and some that don't: a bson format key and short ones.
+     */
+    static vector<BSONObj> keys() {
+        vector<BSONObj> v;
+        const char* const paths[] = { "http://www.example.com/catalog/department-1/",
+                                      "http://www.example.com/catalog/department-1/items/",
+                                      "http://www.example.com/catalog/department-2/",
+                                      "http://www.example.com/" };
+        for ( size_t i = 0; i < sizeof( paths ) / sizeof( paths[0] ); i++ ) {
+            for ( int n = 0; n < 3; n++ ) {
+                v.push_back( BSON( "" << paths[i] << "" << n ) );
+                v.push_back( BSON( "" << paths[i] << "" << "item-" + string( n * 40, 'x' ) ) );
+            }
+        }
+        v.push_back( BSON( "" << "http" << "" << 1 ) );
+        v.push_back( BSON( "" << "http://www.example.com/catalog/department-1/" << "" << 1.5 ) );
+        v.push_back( BSON( "" << 7 << "" << "http://www.example.com/" ) );
+        // not representable in the compact format
+        v.push_back( BSON( "" << "http://www.example.com/catalog/department-1/"
+                           << "" << BSON( "x" << 1 ) ) );
+        v.push_back( BSON( "" << "http://www.example.com/catalog/department-1/"
+                           << "" << BSON( "x" << 2 ) ) );
+        return v;
+    }
+
+    /**
+     * Stores each key under a prefix made of the leading bytes of every key, cut at every
+     * length so that the split between prefix and suffix falls inside each element, and checks
+     * that it reads back the same and compares to every key as the decoded key does.
+     */
+    class StoreAndCompare {
+    public:
+        void run() {
+            const vector<BSONObj> objs = keys();
+            // KeyV2 can't be assigned, so isn't held in a vector itself
+            vector< boost::shared_ptr<KeyV2> > k;
+            for ( size_t i = 0; i < objs.size(); i++ )
+                k.push_back( boost::shared_ptr<KeyV2>( new KeyV2( objs[i] ) ) );
+
+            const Ordering orders[] = { Ordering::make( BSON( "" << 1 << "" << 1 ) ),
+                                        Ordering::make( BSON( "" << -1 << "" << 1 ) ),
+                                        Ordering::make( BSON( "" << 1 << "" << -1 ) ) };
+            const size_t nOrders = sizeof( orders ) / sizeof( orders[0] );
+
+            int prefixed = 0;
+            char buf[1024];
+            for ( size_t p = 0; p < k.size(); p++ ) {
+                const char* prefix = k[p]->data();
+                for ( int prefixLen = 0; prefixLen <= k[p]->dataSize(); prefixLen++ ) {
+                    for ( size_t i = 0; i < k.size(); i++ ) {
+                        const KeyV2& key = *k[i];
+                        const int size = KeyV2::sizeToStore( prefix, prefixLen, key );
+                        ASSERT( size <= static_cast<int>( sizeof( buf ) ) );
+                        KeyV2::store( prefix, prefixLen, key, buf );
+                        ASSERT_EQUALS( size, KeyV2::storedSize( prefix, prefixLen, buf ) );
+                        if ( size < key.dataSize() )
+                            prefixed++;
+
+                        const KeyV2 decoded = KeyV2::fromStored( prefix, prefixLen, buf );
+                        ASSERT( sameKey( key, decoded ) );
+                        ASSERT_EQUALS( 0, objs[i].woCompare( decoded.toBson(), BSONObj(), false ) );
+
+                        for ( size_t j = 0; j < k.size(); j++ ) {
+                            for ( size_t o = 0; o < nOrders; o++ ) {
+                                const int stored = KeyV2::compareStored( prefix, prefixLen, buf,
+                                                                         *k[j], orders[o] );
+                                ASSERT_EQUALS( sign( k[j]->woCompare( decoded, orders[o] ) ),
+                                               sign( stored ) );
+                            }
+                        }
+                    }
+                }
+            }
+            // the split went through the stored keys, not only around them
+            ASSERT_GREATER_THAN( prefixed, 1000 );
+        }
+    };
+
+    /**
+     * What a merge or split does to a key: read it under one bucket's prefix and store it under
+     * another's.
+     */
+    class Reprefix {
+    public:
+        void run() {
+            const vector<BSONObj> objs = keys();
+            char from[1024];
+            char to[1024];
+            for ( size_t a = 0; a < objs.size(); a++ ) {
+                const KeyV2 prefixA( objs[a] );
+                for ( size_t b = 0; b < objs.size(); b++ ) {
+                    const KeyV2 prefixB( objs[b] );
+                    for ( size_t i = 0; i < objs.size(); i++ ) {
+                        const KeyV2 k( objs[i] );
+                        KeyV2::store( prefixA.data(), prefixA.dataSize(), k, from );
+                        const KeyV2 moving =
+                            KeyV2::fromStored( prefixA.data(), prefixA.dataSize(), from );
+
+                        KeyV2::store( prefixB.data(), prefixB.dataSize(), moving, to );
+                        const KeyV2 moved =
+                            KeyV2::fromStored( prefixB.data(), prefixB.dataSize(), to );
+                        ASSERT( sameKey( k, moved ) );
+                    }
+                }
+            }
+        }
+    };
+
+    /**
+     * Removes the keys on either side of where one long common prefix gives way to another in a
+     * v:2 index, so that buckets with different prefixes merge, and checks the index.
+     */
+    class MergeDifferentPrefixes {
+    public:
+        MergeDifferentPrefixes() : _ns( "unittests.btreekeyv2" ) {}
+        ~MergeDifferentPrefixes() {
+            _client.dropCollection( _ns );
+        }
+
+        void run() {
+            _client.dropCollection( _ns );
+            _client.ensureIndex( _ns, BSON( "k" << 1 ), false, "k_1", false, false, 2 );
+
+            const int n = 2000;
+            for ( int i = 0; i < n; i++ ) {
+                // not in key order, so buckets split in the middle as well as at the end
+                const int j = ( i * 7919 ) % n;
+                _client.insert( _ns, BSON( "_id" << j << "k" << key( j ) ) );
+            }
+            ASSERT_EQUALS( "", _client.getLastError() );
+
+            // all but every 50th of the last quarter of one prefix and the first of the other
+            set<int> kept;
+            for ( int i = 0; i < n; i++ ) {
+                if ( i < 3 * n / 8 || i >= 5 * n / 8 || i % 50 == 0 )
+                    kept.insert( i );
+            }
+            const BSONObj every50th = BSON( "$mod" << BSON_ARRAY( 50 << 0 ) );
+            _client.remove( _ns, BSON( "_id" << BSON( "$gte" << 3 * n / 8
+                                                     << "$lt" << 5 * n / 8
+                                                     << "$not" << every50th ) ) );
+            ASSERT_EQUALS( "", _client.getLastError() );
+            ASSERT_EQUALS( static_cast<unsigned long long>( kept.size() ), _client.count( _ns ) );
+
+            BSONObj info;
+            ASSERT( _client.runCommand( "unittests",
+                                        BSON( "validate" << "btreekeyv2" << "full" << true ),
+                                        info ) );
+            ASSERT( info["valid"].trueValue() );
+            ASSERT_EQUALS( static_cast<int>( kept.size() ),
+                           info["keysPerIndex"].Obj()[ _ns + ".$k_1" ].numberInt() );
+
+            // every key in order through the index, and each found on its own
+            auto_ptr<DBClientCursor> c =
+                _client.query( _ns, Query().hint( BSON( "k" << 1 ) ) );
+            for ( set<int>::const_iterator i = kept.begin(); i != kept.end(); ++i ) {
+                ASSERT( c->more() );
+                ASSERT_EQUALS( *i, c->next()["_id"].numberInt() );
+                ASSERT_EQUALS( 1U, _client.count( _ns, BSON( "k" << key( *i ) ) ) );
+            }
+            ASSERT( !c->more() );
+        }
+
+    private:
+        /** the first half of the keys share one long prefix, the second half another */
+        static string key( int i ) {
+            char n[8];
+            sprintf( n, "%05d", i );
+            return ( i < 1000 ? "http://www.example.com/catalog/department-1/items/"
+                              : "http://www.example.org/archive/2013/collection-9/pages/" )
+                   + string( n );
+        }
+
+        const string _ns;
+        DBDirectClient _client;
+    };
+
+    class All : public Suite {
+    public:
+        All() : Suite( "btreekeyv2" ) {
+        }
+        void setupTests() {
+            add< StoreAndCompare >();
+            add< Reprefix >();
+            add< MergeDifferentPrefixes >();
+        }
+    } myall;
+
+} // namespace BtreeKeyV2Tests
@@ -147,6 +147,31 @@ namespace DocumentSourceTests {
                 }
             }
         };
+
+        /** ParsedDeps::extractFields() copies only the needed fields and stops reading early. */
+        class ExtractFields {
+        public:
+            void run() {
+                const char* array[] = {"b", "c.x", "d.y"};
+                DepsTracker deps;
+                deps.fields = arrayToSet(array);
+                const ParsedDeps parsed = *deps.toParsedDeps();
+
+                BSONObj obj = fromjson("{a: 1, b: 'long enough not to be stored inline',"
+                                       " c: {x: 2, y: 3}, d: [{y: 4, z: 5}, 6, [{y: 7}]], e: 8}");
+                ASSERT_EQUALS(parsed.extractFields(obj).toBson(),
+                              fromjson("{b: 'long enough not to be stored inline',"
+                                       " c: {x: 2}, d: [{y: 4}, [{y: 7}]]}"));
+
+                // a repeated field name doesn't count as another needed field
+                obj = fromjson("{b: 1, b: 2, c: {x: 3}, d: 4}");
+                ASSERT_EQUALS(parsed.extractFields(obj).toBson(),
+                              fromjson("{b: 1, b: 2, c: {x: 3}}"));
+
+                // missing fields
+                ASSERT_EQUALS(parsed.extractFields(BSON("e" << 1)).toBson(), BSONObj());
+            }
+        };
     }
 
     namespace DocumentSourceCursor {
@@ -690,6 +715,9 @@ namespace DocumentSourceTests {
                 populateData();
                 createSource();
                 createGroup( groupSpec() );
+                if ( streaming() ) {
+                    static_cast<DocumentSourceGroup*>( group() )->setStreaming();
+                }
 
                 intrusive_ptr<DocumentSource> sink = group();
                 if ( sharded ) {
@@ -704,6 +732,8 @@ namespace DocumentSourceTests {
         protected:
             virtual void populateData() {}
             virtual BSONObj groupSpec() { return BSON( "_id" << 0 ); }
+            /** Whether the data is inserted in an order that brings each group together. */
+            virtual bool streaming() { return false; }
             /** Expected results.  Must be sorted by _id to ensure consistent ordering. */
             virtual BSONObj expectedResultSet() {
                 BSONObj wrappedResult =
@@ -829,6 +859,58 @@ namespace DocumentSourceTests {
             virtual string expectedResultSetString() { return "[{_id:null,sum:110}]"; }
         };
 
+        /** Groups are returned one at a time from input sorted by _id. */
+        class StreamingSortedInput : public CheckResultsBase {
+            void populateData() {
+                client.insert( ns, BSON( "a" << 1 ) );
+                client.insert( ns, BSON( "id" << BSONNULL << "a" << 2 ) );
+                client.insert( ns, BSON( "id" << 0 << "a" << 3 ) );
+                client.insert( ns, BSON( "id" << 0.0 << "a" << 4 ) );
+                client.insert( ns, BSON( "id" << 1 << "a" << 5 ) );
+                client.insert( ns, BSON( "id" << 2 << "a" << 6 ) );
+                client.insert( ns, BSON( "id" << 2 << "a" << 7 ) );
+            }
+            virtual BSONObj groupSpec() {
+                return BSON( "_id" << "$id" << "a" << BSON( "$push" << "$a" ) );
+            }
+            virtual bool streaming() { return true; }
+            virtual string expectedResultSetString() {
+                return "[{_id:null,a:[1,2]},{_id:0,a:[3,4]},{_id:1,a:[5]},{_id:2,a:[6,7]}]";
+            }
+        };
+
+        /** Sort patterns that do and don't bring each group's documents together. */
+        class IsGroupedBySort : public Base {
+        public:
+            void run() {
+                createGroup( fromjson( "{_id:'$a',n:{$sum:1}}" ) );
+                ASSERT( grouped( "{a:1}" ) );
+                ASSERT( grouped( "{a:-1,b:1}" ) );
+                ASSERT( !grouped( "{b:1,a:1}" ) );
+                ASSERT( !grouped( "{'a.b':1}" ) );
+                ASSERT( !grouped( "{}" ) );
+
+                createGroup( fromjson( "{_id:{x:'$a.b',y:'$c'}}" ) );
+                ASSERT( grouped( "{c:1,'a.b':-1}" ) );
+                ASSERT( grouped( "{'a.b':1,c:1,d:1}" ) );
+                ASSERT( !grouped( "{'a.b':1}" ) );
+                ASSERT( !grouped( "{'a.b':1,d:1,c:1}" ) );
+
+                // Only field paths can be streamed.
+                createGroup( fromjson( "{_id:{$add:['$a',1]}}" ) );
+                ASSERT( !grouped( "{a:1}" ) );
+                createGroup( fromjson( "{_id:'$$ROOT'}" ) );
+                ASSERT( !grouped( "{a:1}" ) );
+                createGroup( fromjson( "{_id:null}" ) );
+                ASSERT( !grouped( "{a:1}" ) );
+            }
+        private:
+            bool grouped( const char* sortPattern ) {
+                return static_cast<DocumentSourceGroup*>( group() )
+                        ->isGroupedBySort( fromjson( sortPattern ) );
+            }
+        };
+
         /** A complex _id expression. */
         class ComplexId : public CheckResultsBase {
             void populateData() {
@@ -1709,6 +1791,129 @@ namespace DocumentSourceTests {
         };
     } // namespace DocumentSourceGeoNear
 
+    namespace DocumentSourceLookup {
+        using mongo::DocumentSourceLookup;
+
+        static const char* const foreignNs = "unittests.documentsourcetests_foreign";
+
+        class MongodInterface : public DocumentSourceNeedsMongod::MongodInterface {
+        public:
+            virtual DBClientBase* directClient() { return &client; }
+            virtual bool isSharded(const NamespaceString& ns) { return false; }
+            virtual bool isCapped(const NamespaceString& ns) { return false; }
+        };
+
+        class Base : public DocumentSourceCursor::Base {
+        public:
+            ~Base() {
+                client.dropCollection( foreignNs );
+            }
+        protected:
+            intrusive_ptr<DocumentSource> createLookup( const BSONObj& spec ) {
+                BSONObj namedSpec = BSON( "$lookup" << spec );
+                return DocumentSourceLookup::createFromBson( namedSpec.firstElement(), ctx() );
+            }
+
+            /** Joins 'input' on a to the foreign collection on b, returning the joined _ids. */
+            vector<BSONObj> joinedIds( const BSONObj& input ) {
+                intrusive_ptr<DocumentSource> lookup =
+                        createLookup( fromjson( "{from: 'documentsourcetests_foreign',"
+                                                " localField: 'a', foreignField: 'b',"
+                                                " as: 'joined'}" ) );
+                dynamic_cast<DocumentSourceLookup*>( lookup.get() )->injectMongodInterface(
+                        boost::make_shared<MongodInterface>() );
+                intrusive_ptr<DocumentSourceBsonArray> source =
+                        DocumentSourceBsonArray::create( input, ctx() );
+                lookup->setSource( source.get() );
+
+                vector<BSONObj> ids;
+                while ( boost::optional<Document> next = lookup->getNext() ) {
+                    vector<int> joined;
+                    const vector<Value>& matches = (*next)["joined"].getArray();
+                    for ( size_t i = 0; i < matches.size(); i++ ) {
+                        joined.push_back( matches[i]["_id"].getInt() );
+                    }
+                    std::sort( joined.begin(), joined.end() );
+                    ids.push_back( BSON( "a" << (*next)["a"] << "joined" << joined ) );
+                }
+                return ids;
+            }
+        };
+
+        /** The specification round trips, and each argument is required to be a string. */
+        class Parse : public Base {
+        public:
+            void run() {
+                BSONObj spec = fromjson( "{from: 'coll', localField: 'a.b', foreignField: 'c',"
+                                         " as: 'd.e'}" );
+                ASSERT_EQUALS( BSON( "$lookup" << spec ), toBson( createLookup( spec ) ) );
+
+                ASSERT_THROWS( DocumentSourceLookup::createFromBson(
+                                       BSON( "$lookup" << 1 ).firstElement(), ctx() ),
+                               UserException );
+                ASSERT_THROWS( createLookup( fromjson( "{from: 'coll', localField: 1,"
+                                                       " foreignField: 'c', as: 'd'}" ) ),
+                               UserException );
+                ASSERT_THROWS( createLookup( fromjson( "{from: 'coll', localField: 'a',"
+                                                       " foreignField: 'c', as: 'd', x: 'y'}" ) ),
+                               UserException );
+                ASSERT_THROWS( createLookup( fromjson( "{from: 'coll', localField: 'a',"
+                                                       " foreignField: 'c'}" ) ),
+                               UserException );
+            }
+        };
+
+        /** The hash table and index lookups match documents the same way. */
+        class HashAndIndexAgree : public Base {
+        public:
+            void run() {
+                client.insert( foreignNs, fromjson( "{_id: 0, b: 1}" ) );
+                client.insert( foreignNs, fromjson( "{_id: 1, b: 1.0}" ) );
+                client.insert( foreignNs, fromjson( "{_id: 2, b: [1, 2]}" ) );
+                client.insert( foreignNs, fromjson( "{_id: 3}" ) );
+                client.insert( foreignNs, fromjson( "{_id: 4, b: null}" ) );
+                client.insert( foreignNs, fromjson( "{_id: 5, b: 'x'}" ) );
+                client.insert( foreignNs, fromjson( "{_id: 6, b: [[1, 2], 3]}" ) );
+
+                BSONObj input = fromjson( "{'': [{a: 1}, {a: 2}, {}, {a: [1, 2]}, {a: 'x'},"
+                                          " {a: 4}]}" ).firstElement().Obj();
+                vector<BSONObj> expected;
+                expected.push_back( fromjson( "{a: 1, joined: [0, 1, 2]}" ) );
+                expected.push_back( fromjson( "{a: 2, joined: [2]}" ) );
+                expected.push_back( fromjson( "{joined: [3, 4]}" ) );
+                expected.push_back( fromjson( "{a: [1, 2], joined: [2, 6]}" ) );
+                expected.push_back( fromjson( "{a: 'x', joined: [5]}" ) );
+                expected.push_back( fromjson( "{a: 4, joined: []}" ) );
+
+                vector<BSONObj> hashed = joinedIds( input );
+                client.ensureIndex( foreignNs, BSON( "b" << 1 ) );
+                vector<BSONObj> indexed = joinedIds( input );
+
+                ASSERT_EQUALS( expected.size(), hashed.size() );
+                ASSERT_EQUALS( expected.size(), indexed.size() );
+                for ( size_t i = 0; i < expected.size(); i++ ) {
+                    ASSERT_EQUALS( expected[i], hashed[i] );
+                    ASSERT_EQUALS( expected[i], indexed[i] );
+                }
+            }
+        };
+
+        /** Only the local field is needed from the input. */
+        class Dependencies : public Base {
+        public:
+            void run() {
+                intrusive_ptr<DocumentSource> lookup =
+                        createLookup( fromjson( "{from: 'coll', localField: 'a.b',"
+                                                " foreignField: 'c', as: 'd'}" ) );
+                DepsTracker dependencies;
+                ASSERT_EQUALS( DocumentSource::SEE_NEXT, lookup->getDependencies( &dependencies ) );
+                ASSERT_EQUALS( 1U, dependencies.fields.size() );
+                ASSERT_EQUALS( 1U, dependencies.fields.count( "a.b" ) );
+                ASSERT_EQUALS( false, dependencies.needWholeDocument );
+            }
+        };
+    } // namespace DocumentSourceLookup
+
     namespace DocumentSourceMatch {
         using mongo::DocumentSourceMatch;
 
@@ -1926,6 +2131,7 @@ namespace DocumentSourceTests {
         }
         void setupTests() {
             add<DocumentSourceClass::Deps>();
+            add<DocumentSourceClass::ExtractFields>();
 
             add<DocumentSourceCursor::Empty>();
             add<DocumentSourceCursor::Iterate>();
@@ -1967,6 +2173,8 @@ namespace DocumentSourceTests {
             add<DocumentSourceGroup::FourValuesTwoKeys>();
             add<DocumentSourceGroup::FourValuesTwoKeysTwoAccumulators>();
             add<DocumentSourceGroup::GroupNullUndefinedIds>();
+            add<DocumentSourceGroup::StreamingSortedInput>();
+            add<DocumentSourceGroup::IsGroupedBySort>();
             add<DocumentSourceGroup::ComplexId>();
             add<DocumentSourceGroup::UndefinedAccumulatorValue>();
             add<DocumentSourceGroup::RouterMerger>();
@@ -2024,6 +2232,10 @@ namespace DocumentSourceTests {
 
             add<DocumentSourceGeoNear::LimitCoalesce>();
 
+            add<DocumentSourceLookup::Parse>();
+            add<DocumentSourceLookup::HashAndIndexAgree>();
+            add<DocumentSourceLookup::Dependencies>();
+
             add<DocumentSourceMatch::RedactSafePortion>();
             add<DocumentSourceMatch::Coalesce>();
         }
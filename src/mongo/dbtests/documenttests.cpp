@@ -90,6 +90,27 @@ namespace DocumentTests {
             }            
         };
 
+        /** A Document from a BSONObj is allocated at about the size its fields need. */
+        class CreateFromBsonObjSize {
+        public:
+            void run() {
+                BSONObjBuilder bob;
+                for ( int i = 0; i < 10; ++i ) {
+                    bob.append( "a field name of 24 bytes" + string( 1, 'a' + i ), i );
+                }
+                Document document = fromBson( bob.obj() );
+                ASSERT_EQUALS( 10U, document.size() );
+
+                // no more than the fields, their names, up to 7 bytes of padding each, and the
+                // hash table
+                const size_t fieldBytes = sizeof( ValueElement ) + 25 + 7;
+                ASSERT_LESS_THAN_OR_EQUALS( document.getApproximateSize(),
+                                            sizeof( DocumentStorage ) + 10 * fieldBytes
+                                                + 16 * sizeof( Position ) + 8 );
+                assertRoundTrips( document );
+            }
+        };
+
         /** Add Document fields. */
         class AddField {
         public:
@@ -1417,6 +1438,7 @@ namespace DocumentTests {
         void setupTests() {
             add<Document::Create>();
             add<Document::CreateFromBsonObj>();
+            add<Document::CreateFromBsonObjSize>();
             add<Document::AddField>();
             add<Document::GetValue>();
             add<Document::SetField>();
@@ -40,6 +40,8 @@
 #include "mongo/db/json.h"
 #include "mongo/db/query/internal_plans.h"
 #include "mongo/db/queryutil.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/structure/catalog/freelist_index.h"
 #include "mongo/db/structure/catalog/namespace.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/dbtests/dbtests.h"
@@ -1575,6 +1577,196 @@ namespace NamespaceTests {
             virtual string spec() const { return ""; }
         };
 
+        /** Carve records of the given sizes out of the initial extent and free them again. */
+        class FreeListIndexBase : public Base {
+        protected:
+            void makeDeleted( const int* sizes, int n, DiskLoc* locs ) {
+                for ( int i = 0; i < n; ++i ) {
+                    locs[ i ] = nsd()->alloc( NULL, ns(), sizes[ i ] );
+                    ASSERT( !locs[ i ].isNull() );
+                }
+                for ( int i = 0; i < n; ++i ) {
+                    nsd()->addDeletedRec( locs[ i ].drec(), locs[ i ] );
+                }
+            }
+            /** number of deleted records, walking the on disk lists */
+            int nDeleted() {
+                int count = 0;
+                for ( int i = 0; i < Buckets; ++i ) {
+                    for ( DiskLoc l = nsd()->deletedListEntry( i ); !l.isNull();
+                          l = l.drec()->nextDeleted() ) {
+                        ++count;
+                    }
+                }
+                return count;
+            }
+            virtual string spec() const { return ""; }
+        };
+
+        /** alloc() takes the smallest deleted record that fits, from any bucket. */
+        class FreeListIndexBestFit : public FreeListIndexBase {
+        public:
+            void run() {
+                create();
+                const int sizes[] = { 1000, 400, 600, 2000 };
+                DiskLoc l[ 4 ];
+                makeDeleted( sizes, 4, l );
+
+                DiskLoc actualLocation = nsd()->alloc( NULL, ns(), 500 );
+                ASSERT_EQUALS( l[ 2 ], actualLocation );
+                ASSERT( FreeListIndex::find( nsd() ) );
+
+                // the next best fit after that
+                actualLocation = nsd()->alloc( NULL, ns(), 700 );
+                ASSERT_EQUALS( l[ 0 ], actualLocation );
+
+                // the lists and the index agree on what is left
+                FreeListIndex* index = FreeListIndex::find( nsd() );
+                ASSERT( index );
+                for ( int i = 0; i < Buckets; ++i ) {
+                    DiskLoc prev;
+                    for ( DiskLoc d = nsd()->deletedListEntry( i ); !d.isNull();
+                          d = d.drec()->nextDeleted() ) {
+                        const FreeListIndex::Entry* e = index->entry( d );
+                        ASSERT( e );
+                        ASSERT_EQUALS( d.drec()->lengthWithHeaders(), e->len );
+                        ASSERT_EQUALS( i, e->bucket );
+                        ASSERT_EQUALS( prev, e->prev );
+                        ASSERT_EQUALS( d.drec()->nextDeleted(), e->next );
+                        prev = d;
+                    }
+                }
+                ASSERT( index->entry( l[ 0 ] ) == NULL );
+                ASSERT( index->entry( l[ 2 ] ) == NULL );
+            }
+        };
+
+        /** The index is dropped and rebuilt when the on disk lists change under it. */
+        class FreeListIndexRebuiltWhenStale : public FreeListIndexBase {
+        public:
+            void run() {
+                create();
+                const int sizes[] = { 300, 500 };
+                DiskLoc l[ 2 ];
+                makeDeleted( sizes, 2, l );
+                ASSERT( !nsd()->alloc( NULL, ns(), 200 ).isNull() );
+                ASSERT( FreeListIndex::find( nsd() ) );
+
+                nsd()->orphanDeletedList();
+                ASSERT( FreeListIndex::find( nsd() ) == NULL );
+                ASSERT( nsd()->alloc( NULL, ns(), 200 ).isNull() );
+
+                nsd()->addDeletedRec( l[ 1 ].drec(), l[ 1 ] );
+                ASSERT_EQUALS( l[ 1 ], nsd()->alloc( NULL, ns(), 200 ) );
+                ASSERT_EQUALS( 1, nDeleted() ); // only the split off remainder is left
+            }
+        };
+
+        /** appendStats() reports the same figures with and without an index. */
+        class FreeListIndexStats : public FreeListIndexBase {
+        public:
+            void run() {
+                create();
+                const int sizes[] = { 100, 300, 5000 };
+                DiskLoc l[ 3 ];
+                makeDeleted( sizes, 3, l );
+
+                BSONObjBuilder walked;
+                FreeListIndex::forget( nsd() );
+                FreeListIndex::appendStats( nsd(), &walked );
+                BSONObj walkedObj = walked.obj();
+                ASSERT( !walkedObj["indexed"].trueValue() );
+                ASSERT_EQUALS( nDeleted(), walkedObj["deletedRecords"].numberInt() );
+
+                ASSERT( FreeListIndex::get( nsd() ) );
+                BSONObjBuilder indexed;
+                FreeListIndex::appendStats( nsd(), &indexed );
+                BSONObj indexedObj = indexed.obj();
+                ASSERT( indexedObj["indexed"].trueValue() );
+                ASSERT_EQUALS( walkedObj["deletedRecords"].numberLong(),
+                               indexedObj["deletedRecords"].numberLong() );
+                ASSERT_EQUALS( walkedObj["deletedBytes"].numberLong(),
+                               indexedObj["deletedBytes"].numberLong() );
+                ASSERT_EQUALS( walkedObj["largestDeletedRecord"].numberLong(),
+                               indexedObj["largestDeletedRecord"].numberLong() );
+                ASSERT_EQUALS( walkedObj["buckets"].Obj(), indexedObj["buckets"].Obj() );
+            }
+        };
+
+        /** A build done a record at a time stays in step with records freed meanwhile. */
+        class FreeListIndexBuiltInSteps : public FreeListIndexBase {
+        public:
+            void run() {
+                create();
+                const int sizes[] = { 1000, 400, 600, 2000, 300, 5000 };
+                DiskLoc l[ 6 ];
+                makeDeleted( sizes, 4, l );
+                for ( int i = 4; i < 6; ++i ) {
+                    l[ i ] = nsd()->alloc( NULL, ns(), sizes[ i ] );
+                    ASSERT( !l[ i ].isNull() );
+                }
+
+                bool unfinished;
+                ASSERT( FreeListIndex::getWithin( nsd(), 0, &unfinished ) == NULL );
+                ASSERT( unfinished );
+                ASSERT( FreeListIndex::find( nsd() ) == NULL );
+
+                int steps = 1;
+                FreeListIndex* index = NULL;
+                while ( !index ) {
+                    // freed between steps, onto whichever lists their sizes belong to
+                    if ( steps <= 2 )
+                        nsd()->addDeletedRec( l[ 3 + steps ].drec(), l[ 3 + steps ] );
+                    index = FreeListIndex::getWithin( nsd(), 0, &unfinished );
+                    ASSERT( index || unfinished );
+                    ASSERT( ++steps < 100 );
+                }
+                ASSERT_GREATER_THAN( steps, 2 );
+                ASSERT( FreeListIndex::find( nsd() ) == index );
+
+                for ( int i = 0; i < Buckets; ++i ) {
+                    DiskLoc prev;
+                    for ( DiskLoc d = nsd()->deletedListEntry( i ); !d.isNull();
+                          d = d.drec()->nextDeleted() ) {
+                        const FreeListIndex::Entry* e = index->entry( d );
+                        ASSERT( e );
+                        ASSERT_EQUALS( i, e->bucket );
+                        ASSERT_EQUALS( prev, e->prev );
+                        ASSERT_EQUALS( d.drec()->nextDeleted(), e->next );
+                        prev = d;
+                    }
+                }
+                ASSERT( index->entry( l[ 4 ] ) );
+                ASSERT( index->entry( l[ 5 ] ) );
+            }
+        };
+
+        /** Past freelistIndexMaxBytes there is no index and alloc() walks the lists. */
+        class FreeListIndexOverCap : public FreeListIndexBase {
+        public:
+            void run() {
+                ServerParameter* maxBytes = ServerParameterSet::getGlobal()->getMap().find(
+                        "freelistIndexMaxBytes" )->second;
+                BSONObjBuilder old;
+                maxBytes->append( old, "old" );
+                ASSERT_OK( maxBytes->setFromString( "1" ) );
+
+                create();
+                const int sizes[] = { 1000, 400, 600, 2000 };
+                DiskLoc l[ 4 ];
+                makeDeleted( sizes, 4, l );
+
+                ASSERT( FreeListIndex::get( nsd() ) == NULL );
+                ASSERT( FreeListIndex::find( nsd() ) == NULL );
+                ASSERT( !nsd()->alloc( NULL, ns(), 500 ).isNull() );
+                ASSERT( FreeListIndex::find( nsd() ) == NULL );
+
+                ASSERT_OK( maxBytes->set( old.obj()["old"] ) );
+                FreeListIndex::forget( nsd() );
+                ASSERT( FreeListIndex::get( nsd() ) );
+            }
+        };
+
         /* test  NamespaceDetails::cappedTruncateAfter(const char *ns, DiskLoc loc)
         */
         class TruncateCapped : public Base {
@@ -1814,6 +2006,11 @@ namespace NamespaceTests {
             add< NamespaceDetailsTests::AllocQuantizedWithoutExtra >();
             add< NamespaceDetailsTests::AllocNotQuantizedNearDeletedSize >();
             add< NamespaceDetailsTests::AllocFailsWithTooSmallDeletedRecord >();
+            add< NamespaceDetailsTests::FreeListIndexBestFit >();
+            add< NamespaceDetailsTests::FreeListIndexRebuiltWhenStale >();
+            add< NamespaceDetailsTests::FreeListIndexBuiltInSteps >();
+            add< NamespaceDetailsTests::FreeListIndexOverCap >();
+            add< NamespaceDetailsTests::FreeListIndexStats >();
             add< NamespaceDetailsTests::TwoExtent >();
             add< NamespaceDetailsTests::TruncateCapped >();
             add< NamespaceDetailsTests::Migrate >();
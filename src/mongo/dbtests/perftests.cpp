@@ -42,10 +42,16 @@
 
 #include "mongo/db/db.h"
 #include "mongo/db/dur_stats.h"
+#include "mongo/db/exec/collection_scan.h"
+#include "mongo/db/exec/limit.h"
+#include "mongo/db/exec/projection.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/json.h"
 #include "mongo/db/structure/btree/key.h"
 #include "mongo/db/lasterror.h"
+#include "mongo/db/matcher/expression_parser.h"
+#include "mongo/db/query/plan_executor.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/taskqueue.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/dbtests/framework_options.h"
@@ -500,6 +506,39 @@ namespace PerfTests {
         }
     };
 
+    /**
+     * Point lookups on an index of keys with long common beginnings, as urls and
+     * paths have, for a btree index version: v:2 indexes store such keys prefix
+     * compressed.  prep() reports the index size per key.
+     */
+    template< int Version >
+    class IndexLookup : public B {
+    public:
+        enum { N = 50000 };
+        string name() { return str::stream() << "index-lookup-v" << Version; }
+        virtual int howLongMillis() { return 3000; }
+        virtual bool showDurStats() { return false; }
+        static string key(int i) {
+            return str::stream() << "http://www.example.com/catalog/department-" << i % 20
+                                 << "/products/item-" << i;
+        }
+        void prep() {
+            client().ensureIndex(ns(), BSON("k" << 1), false, "", false, false, Version);
+            for( int i = 0; i < N; i++ ) {
+                client().insert(ns(), BSON("_id" << i << "k" << key(i)));
+            }
+            BSONObj stats;
+            verify( client().runCommand("perftest", BSON("collStats" << name()), stats) );
+            long long bytes = stats["indexSizes"]["k_1"].numberLong();
+            cout << "stats " << setw(42) << left << name() + " bytes/key" << ' ' << right
+                 << setw(9) << bytes / N << endl;
+        }
+        void timed() {
+            BSONObj o = client().findOne(ns(), QUERY("k" << key(rand() % N)));
+            verify( !o.isEmpty() );
+        }
+    };
+
     unsigned long long aaa;
 
     class Timer : public B {
@@ -1151,6 +1190,110 @@ namespace PerfTests {
         }
     };
 
+    // Runs a collection scan -> projection -> limit plan over the whole collection, filtering out
+    // nine documents in ten, with the PlanExecutor asking for 'batch' units of work at a time.
+    // Compare batch 1 (one work() call per stage per document) with the batched pipelines.
+    template <int batch>
+    class CollScanPipeline : public B {
+    public:
+        virtual string name() {
+            return str::stream() << "collscan-filter-project-batch-" << batch;
+        }
+        virtual unsigned batchSize() { return 1; }
+        virtual bool showDurStats() { return false; }
+
+        void prep() {
+            string pad(100, 'x');
+            for (int i = 0; i < kDocs; ++i) {
+                client().insert(ns(), BSON("a" << i << "b" << i % 10 << "pad" << pad));
+            }
+            client().getLastError();
+
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(BSON("b" << 3));
+            verify(swme.isOK());
+            _filter.reset(swme.getValue());
+        }
+
+        void timed() {
+            int oldBatchSize = internalQueryExecBatchSize;
+            internalQueryExecBatchSize = batch;
+
+            Client::ReadContext ctx(ns());
+
+            CollectionScanParams params;
+            params.ns = ns();
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            ProjectionStageParams projParams;
+            projParams.projImpl = ProjectionStageParams::SIMPLE_DOC;
+            projParams.projObj = BSON("a" << 1);
+
+            WorkingSet* ws = new WorkingSet();
+            PlanStage* root = new CollectionScan(params, ws, _filter.get());
+            root = new ProjectionStage(projParams, ws, root);
+            root = new LimitStage(kDocs, ws, root);
+            PlanExecutor runner(ws, root);
+
+            int n = 0;
+            for (BSONObj obj; Runner::RUNNER_ADVANCED == runner.getNext(&obj, NULL); ) {
+                dontOptimizeOutHopefully += obj.objsize();
+                ++n;
+            }
+            verify(kDocs / 10 == n);
+
+            internalQueryExecBatchSize = oldBatchSize;
+        }
+
+    private:
+        static const int kDocs = 100000;
+        boost::scoped_ptr<MatchExpression> _filter;
+    };
+
+    // Joins every document of the collection to the one document of a second collection with
+    // the same key through $lookup.  With 'indexed' the second collection has an index on the
+    // key and each document is joined by a query; without it, by a hash table of the collection.
+    template <bool indexed>
+    class LookupPipeline : public B {
+    public:
+        virtual string name() {
+            return indexed ? "lookup-indexed" : "lookup-hashed";
+        }
+        virtual unsigned batchSize() { return 1; }
+        virtual bool showDurStats() { return false; }
+
+        string foreignNs() { return string(ns()) + "_foreign"; }
+
+        void prep() {
+            client().dropCollection(foreignNs());
+            if (indexed)
+                client().ensureIndex(foreignNs(), BSON("k" << 1));
+            for (int i = 0; i < kDocs; ++i) {
+                client().insert(ns(), BSON("_id" << i << "k" << (i * 7) % kDocs));
+                client().insert(foreignNs(), BSON("_id" << i << "k" << i << "v" << i % 10));
+            }
+            client().getLastError();
+        }
+
+        void timed() {
+            BSONObj lookup = BSON("$lookup" << BSON("from" << nsToCollectionSubstring(foreignNs())
+                                                    << "localField" << "k"
+                                                    << "foreignField" << "k"
+                                                    << "as" << "joined"));
+            BSONObj group = BSON("$group" << BSON("_id" << BSONNULL << "n" << BSON("$sum" << 1)));
+            BSONObj result;
+            verify(client().runCommand("perftest",
+                                       BSON("aggregate" << nsToCollectionSubstring(ns())
+                                            << "pipeline" << BSON_ARRAY(lookup << group)),
+                                       result));
+            verify(kDocs == result["result"]["0"]["n"].numberInt());
+            dontOptimizeOutHopefully += result.objsize();
+        }
+
+    private:
+        static const int kDocs = 100000;
+    };
+
     // Tests what the worst case is for the overhead of enabling a fail point. If 'fpInjected'
     // is false, then the fail point will be compiled out. If 'fpInjected' is true, then the
     // fail point will be compiled in. Since the conditioned block is more or less trivial, any
@@ -1421,6 +1564,8 @@ namespace PerfTests {
                 add< CTM >();
                 add< CTMicros >();
                 add< KeyTest >();
+                add< IndexLookup<1> >();
+                add< IndexLookup<2> >();
                 add< Bldr >();
                 add< StkBldr >();
                 add< BSONIter >();
@@ -1434,6 +1579,11 @@ namespace PerfTests {
                 add< Update1 >();
                 add< MoreIndexes<Update1> >();
                 add< InsertBig >();
+                add< CollScanPipeline<1> >();
+                add< CollScanPipeline<100> >();
+                add< CollScanPipeline<1000> >();
+                add< LookupPipeline<false> >();
+                add< LookupPipeline<true> >();
                 add< FailPointTest<false, false> >();
                 add< FailPointTest<true, false> >();
                 add< FailPointTest<true, true> >();
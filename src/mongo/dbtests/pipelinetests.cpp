@@ -235,6 +235,93 @@ namespace PipelineTests {
     namespace Optimizations {
         using namespace mongo;
 
+        namespace Local {
+            class Base {
+            public:
+                // These return json arrays of pipeline operators
+                virtual string inputPipeJson() = 0;
+                virtual string outputPipeJson() = 0;
+
+                BSONObj pipelineFromJsonArray(const string& array) {
+                    return fromjson("{pipeline: " + array + "}");
+                }
+                virtual void run() {
+                    const BSONObj inputBson = pipelineFromJsonArray(inputPipeJson());
+                    const BSONObj outputPipeExpected = pipelineFromJsonArray(outputPipeJson());
+
+                    intrusive_ptr<ExpressionContext> ctx =
+                        new ExpressionContext(InterruptStatusMongod::status,
+                                              NamespaceString("a.collection"));
+                    string errmsg;
+                    intrusive_ptr<Pipeline> pipe = Pipeline::parseCommand(errmsg, inputBson, ctx);
+                    ASSERT_EQUALS(errmsg, "");
+                    ASSERT(pipe != NULL);
+
+                    ASSERT_EQUALS(pipe->serialize()["pipeline"],
+                                  Value(outputPipeExpected["pipeline"]));
+                }
+
+                virtual ~Base() {};
+            };
+
+            namespace moveLimitToSort {
+
+                class PastProject : public Base {
+                    string inputPipeJson() {
+                        return "[{$sort: {a: 1}}, {$project: {_id: true, a: true}}, {$limit: 5}]";
+                    }
+                    string outputPipeJson() {
+                        return "[{$sort: {a: 1}}, {$limit: 5}, {$project: {_id: true, a: true}}]";
+                    }
+                };
+
+                class PastProjectAndSkip : public Base {
+                    string inputPipeJson() {
+                        return "[{$sort: {a: 1}}"
+                               ",{$skip: 2}"
+                               ",{$project: {_id: true, a: true}}"
+                               ",{$skip: 3}"
+                               ",{$limit: 5}"
+                               "]";
+                    }
+                    string outputPipeJson() {
+                        return "[{$sort: {a: 1}}"
+                               ",{$limit: 10}"
+                               ",{$skip: 2}"
+                               ",{$project: {_id: true, a: true}}"
+                               ",{$skip: 3}"
+                               "]";
+                    }
+                };
+
+                class NoSort : public Base {
+                    string inputPipeJson() {
+                        return "[{$project: {_id: true, a: true}}, {$limit: 5}]";
+                    }
+                    string outputPipeJson() {
+                        return "[{$project: {_id: true, a: true}}, {$limit: 5}]";
+                    }
+                };
+
+                class NotPastUnwind : public Base {
+                    string inputPipeJson() {
+                        return "[{$sort: {a: 1}}"
+                               ",{$unwind: '$a'}"
+                               ",{$project: {_id: true, a: true}}"
+                               ",{$limit: 5}"
+                               "]";
+                    }
+                    string outputPipeJson() {
+                        return "[{$sort: {a: 1}}"
+                               ",{$unwind: '$a'}"
+                               ",{$project: {_id: true, a: true}}"
+                               ",{$limit: 5}"
+                               "]";
+                    }
+                };
+            } // namespace moveLimitToSort
+        } // namespace Local
+
         namespace Sharded {
             class Base {
             public:
@@ -392,6 +479,31 @@ namespace PipelineTests {
                 };
 
             } // namespace limitFieldsSentFromShardsToMerger
+
+            namespace lookup {
+                // The foreign collection is only on the primary shard, so $lookup and all that
+                // follows it must run on the merger.
+                const string lookupJson =
+                    "{$lookup: {from: 'b', localField: 'a', foreignField: 'b', as: 'c'}}";
+
+                class AfterMatch : public Base {
+                    string inputPipeJson() {
+                        return "[{$match: {a: 1}}," + lookupJson + ",{$match: {c: {$size: 0}}}]";
+                    }
+                    string shardPipeJson() {
+                        return "[{$match: {a: 1}}]";
+                    }
+                    string mergePipeJson() {
+                        return "[" + lookupJson + ",{$match: {c: {$size: 0}}}]";
+                    }
+                };
+
+                class BeforeOtherSplitPoint : public Base {
+                    string inputPipeJson() { return "[" + lookupJson + ",{$limit: 1}]"; }
+                    string shardPipeJson() { return "[]"; }
+                    string mergePipeJson() { return "[" + lookupJson + ",{$limit: 1}]"; }
+                };
+            } // namespace lookup
         } // namespace Sharded
     } // namespace Optimizations
 
@@ -420,6 +532,10 @@ namespace PipelineTests {
             add<FieldPath::Tail>();
             add<FieldPath::TailThreeFields>();
 
+            add<Optimizations::Local::moveLimitToSort::PastProject>();
+            add<Optimizations::Local::moveLimitToSort::PastProjectAndSkip>();
+            add<Optimizations::Local::moveLimitToSort::NoSort>();
+            add<Optimizations::Local::moveLimitToSort::NotPastUnwind>();
             add<Optimizations::Sharded::Empty>();
             add<Optimizations::Sharded::moveFinalUnwindFromShardsToMerger::OneUnwind>();
             add<Optimizations::Sharded::moveFinalUnwindFromShardsToMerger::TwoUnwind>();
@@ -431,6 +547,8 @@ namespace PipelineTests {
             add<Optimizations::Sharded::limitFieldsSentFromShardsToMerger::NothingNeeded>();
             add<Optimizations::Sharded::limitFieldsSentFromShardsToMerger::JustNeedsMetadata>();
             add<Optimizations::Sharded::limitFieldsSentFromShardsToMerger::ShardAlreadyExhaustive>();
+            add<Optimizations::Sharded::lookup::AfterMatch>();
+            add<Optimizations::Sharded::lookup::BeforeOtherSplitPoint>();
         }
     } myall;
     
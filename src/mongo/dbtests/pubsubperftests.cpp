@@ -0,0 +1,385 @@
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#include "mongo/pch.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "mongo/db/matcher/compiled_matcher.h"
+#include "mongo/db/matcher/matcher.h"
+#include "mongo/db/pubsub.h"
+#include "mongo/db/pubsub_sendsock.h"
+#include "mongo/dbtests/dbtests.h"
+#include "mongo/util/timer.h"
+
+namespace PubSubPerfTests {
+
+    // Benchmarks for the in-process pubsub path: PubSubSendSocket::publish through the
+    // internal proxy to PubSub::poll, plus PubSub::subscribe/unsubscribe. Latency is measured
+    // from the timestamp taken in publish to the poll that returns the message.
+    //
+    // Run with: ./test pubsubperf
+
+    // same endpoint the benchmarks use in place of the replica set's external sockets
+    const char* const kPerfPubEndpoint = "inproc://pubsubperf";
+
+    // Wires up the pubsub sockets within this process, as PubSubCleanup does for mongod,
+    // except that the external PUB/SUB pair is connected over inproc.
+    void initPubSub() {
+        static bool initialized = false;
+        if (initialized)
+            return;
+        initialized = true;
+
+        PubSubSendSocket::extSendSocket = new zmq::socket_t(PubSub::zmqContext, ZMQ_PUB);
+        int hwm = 0;
+        PubSubSendSocket::extSendSocket->setsockopt(ZMQ_SNDHWM, &hwm, sizeof(hwm));
+        PubSubSendSocket::extSendSocket->bind(kPerfPubEndpoint);
+
+        PubSub::extRecvSocket = new zmq::socket_t(PubSub::zmqContext, ZMQ_SUB);
+        PubSub::extRecvSocket->setsockopt(ZMQ_SUBSCRIBE, "", 0);
+        PubSub::extRecvSocket->setsockopt(ZMQ_RCVHWM, &hwm, sizeof(hwm));
+        PubSub::extRecvSocket->connect(kPerfPubEndpoint);
+
+        PubSub::intPubSocket.bind(PubSub::kIntPubSubEndpoint);
+
+        // runs for the life of the process
+        boost::thread internalProxy(PubSub::proxy, PubSub::extRecvSocket, &PubSub::intPubSocket);
+    }
+
+    /**
+     * Collects latency samples and reports throughput and latency percentiles.
+     */
+    class LatencyStats {
+    public:
+        void add(long long micros) { _samples.push_back(micros); }
+
+        void add(const LatencyStats& other) {
+            _samples.insert(_samples.end(), other._samples.begin(), other._samples.end());
+        }
+
+        size_t count() const { return _samples.size(); }
+
+        void say(const string& name, unsigned long long n, long long micros) {
+            std::sort(_samples.begin(), _samples.end());
+            unsigned long long rps = (n * 1000 * 1000) / (micros > 0 ? micros : 1);
+            cout << "stats " << setw(42) << left << name
+                 << ' ' << right << setw(9) << rps
+                 << ' ' << right << setw(5) << micros / 1000 << "ms"
+                 << "  p50 " << setw(7) << percentile(0.5) << "us"
+                 << "  p99 " << setw(7) << percentile(0.99) << "us"
+                 << "  p999 " << setw(7) << percentile(0.999) << "us"
+                 << endl;
+        }
+
+    private:
+        // nearest-rank percentile, samples must be sorted
+        long long percentile(double p) const {
+            if (_samples.empty())
+                return 0;
+            size_t rank = static_cast<size_t>(p * _samples.size());
+            return _samples[std::min(rank, _samples.size() - 1)];
+        }
+
+        std::vector<long long> _samples;
+    };
+
+    // Builds a message of roughly messageSize bytes with numFields int fields,
+    // all of which match the filter from makeFilter().
+    BSONObj makeMessage(int messageSize, int numFields, int seq) {
+        BSONObjBuilder b;
+        for (int i = 0; i < numFields; i++)
+            b.append(static_cast<string>(str::stream() << "f" << i), seq);
+        int padding = messageSize - b.len();
+        if (padding > 0)
+            b.append("pad", string(padding, 'x'));
+        return b.obj();
+    }
+
+    BSONObj makeFilter(int numPredicates) {
+        BSONObjBuilder b;
+        for (int i = 0; i < numPredicates; i++)
+            b.append(static_cast<string>(str::stream() << "f" << i), BSON("$gte" << 0));
+        return b.obj();
+    }
+
+    /**
+     * Publishes messages from NumThreads threads to NumSubscribers subscriptions on one channel,
+     * which are polled on from NumThreads threads. Each subscription has a filter with
+     * NumPredicates predicates (no filter if 0) that every message passes.
+     */
+    template <int MessageSize, int NumSubscribers, int NumPredicates, int NumThreads>
+    class PublishPoll {
+    public:
+        // messages published in total, each of which is delivered to every subscriber
+        static const int kNumMessages = 10000;
+
+        // give up on messages that have not arrived after this long
+        static const int kMaxWaitMillis = 30000;
+
+        string name() {
+            return str::stream() << "pubsub-publish-poll"
+                                 << "-size" << MessageSize
+                                 << "-subs" << NumSubscribers
+                                 << "-preds" << NumPredicates
+                                 << "-threads" << NumThreads;
+        }
+
+        void run() {
+            initPubSub();
+
+            const string channel = name();
+            BSONObj filter = makeFilter(NumPredicates);
+            std::vector<std::set<SubscriptionId> > pollerSubs(NumThreads);
+            for (int i = 0; i < NumSubscribers; i++) {
+                pollerSubs[i % NumThreads].insert(
+                        PubSub::subscribe(channel, filter, BSONObj()));
+            }
+
+            // subscriptions reach the internal publisher asynchronously
+            sleepmillis(100);
+
+            std::vector<LatencyStats> pollerStats(NumThreads);
+            std::vector<long long> pollerReceived(NumThreads, 0);
+
+            mongo::Timer t;
+            boost::thread_group threads;
+            for (int i = 0; i < NumThreads; i++) {
+                threads.create_thread(boost::bind(&PublishPoll::publisher, this, channel, i));
+                threads.create_thread(boost::bind(&PublishPoll::poller, this,
+                                                  &pollerSubs[i],
+                                                  &pollerStats[i],
+                                                  &pollerReceived[i]));
+            }
+            threads.join_all();
+            long long micros = t.micros();
+
+            LatencyStats stats;
+            for (int i = 0; i < NumThreads; i++)
+                stats.add(pollerStats[i]);
+            stats.say(name(), stats.count(), micros);
+
+            long long expected = static_cast<long long>(kNumMessages) * NumSubscribers;
+            if (static_cast<long long>(stats.count()) < expected) {
+                cout << "stats " << name() << " lost "
+                     << expected - stats.count() << " of " << expected << " messages" << endl;
+            }
+
+            std::map<SubscriptionId, std::string> errors;
+            for (int i = 0; i < NumThreads; i++) {
+                for (std::set<SubscriptionId>::iterator it = pollerSubs[i].begin();
+                     it != pollerSubs[i].end();
+                     it++) {
+                        PubSub::unsubscribe(*it, errors);
+                }
+            }
+        }
+
+    private:
+        void publisher(const string& channel, int threadNum) {
+            for (int i = threadNum; i < kNumMessages; i += NumThreads) {
+                PubSubSendSocket::publish(channel, makeMessage(MessageSize, NumPredicates, i));
+            }
+        }
+
+        void poller(std::set<SubscriptionId>* subs, LatencyStats* stats, long long* received) {
+            const long long expected = static_cast<long long>(kNumMessages) * subs->size();
+            mongo::Timer t;
+            while (*received < expected && t.millis() < kMaxWaitMillis) {
+                long long millisPolled = 0;
+                bool pollAgain = false;
+                std::map<SubscriptionId, std::string> errors;
+                std::vector<SequenceGap> gaps;
+                std::priority_queue<SubscriptionMessage> messages =
+                    PubSub::poll(*subs, 100, millisPolled, pollAgain, errors, gaps);
+
+                unsigned long long now = curTimeMicros64();
+                for (; !messages.empty(); messages.pop()) {
+                    stats->add(static_cast<long long>(now - messages.top().timestamp));
+                    (*received)++;
+                }
+            }
+        }
+    };
+
+    /**
+     * Cost of setting up and tearing down a subscription, with NumPredicates in its filter.
+     */
+    template <int NumPredicates>
+    class SubscribeUnsubscribe {
+    public:
+        static const int kIterations = 10000;
+
+        string name() {
+            return str::stream() << "pubsub-subscribe-unsubscribe-preds" << NumPredicates;
+        }
+
+        void run() {
+            initPubSub();
+
+            BSONObj filter = makeFilter(NumPredicates);
+            LatencyStats stats;
+            std::map<SubscriptionId, std::string> errors;
+
+            mongo::Timer t;
+            for (int i = 0; i < kIterations; i++) {
+                mongo::Timer op;
+                SubscriptionId id = PubSub::subscribe("subscribe", filter, BSONObj());
+                PubSub::unsubscribe(id, errors);
+                stats.add(op.micros());
+            }
+            stats.say(name(), kIterations, t.micros());
+        }
+    };
+
+    /**
+     * Cost of polling on NumSubscribers subscriptions that have no messages waiting.
+     */
+    template <int NumSubscribers>
+    class PollEmpty {
+    public:
+        static const int kIterations = 2000;
+
+        string name() {
+            return str::stream() << "pubsub-poll-empty-subs" << NumSubscribers;
+        }
+
+        void run() {
+            initPubSub();
+
+            std::set<SubscriptionId> subs;
+            for (int i = 0; i < NumSubscribers; i++)
+                subs.insert(PubSub::subscribe("pollempty", BSONObj(), BSONObj()));
+
+            LatencyStats stats;
+            mongo::Timer t;
+            for (int i = 0; i < kIterations; i++) {
+                long long millisPolled = 0;
+                bool pollAgain = false;
+                std::map<SubscriptionId, std::string> errors;
+                std::vector<SequenceGap> gaps;
+                mongo::Timer op;
+                PubSub::poll(subs, 0, millisPolled, pollAgain, errors, gaps);
+                stats.add(op.micros());
+            }
+            stats.say(name(), kIterations, t.micros());
+
+            std::map<SubscriptionId, std::string> errors;
+            for (std::set<SubscriptionId>::iterator it = subs.begin(); it != subs.end(); it++)
+                PubSub::unsubscribe(*it, errors);
+        }
+    };
+
+    /**
+     * Cost of matching a message against a subscription filter with NumPredicates predicates,
+     * using the interpreted Matcher2 or the CompiledMatcher used by pubsub. The message is
+     * nested one level deep to exercise dotted paths.
+     */
+    template <typename MatcherType, int NumPredicates>
+    class Match {
+    public:
+        static const int kIterations = 1000 * 1000;
+
+        string name() {
+            return str::stream() << "pubsub-match-" << MatcherType::kName
+                                 << "-preds" << NumPredicates;
+        }
+
+        void run() {
+            BSONObjBuilder filter;
+            for (int i = 0; i < NumPredicates; i++) {
+                filter.append(static_cast<string>(str::stream() << "doc.f" << i),
+                              BSON("$gte" << 0 << "$lt" << kIterations));
+            }
+            MatcherType matcher(filter.obj());
+            BSONObj message = BSON("channel" << "match" <<
+                                   "doc" << makeMessage(64, NumPredicates, 1));
+
+            LatencyStats stats;
+            long long matched = 0;
+            mongo::Timer t;
+            for (int i = 0; i < kIterations; i++) {
+                if (matcher.matches(message))
+                    matched++;
+            }
+            stats.say(name(), kIterations, t.micros());
+            verify(matched == kIterations);
+        }
+    };
+
+    struct InterpretedMatcher : public Matcher2 {
+        static const char* const kName;
+        explicit InterpretedMatcher(const BSONObj& pattern) : Matcher2(pattern) {}
+    };
+    const char* const InterpretedMatcher::kName = "interpreted";
+
+    struct CompiledFilter : public CompiledMatcher {
+        static const char* const kName;
+        explicit CompiledFilter(const BSONObj& pattern) : CompiledMatcher(pattern) {}
+    };
+    const char* const CompiledFilter::kName = "compiled";
+
+    class All : public Suite {
+    public:
+        All() : Suite( "pubsubperf" ) { }
+
+        void setupTests() {
+            cout << "stats test                                       rps------  time--"
+                 << "  latency--------------------------------------" << endl;
+
+            add< SubscribeUnsubscribe<0> >();
+            add< SubscribeUnsubscribe<8> >();
+
+            add< Match<InterpretedMatcher, 1> >();
+            add< Match<CompiledFilter, 1> >();
+            add< Match<InterpretedMatcher, 8> >();
+            add< Match<CompiledFilter, 8> >();
+
+            add< PollEmpty<1> >();
+            add< PollEmpty<100> >();
+
+            // message size
+            add< PublishPoll<64, 1, 0, 1> >();
+            add< PublishPoll<1024, 1, 0, 1> >();
+            add< PublishPoll<16 * 1024, 1, 0, 1> >();
+
+            // fan-out
+            add< PublishPoll<64, 10, 0, 1> >();
+            add< PublishPoll<64, 100, 0, 1> >();
+
+            // filter complexity
+            add< PublishPoll<64, 10, 1, 1> >();
+            add< PublishPoll<64, 10, 8, 1> >();
+
+            // concurrency
+            add< PublishPoll<64, 10, 0, 4> >();
+            add< PublishPoll<64, 100, 1, 8> >();
+        }
+    } myall;
+
+}  // namespace PubSubPerfTests
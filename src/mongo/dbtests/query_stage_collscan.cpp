@@ -38,6 +38,7 @@
 #include "mongo/db/matcher/expression_parser.h"
 #include "mongo/db/pdfile.h"
 #include "mongo/db/query/plan_executor.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/util/fail_point_service.h"
 
@@ -471,6 +472,39 @@ namespace QueryStageCollectionScan {
         }
     };
 
+    //
+    // Start and stop at given records, as a parallel scan of an extent does.
+    //
+
+    class QueryStageCollscanStartAndEnd : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            Client::ReadContext ctx(ns());
+
+            vector<DiskLoc> locs;
+            getLocs(CollectionScanParams::FORWARD, &locs);
+
+            CollectionScanParams params;
+            params.ns = ns();
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+            params.start = locs[10];
+            params.end = locs[19];
+
+            WorkingSet* ws = new WorkingSet();
+            PlanStage* ps = new CollectionScan(params, ws, NULL);
+            PlanExecutor runner(ws, ps);
+
+            int count = 0;
+            for (BSONObj obj; Runner::RUNNER_ADVANCED == runner.getNext(&obj, NULL); ) {
+                ASSERT_EQUALS(10 + count, obj["foo"].numberInt());
+                ++count;
+            }
+
+            ASSERT_EQUALS(10, count);
+        }
+    };
+
     //
     // Scan through half the objects, delete the one we're about to fetch, then expect to get the
     // "next" object we would have gotten after that.
@@ -657,6 +691,101 @@ namespace QueryStageCollectionScan {
     };
 
 
+    //
+    // Scan in batches, with and without a filter, and expect what a scan one unit of work at a
+    // time returns.
+    //
+
+    class QueryStageCollscanBatched : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            Client::ReadContext ctx(ns());
+
+            vector<DiskLoc> locs;
+            getLocs(CollectionScanParams::FORWARD, &locs);
+
+            BSONObj filterObj = BSON("foo" << BSON("$lt" << 25));
+            StatusWithMatchExpression swme = MatchExpressionParser::parse(filterObj);
+            verify(swme.isOK());
+            auto_ptr<MatchExpression> filterExpr(swme.getValue());
+
+            for (size_t batchSize = 1; batchSize <= 100; batchSize *= 10) {
+                for (int filtered = 0; filtered < 2; ++filtered) {
+                    CollectionScanParams params;
+                    params.ns = ns();
+                    params.direction = CollectionScanParams::FORWARD;
+                    params.tailable = false;
+
+                    WorkingSet ws;
+                    scoped_ptr<CollectionScan> scan(
+                        new CollectionScan(params, &ws, filtered ? filterExpr.get() : NULL));
+
+                    size_t count = 0;
+                    while (!scan->isEOF()) {
+                        vector<WorkingSetID> batch;
+                        WorkingSetID special = WorkingSet::INVALID_ID;
+                        scan->workBatch(batchSize, &batch, &special);
+                        ASSERT_LESS_THAN_OR_EQUALS(batch.size(), batchSize);
+                        for (size_t i = 0; i < batch.size(); ++i) {
+                            WorkingSetMember* member = ws.get(batch[i]);
+                            ASSERT_EQUALS(locs[count], member->loc);
+                            ASSERT_EQUALS(static_cast<int>(count),
+                                          member->obj["foo"].numberInt());
+                            ++count;
+                        }
+                    }
+
+                    ASSERT_EQUALS(filtered ? 25U : size_t(numObj()), count);
+                }
+            }
+        }
+    };
+
+    //
+    // Have a PlanExecutor run ahead of its caller a batch at a time, and delete a result it is
+    // holding but hasn't returned yet.  It must still return it, from its own copy.
+    //
+
+    class QueryStageCollscanBatchedExecutorInvalidate : public QueryStageCollectionScanBase {
+    public:
+        void run() {
+            Client::WriteContext ctx(ns());
+
+            vector<DiskLoc> locs;
+            getLocs(CollectionScanParams::FORWARD, &locs);
+
+            int oldBatchSize = internalQueryExecBatchSize;
+            internalQueryExecBatchSize = 100;
+
+            CollectionScanParams params;
+            params.ns = ns();
+            params.direction = CollectionScanParams::FORWARD;
+            params.tailable = false;
+
+            WorkingSet* ws = new WorkingSet();
+            PlanStage* ps = new CollectionScan(params, ws, NULL);
+            PlanExecutor runner(ws, ps);
+
+            int count = 0;
+            BSONObj obj;
+            ASSERT_EQUALS(Runner::RUNNER_ADVANCED, runner.getNext(&obj, NULL));
+            ASSERT_EQUALS(count++, obj["foo"].numberInt());
+
+            // The rest of the collection has been read into the executor's batch.
+            runner.saveState();
+            runner.invalidate(locs[10], INVALIDATION_DELETION);
+            remove(locs[10].obj());
+            ASSERT(runner.restoreState());
+
+            while (Runner::RUNNER_ADVANCED == runner.getNext(&obj, NULL)) {
+                ASSERT_EQUALS(count++, obj["foo"].numberInt());
+            }
+            ASSERT_EQUALS(numObj(), count);
+
+            internalQueryExecBatchSize = oldBatchSize;
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "QueryStageCollectionScan" ) {}
@@ -683,9 +812,12 @@ namespace QueryStageCollectionScan {
             add<QueryStageCollscanBasicBackwardWithMatch>();
             add<QueryStageCollscanObjectsInOrderForward>();
             add<QueryStageCollscanObjectsInOrderBackward>();
+            add<QueryStageCollscanStartAndEnd>();
             add<QueryStageCollscanInvalidateUpcomingObject>();
             add<QueryStageCollscanInvalidateUpcomingObjectBackward>();
             add<QueryStageCollscanFetch>();
+            add<QueryStageCollscanBatched>();
+            add<QueryStageCollscanBatchedExecutorInvalidate>();
         }
     } all;
 
@@ -74,6 +74,18 @@ namespace {
         return count;
     }
 
+    int countBatchResults(PlanStage* stage, size_t batchSize) {
+        int count = 0;
+        while (!stage->isEOF()) {
+            std::vector<WorkingSetID> batch;
+            WorkingSetID special = WorkingSet::INVALID_ID;
+            stage->workBatch(batchSize, &batch, &special);
+            ASSERT_LESS_THAN_OR_EQUALS(batch.size(), batchSize);
+            count += batch.size();
+        }
+        return count;
+    }
+
     //
     // Insert 50 objects.  Filter/skip 0, 1, 2, ..., 100 objects and expect the right # of results.
     //
@@ -92,12 +104,29 @@ namespace {
         }
     };
 
+    //
+    // Limit a batched child to 0, 1, 2, ..., 100 objects, a few units of work at a time.
+    //
+    class QueryStageLimitBatchTest {
+    public:
+        void run() {
+            for (int i = 0; i < 2 * N; ++i) {
+                for (size_t batchSize = 1; batchSize <= 64; batchSize *= 4) {
+                    WorkingSet ws;
+                    scoped_ptr<PlanStage> limit(new LimitStage(i, &ws, getMS(&ws)));
+                    ASSERT_EQUALS(min(N, i), countBatchResults(limit.get(), batchSize));
+                }
+            }
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "query_stage_limit_skip" ) { }
 
         void setupTests() {
             add<QueryStageLimitSkipBasicTest>();
+            add<QueryStageLimitBatchTest>();
         }
     }  queryStageLimitSkipAll;
 
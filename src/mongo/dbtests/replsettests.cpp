@@ -101,9 +101,12 @@ namespace ReplSetTests {
     };
 
     class BackgroundSyncTest : public replset::BackgroundSyncInterface {
-        std::queue<BSONObj> _queue;
+        std::deque<BSONObj> _queue;
+        // Every op handed out by peekAhead(), in order, and how many times it was called
+        std::vector<BSONObj> _peekedAhead;
+        int _peekAheadCalls;
     public:
-        BackgroundSyncTest() {}
+        BackgroundSyncTest() : _peekAheadCalls(0) {}
         virtual ~BackgroundSyncTest() {}
         virtual bool peek(BSONObj* op) {
             if (_queue.empty()) {
@@ -112,18 +115,31 @@ namespace ReplSetTests {
             *op = _queue.front();
             return true;
         }
+        virtual void peekAhead(size_t skip, size_t limit, std::vector<BSONObj>* ops) {
+            _peekAheadCalls++;
+            for (size_t i = skip; i < _queue.size() && i - skip < limit; i++) {
+                ops->push_back(_queue[i]);
+                _peekedAhead.push_back(_queue[i]);
+            }
+        }
         virtual void consume() {
-            _queue.pop();
+            _queue.pop_front();
         }
         virtual Member* getSyncTarget() {
             return 0;
         }
         void addDoc(BSONObj doc) {
-            _queue.push(doc.getOwned());
+            _queue.push_back(doc.getOwned());
         }
         virtual void waitForMore() {
             return;
         }
+        const std::vector<BSONObj>& peekedAhead() const {
+            return _peekedAhead;
+        }
+        int peekAheadCalls() const {
+            return _peekAheadCalls;
+        }
     };
 
 
@@ -569,6 +585,108 @@ namespace ReplSetTests {
         }
     };
 
+    // Runs multiApply() without writing the batch, so only the prefetching is exercised
+    class PrefetchAheadSync : public replset::SyncTail {
+    public:
+        PrefetchAheadSync(replset::BackgroundSyncInterface* q) : SyncTail(q) {}
+        void apply(std::deque<BSONObj>& ops) {
+            multiApply(ops, &skipApply);
+        }
+    private:
+        static void skipApply(const std::vector<BSONObj>& ops, replset::SyncTail* st) {}
+    };
+
+    class TestPrefetchAhead : public Base {
+        BSONObj updateOp(int id) {
+            OpTime ts;
+            {
+                Lock::GlobalWrite lk;
+                ts = OpTime::_now();
+            }
+
+            BSONObjBuilder b;
+            b.appendTimestamp("ts", ts.asLL());
+            b.append("op", "u");
+            b.append("o", BSON("$set" << BSON("x" << id)));
+            b.append("o2", BSON("_id" << id));
+            b.append("ns", ns());
+            return b.obj();
+        }
+
+        // Moves the first 'count' ops from the network queue into a batch, as
+        // tryPopAndWaitForMore() does
+        void popBatch(BackgroundSyncTest* queue, int count, std::deque<BSONObj>* batch) {
+            batch->clear();
+            for (int i = 0; i < count; i++) {
+                BSONObj op;
+                ASSERT(queue->peek(&op));
+                batch->push_back(op);
+                queue->consume();
+            }
+        }
+
+        BSONObj preloadMetrics() {
+            BSONObj status;
+            ASSERT(client()->runCommand("admin", BSON("serverStatus" << 1 << "repl" << 0),
+                                        status));
+            return status["metrics"]["repl"]["preload"].Obj().getOwned();
+        }
+
+        // Updates are the only ops whose document prefetchOp() pages in, once each
+        long long docsPrefetched() {
+            return preloadMetrics()["docs"]["num"].numberLong();
+        }
+
+        long long aheadOps() {
+            return preloadMetrics()["aheadOps"].numberLong();
+        }
+
+    public:
+        void run() {
+            drop();
+            for (int i = 0; i < 8; i++) {
+                insert(BSON("_id" << i));
+            }
+
+            BackgroundSyncTest queue;
+            PrefetchAheadSync tailer(&queue);
+            for (int i = 0; i < 8; i++) {
+                queue.addDoc(updateOp(i));
+            }
+
+            const long long docsBefore = docsPrefetched();
+            const long long aheadBefore = aheadOps();
+            std::deque<BSONObj> batch;
+
+            // Applying the first batch schedules everything queued behind it
+            popBatch(&queue, 3, &batch);
+            tailer.apply(batch);
+            ASSERT_EQUALS(1, queue.peekAheadCalls());
+            ASSERT_EQUALS(5U, queue.peekedAhead().size());
+            for (int i = 0; i < 5; i++) {
+                ASSERT_EQUALS(i + 3, queue.peekedAhead()[i]["o2"]["_id"].numberInt());
+            }
+            ASSERT_EQUALS(5, aheadOps() - aheadBefore);
+
+            // The second batch was already scheduled, so prefetchOps() skips all of it; its
+            // join() waits for the ops scheduled ahead, which are then the only ones paged in
+            // besides the first batch
+            popBatch(&queue, 3, &batch);
+            tailer.apply(batch);
+            ASSERT_EQUALS(8, docsPrefetched() - docsBefore);
+            ASSERT_EQUALS(2, queue.peekAheadCalls());
+            ASSERT_EQUALS(5U, queue.peekedAhead().size());
+
+            // The rest of the queue was covered by the first peekAhead() too
+            popBatch(&queue, 2, &batch);
+            tailer.apply(batch);
+            ASSERT_EQUALS(8, docsPrefetched() - docsBefore);
+            ASSERT_EQUALS(5, aheadOps() - aheadBefore);
+
+            drop();
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "replset" ) {
@@ -582,6 +700,7 @@ namespace ReplSetTests {
             add< CappedUpdate >();
             add< CappedInsert >();
             add< TestRSSync >();
+            add< TestPrefetchAhead >();
         }
     } myall;
 }
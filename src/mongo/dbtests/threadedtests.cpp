@@ -36,6 +36,8 @@
 
 #include "mongo/bson/util/atomic_int.h"
 #include "mongo/db/d_concurrency.h"
+#include "mongo/db/namespace_string.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/platform/atomic_word.h"
 #include "mongo/util/concurrency/mvar.h"
@@ -913,6 +915,178 @@ namespace ThreadedTests {
         }
     };
 
+    static void setCollectionLevelLocking( bool on ) {
+        ServerParameter* p =
+            ServerParameterSet::getGlobal()->getMap().find( "collectionLevelLocking" )->second;
+        ASSERT_OK( p->setFromString( on ? "true" : "false" ) );
+    }
+
+    // Two writers to different collections of one database hold their collection locks at the same
+    // time, and neither can write the other's collection or the database as a whole.
+    class CollectionLocksAreConcurrent : public ThreadedTest<2> {
+    public:
+        CollectionLocksAreConcurrent() : _barrier(2) {}
+    private:
+        boost::barrier _barrier;
+        AtomicUInt32 _inside;
+
+        static string ns( int x ) {
+            return str::stream() << "unittests_collectionlocks.c" << x;
+        }
+
+        virtual void setup() {
+            // before the database's first lock, which only supports intent locking if made while
+            // collection level locking is on
+            setCollectionLevelLocking( true );
+            DBDirectClient db;
+            db.insert( ns(1), BSON( "x" << 1 ) );
+            db.insert( ns(2), BSON( "x" << 1 ) );
+        }
+        virtual void subthread( int x ) {
+            Client::initThread( "collectionlocks" );
+            _barrier.wait();
+            {
+                Lock::DBWrite lk( ns(x), Lock::DBWrite::collectionScope );
+                ASSERT( Lock::isCollectionLocked() );
+                ASSERT( Lock::isWriteLocked( ns(x) ) );
+                ASSERT( !Lock::isWriteLocked( ns(3 - x) ) );
+                ASSERT( !Lock::isWriteLocked( "unittests_collectionlocks" ) );
+                ASSERT( Lock::atLeastIntentWriteLocked( "unittests_collectionlocks" ) );
+
+                _inside.fetchAndAdd( 1 );
+                Timer t;
+                while ( _inside.load() < 2 ) {
+                    ASSERT( t.seconds() < 10 );
+                    sleepmillis( 1 );
+                }
+            }
+            ASSERT( !Lock::isCollectionLocked() );
+            cc().shutdown();
+        }
+        virtual void validate() {
+            setCollectionLevelLocking( false );
+            ASSERT_EQUALS( 2U, _inside.load() );
+
+            DBDirectClient db;
+            db.dropDatabase( "unittests_collectionlocks" );
+        }
+    };
+
+    // Writers to different collections of one database insert concurrently under collection locks,
+    // enough for them all to allocate extents and for the database to add data files.
+    class CollectionLockedInsertsAllocate : public ThreadedTest<4> {
+    public:
+        CollectionLockedInsertsAllocate() : _barrier(4) {}
+    private:
+        static const int docsPerThread = 400;
+        boost::barrier _barrier;
+
+        static string ns( int x ) {
+            return str::stream() << "unittests_collectionalloc.c" << x;
+        }
+
+        virtual void setup() {
+            setCollectionLevelLocking( true );
+            DBDirectClient db;
+            db.dropDatabase( "unittests_collectionalloc" );
+            for ( int x = 0; x < 4; x++ )
+                db.insert( ns(x), BSON( "_id" << -1 ) );
+        }
+        virtual void subthread( int x ) {
+            Client::initThread( "collectionalloc" );
+            // large enough that the threads fill several data files between them
+            const string filler( 100 * 1024, 'a' + x );
+            DBDirectClient db;
+            _barrier.wait();
+            for ( int i = 0; i < docsPerThread; i++ )
+                db.insert( ns(x), BSON( "_id" << i << "filler" << filler ) );
+            ASSERT_EQUALS( "", db.getLastError() );
+            cc().shutdown();
+        }
+        virtual void validate() {
+            setCollectionLevelLocking( false );
+
+            DBDirectClient db;
+            for ( int x = 0; x < 4; x++ ) {
+                ASSERT_EQUALS( static_cast<unsigned long long>( docsPerThread + 1 ), db.count( ns(x) ) );
+                BSONObj info;
+                ASSERT( db.runCommand( "unittests_collectionalloc",
+                                       BSON( "validate" << NamespaceString( ns(x) ).coll()
+                                             << "full" << true ),
+                                       info ) );
+                ASSERT( info["valid"].trueValue() );
+            }
+            BSONObj stats;
+            ASSERT( db.runCommand( "unittests_collectionalloc", BSON( "dbStats" << 1 ), stats ) );
+            ASSERT_GREATER_THAN( stats["numExtents"].numberInt(), 4 );
+            ASSERT_GREATER_THAN( stats["fileSize"].numberLong(), 64LL * 1024 * 1024 );
+            db.dropDatabase( "unittests_collectionalloc" );
+        }
+    };
+
+    // Two writers batch inserts into different collections of a profiled database under collection
+    // locks. Each insert is profiled, once the batch has released its collection lock.
+    class CollectionLockedInsertsProfile : public ThreadedTest<2> {
+    public:
+        CollectionLockedInsertsProfile() : _barrier(2) {}
+    private:
+        static const int batches = 20;
+        static const int docsPerBatch = 10;
+        boost::barrier _barrier;
+
+        static string coll( int x ) {
+            return str::stream() << "c" << x;
+        }
+        static string ns( int x ) {
+            return "unittests_collectionprofile." + coll( x );
+        }
+
+        virtual void setup() {
+            setCollectionLevelLocking( true );
+            DBDirectClient db;
+            db.dropDatabase( "unittests_collectionprofile" );
+            db.insert( ns(0), BSON( "_id" << -1 ) );
+            db.insert( ns(1), BSON( "_id" << -1 ) );
+            BSONObj info;
+            ASSERT( db.runCommand( "unittests_collectionprofile", BSON( "profile" << 2 ), info ) );
+        }
+        virtual void subthread( int x ) {
+            Client::initThread( "collectionprofile" );
+            DBDirectClient db;
+            _barrier.wait();
+            for ( int i = 0; i < batches; i++ ) {
+                BSONArrayBuilder docs;
+                for ( int j = 0; j < docsPerBatch; j++ )
+                    docs.append( BSON( "_id" << i * docsPerBatch + j ) );
+                BSONObj res;
+                ASSERT( db.runCommand( "unittests_collectionprofile",
+                                       BSON( "insert" << coll(x) << "documents" << docs.arr() ),
+                                       res ) );
+                ASSERT_EQUALS( docsPerBatch, res["n"].numberInt() );
+            }
+            cc().shutdown();
+        }
+        virtual void validate() {
+            setCollectionLevelLocking( false );
+
+            DBDirectClient db;
+            BSONObj info;
+            ASSERT( db.runCommand( "unittests_collectionprofile", BSON( "profile" << 0 ), info ) );
+            for ( int x = 0; x < 2; x++ ) {
+                ASSERT_EQUALS( static_cast<unsigned long long>( batches * docsPerBatch + 1 ),
+                               db.count( ns(x) ) );
+                ASSERT_EQUALS( static_cast<unsigned long long>( batches * docsPerBatch ),
+                               db.count( "unittests_collectionprofile.system.profile",
+                                         BSON( "op" << "insert" << "ns" << ns(x) ) ) );
+            }
+            ASSERT( db.runCommand( "unittests_collectionprofile",
+                                   BSON( "validate" << "system.profile" << "full" << true ),
+                                   info ) );
+            ASSERT( info["valid"].trueValue() );
+            db.dropDatabase( "unittests_collectionprofile" );
+        }
+    };
+
     // Tests waiting on the TicketHolder by running many more threads than can fit into the "hotel", but only
     // max _nRooms threads should ever get in at once
     class TicketHolderWaits : public ThreadedTest<10> {
@@ -1022,6 +1196,9 @@ namespace ThreadedTests {
             add< RWLockTest4 >();
 
             add< MongoMutexTest >();
+            add< CollectionLocksAreConcurrent >();
+            add< CollectionLockedInsertsAllocate >();
+            add< CollectionLockedInsertsProfile >();
             add< TicketHolderWaits >();
         }
     } myall;
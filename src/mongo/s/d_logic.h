@@ -296,6 +296,11 @@ namespace mongo {
 
         static ShardedConnectionInfo* get( bool create );
         static void reset();
+
+        /** takes this thread's info (if any) out of TLS without destroying it */
+        static ShardedConnectionInfo* release();
+        /** makes info, previously returned by release(), this thread's info */
+        static void set( ShardedConnectionInfo* info );
         static void addHook();
 
         bool inForceVersionOkMode() const {
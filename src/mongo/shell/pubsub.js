@@ -1,4 +1,4 @@
-var PS, Subscription;
+var PS, Subscription, PollGroup;
 
 (function() {
 
@@ -20,6 +20,9 @@ PS.prototype.help = function() {
     print("\tps.pollAll([timeout])           polls for messages on all subscriptions issed by " +
                                              "this instance of PS");
     print("\tps.unsubscribe(id)              unsubscribes from subscription id given");
+    print("\tps.createPollGroup(ids)         <PollGroup> binds the subscription ids given " +
+                                             "so they can be polled on together");
+    print("\tps.destroyPollGroup(id)         removes poll group id given");
     print("\tps.unsubscribeAll()             unsubscribes from all subscriptions issued by " +
                                              "this instance of PS");
 }
@@ -85,6 +88,26 @@ PS.prototype.unsubscribe = function(id) {
     return res;
 }
 
+PS.prototype.createPollGroup = function(ids) {
+    idsType = typeof ids;
+    if (idsType != "object" && idsType != "array")
+        throw Error("The subscriptionId argument to the createPollGroup command must be " +
+                    "an object or array but was a " + idsType);
+    var res = this._db.runCommand({ createPollGroup: ids });
+    assert.commandWorked(res);
+    return new PollGroup(res.pollGroupId, this);
+}
+
+PS.prototype.destroyPollGroup = function(id) {
+    idType = typeof id;
+    if (idType != "object" && idType != "array")
+        throw Error("The pollGroupId argument to the destroyPollGroup command must be " +
+                    "an object or array but was a " + idType);
+    var res = this._db.runCommand({ destroyPollGroup: id });
+    assert.commandWorked(res);
+    return res;
+}
+
 if (Subscription === undefined) {
     Subscription = function(id, ps) {
         if (id === undefined) {
@@ -116,4 +139,26 @@ Subscription.prototype.unsubscribe = function() {
     return this._ps.unsubscribe(this._id);
 }
 
+if (PollGroup === undefined) {
+    PollGroup = function(id, ps) {
+        if (id === undefined) {
+            throw Error("The PollGroup constructor takes an id");
+        }
+        this._id = id;
+        this._ps = ps;
+    }
+}
+
+PollGroup.prototype.poll = function(timeout) {
+    return this._ps.poll(this._id, timeout);
+}
+
+PollGroup.prototype.getId = function() {
+    return this._id;
+}
+
+PollGroup.prototype.destroy = function() {
+    return this._ps.destroyPollGroup(this._id);
+}
+
 }());
@@ -345,6 +345,7 @@ namespace mongo {
                           << "size: " << size/1024/1024 << "MB, "
                           << " took " << ((double)t.millis())/1000.0 << " secs"
                           << endl;
+                    fa->_lastAllocationMillis.store( t.millis() );
 
                     // no longer in a failed state. allow new writers.
                     fa->_failed = false;
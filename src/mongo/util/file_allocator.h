@@ -21,6 +21,7 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/thread/condition.hpp>
 
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/concurrency/mutex.h"
 
 namespace mongo {
@@ -56,6 +57,9 @@ namespace mongo {
         
         bool hasFailed() const;
 
+        /** how long the most recent allocation took, 0 if there has been none */
+        long long lastAllocationMillis() const { return _lastAllocationMillis.load(); }
+
         static void ensureLength(int fd, long size);
 
         /** @return the singleton */
@@ -91,6 +95,8 @@ namespace mongo {
 
         bool _failed;
 
+        AtomicInt64 _lastAllocationMillis;
+
         static FileAllocator* _instance;
 
     };
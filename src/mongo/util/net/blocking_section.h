@@ -0,0 +1,56 @@
+// blocking_section.h
+
+/*    Copyright 2014 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include "mongo/base/disallow_copying.h"
+
+namespace mongo {
+
+    /**
+     * Marks a stretch of request processing that waits on something other than the server's
+     * own work: a long poll, a tailable cursor awaiting data, replication of a write, a client
+     * reading an exhaust cursor.
+     *
+     * When connections are serviced by a pool of worker threads, the pool starts another
+     * worker for as long as a section is open on one of its threads, so that requests which
+     * block can't take every worker and starve the other connections. It only starts so many,
+     * though: past that, shouldEndEarly() is true, and a wait that can end early (a long poll,
+     * a tail awaiting data) should go back to its client, which asks again, rather than hold a
+     * worker. Elsewhere, and on threads outside the pool, a section does nothing.
+     */
+    class BlockingSection {
+        MONGO_DISALLOW_COPYING(BlockingSection);
+    public:
+        BlockingSection() : _endEarly( enterHook && ! enterHook() ) { }
+        ~BlockingSection() { if ( leaveHook ) leaveHook(); }
+
+        /** true if no worker was started in this thread's place */
+        bool shouldEndEarly() const { return _endEarly; }
+
+        // set by the server when it starts a worker pool; called on the thread opening or
+        // closing a section. enterHook returns false if it couldn't replace the thread.
+        typedef bool (*EnterHook)();
+        typedef void (*LeaveHook)();
+        static EnterHook enterHook;
+        static LeaveHook leaveHook;
+
+    private:
+        const bool _endEarly;
+    };
+
+}
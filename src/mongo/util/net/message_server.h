@@ -30,6 +30,15 @@ namespace mongo {
 
     class MessageHandler {
     public:
+        /**
+         * Whatever per-connection state a handler keeps in thread locals, packaged up so it can
+         * move between threads. Deleting it destroys any state it still holds.
+         */
+        class ConnectionState {
+        public:
+            virtual ~ConnectionState() {}
+        };
+
         virtual ~MessageHandler() {}
         
         /**
@@ -47,6 +56,25 @@ namespace mongo {
          * called once when a socket is disconnected
          */
         virtual void disconnected( AbstractMessagingPort* p ) = 0;
+
+        /**
+         * @return true if the handler implements detach() and attach(), so that a connection
+         *     can be serviced by a different thread for each message. Otherwise the server
+         *     dedicates a thread to each connection.
+         */
+        virtual bool canDetach() const { return false; }
+
+        /**
+         * called on the servicing thread after a message has been processed, or after
+         * disconnected(); moves the connection's thread local state off the current thread.
+         */
+        virtual ConnectionState* detach( AbstractMessagingPort* p ) { return NULL; }
+
+        /**
+         * called before the next message on the connection is processed, possibly on another
+         * thread, with the result of the last detach(). takes ownership of state.
+         */
+        virtual void attach( AbstractMessagingPort* p , ConnectionState* state ) { delete state; }
     };
 
     class MessageServer {
@@ -23,9 +23,12 @@
 
 
 #include "mongo/db/lasterror.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/stats/counters.h"
 #include "mongo/util/concurrency/ticketholder.h"
 #include "mongo/util/concurrency/thread_name.h"
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/net/blocking_section.h"
 #include "mongo/util/net/listen.h"
 #include "mongo/util/net/message.h"
 #include "mongo/util/net/message_port.h"
@@ -33,11 +36,442 @@
 #include "mongo/util/net/ssl_manager.h"
 
 #ifdef __linux__  // TODO: consider making this ifndef _WIN32
+# include <sys/epoll.h>
 # include <sys/resource.h>
 #endif
 
 namespace mongo {
 
+    // If non-zero, connections are serviced by this many worker threads rather than a thread
+    // per connection, where the handler and platform support it.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(connectionWorkerThreads, int, 0);
+
+    // The most worker threads a pool runs, counting those started in place of blocked ones.
+    // 0 is ten times connectionWorkerThreads.
+    MONGO_EXPORT_SERVER_PARAMETER(connectionWorkerMaxThreads, int, 0);
+
+namespace {
+
+    /**
+     * A connection accepted by the server, owning its port.
+     */
+    struct Connection {
+        explicit Connection( MessagingPort* inPort ) :
+            port( inPort ), lastError( NULL ), connected( false ),
+            headerRead( 0 ), data( NULL ), dataRead( 0 ), bytesRead( 0 ) {
+            threadName = "conn";
+            if ( port->connectionId() > 0 )
+                threadName = str::stream() << threadName << port->connectionId();
+        }
+
+        ~Connection() { free( data ); }
+
+        scoped_ptr<MessagingPort> port;
+        LastError* lastError;
+        bool connected; // true once MessageHandler::connected() has been called
+        std::auto_ptr<MessageHandler::ConnectionState> state; // while not being serviced
+        string threadName;
+        string otherSide;
+
+        // In a worker pool, the message being read while only part of it has arrived: the
+        // header first, then the whole message once its length is known.
+        MSGHEADER header;
+        int headerRead;
+        MsgData* data;
+        int dataRead;
+        long long bytesRead; // read outside the port's counters, for networkCounter
+    };
+
+    /** logs the end of c and shuts its port down */
+    void endConnection( Connection* c ) {
+        if (!serverGlobalParams.quiet) {
+            int conns = Listener::globalTicketHolder.used()-1;
+            const char* word = (conns == 1 ? " connection" : " connections");
+            log() << "end connection " << c->otherSide << " (" << conns << word << " now open)" << endl;
+        }
+        c->port->shutdown();
+    }
+
+    /**
+     * Processes one message from c, calling handler->connected() first if this is the first
+     * message on the connection. The message is 'received' if the caller has already read it,
+     * otherwise it is read from the port. c->lastError must be the current thread's lastError.
+     *
+     * @return false if the connection should be closed, because the remote side closed it or
+     *     because of an error handling the request, in which case the port has been shut down.
+     */
+    bool handleNextMessage( Connection* c , MessageHandler* handler , Message* received = NULL ) {
+        MessagingPort* p = c->port.get();
+
+        Message m;
+        Message* msg = received ? received : &m;
+        try {
+            if ( ! c->connected ) {
+                c->connected = true;
+                c->otherSide = p->psock->remoteString();
+                handler->connected( p );
+            }
+
+            p->psock->clearCounters();
+
+            if ( ! received && ! p->recv(m) ) {
+                endConnection( c );
+                return false;
+            }
+
+            handler->process( *msg , p , c->lastError );
+            networkCounter.hit( p->psock->getBytesIn() + c->bytesRead , p->psock->getBytesOut() );
+            c->bytesRead = 0;
+            return true;
+        }
+        catch ( AssertionException& e ) {
+            log() << "AssertionException handling request, closing client connection: " << e << endl;
+            p->shutdown();
+        }
+        catch ( SocketException& e ) {
+            log() << "SocketException handling request, closing client connection: " << e << endl;
+            p->shutdown();
+        }
+        catch ( const DBException& e ) { // must be right above std::exception to avoid catching subclasses
+            log() << "DBException handling request, closing client connection: " << e << endl;
+            p->shutdown();
+        }
+        catch ( std::exception &e ) {
+            error() << "Uncaught std::exception: " << e.what() << ", terminating" << endl;
+            dbexit( EXIT_UNCAUGHT );
+        }
+        catch ( ... ) {
+            error() << "Uncaught exception, terminating" << endl;
+            dbexit( EXIT_UNCAUGHT );
+        }
+        return false;
+    }
+
+#ifdef __linux__
+    enum ReadResult { READ_COMPLETE , READ_PARTIAL , READ_CLOSED };
+
+    /**
+     * Checks the header of the message c has started reading and allocates room for the rest.
+     * Answers the endian check old drivers send, in which case the header is discarded.
+     *
+     * @return false if the connection should be closed
+     */
+    bool startMessage( Connection* c ) {
+        MessagingPort* p = c->port.get();
+        int len = c->header.messageLength;
+
+        if ( len == -1 ) {
+            unsigned foo = 0x10203040;
+            try {
+                p->send( (char *) &foo, 4, "endian" );
+            }
+            catch ( SocketException& ) {
+                return false;
+            }
+            p->psock->setHandshakeReceived();
+            c->headerRead = 0;
+            return true;
+        }
+
+        if ( p->psock->isAwaitingHandshake() &&
+             c->header.responseTo != 0 && c->header.responseTo != -1 ) {
+            log() << "SSL handshake requested, not supported with connectionWorkerThreads, "
+                  << "closing connection " << c->otherSide << endl;
+            return false;
+        }
+
+        if ( static_cast<size_t>(len) < sizeof(MSGHEADER) ||
+             static_cast<size_t>(len) > MaxMessageSizeBytes ) {
+            LOG(0) << "recv(): message len " << len << " is invalid. "
+                   << "Min " << sizeof(MSGHEADER) << " Max: " << MaxMessageSizeBytes << endl;
+            return false;
+        }
+
+        p->psock->setHandshakeReceived();
+        int z = (len+1023)&0xfffffc00;
+        c->data = static_cast<MsgData*>( malloc(z) );
+        verify( c->data );
+        memcpy( c->data , &c->header , sizeof(MSGHEADER) );
+        c->dataRead = sizeof(MSGHEADER);
+        return true;
+    }
+
+    /**
+     * Reads whatever has arrived of the next message on c without waiting for the rest, which
+     * is kept in c for the next call. Fills in m once the whole message has been read.
+     */
+    ReadResult readAvailable( Connection* c , Message* m ) {
+        int fd = c->port->psock->rawFD();
+
+        while ( true ) {
+            char* buf;
+            int want;
+            if ( ! c->data ) {
+                buf = reinterpret_cast<char*>( &c->header ) + c->headerRead;
+                want = sizeof(MSGHEADER) - c->headerRead;
+            }
+            else {
+                buf = reinterpret_cast<char*>( c->data ) + c->dataRead;
+                want = c->header.messageLength - c->dataRead;
+            }
+
+            if ( want > 0 ) {
+                int n = ::recv( fd , buf , want , MSG_DONTWAIT );
+                if ( n < 0 ) {
+                    if ( errno == EINTR )
+                        continue;
+                    if ( errno == EAGAIN || errno == EWOULDBLOCK )
+                        return READ_PARTIAL;
+                    LOG(1) << "recv() " << errnoWithDescription() << ' ' << c->otherSide << endl;
+                    return READ_CLOSED;
+                }
+                if ( n == 0 )
+                    return READ_CLOSED;
+
+                c->bytesRead += n;
+                if ( ! c->data ) {
+                    c->headerRead += n;
+                    bool headerDone = c->headerRead == static_cast<int>( sizeof(MSGHEADER) );
+                    if ( headerDone && ! startMessage( c ) )
+                        return READ_CLOSED;
+                    continue;
+                }
+                c->dataRead += n;
+                want -= n;
+            }
+
+            if ( want == 0 ) {
+                m->setData( c->data , true );
+                c->data = NULL;
+                c->headerRead = 0;
+                c->dataRead = 0;
+                return READ_COMPLETE;
+            }
+        }
+    }
+
+    class ConnectionWorkerPool;
+
+    // the pool the current thread works for, if any, how many BlockingSections it has open, and
+    // whether a worker was started in its place when the first was opened
+    __thread ConnectionWorkerPool* servicingPool = NULL;
+    __thread int blockingDepth = 0;
+    __thread bool blockingReplaced = false;
+
+    /**
+     * Services connections from a pool of worker threads instead of a thread each.
+     *
+     * Idle connections cost no thread: they sit in an epoll set, registered one-shot, until
+     * they become readable. The poller thread then queues the connection for a worker, which
+     * reads what has arrived without waiting for more. A connection whose message is still
+     * incomplete goes back in the epoll set, so slow clients don't hold workers. Once a whole
+     * message is in, the worker attaches the handler's state for the connection, processes the
+     * message, detaches the state again and re-arms the connection. A connection is only ever
+     * in the epoll set, queued, or with one worker.
+     *
+     * A request that waits on something other than the server (see BlockingSection) has
+     * another worker started in its place while it waits, so the pool has nThreads workers that
+     * aren't blocked, up to connectionWorkerMaxThreads in all. Past that the request is told to
+     * end its wait early if it can; a wait that can't (replication of a write) holds its worker.
+     * Extra workers retire after a second with nothing to do once the blocked requests have
+     * returned.
+     */
+    class ConnectionWorkerPool {
+    public:
+        ConnectionWorkerPool( MessageHandler* handler , int nThreads ) :
+            _handler( handler ), _nThreads( nThreads ), _mutex( "ConnectionWorkerPool" ),
+            _threads( 0 ), _blocked( 0 ) {
+            _epfd = epoll_create1( EPOLL_CLOEXEC );
+            if ( _epfd < 0 ) {
+                error() << "epoll_create1 failed: " << errnoWithDescription() << endl;
+                fassertFailed( 18601 );
+            }
+
+            {
+                mutex::scoped_lock lk( _mutex );
+                for ( int i = 0; i < nThreads; i++ )
+                    startWorker( lk );
+            }
+            BlockingSection::enterHook = &ConnectionWorkerPool::enterBlocking;
+            BlockingSection::leaveHook = &ConnectionWorkerPool::leaveBlocking;
+
+            boost::thread poller( boost::bind( &ConnectionWorkerPool::pollConnections, this ) );
+        }
+
+        /** takes ownership of p, for which a connection ticket has already been acquired */
+        void add( MessagingPort* p ) {
+            p->psock->setLogLevel(logger::LogSeverity::Debug(1));
+            Connection* c = new Connection( p );
+            c->otherSide = p->psock->remoteString();
+            c->lastError = new LastError();
+            arm( c , EPOLL_CTL_ADD );
+        }
+
+    private:
+        void pollConnections() {
+            setThreadName( "connPoller" );
+
+            const int maxEvents = 256;
+            epoll_event events[maxEvents];
+
+            while ( ! inShutdown() ) {
+                int n = epoll_wait( _epfd , events , maxEvents , 1000 );
+                if ( n < 0 ) {
+                    if ( errno == EINTR )
+                        continue;
+                    error() << "epoll_wait failed: " << errnoWithDescription() << endl;
+                    fassertFailed( 18602 );
+                }
+
+                mutex::scoped_lock lk( _mutex );
+                for ( int i = 0; i < n; i++ ) {
+                    _ready.push_back( static_cast<Connection*>( events[i].data.ptr ) );
+                    _wake.notify_one();
+                }
+            }
+        }
+
+        /** must hold _mutex. @return false if the thread couldn't be started */
+        bool startWorker( mutex::scoped_lock& ) {
+            try {
+                boost::thread worker( boost::bind( &ConnectionWorkerPool::work , this ) );
+                _threads++;
+                return true;
+            }
+            catch ( boost::thread_resource_error& ) {
+                warning() << "can't start connection worker thread, " << _threads
+                          << " running, " << _blocked << " blocked" << endl;
+                return false;
+            }
+        }
+
+        void work() {
+            setThreadName( "connWorker" );
+            servicingPool = this;
+
+            bool idle = false;
+            while ( true ) {
+                Connection* c;
+                {
+                    mutex::scoped_lock lk( _mutex );
+                    while ( _ready.empty() ) {
+                        // workers started in place of blocked ones stay until they've been
+                        // idle a while, in case more requests block
+                        if ( inShutdown() || ( idle && _threads - _blocked > _nThreads ) ) {
+                            _threads--;
+                            return;
+                        }
+                        idle = ! _wake.timed_wait( lk.boost() , boost::posix_time::seconds( 1 ) );
+                    }
+                    idle = false;
+                    c = _ready.front();
+                    _ready.pop_front();
+                }
+                service( c );
+            }
+        }
+
+        static bool enterBlocking() {
+            if ( ! servicingPool )
+                return true;
+            if ( blockingDepth++ == 0 )
+                blockingReplaced = servicingPool->block();
+            return blockingReplaced;
+        }
+
+        static void leaveBlocking() {
+            if ( servicingPool && --blockingDepth == 0 )
+                servicingPool->unblock();
+        }
+
+        /** @return false if no worker could be started in the blocked one's place */
+        bool block() {
+            mutex::scoped_lock lk( _mutex );
+            _blocked++;
+            if ( _threads - _blocked >= _nThreads )
+                return true;
+            int maxThreads = connectionWorkerMaxThreads > 0 ? connectionWorkerMaxThreads
+                                                            : 10 * _nThreads;
+            return _threads < maxThreads && startWorker( lk );
+        }
+
+        void unblock() {
+            mutex::scoped_lock lk( _mutex );
+            _blocked--;
+        }
+
+        void service( Connection* c ) {
+            Message m;
+            ReadResult read = inShutdown() ? READ_CLOSED : readAvailable( c , &m );
+            if ( read == READ_PARTIAL ) {
+                arm( c , EPOLL_CTL_MOD );
+                return;
+            }
+
+            setThreadName( c->threadName.c_str() );
+            lastError.reset( c->lastError );
+            if ( c->connected )
+                _handler->attach( c->port.get() , c->state.release() );
+
+            if ( read == READ_COMPLETE && handleNextMessage( c , _handler , &m ) ) {
+                c->state.reset( _handler->detach( c->port.get() ) );
+                lastError.release();
+                setThreadName( "connWorker" );
+                arm( c , EPOLL_CTL_MOD );
+                return;
+            }
+
+            if ( read == READ_CLOSED )
+                endConnection( c );
+
+            if ( c->connected ) {
+                _handler->disconnected( c->port.get() );
+                delete _handler->detach( c->port.get() );
+            }
+            lastError.release();
+            close( c );
+            setThreadName( "connWorker" );
+        }
+
+        /** (re)registers c for a single readable event */
+        void arm( Connection* c , int op ) {
+            epoll_event event;
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.ptr = c;
+            if ( epoll_ctl( _epfd , op , c->port->psock->rawFD() , &event ) != 0 ) {
+                error() << "epoll_ctl failed, closing connection: " << errnoWithDescription() << endl;
+                c->port->shutdown();
+                if ( c->connected ) {
+                    // the state was detached by our caller; it goes away with the connection
+                    _handler->attach( c->port.get() , c->state.release() );
+                    _handler->disconnected( c->port.get() );
+                    delete _handler->detach( c->port.get() );
+                }
+                close( c );
+            }
+        }
+
+        /** destroys c, whose LastError must not be attached to any thread */
+        void close( Connection* c ) {
+            delete c->lastError;
+            delete c; // closing the socket also removes it from the epoll set
+            Listener::globalTicketHolder.release();
+        }
+
+        MessageHandler* _handler;
+        const int _nThreads;
+        int _epfd;
+
+        mutex _mutex; // guards the rest
+        boost::condition _wake;
+        std::deque<Connection*> _ready; // readable connections waiting for a worker
+        int _threads;
+        int _blocked; // workers in a BlockingSection
+    };
+#endif
+
+}
+
     class PortMessageServer : public MessageServer , public Listener {
     public:
         /**
@@ -64,6 +498,13 @@ namespace mongo {
                 return;
             }
 
+#ifdef __linux__
+            if ( _workerPool ) {
+                _workerPool->add( p );
+                return;
+            }
+#endif
+
             try {
 #ifndef __linux__  // TODO: consider making this ifdef _WIN32
                 {
@@ -130,6 +571,8 @@ namespace mongo {
         }
 
         void run() {
+            if ( connectionWorkerThreads > 0 )
+                startWorkerPool();
             initAndListen();
         }
 
@@ -138,6 +581,34 @@ namespace mongo {
     private:
         MessageHandler* _handler;
 
+#ifdef __linux__
+        scoped_ptr<ConnectionWorkerPool> _workerPool;
+#endif
+
+        void startWorkerPool() {
+            if ( ! _handler->canDetach() ) {
+                warning() << "connectionWorkerThreads is not supported by this server, "
+                          << "using a thread per connection" << endl;
+                return;
+            }
+#ifdef MONGO_SSL
+            if ( getSSLManager() ) {
+                // SSL may have buffered input that epoll can't see
+                warning() << "connectionWorkerThreads is not supported with SSL, "
+                          << "using a thread per connection" << endl;
+                return;
+            }
+#endif
+#ifdef __linux__
+            log() << "servicing connections with " << connectionWorkerThreads
+                  << " worker threads" << endl;
+            _workerPool.reset( new ConnectionWorkerPool( _handler , connectionWorkerThreads ) );
+#else
+            warning() << "connectionWorkerThreads is only supported on Linux, "
+                      << "using a thread per connection" << endl;
+#endif
+        }
+
         /**
          * Simple holder for threadRun parameters. Should not destroy the objects it holds -
          * it is the responsibility of the caller to take care of them.
@@ -170,65 +641,16 @@ namespace mongo {
             MessagingPort* inPort = himArg->inPort;
             MessageHandler* handler = himArg->handler;
 
-            {
-                string threadName = "conn";
-                if ( inPort->connectionId() > 0 )
-                    threadName = str::stream() << threadName << inPort->connectionId();
-                setThreadName( threadName.c_str() );
-            }
-
             verify( inPort );
-            inPort->psock->setLogLevel(logger::LogSeverity::Debug(1));
-            scoped_ptr<MessagingPort> p( inPort );
-
-            string otherSide;
+            Connection c( inPort );
+            setThreadName( c.threadName.c_str() );
 
-            Message m;
-            try {
-                LastError * le = new LastError();
-                lastError.reset( le ); // lastError now has ownership
-
-                otherSide = p->psock->remoteString();
-
-                handler->connected( p.get() );
-
-                while ( ! inShutdown() ) {
-                    m.reset();
-                    p->psock->clearCounters();
+            inPort->psock->setLogLevel(logger::LogSeverity::Debug(1));
 
-                    if ( ! p->recv(m) ) {
-                        if (!serverGlobalParams.quiet) {
-                            int conns = Listener::globalTicketHolder.used()-1;
-                            const char* word = (conns == 1 ? " connection" : " connections");
-                            log() << "end connection " << otherSide << " (" << conns << word << " now open)" << endl;
-                        }
-                        p->shutdown();
-                        break;
-                    }
+            c.lastError = new LastError();
+            lastError.reset( c.lastError ); // lastError now has ownership
 
-                    handler->process( m , p.get() , le );
-                    networkCounter.hit( p->psock->getBytesIn() , p->psock->getBytesOut() );
-                }
-            }
-            catch ( AssertionException& e ) {
-                log() << "AssertionException handling request, closing client connection: " << e << endl;
-                p->shutdown();
-            }
-            catch ( SocketException& e ) {
-                log() << "SocketException handling request, closing client connection: " << e << endl;
-                p->shutdown();
-            }
-            catch ( const DBException& e ) { // must be right above std::exception to avoid catching subclasses
-                log() << "DBException handling request, closing client connection: " << e << endl;
-                p->shutdown();
-            }
-            catch ( std::exception &e ) {
-                error() << "Uncaught std::exception: " << e.what() << ", terminating" << endl;
-                dbexit( EXIT_UNCAUGHT );
-            }
-            catch ( ... ) {
-                error() << "Uncaught exception, terminating" << endl;
-                dbexit( EXIT_UNCAUGHT );
+            while ( ! inShutdown() && handleNextMessage( &c , handler ) ) {
             }
 
             // Normal disconnect path.
@@ -237,7 +659,7 @@ namespace mongo {
             if (manager)
                 manager->cleanupThreadLocals();
 #endif
-            handler->disconnected( p.get() );
+            handler->disconnected( inPort );
 
             return NULL;
         }